@@ -192,6 +192,28 @@ struct definition_sequence *_bt_python_get_sequence_from_def(
 	return NULL;
 }
 
+/*
+ * Return the packed elements of an integer array or sequence as a bytes
+ * object, or None if they are not read packed.
+ */
+PyObject *_bt_python_get_int_array(struct bt_definition *field)
+{
+	struct bt_declaration *decl, *elem_decl;
+	const void *data;
+	uint64_t len;
+
+	data = bt_ctf_get_int_array(field, &len);
+	if (!data)
+		Py_RETURN_NONE;
+	decl = (struct bt_declaration *) bt_ctf_get_decl_from_def(field);
+	if (bt_ctf_field_type(decl) == CTF_TYPE_ARRAY)
+		elem_decl = _bt_python_get_array_element_declaration(decl);
+	else
+		elem_decl = _bt_python_get_sequence_element_declaration(decl);
+	return PyBytes_FromStringAndSize(data,
+		len * (bt_ctf_get_int_len(elem_decl) / CHAR_BIT));
+}
+
 int _bt_python_field_integer_get_signedness(const struct bt_ctf_field *field)
 {
 	int ret;
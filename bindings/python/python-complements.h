@@ -18,6 +18,7 @@
  * all copies or substantial portions of the Software.
  */
 
+#include <Python.h>
 #include <stdio.h>
 #include <glib.h>
 #include <babeltrace/babeltrace.h>
@@ -64,6 +65,7 @@ struct bt_declaration *_bt_python_get_sequence_element_declaration(
 		struct bt_declaration *field);
 const char *_bt_python_get_array_string(struct bt_definition *field);
 const char *_bt_python_get_sequence_string(struct bt_definition *field);
+PyObject *_bt_python_get_int_array(struct bt_definition *field);
 
 /* ctf ir */
 int _bt_python_field_integer_get_signedness(const struct bt_ctf_field *field);
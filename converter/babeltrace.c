@@ -36,6 +36,7 @@
 #include <babeltrace/ctf/events.h>
 /* TODO: fix object model for format-agnostic callbacks */
 #include <babeltrace/ctf/events-internal.h>
+#include <babeltrace/ctf/metadata.h>
 #include <babeltrace/ctf/iterator.h>
 #include <babeltrace/ctf-text/types.h>
 #include <babeltrace/iterator.h>
@@ -45,7 +46,9 @@
 #include <ctype.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <fcntl.h>
+#include <signal.h>
 #include <unistd.h>
 #include <inttypes.h>
 #include <ftw.h>
@@ -72,6 +75,10 @@ static char *opt_input_format, *opt_output_format;
  */
 static GPtrArray *opt_input_paths;
 static char *opt_output_path;
+static char *opt_event_names;
+static int opt_decode_threads;
+static int opt_jobs;
+static enum bt_iter_merge opt_merge;
 
 static struct bt_format *fmt_read;
 
@@ -103,6 +110,14 @@ enum {
 	OPT_CLOCK_DATE,
 	OPT_CLOCK_GMT,
 	OPT_CLOCK_FORCE_CORRELATE,
+	OPT_DECODER,
+	OPT_EVENTS,
+	OPT_MMAP_WINDOW,
+	OPT_INDEX_CACHE,
+	OPT_TIME_INDEX,
+	OPT_DECODE_THREADS,
+	OPT_JOBS,
+	OPT_MERGE,
 };
 
 /*
@@ -132,6 +147,14 @@ static struct poptOption long_options[] = {
 	{ "clock-date", 0, POPT_ARG_NONE, NULL, OPT_CLOCK_DATE, NULL, NULL },
 	{ "clock-gmt", 0, POPT_ARG_NONE, NULL, OPT_CLOCK_GMT, NULL, NULL },
 	{ "clock-force-correlate", 0, POPT_ARG_NONE, NULL, OPT_CLOCK_FORCE_CORRELATE, NULL, NULL },
+	{ "decoder", 0, POPT_ARG_STRING, NULL, OPT_DECODER, NULL, NULL },
+	{ "events", 0, POPT_ARG_STRING, NULL, OPT_EVENTS, NULL, NULL },
+	{ "mmap-window", 0, POPT_ARG_STRING, NULL, OPT_MMAP_WINDOW, NULL, NULL },
+	{ "index-cache", 0, POPT_ARG_NONE, NULL, OPT_INDEX_CACHE, NULL, NULL },
+	{ "time-index", 0, POPT_ARG_NONE, NULL, OPT_TIME_INDEX, NULL, NULL },
+	{ "decode-threads", 0, POPT_ARG_STRING, NULL, OPT_DECODE_THREADS, NULL, NULL },
+	{ "jobs", 'j', POPT_ARG_STRING, NULL, OPT_JOBS, NULL, NULL },
+	{ "merge", 0, POPT_ARG_STRING, NULL, OPT_MERGE, NULL, NULL },
 	{ NULL, 0, 0, NULL, 0, NULL, NULL },
 };
 
@@ -177,6 +200,21 @@ static void usage(FILE *fp)
 	fprintf(fp, "      --clock-gmt                Print clock in GMT time zone (default: local time zone)\n");
 	fprintf(fp, "      --clock-force-correlate    Assume that clocks are inherently correlated\n");
 	fprintf(fp, "                                 across traces.\n");
+	fprintf(fp, "      --decoder plan|tree        Decode events with compiled per-event plans\n");
+	fprintf(fp, "                                 or by walking the definition tree (default: plan)\n");
+	fprintf(fp, "      --events name1<,name2,...> Only output events of the named classes\n");
+	fprintf(fp, "      --mmap-window MiB          Length of the trace file windows mapped in memory\n");
+	fprintf(fp, "                                 (default: 64, 0: map each packet separately)\n");
+	fprintf(fp, "      --index-cache              Cache the packet indexes of traces without index\n");
+	fprintf(fp, "                                 files in the user cache directory\n");
+	fprintf(fp, "      --time-index               Record seek points within packets while reading,\n");
+	fprintf(fp, "                                 and keep them in the user cache directory\n");
+	fprintf(fp, "      --decode-threads N         Decode events ahead on N worker threads\n");
+	fprintf(fp, "                                 (default: 0, decode on the reading thread)\n");
+	fprintf(fp, "  -j, --jobs N                   Convert N time slices of the traces in parallel\n");
+	fprintf(fp, "                                 (text output only, default: 1)\n");
+	fprintf(fp, "      --merge heap|loser-tree    Structure merging the streams by timestamp\n");
+	fprintf(fp, "                                 (default: heap, loser-tree for many streams)\n");
 	list_formats(fp);
 	fprintf(fp, "\n");
 }
@@ -396,6 +434,142 @@ static int parse_options(int argc, char **argv)
 		case OPT_CLOCK_FORCE_CORRELATE:
 			opt_clock_force_correlate = 1;
 			break;
+		case OPT_DECODER:
+		{
+			char *str;
+
+			str = (char *) poptGetOptArg(pc);
+			if (!str) {
+				fprintf(stderr, "[error] Missing --decoder argument\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			if (!strcmp(str, "plan")) {
+				opt_tree_decoder = 0;
+			} else if (!strcmp(str, "tree")) {
+				opt_tree_decoder = 1;
+			} else {
+				fprintf(stderr, "[error] Incorrect --decoder argument: %s\n", str);
+				ret = -EINVAL;
+				free(str);
+				goto end;
+			}
+			free(str);
+			break;
+		}
+		case OPT_MERGE:
+		{
+			char *str;
+
+			str = (char *) poptGetOptArg(pc);
+			if (!str) {
+				fprintf(stderr, "[error] Missing --merge argument\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			if (!strcmp(str, "heap")) {
+				opt_merge = BT_ITER_MERGE_HEAP;
+			} else if (!strcmp(str, "loser-tree")) {
+				opt_merge = BT_ITER_MERGE_LOSER_TREE;
+			} else {
+				fprintf(stderr, "[error] Incorrect --merge argument: %s\n", str);
+				ret = -EINVAL;
+				free(str);
+				goto end;
+			}
+			free(str);
+			break;
+		}
+		case OPT_INDEX_CACHE:
+			opt_index_cache = 1;
+			break;
+		case OPT_TIME_INDEX:
+			opt_time_index = 1;
+			break;
+		case OPT_DECODE_THREADS:
+		{
+			char *str;
+			char *endptr;
+			unsigned long nr_threads;
+
+			str = (char *) poptGetOptArg(pc);
+			if (!str) {
+				fprintf(stderr, "[error] Missing --decode-threads argument\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			errno = 0;
+			nr_threads = strtoul(str, &endptr, 0);
+			if (*endptr != '\0' || str == endptr || errno != 0
+					|| nr_threads > INT_MAX) {
+				fprintf(stderr, "[error] Incorrect --decode-threads argument: %s\n", str);
+				ret = -EINVAL;
+				free(str);
+				goto end;
+			}
+			opt_decode_threads = nr_threads;
+			free(str);
+			break;
+		}
+		case OPT_JOBS:
+		{
+			char *str;
+			char *endptr;
+			unsigned long nr_jobs;
+
+			str = (char *) poptGetOptArg(pc);
+			if (!str) {
+				fprintf(stderr, "[error] Missing --jobs argument\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			errno = 0;
+			nr_jobs = strtoul(str, &endptr, 0);
+			if (*endptr != '\0' || str == endptr || errno != 0
+					|| nr_jobs == 0 || nr_jobs > INT_MAX) {
+				fprintf(stderr, "[error] Incorrect --jobs argument: %s\n", str);
+				ret = -EINVAL;
+				free(str);
+				goto end;
+			}
+			opt_jobs = nr_jobs;
+			free(str);
+			break;
+		}
+		case OPT_MMAP_WINDOW:
+		{
+			char *str;
+			char *endptr;
+			unsigned long long window;
+
+			str = (char *) poptGetOptArg(pc);
+			if (!str) {
+				fprintf(stderr, "[error] Missing --mmap-window argument\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			errno = 0;
+			window = strtoull(str, &endptr, 0);
+			if (*endptr != '\0' || str == endptr || errno != 0
+					|| window > (SIZE_MAX >> 20)) {
+				fprintf(stderr, "[error] Incorrect --mmap-window argument: %s\n", str);
+				ret = -EINVAL;
+				free(str);
+				goto end;
+			}
+			opt_mmap_window = window << 20;
+			free(str);
+			break;
+		}
+		case OPT_EVENTS:
+			free(opt_event_names);
+			opt_event_names = (char *) poptGetOptArg(pc);
+			if (!opt_event_names) {
+				fprintf(stderr, "[error] Missing --events argument\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			break;
 
 		default:
 			ret = -EINVAL;
@@ -617,14 +791,84 @@ end:
 	return ret;
 }
 
+static
+struct bt_ctf_iter *create_convert_iter(struct bt_context *ctx,
+		const struct bt_iter_pos *end_pos)
+{
+	struct bt_ctf_iter *iter;
+	struct bt_iter_pos begin_pos;
+	int ret;
+
+	begin_pos.type = BT_SEEK_BEGIN;
+	iter = bt_ctf_iter_create_merge(ctx, &begin_pos, end_pos, opt_merge);
+	if (!iter)
+		return NULL;
+	/* Events are written out before the iterator moves on. */
+	ret = bt_ctf_iter_set_zero_copy_strings(iter, 1);
+	if (ret)
+		goto error;
+	if (opt_decode_threads) {
+		ret = bt_ctf_iter_set_decode_threads(iter, opt_decode_threads);
+		if (ret) {
+			fprintf(stderr, "[error] Cannot start decode threads.\n");
+			goto error;
+		}
+	}
+	if (opt_event_names) {
+		char *strlist, *str, *strctx;
+
+		strlist = strdup(opt_event_names);
+		if (!strlist)
+			goto error;
+		for (str = strtok_r(strlist, ",", &strctx); str;
+				str = strtok_r(NULL, ",", &strctx)) {
+			ret = bt_ctf_iter_select_event(iter, str);
+			if (ret == -ENOENT) {
+				fprintf(stderr, "[warning] No event class named \"%s\" in the traces.\n",
+					str);
+				ret = 0;
+			}
+			if (ret)
+				break;
+		}
+		free(strlist);
+		if (ret) {
+			fprintf(stderr, "[error] Cannot select events.\n");
+			goto error;
+		}
+	}
+	return iter;
+
+error:
+	bt_ctf_iter_destroy(iter);
+	return NULL;
+}
+
+static
+int write_events(struct ctf_text_stream_pos *sout, struct bt_ctf_iter *iter)
+{
+	struct bt_ctf_event *ctf_event;
+	int ret;
+
+	while ((ctf_event = bt_ctf_iter_read_event(iter))) {
+		ret = sout->parent.event_cb(&sout->parent, ctf_event->parent->stream);
+		if (ret) {
+			fprintf(stderr, "[error] Writing event failed.\n");
+			return ret;
+		}
+		ret = bt_iter_next(bt_ctf_get_iter(iter));
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
+
 static
 int convert_trace(struct bt_trace_descriptor *td_write,
 		  struct bt_context *ctx)
 {
 	struct bt_ctf_iter *iter;
 	struct ctf_text_stream_pos *sout;
-	struct bt_iter_pos begin_pos;
-	struct bt_ctf_event *ctf_event;
 	int ret;
 
 	sout = container_of(td_write, struct ctf_text_stream_pos,
@@ -633,27 +877,271 @@ int convert_trace(struct bt_trace_descriptor *td_write,
 	if (!sout->parent.event_cb)
 		return 0;
 
-	begin_pos.type = BT_SEEK_BEGIN;
-	iter = bt_ctf_iter_create(ctx, &begin_pos, NULL);
-	if (!iter) {
-		ret = -1;
-		goto error_iter;
+	iter = create_convert_iter(ctx, NULL);
+	if (!iter)
+		return -1;
+	ret = write_events(sout, iter);
+	bt_ctf_iter_destroy(iter);
+	return ret;
+}
+
+/*
+ * Parallel conversion (--jobs): the time range of the traces is split
+ * into slices starting at packet beginnings. Each slice is converted by
+ * a child process, which inherits the opened traces, into a temporary
+ * file, and the files are copied to the output in time order. All the
+ * events of a given timestamp belong to the same slice, so the output
+ * is the one of a single job.
+ */
+struct convert_job {
+	FILE *fp;
+	pid_t pid;
+};
+
+static
+int compare_timestamps(gconstpointer a, gconstpointer b)
+{
+	uint64_t ta = *(const uint64_t *) a, tb = *(const uint64_t *) b;
+
+	if (ta < tb)
+		return -1;
+	return ta > tb;
+}
+
+/*
+ * Return the sorted, distinct real timestamps at which the packets of
+ * the traces begin.
+ */
+static
+GArray *get_packet_begins(struct bt_context *ctx)
+{
+	struct trace_collection *tc = ctx->tc;
+	GArray *begins;
+	int i, j, k, l;
+
+	begins = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	for (i = 0; i < tc->array->len; i++) {
+		struct bt_trace_descriptor *td;
+		struct ctf_trace *trace;
+
+		td = g_ptr_array_index(tc->array, i);
+		if (!td)
+			continue;
+		trace = container_of(td, struct ctf_trace, parent);
+		for (j = 0; j < trace->streams->len; j++) {
+			struct ctf_stream_declaration *stream_class;
+
+			stream_class = g_ptr_array_index(trace->streams, j);
+			if (!stream_class)
+				continue;
+			for (k = 0; k < stream_class->streams->len; k++) {
+				struct ctf_file_stream *file_stream;
+				GArray *index;
+
+				file_stream = g_ptr_array_index(stream_class->streams, k);
+				if (!file_stream)
+					continue;
+				index = file_stream->pos.packet_index;
+				for (l = 0; index && l < index->len; l++) {
+					struct packet_index *packet;
+
+					packet = &g_array_index(index,
+							struct packet_index, l);
+					g_array_append_val(begins,
+							packet->ts_real.timestamp_begin);
+				}
+			}
+		}
 	}
-	while ((ctf_event = bt_ctf_iter_read_event(iter))) {
-		ret = sout->parent.event_cb(&sout->parent, ctf_event->parent->stream);
-		if (ret) {
-			fprintf(stderr, "[error] Writing event failed.\n");
-			goto end;
+	g_array_sort(begins, compare_timestamps);
+	for (i = 0, j = 0; i < begins->len; i++) {
+		uint64_t ts = g_array_index(begins, uint64_t, i);
+
+		if (j && g_array_index(begins, uint64_t, j - 1) == ts)
+			continue;
+		g_array_index(begins, uint64_t, j++) = ts;
+	}
+	g_array_set_size(begins, j);
+	return begins;
+}
+
+/*
+ * Set the timestamp the delta of the first event of a slice is relative
+ * to: the one of the last event output before the slice begins. It is
+ * looked for from packet beginnings further and further back.
+ */
+static
+int seed_slice_delta(struct ctf_text_stream_pos *sout,
+		struct bt_ctf_iter *iter, GArray *begins, unsigned long first)
+{
+	uint64_t slice_begin = g_array_index(begins, uint64_t, first);
+	unsigned long back = 1;
+
+	for (;;) {
+		unsigned long from = back < first ? first - back : 0;
+		struct bt_ctf_event *ctf_event;
+		struct bt_iter_pos pos;
+		int ret, found = 0;
+
+		pos.type = BT_SEEK_TIME;
+		pos.u.seek_time = g_array_index(begins, uint64_t, from);
+		ret = bt_iter_set_pos(bt_ctf_get_iter(iter), &pos);
+		if (ret)
+			return ret;
+		while ((ctf_event = bt_ctf_iter_read_event(iter))) {
+			struct ctf_stream_definition *stream =
+				ctf_event->parent->stream;
+
+			if (stream->real_timestamp >= slice_begin)
+				break;
+			if (stream->has_timestamp) {
+				sout->last_real_timestamp = stream->real_timestamp;
+				sout->last_cycles_timestamp = stream->cycles_timestamp;
+				found = 1;
+			}
+			ret = bt_iter_next(bt_ctf_get_iter(iter));
+			if (ret < 0)
+				return ret;
 		}
-		ret = bt_iter_next(bt_ctf_get_iter(iter));
-		if (ret < 0)
-			goto end;
+		if (found || from == 0)
+			return 0;
+		back <<= 1;
 	}
-	ret = 0;
+}
+
+/*
+ * Convert the events from packet beginning "first" (0: from the start)
+ * up to, excluding, packet beginning "last" (begins->len: to the end).
+ */
+static
+int convert_slice(struct ctf_text_stream_pos *sout, struct bt_context *ctx,
+		GArray *begins, unsigned long first, unsigned long last)
+{
+	struct bt_ctf_iter *iter;
+	struct bt_iter_pos end_pos;
+	int ret;
 
+	end_pos.type = BT_SEEK_TIME;
+	if (last < begins->len)
+		end_pos.u.seek_time = g_array_index(begins, uint64_t, last) - 1;
+	iter = create_convert_iter(ctx, last < begins->len ? &end_pos : NULL);
+	if (!iter)
+		return -1;
+	if (first) {
+		struct bt_iter_pos pos;
+
+		if (opt_delta_field) {
+			ret = seed_slice_delta(sout, iter, begins, first);
+			if (ret)
+				goto end;
+		}
+		pos.type = BT_SEEK_TIME;
+		pos.u.seek_time = g_array_index(begins, uint64_t, first);
+		ret = bt_iter_set_pos(bt_ctf_get_iter(iter), &pos);
+		if (ret)
+			goto end;
+	}
+	ret = write_events(sout, iter);
 end:
 	bt_ctf_iter_destroy(iter);
-error_iter:
+	return ret;
+}
+
+static
+int copy_slice(FILE *out, FILE *in)
+{
+	char buf[65536];
+	size_t len;
+
+	rewind(in);
+	while ((len = fread(buf, 1, sizeof(buf), in)) > 0) {
+		if (fwrite(buf, 1, len, out) != len)
+			return -1;
+	}
+	return ferror(in) ? -1 : 0;
+}
+
+static
+int convert_trace_jobs(struct bt_trace_descriptor *td_write,
+		  struct bt_context *ctx)
+{
+	struct ctf_text_stream_pos *sout;
+	struct convert_job *jobs;
+	GArray *begins;
+	unsigned long nr_jobs, i, started = 0;
+	int ret = 0;
+
+	sout = container_of(td_write, struct ctf_text_stream_pos,
+			trace_descriptor);
+
+	if (!sout->parent.event_cb)
+		return 0;
+
+	begins = get_packet_begins(ctx);
+	nr_jobs = MIN(opt_jobs, begins->len);
+	if (nr_jobs < 2) {
+		g_array_free(begins, TRUE);
+		return convert_trace(td_write, ctx);
+	}
+	jobs = g_new0(struct convert_job, nr_jobs);
+
+	/* Do not let the children write out what is buffered so far. */
+	if (ctf_text_flush(sout)) {
+		ret = -1;
+		goto wait;
+	}
+	fflush(NULL);
+	for (i = 0; i < nr_jobs; i++) {
+		jobs[i].fp = tmpfile();
+		if (!jobs[i].fp) {
+			perror("[error] Cannot create slice file");
+			ret = -1;
+			goto wait;
+		}
+		jobs[i].pid = fork();
+		if (jobs[i].pid < 0) {
+			perror("[error] Cannot start conversion job");
+			ret = -1;
+			goto wait;
+		}
+		if (jobs[i].pid == 0) {
+			sout->fp = jobs[i].fp;
+			sout->out.line_buffered = 0;
+			ret = convert_slice(sout, ctx, begins,
+					i * begins->len / nr_jobs,
+					(i + 1) * begins->len / nr_jobs);
+			if (ctf_text_flush(sout) || fflush(sout->fp))
+				ret = -1;
+			/* Leave the traces and their caches to the parent. */
+			_exit(ret ? EXIT_FAILURE : EXIT_SUCCESS);
+		}
+		started++;
+	}
+
+wait:
+	for (i = 0; i < started; i++) {
+		int status;
+
+		if (ret)
+			kill(jobs[i].pid, SIGTERM);
+		if (waitpid(jobs[i].pid, &status, 0) < 0
+				|| !WIFEXITED(status)
+				|| WEXITSTATUS(status) != EXIT_SUCCESS) {
+			fprintf(stderr, "[error] Conversion job %lu failed.\n", i);
+			ret = -1;
+			continue;
+		}
+		if (!ret && copy_slice(sout->fp, jobs[i].fp)) {
+			perror("[error] Cannot copy slice to output");
+			ret = -1;
+		}
+	}
+	for (i = 0; i < nr_jobs; i++) {
+		if (jobs[i].fp)
+			fclose(jobs[i].fp);
+	}
+	g_free(jobs);
+	g_array_free(begins, TRUE);
 	return ret;
 }
 
@@ -774,7 +1262,10 @@ int main(int argc, char **argv)
 
 	/* For now, we support only CTF iterators */
 	if (fmt_read->name == g_quark_from_static_string("ctf")) {
-		ret = convert_trace(td_write, ctx);
+		if (opt_jobs > 1 && !strcmp(opt_output_format, "text"))
+			ret = convert_trace_jobs(td_write, ctx);
+		else
+			ret = convert_trace(td_write, ctx);
 		if (ret) {
 			fprintf(stderr, "Error printing trace.\n\n");
 			goto error_copy_trace;
@@ -807,6 +1298,7 @@ end:
 	free(opt_input_format);
 	free(opt_output_format);
 	free(opt_output_path);
+	free(opt_event_names);
 	g_ptr_array_free(opt_input_paths, TRUE);
 	if (partial_error)
 		exit(EXIT_FAILURE);
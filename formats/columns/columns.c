@@ -0,0 +1,823 @@
+/*
+ * BabelTrace - Columnar export format
+ *
+ * Writes a directory of column files per event class, laid out as
+ * described in doc/columns.txt.
+ *
+ * Copyright 2015 EfficiOS Inc. and Linux Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/format.h>
+#include <babeltrace/format-internal.h>
+#include <babeltrace/ctf/types.h>
+#include <babeltrace/ctf/metadata.h>
+#include <babeltrace/babeltrace-internal.h>
+#include <babeltrace/ctf-text/types.h>
+#include <babeltrace/ctf-text/buffer.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/* Rows of an event class kept in memory before being written out */
+#define COLUMNS_BATCH_ROWS	4096
+
+#define COLUMNS_MANIFEST	"columns.txt"
+#define COLUMNS_VERSION		1
+
+enum column_type {
+	COLUMN_TIMESTAMP,	/* int64 deltas */
+	COLUMN_UNSIGNED,
+	COLUMN_SIGNED,
+	COLUMN_FLOAT,		/* float64 */
+	COLUMN_STRING,		/* uint64 end offsets and bytes */
+};
+
+struct column {
+	char *name;
+	enum column_type type;
+	unsigned int size;		/* Value size, in bytes */
+	struct ctf_text_buffer values;	/* Values not yet written out */
+	struct ctf_text_buffer data;	/* STRING: bytes not yet written out */
+	uint64_t data_len;		/* STRING: total bytes */
+};
+
+/* Rows of the event classes of the same name and fields */
+struct column_table {
+	char *dir;			/* Directory name within the output */
+	GQuark event_name;
+	GPtrArray *columns;		/* Array of struct column pointers */
+	uint64_t nr_rows;
+	unsigned int nr_pending;	/* Rows not yet written out */
+	uint64_t last_timestamp;	/* Timestamp of the last row, in ns */
+};
+
+/*
+ * The converter accesses output positions as struct ctf_text_stream_pos,
+ * only through their stream position and trace descriptor.
+ */
+struct columns_stream_pos {
+	struct ctf_text_stream_pos parent;
+	char *path;			/* Output directory */
+	GPtrArray *tables;		/* Array of struct column_table pointers */
+	GHashTable *tables_by_class;	/* ctf_event_declaration to table */
+};
+
+/* Scopes exported, in column order after the timestamp */
+enum column_scope {
+	SCOPE_STREAM_PACKET_CONTEXT,
+	SCOPE_STREAM_EVENT_CONTEXT,
+	SCOPE_EVENT_CONTEXT,
+	SCOPE_EVENT_FIELDS,
+	NR_SCOPES,
+};
+
+static const char *scope_names[NR_SCOPES] = {
+	[ SCOPE_STREAM_PACKET_CONTEXT ] = "stream.packet.context",
+	[ SCOPE_STREAM_EVENT_CONTEXT ] = "stream.event.context",
+	[ SCOPE_EVENT_CONTEXT ] = "event.context",
+	[ SCOPE_EVENT_FIELDS ] = "event.fields",
+};
+
+static
+struct bt_trace_descriptor *columns_open_trace(const char *path, int flags,
+		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
+			int whence), FILE *metadata_fp);
+static
+int columns_close_trace(struct bt_trace_descriptor *descriptor);
+
+static
+struct bt_format columns_format = {
+	.open_trace = columns_open_trace,
+	.close_trace = columns_close_trace,
+};
+
+static
+void event_scopes(struct ctf_stream_definition *stream,
+		struct ctf_event_definition *event,
+		struct definition_struct *scopes[NR_SCOPES])
+{
+	scopes[SCOPE_STREAM_PACKET_CONTEXT] = stream->stream_packet_context;
+	scopes[SCOPE_STREAM_EVENT_CONTEXT] = stream->stream_event_context;
+	scopes[SCOPE_EVENT_CONTEXT] = event->event_context;
+	scopes[SCOPE_EVENT_FIELDS] = event->event_fields;
+}
+
+/* Integers encoding characters, read as strings within arrays */
+static
+int is_char_declaration(struct bt_declaration *declaration)
+{
+	struct declaration_integer *integer_declaration;
+
+	if (declaration->id != CTF_TYPE_INTEGER)
+		return 0;
+	integer_declaration = container_of(declaration,
+		struct declaration_integer, p);
+	return integer_declaration->encoding == CTF_STRING_UTF8
+		|| integer_declaration->encoding == CTF_STRING_ASCII;
+}
+
+static
+unsigned int integer_size(const struct declaration_integer *declaration)
+{
+	if (declaration->len <= 8)
+		return 1;
+	if (declaration->len <= 16)
+		return 2;
+	if (declaration->len <= 32)
+		return 4;
+	return 8;
+}
+
+static
+void add_column(GPtrArray *columns, const char *name, enum column_type type,
+		unsigned int size)
+{
+	struct column *column = g_new0(struct column, 1);
+
+	column->name = g_strdup(name);
+	column->type = type;
+	column->size = size;
+	g_ptr_array_add(columns, column);
+}
+
+static
+void add_integer_column(GPtrArray *columns, const char *name,
+		const struct declaration_integer *declaration)
+{
+	add_column(columns, name,
+		declaration->signedness ? COLUMN_SIGNED : COLUMN_UNSIGNED,
+		integer_size(declaration));
+}
+
+/*
+ * Append the columns of a definition, named after its path from the
+ * scope. Structures and fixed-size arrays are flattened, arrays and
+ * sequences of characters are strings. Variants and other sequences,
+ * whose fields vary from one event to the next, are left out.
+ */
+static
+void add_columns(GPtrArray *columns, GString *name,
+		struct bt_definition *definition)
+{
+	struct bt_declaration *declaration = definition->declaration;
+	size_t name_len = name->len;
+	uint64_t i;
+
+	switch (declaration->id) {
+	case CTF_TYPE_INTEGER:
+		add_integer_column(columns, name->str,
+			container_of(declaration, struct declaration_integer, p));
+		break;
+	case CTF_TYPE_ENUM:
+		add_integer_column(columns, name->str,
+			container_of(declaration, struct declaration_enum, p)
+				->integer_declaration);
+		break;
+	case CTF_TYPE_FLOAT:
+		add_column(columns, name->str, COLUMN_FLOAT, 8);
+		break;
+	case CTF_TYPE_STRING:
+		add_column(columns, name->str, COLUMN_STRING, 8);
+		break;
+	case CTF_TYPE_STRUCT:
+	{
+		struct definition_struct *struct_definition =
+			container_of(definition, struct definition_struct, p);
+
+		for (i = 0; i < struct_definition->fields->len; i++) {
+			struct bt_definition *field =
+				g_ptr_array_index(struct_definition->fields, i);
+
+			g_string_append_printf(name, ".%s",
+				rem_(g_quark_to_string(field->name)));
+			add_columns(columns, name, field);
+			g_string_truncate(name, name_len);
+		}
+		break;
+	}
+	case CTF_TYPE_ARRAY:
+	{
+		struct definition_array *array_definition =
+			container_of(definition, struct definition_array, p);
+		struct declaration_array *array_declaration =
+			array_definition->declaration;
+
+		if (is_char_declaration(array_declaration->elem)) {
+			add_column(columns, name->str, COLUMN_STRING, 8);
+			break;
+		}
+		for (i = 0; i < array_declaration->len; i++) {
+			g_string_append_printf(name, "[%" PRIu64 "]", i);
+			add_columns(columns, name,
+				bt_array_index(array_definition, i));
+			g_string_truncate(name, name_len);
+		}
+		break;
+	}
+	case CTF_TYPE_SEQUENCE:
+	{
+		struct definition_sequence *sequence_definition =
+			container_of(definition, struct definition_sequence, p);
+
+		if (is_char_declaration(sequence_definition->declaration->elem))
+			add_column(columns, name->str, COLUMN_STRING, 8);
+		break;
+	}
+	case CTF_TYPE_VARIANT:
+	default:
+		break;
+	}
+}
+
+static
+void put_le(struct ctf_text_buffer *buf, uint64_t v, unsigned int size)
+{
+	char *p = ctf_text_reserve(buf, size);
+	unsigned int i;
+
+	for (i = 0; i < size; i++)
+		p[i] = (char) (v >> (8 * i));
+	buf->len += size;
+}
+
+static
+void put_string(struct column *column, const char *str, size_t len)
+{
+	ctf_text_write(&column->data, str, len);
+	column->data_len += len;
+	put_le(&column->values, column->data_len, 8);
+}
+
+/*
+ * Characters of an array or sequence, up to the first null character,
+ * as the text format prints them.
+ */
+static
+void put_char_elements(struct column *column, GString *string,
+		struct declaration_integer *elem, uint64_t len,
+		struct bt_definition *(*get_index)(void *container, uint64_t i),
+		void *container)
+{
+	uint64_t i;
+
+	/* Bytes are read into the string directly. */
+	if (!(elem->len == CHAR_BIT && elem->p.alignment == CHAR_BIT)) {
+		g_string_assign(string, "");
+		for (i = 0; i < len; i++) {
+			struct definition_integer *c =
+				container_of(get_index(container, i),
+					struct definition_integer, p);
+
+			g_string_append_c(string, (int) c->value._unsigned);
+		}
+	}
+	put_string(column, string->str, strlen(string->str));
+}
+
+static
+struct bt_definition *array_index(void *container, uint64_t i)
+{
+	return bt_array_index(container, i);
+}
+
+static
+struct bt_definition *sequence_index(void *container, uint64_t i)
+{
+	return bt_sequence_index(container, i);
+}
+
+static
+void put_integer(struct column *column,
+		const struct definition_integer *integer_definition)
+{
+	put_le(&column->values, integer_definition->value._unsigned,
+		column->size);
+}
+
+/*
+ * Append the values of a definition to the columns from index *nr,
+ * following the traversal of add_columns().
+ */
+static
+void put_values(struct column_table *table, unsigned int *nr,
+		struct bt_definition *definition)
+{
+	struct column *column;
+	uint64_t i;
+
+	switch (definition->declaration->id) {
+	case CTF_TYPE_INTEGER:
+		column = g_ptr_array_index(table->columns, (*nr)++);
+		put_integer(column, container_of(definition,
+			struct definition_integer, p));
+		break;
+	case CTF_TYPE_ENUM:
+		column = g_ptr_array_index(table->columns, (*nr)++);
+		put_integer(column, container_of(definition,
+			struct definition_enum, p)->integer);
+		break;
+	case CTF_TYPE_FLOAT:
+	{
+		union {
+			double d;
+			uint64_t u;
+		} v;
+
+		column = g_ptr_array_index(table->columns, (*nr)++);
+		v.d = container_of(definition, struct definition_float, p)->value;
+		put_le(&column->values, v.u, 8);
+		break;
+	}
+	case CTF_TYPE_STRING:
+	{
+		struct definition_string *string_definition =
+			container_of(definition, struct definition_string, p);
+
+		column = g_ptr_array_index(table->columns, (*nr)++);
+		put_string(column, string_definition->value,
+			strlen(string_definition->value));
+		break;
+	}
+	case CTF_TYPE_STRUCT:
+	{
+		struct definition_struct *struct_definition =
+			container_of(definition, struct definition_struct, p);
+
+		for (i = 0; i < struct_definition->fields->len; i++)
+			put_values(table, nr,
+				g_ptr_array_index(struct_definition->fields, i));
+		break;
+	}
+	case CTF_TYPE_ARRAY:
+	{
+		struct definition_array *array_definition =
+			container_of(definition, struct definition_array, p);
+		struct declaration_array *array_declaration =
+			array_definition->declaration;
+
+		if (is_char_declaration(array_declaration->elem)) {
+			column = g_ptr_array_index(table->columns, (*nr)++);
+			put_char_elements(column, array_definition->string,
+				container_of(array_declaration->elem,
+					struct declaration_integer, p),
+				array_declaration->len, array_index,
+				array_definition);
+			break;
+		}
+		for (i = 0; i < array_declaration->len; i++)
+			put_values(table, nr,
+				bt_array_index(array_definition, i));
+		break;
+	}
+	case CTF_TYPE_SEQUENCE:
+	{
+		struct definition_sequence *sequence_definition =
+			container_of(definition, struct definition_sequence, p);
+		struct bt_declaration *elem =
+			sequence_definition->declaration->elem;
+
+		if (!is_char_declaration(elem))
+			break;
+		column = g_ptr_array_index(table->columns, (*nr)++);
+		put_char_elements(column, sequence_definition->string,
+			container_of(elem, struct declaration_integer, p),
+			bt_sequence_len(sequence_definition), sequence_index,
+			sequence_definition);
+		break;
+	}
+	case CTF_TYPE_VARIANT:
+	default:
+		break;
+	}
+}
+
+static
+void destroy_columns(GPtrArray *columns)
+{
+	unsigned int i;
+
+	for (i = 0; i < columns->len; i++) {
+		struct column *column = g_ptr_array_index(columns, i);
+
+		g_free(column->name);
+		ctf_text_buffer_free(&column->values);
+		ctf_text_buffer_free(&column->data);
+		g_free(column);
+	}
+	g_ptr_array_free(columns, TRUE);
+}
+
+static
+int same_columns(GPtrArray *a, GPtrArray *b)
+{
+	unsigned int i;
+
+	if (a->len != b->len)
+		return 0;
+	for (i = 0; i < a->len; i++) {
+		struct column *ca = g_ptr_array_index(a, i),
+			*cb = g_ptr_array_index(b, i);
+
+		if (ca->type != cb->type || ca->size != cb->size
+				|| strcmp(ca->name, cb->name))
+			return 0;
+	}
+	return 1;
+}
+
+/* Column files: "<nr>" for values, "<nr>.data" for string bytes */
+static
+char *column_path(struct columns_stream_pos *pos, struct column_table *table,
+		unsigned int nr, const char *suffix)
+{
+	return g_strdup_printf("%s/%s/%u%s", pos->path, table->dir, nr,
+		suffix);
+}
+
+/* Append the pending output of a buffer to a file. */
+static
+int append_file(const char *path, struct ctf_text_buffer *buf, const char *mode)
+{
+	FILE *fp;
+	int ret;
+
+	fp = fopen(path, mode);
+	if (!fp) {
+		ret = -errno;
+		fprintf(stderr, "[error] Unable to open %s: %s\n", path,
+			strerror(errno));
+		return ret;
+	}
+	ret = ctf_text_buffer_flush(buf, fp);
+	if (fclose(fp) && !ret) {
+		ret = -errno;
+		fprintf(stderr, "[error] Unable to close %s: %s\n", path,
+			strerror(errno));
+	}
+	return ret;
+}
+
+/*
+ * Write out the pending rows of a table. The first call creates the
+ * column files, later ones append to them.
+ */
+static
+int flush_table(struct columns_stream_pos *pos, struct column_table *table)
+{
+	const char *mode = table->nr_rows == table->nr_pending ? "w" : "a";
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < table->columns->len && !ret; i++) {
+		struct column *column = g_ptr_array_index(table->columns, i);
+		char *path;
+
+		path = column_path(pos, table, i, "");
+		ret = append_file(path, &column->values, mode);
+		g_free(path);
+		if (column->type != COLUMN_STRING || ret)
+			continue;
+		path = column_path(pos, table, i, ".data");
+		ret = append_file(path, &column->data, mode);
+		g_free(path);
+	}
+	table->nr_pending = 0;
+	return ret;
+}
+
+static
+const char *column_type_name(const struct column *column)
+{
+	switch (column->type) {
+	case COLUMN_TIMESTAMP:
+		return "timestamp";
+	case COLUMN_STRING:
+		return "string";
+	case COLUMN_FLOAT:
+		return "f8";
+	case COLUMN_SIGNED:
+		switch (column->size) {
+		case 1: return "i1";
+		case 2: return "i2";
+		case 4: return "i4";
+		default: return "i8";
+		}
+	case COLUMN_UNSIGNED:
+	default:
+		switch (column->size) {
+		case 1: return "u1";
+		case 2: return "u2";
+		case 4: return "u4";
+		default: return "u8";
+		}
+	}
+}
+
+static
+int write_manifest(struct columns_stream_pos *pos, struct column_table *table)
+{
+	char *path;
+	FILE *fp;
+	unsigned int i;
+	int ret = 0;
+
+	path = g_strdup_printf("%s/%s/%s", pos->path, table->dir,
+		COLUMNS_MANIFEST);
+	fp = fopen(path, "w");
+	if (!fp) {
+		ret = -errno;
+		fprintf(stderr, "[error] Unable to open %s: %s\n", path,
+			strerror(errno));
+		goto end;
+	}
+	fprintf(fp, "version\t%d\n", COLUMNS_VERSION);
+	fprintf(fp, "event\t%s\n", g_quark_to_string(table->event_name));
+	fprintf(fp, "rows\t%" PRIu64 "\n", table->nr_rows);
+	for (i = 0; i < table->columns->len; i++) {
+		struct column *column = g_ptr_array_index(table->columns, i);
+
+		fprintf(fp, "column\t%u\t%s\t%s\n", i,
+			column_type_name(column), column->name);
+	}
+	if (fclose(fp)) {
+		ret = -errno;
+		fprintf(stderr, "[error] Unable to write %s: %s\n", path,
+			strerror(errno));
+	}
+end:
+	g_free(path);
+	return ret;
+}
+
+static
+int make_dir(const char *path)
+{
+	if (mkdir(path, 0755) && errno != EEXIST) {
+		int ret = -errno;
+
+		fprintf(stderr, "[error] Unable to create directory %s: %s\n",
+			path, strerror(errno));
+		return ret;
+	}
+	return 0;
+}
+
+static
+int dir_in_use(struct columns_stream_pos *pos, const char *dir)
+{
+	unsigned int i;
+
+	for (i = 0; i < pos->tables->len; i++) {
+		struct column_table *t = g_ptr_array_index(pos->tables, i);
+
+		if (!strcmp(t->dir, dir))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Find the table of an event class: event classes of the same name and
+ * columns, e.g. from several traces, share their table. Other event
+ * classes get a table of their own, whose directory name is suffixed
+ * by a number when another table already uses it, e.g. for event
+ * classes of the same name with other columns, or events named "foo"
+ * and "foo.1".
+ */
+static
+struct column_table *lookup_table(struct columns_stream_pos *pos,
+		struct ctf_stream_definition *stream,
+		struct ctf_event_definition *event,
+		struct ctf_event_declaration *event_class)
+{
+	struct definition_struct *scopes[NR_SCOPES];
+	struct column_table *table = NULL;
+	GPtrArray *columns;
+	GString *name;
+	char *dir, *p;
+	unsigned int i, suffix = 0;
+
+	columns = g_ptr_array_new();
+	add_column(columns, "timestamp", COLUMN_TIMESTAMP, 8);
+	name = g_string_new("");
+	event_scopes(stream, event, scopes);
+	for (i = 0; i < NR_SCOPES; i++) {
+		if (!scopes[i])
+			continue;
+		g_string_assign(name, scope_names[i]);
+		add_columns(columns, name, &scopes[i]->p);
+	}
+	g_string_free(name, TRUE);
+
+	/* Directory names are event names without path separators. */
+	dir = g_strdup(g_quark_to_string(event_class->name));
+	for (p = dir; *p; p++) {
+		if (*p == '/')
+			*p = '_';
+	}
+	if (dir[0] == '\0' || dir[0] == '.') {
+		p = dir;
+		dir = g_strdup_printf("_%s", p);
+		g_free(p);
+	}
+
+	for (i = 0; i < pos->tables->len; i++) {
+		struct column_table *t = g_ptr_array_index(pos->tables, i);
+
+		if (t->event_name == event_class->name
+		    && same_columns(t->columns, columns)) {
+			table = t;
+			break;
+		}
+	}
+	if (table) {
+		destroy_columns(columns);
+		g_free(dir);
+		goto end;
+	}
+
+	table = g_new0(struct column_table, 1);
+	table->dir = g_strdup(dir);
+	while (dir_in_use(pos, table->dir)) {
+		g_free(table->dir);
+		table->dir = g_strdup_printf("%s.%u", dir, ++suffix);
+	}
+	g_free(dir);
+	table->event_name = event_class->name;
+	table->columns = columns;
+	g_ptr_array_add(pos->tables, table);
+
+	dir = g_strdup_printf("%s/%s", pos->path, table->dir);
+	if (make_dir(dir)) {
+		g_free(dir);
+		return NULL;
+	}
+	g_free(dir);
+
+	/* String offsets start at 0. */
+	for (i = 0; i < columns->len; i++) {
+		struct column *column = g_ptr_array_index(columns, i);
+
+		if (column->type == COLUMN_STRING)
+			put_le(&column->values, 0, 8);
+	}
+end:
+	g_hash_table_insert(pos->tables_by_class, event_class, table);
+	return table;
+}
+
+static
+int columns_write_event(struct bt_stream_pos *ppos,
+		struct ctf_stream_definition *stream)
+{
+	struct columns_stream_pos *pos =
+		container_of(ppos, struct columns_stream_pos, parent.parent);
+	struct ctf_stream_declaration *stream_class = stream->stream_class;
+	struct definition_struct *scopes[NR_SCOPES];
+	struct ctf_event_declaration *event_class;
+	struct ctf_event_definition *event;
+	struct column_table *table;
+	unsigned int i, nr;
+	uint64_t id;
+	int ret;
+
+	id = stream->event_id;
+
+	if (id >= stream_class->events_by_id->len) {
+		fprintf(stderr, "[error] Event id %" PRIu64 " is outside range.\n", id);
+		return -EINVAL;
+	}
+	event = g_ptr_array_index(stream->events_by_id, id);
+	if (!event) {
+		fprintf(stderr, "[error] Event id %" PRIu64 " is unknown.\n", id);
+		return -EINVAL;
+	}
+	event_class = g_ptr_array_index(stream_class->events_by_id, id);
+	if (!event_class) {
+		fprintf(stderr, "[error] Event class id %" PRIu64 " is unknown.\n", id);
+		return -EINVAL;
+	}
+	ret = ctf_decode_pending_event(stream);
+	if (ret)
+		return ret;
+
+	table = g_hash_table_lookup(pos->tables_by_class, event_class);
+	if (!table) {
+		table = lookup_table(pos, stream, event, event_class);
+		if (!table)
+			return -EIO;
+	}
+
+	put_le(&((struct column *) g_ptr_array_index(table->columns, 0))->values,
+		stream->real_timestamp - table->last_timestamp, 8);
+	table->last_timestamp = stream->real_timestamp;
+	nr = 1;
+	event_scopes(stream, event, scopes);
+	for (i = 0; i < NR_SCOPES; i++) {
+		if (scopes[i])
+			put_values(table, &nr, &scopes[i]->p);
+	}
+	assert(nr == table->columns->len);
+
+	table->nr_rows++;
+	if (++table->nr_pending >= COLUMNS_BATCH_ROWS)
+		return flush_table(pos, table);
+	return 0;
+}
+
+static
+struct bt_trace_descriptor *columns_open_trace(const char *path, int flags,
+		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
+			int whence), FILE *metadata_fp)
+{
+	struct columns_stream_pos *pos;
+
+	switch (flags & O_ACCMODE) {
+	case O_RDWR:
+		break;
+	case O_RDONLY:
+	default:
+		fprintf(stderr, "[error] Incorrect open flags.\n");
+		return NULL;
+	}
+	if (!path) {
+		fprintf(stderr, "[error] The columns format needs an output directory.\n");
+		return NULL;
+	}
+	if (make_dir(path))
+		return NULL;
+
+	pos = g_new0(struct columns_stream_pos, 1);
+	pos->path = g_strdup(path);
+	pos->tables = g_ptr_array_new();
+	pos->tables_by_class = g_hash_table_new(g_direct_hash,
+		g_direct_equal);
+	pos->parent.parent.event_cb = columns_write_event;
+	pos->parent.parent.trace = &pos->parent.trace_descriptor;
+	return &pos->parent.trace_descriptor;
+}
+
+static
+int columns_close_trace(struct bt_trace_descriptor *td)
+{
+	struct columns_stream_pos *pos =
+		container_of(td, struct columns_stream_pos,
+			parent.trace_descriptor);
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < pos->tables->len; i++) {
+		struct column_table *table = g_ptr_array_index(pos->tables, i);
+
+		if (table->nr_pending)
+			ret |= flush_table(pos, table);
+		ret |= write_manifest(pos, table);
+		destroy_columns(table->columns);
+		g_free(table->dir);
+		g_free(table);
+	}
+	g_ptr_array_free(pos->tables, TRUE);
+	g_hash_table_destroy(pos->tables_by_class);
+	g_free(pos->path);
+	g_free(pos);
+	return ret ? -1 : 0;
+}
+
+static
+void __attribute__((constructor)) columns_init(void)
+{
+	int ret;
+
+	columns_format.name = g_quark_from_static_string("columns");
+	ret = bt_register_format(&columns_format);
+	assert(!ret);
+}
+
+static
+void __attribute__((destructor)) columns_exit(void)
+{
+	bt_unregister_format(&columns_format);
+}
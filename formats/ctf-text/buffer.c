@@ -0,0 +1,103 @@
+/*
+ * BabelTrace - Common Trace Format (CTF)
+ *
+ * CTF Text Format output buffer.
+ *
+ * Copyright 2015 EfficiOS Inc. and Linux Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/ctf-text/buffer.h>
+#include <babeltrace/babeltrace-internal.h>
+#include <errno.h>
+#include <glib.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <unistd.h>
+
+void ctf_text_buffer_grow(struct ctf_text_buffer *buf, size_t len)
+{
+	size_t alloc_len = MAX(buf->alloc_len, CTF_TEXT_BUFFER_FLUSH_LEN);
+
+	while (alloc_len - buf->len < len)
+		alloc_len <<= 1;
+	buf->data = g_realloc(buf->data, alloc_len);
+	buf->alloc_len = alloc_len;
+}
+
+void ctf_text_buffer_free(struct ctf_text_buffer *buf)
+{
+	g_free(buf->data);
+	buf->data = NULL;
+	buf->len = buf->alloc_len = 0;
+}
+
+int ctf_text_buffer_flush(struct ctf_text_buffer *buf, FILE *fp)
+{
+	size_t done = 0;
+	int ret = 0;
+
+	if (!buf->len)
+		return 0;
+	if (fflush(fp)) {
+		ret = -errno;
+		goto end;
+	}
+	while (done < buf->len) {
+		ssize_t len;
+
+		len = write(fileno(fp), buf->data + done, buf->len - done);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			ret = -errno;
+			goto end;
+		}
+		done += len;
+	}
+end:
+	if (ret)
+		fprintf(stderr, "[error] Unable to write text output: %s\n",
+			strerror(-ret));
+	buf->len = 0;
+	return ret;
+}
+
+int ctf_text_printf(struct ctf_text_buffer *buf, const char *fmt, ...)
+{
+	va_list ap;
+	size_t room = CTF_TEXT_NUMBER_LEN;
+	int len;
+
+	for (;;) {
+		char *p = ctf_text_reserve(buf, room);
+
+		va_start(ap, fmt);
+		len = vsnprintf(p, room, fmt, ap);
+		va_end(ap);
+		if (len < 0)
+			return -errno;
+		if ((size_t) len < room)
+			break;
+		room = len + 1;
+	}
+	buf->len += len;
+	return 0;
+}
@@ -28,6 +28,7 @@
 
 #include <babeltrace/format.h>
 #include <babeltrace/ctf-text/types.h>
+#include <babeltrace/ctf-text/template.h>
 #include <babeltrace/ctf/metadata.h>
 #include <babeltrace/babeltrace-internal.h>
 #include <babeltrace/ctf/events-internal.h>
@@ -111,6 +112,9 @@ struct bt_format ctf_text_format = {
 	.close_trace = ctf_text_close_trace,
 };
 
+/* Open text output positions, written out before warnings */
+static GList *console_positions;
+
 static GQuark Q_STREAM_PACKET_CONTEXT_TIMESTAMP_BEGIN,
 	Q_STREAM_PACKET_CONTEXT_TIMESTAMP_END,
 	Q_STREAM_PACKET_CONTEXT_EVENTS_DISCARDED,
@@ -157,37 +161,55 @@ int print_field(struct bt_definition *definition)
 }
 
 static
-void set_field_names_print(struct ctf_text_stream_pos *pos, enum field_item item)
+int field_names_print(enum field_item item)
 {
 	switch (item) {
 	case ITEM_SCOPE:
-		if (opt_all_field_names || opt_scope_field_names)
-			pos->print_names = 1;
-		else
-			pos->print_names = 0;
-		break;
+		return opt_all_field_names || opt_scope_field_names;
 	case ITEM_HEADER:
-		if (opt_all_field_names || opt_header_field_names)
-			pos->print_names = 1;
-		else
-			pos->print_names = 0;
-		break;
+		return opt_all_field_names || opt_header_field_names;
 	case ITEM_CONTEXT:
-		if (opt_all_field_names || opt_context_field_names)
-			pos->print_names = 1;
-		else
-			pos->print_names = 0;
-		break;
+		return opt_all_field_names || opt_context_field_names;
 	case ITEM_PAYLOAD:
-		if (opt_all_field_names || opt_payload_field_names)
-			pos->print_names = 1;
-		else
-			pos->print_names = 0;
-
-		break;
+		return opt_all_field_names || opt_payload_field_names;
 	default:
 		assert(0);
 	}
+	return 0;
+}
+
+static
+void set_field_names_print(struct ctf_text_stream_pos *pos, enum field_item item)
+{
+	pos->print_names = field_names_print(item);
+}
+
+/*
+ * Options shaping the text of an event, apart from its timestamp and
+ * delta. Event templates are compiled for a given set of options.
+ */
+static
+unsigned int template_options(void)
+{
+	unsigned int options = 0, i = 0;
+
+	options |= !!opt_all_field_names << i++;
+	options |= !!opt_scope_field_names << i++;
+	options |= !!opt_header_field_names << i++;
+	options |= !!opt_context_field_names << i++;
+	options |= !!opt_payload_field_names << i++;
+	options |= !!opt_all_fields << i++;
+	options |= !!opt_trace_field << i++;
+	options |= !!opt_trace_domain_field << i++;
+	options |= !!opt_trace_procname_field << i++;
+	options |= !!opt_trace_vpid_field << i++;
+	options |= !!opt_trace_hostname_field << i++;
+	options |= !!opt_trace_default_fields << i++;
+	options |= !!opt_loglevel_field << i++;
+	options |= !!opt_emf_field << i++;
+	options |= !!opt_callsite_field << i++;
+	options |= !!babeltrace_verbose << i++;
+	return options;
 }
 
 static
@@ -232,298 +254,319 @@ const char *print_loglevel(int value)
 }
 
 static
-int ctf_text_write_event(struct bt_stream_pos *ppos, struct ctf_stream_definition *stream)
-			 
+void put_timestamp(struct ctf_text_stream_pos *pos,
+		struct ctf_stream_definition *stream, uint64_t timestamp)
 {
-	struct ctf_text_stream_pos *pos =
-		container_of(ppos, struct ctf_text_stream_pos, parent);
-	struct ctf_stream_declaration *stream_class = stream->stream_class;
-	int field_nr_saved;
-	struct ctf_event_declaration *event_class;
-	struct ctf_event_definition *event;
-	uint64_t id;
-	int ret;
-	int dom_print = 0;
+	char *p = ctf_text_reserve(&pos->out, CTF_TIMESTAMP_LEN);
 
-	id = stream->event_id;
+	pos->out.len += ctf_format_timestamp(p, &pos->timestamp_cache, stream,
+			timestamp);
+}
 
-	if (id >= stream_class->events_by_id->len) {
-		fprintf(stderr, "[error] Event id %" PRIu64 " is outside range.\n", id);
-		return -EINVAL;
-	}
-	event = g_ptr_array_index(stream->events_by_id, id);
-	if (!event) {
-		fprintf(stderr, "[error] Event id %" PRIu64 " is unknown.\n", id);
-		return -EINVAL;
-	}
-	event_class = g_ptr_array_index(stream_class->events_by_id, id);
-	if (!event_class) {
-		fprintf(stderr, "[error] Event class id %" PRIu64 " is unknown.\n", id);
-		return -EINVAL;
-	}
+int ctf_text_flush(struct ctf_text_stream_pos *pos)
+{
+	return ctf_text_buffer_flush(&pos->out, pos->fp);
+}
 
-	if (stream->has_timestamp) {
-		set_field_names_print(pos, ITEM_HEADER);
-		if (pos->print_names)
-			fprintf(pos->fp, "timestamp = ");
-		else
-			fprintf(pos->fp, "[");
-		if (opt_clock_cycles) {
-			ctf_print_timestamp(pos->fp, stream, stream->cycles_timestamp);
-		} else {
-			ctf_print_timestamp(pos->fp, stream, stream->real_timestamp);
-		}
-		if (!pos->print_names)
-			fprintf(pos->fp, "]");
+static
+void ctf_text_console_flush(void)
+{
+	GList *node;
 
-		if (pos->print_names)
-			fprintf(pos->fp, ", ");
-		else
-			fprintf(pos->fp, " ");
-	}
-	if (opt_delta_field && stream->has_timestamp) {
-		uint64_t delta, delta_sec, delta_nsec;
+	for (node = console_positions; node; node = node->next)
+		(void) ctf_text_flush(node->data);
+}
 
-		set_field_names_print(pos, ITEM_HEADER);
-		if (pos->print_names)
-			fprintf(pos->fp, "delta = ");
-		else
-			fprintf(pos->fp, "(");
-		if (pos->last_real_timestamp != -1ULL) {
-			delta = stream->real_timestamp - pos->last_real_timestamp;
-			delta_sec = delta / NSEC_PER_SEC;
-			delta_nsec = delta % NSEC_PER_SEC;
-			fprintf(pos->fp, "+%" PRIu64 ".%09" PRIu64,
-				delta_sec, delta_nsec);
-		} else {
-			fprintf(pos->fp, "+?.?????????");
-		}
-		if (!pos->print_names)
-			fprintf(pos->fp, ")");
+/* Drop the templates compiled for an event definition about to be freed. */
+static
+void ctf_text_event_definition_free(struct ctf_event_definition *event)
+{
+	GList *node;
 
-		if (pos->print_names)
-			fprintf(pos->fp, ", ");
-		else
-			fprintf(pos->fp, " ");
-		pos->last_real_timestamp = stream->real_timestamp;
-		pos->last_cycles_timestamp = stream->cycles_timestamp;
+	for (node = console_positions; node; node = node->next) {
+		struct ctf_text_stream_pos *pos = node->data;
+
+		g_hash_table_remove(pos->templates, event);
 	}
+}
 
-	if ((opt_trace_field || opt_all_fields) && stream_class->trace->parent.path[0] != '\0') {
-		set_field_names_print(pos, ITEM_HEADER);
-		if (pos->print_names) {
-			fprintf(pos->fp, "trace = ");
-		}
-		fprintf(pos->fp, "%s", stream_class->trace->parent.path);
-		if (pos->print_names)
-			fprintf(pos->fp, ", ");
-		else
-			fprintf(pos->fp, " ");
+/* Scope of an event, as a structure within the event line */
+static
+void append_scope(struct ctf_text_template *tmpl, const char *scope_name,
+		enum field_item item, struct bt_definition *definition)
+{
+	int field_nr_saved;
+
+	if (tmpl->field_nr++ != 0)
+		ctf_text_template_puts(tmpl, ",");
+	tmpl->print_names = field_names_print(ITEM_SCOPE);
+	if (tmpl->print_names)
+		ctf_text_template_printf(tmpl, " %s =", scope_name);
+	field_nr_saved = tmpl->field_nr;
+	tmpl->field_nr = 0;
+	tmpl->print_names = field_names_print(item);
+	ctf_text_template_append(tmpl, definition);
+	tmpl->field_nr = field_nr_saved;
+}
+
+/*
+ * Compile the text of an event following its timestamp and delta: the
+ * trace and event class fields of the header, which do not change from
+ * one event to the next, then the scopes.
+ */
+static
+struct ctf_text_template *compile_event_template(
+		struct ctf_stream_definition *stream,
+		struct ctf_event_definition *event,
+		struct ctf_event_declaration *event_class,
+		unsigned int options)
+{
+	struct ctf_stream_declaration *stream_class = stream->stream_class;
+	struct ctf_trace *trace = stream_class->trace;
+	struct ctf_text_template *tmpl;
+	int print_names = field_names_print(ITEM_HEADER);
+	int dom_print = 0;
+
+	tmpl = ctf_text_template_create(options);
+
+	if ((opt_trace_field || opt_all_fields) && trace->parent.path[0] != '\0') {
+		if (print_names)
+			ctf_text_template_puts(tmpl, "trace = ");
+		ctf_text_template_puts(tmpl, trace->parent.path);
+		ctf_text_template_puts(tmpl, print_names ? ", " : " ");
 	}
 	if ((opt_trace_hostname_field || opt_all_fields || opt_trace_default_fields)
-			&& stream_class->trace->env.hostname[0] != '\0') {
-		set_field_names_print(pos, ITEM_HEADER);
-		if (pos->print_names) {
-			fprintf(pos->fp, "trace:hostname = ");
-		}
-		fprintf(pos->fp, "%s", stream_class->trace->env.hostname);
-		if (pos->print_names)
-			fprintf(pos->fp, ", ");
+			&& trace->env.hostname[0] != '\0') {
+		if (print_names)
+			ctf_text_template_puts(tmpl, "trace:hostname = ");
+		ctf_text_template_puts(tmpl, trace->env.hostname);
+		if (print_names)
+			ctf_text_template_puts(tmpl, ", ");
 		dom_print = 1;
 	}
-	if ((opt_trace_domain_field || opt_all_fields) && stream_class->trace->env.domain[0] != '\0') {
-		set_field_names_print(pos, ITEM_HEADER);
-		if (pos->print_names) {
-			fprintf(pos->fp, "trace:domain = ");
-		}
-		fprintf(pos->fp, "%s", stream_class->trace->env.domain);
-		if (pos->print_names)
-			fprintf(pos->fp, ", ");
+	if ((opt_trace_domain_field || opt_all_fields) && trace->env.domain[0] != '\0') {
+		if (print_names)
+			ctf_text_template_puts(tmpl, "trace:domain = ");
+		ctf_text_template_puts(tmpl, trace->env.domain);
+		if (print_names)
+			ctf_text_template_puts(tmpl, ", ");
 		dom_print = 1;
 	}
 	if ((opt_trace_procname_field || opt_all_fields || opt_trace_default_fields)
-			&& stream_class->trace->env.procname[0] != '\0') {
-		set_field_names_print(pos, ITEM_HEADER);
-		if (pos->print_names) {
-			fprintf(pos->fp, "trace:procname = ");
-		} else if (dom_print) {
-			fprintf(pos->fp, ":");
-		}
-		fprintf(pos->fp, "%s", stream_class->trace->env.procname);
-		if (pos->print_names)
-			fprintf(pos->fp, ", ");
+			&& trace->env.procname[0] != '\0') {
+		if (print_names)
+			ctf_text_template_puts(tmpl, "trace:procname = ");
+		else if (dom_print)
+			ctf_text_template_puts(tmpl, ":");
+		ctf_text_template_puts(tmpl, trace->env.procname);
+		if (print_names)
+			ctf_text_template_puts(tmpl, ", ");
 		dom_print = 1;
 	}
 	if ((opt_trace_vpid_field || opt_all_fields || opt_trace_default_fields)
-			&& stream_class->trace->env.vpid != -1) {
-		set_field_names_print(pos, ITEM_HEADER);
-		if (pos->print_names) {
-			fprintf(pos->fp, "trace:vpid = ");
-		} else if (dom_print) {
-			fprintf(pos->fp, ":");
-		}
-		fprintf(pos->fp, "%d", stream_class->trace->env.vpid);
-		if (pos->print_names)
-			fprintf(pos->fp, ", ");
+			&& trace->env.vpid != -1) {
+		if (print_names)
+			ctf_text_template_puts(tmpl, "trace:vpid = ");
+		else if (dom_print)
+			ctf_text_template_puts(tmpl, ":");
+		ctf_text_template_printf(tmpl, "%d", trace->env.vpid);
+		if (print_names)
+			ctf_text_template_puts(tmpl, ", ");
 		dom_print = 1;
 	}
 	if ((opt_loglevel_field || opt_all_fields) && event_class->loglevel != -1) {
-		set_field_names_print(pos, ITEM_HEADER);
-		if (pos->print_names) {
-			fprintf(pos->fp, "loglevel = ");
-		} else if (dom_print) {
-			fprintf(pos->fp, ":");
-		}
-		fprintf(pos->fp, "%s (%d)",
+		if (print_names)
+			ctf_text_template_puts(tmpl, "loglevel = ");
+		else if (dom_print)
+			ctf_text_template_puts(tmpl, ":");
+		ctf_text_template_printf(tmpl, "%s (%d)",
 			print_loglevel(event_class->loglevel),
 			event_class->loglevel);
-		if (pos->print_names)
-			fprintf(pos->fp, ", ");
+		if (print_names)
+			ctf_text_template_puts(tmpl, ", ");
 		dom_print = 1;
 	}
 	if ((opt_emf_field || opt_all_fields) && event_class->model_emf_uri) {
-		set_field_names_print(pos, ITEM_HEADER);
-		if (pos->print_names) {
-			fprintf(pos->fp, "model.emf.uri = ");
-		} else if (dom_print) {
-			fprintf(pos->fp, ":");
-		}
-		fprintf(pos->fp, "\"%s\"",
+		if (print_names)
+			ctf_text_template_puts(tmpl, "model.emf.uri = ");
+		else if (dom_print)
+			ctf_text_template_puts(tmpl, ":");
+		ctf_text_template_printf(tmpl, "\"%s\"",
 			g_quark_to_string(event_class->model_emf_uri));
-		if (pos->print_names)
-			fprintf(pos->fp, ", ");
+		if (print_names)
+			ctf_text_template_puts(tmpl, ", ");
 		dom_print = 1;
 	}
 	if ((opt_callsite_field || opt_all_fields)) {
 		struct ctf_callsite_dups *cs_dups;
 		struct ctf_callsite *callsite;
 
-		cs_dups = ctf_trace_callsite_lookup(stream_class->trace,
-				event_class->name);
+		cs_dups = ctf_trace_callsite_lookup(trace, event_class->name);
 		if (cs_dups) {
 			int i = 0;
 
-			set_field_names_print(pos, ITEM_HEADER);
-			if (pos->print_names) {
-				fprintf(pos->fp, "callsite = ");
-			} else if (dom_print) {
-				fprintf(pos->fp, ":");
-			}
-			fprintf(pos->fp, "[");
+			if (print_names)
+				ctf_text_template_puts(tmpl, "callsite = ");
+			else if (dom_print)
+				ctf_text_template_puts(tmpl, ":");
+			ctf_text_template_puts(tmpl, "[");
 			bt_list_for_each_entry(callsite, &cs_dups->head, node) {
 				if (i != 0)
-					fprintf(pos->fp, ",");
+					ctf_text_template_puts(tmpl, ",");
 				if (CTF_CALLSITE_FIELD_IS_SET(callsite, ip)) {
-					fprintf(pos->fp, "%s@0x%" PRIx64 ":%s:%" PRIu64 "",
+					ctf_text_template_printf(tmpl, "%s@0x%" PRIx64 ":%s:%" PRIu64 "",
 						callsite->func, callsite->ip, callsite->file,
 						callsite->line);
 				} else {
-					fprintf(pos->fp, "%s:%s:%" PRIu64 "",
+					ctf_text_template_printf(tmpl, "%s:%s:%" PRIu64 "",
 						callsite->func, callsite->file,
 						callsite->line);
 				}
 				i++;
 			}
-			fprintf(pos->fp, "]");
-			if (pos->print_names)
-				fprintf(pos->fp, ", ");
+			ctf_text_template_puts(tmpl, "]");
+			if (print_names)
+				ctf_text_template_puts(tmpl, ", ");
 			dom_print = 1;
 		}
 	}
-	if (dom_print && !pos->print_names)
-		fprintf(pos->fp, " ");
-	set_field_names_print(pos, ITEM_HEADER);
-	if (pos->print_names)
-		fprintf(pos->fp, "name = ");
-	fprintf(pos->fp, "%s", g_quark_to_string(event_class->name));
-	if (pos->print_names)
-		pos->field_nr++;
+	if (dom_print && !print_names)
+		ctf_text_template_puts(tmpl, " ");
+	if (print_names)
+		ctf_text_template_puts(tmpl, "name = ");
+	ctf_text_template_puts(tmpl, g_quark_to_string(event_class->name));
+	if (print_names)
+		tmpl->field_nr++;
 	else
-		fprintf(pos->fp, ":");
+		ctf_text_template_puts(tmpl, ":");
 
 	/* print cpuid field from packet context */
-	if (stream->stream_packet_context) {
-		if (pos->field_nr++ != 0)
-			fprintf(pos->fp, ",");
-		set_field_names_print(pos, ITEM_SCOPE);
-		if (pos->print_names)
-			fprintf(pos->fp, " stream.packet.context =");
-		field_nr_saved = pos->field_nr;
-		pos->field_nr = 0;
-		set_field_names_print(pos, ITEM_CONTEXT);
-		ret = generic_rw(ppos, &stream->stream_packet_context->p);
-		if (ret)
-			goto error;
-		pos->field_nr = field_nr_saved;
-	}
+	if (stream->stream_packet_context)
+		append_scope(tmpl, "stream.packet.context", ITEM_CONTEXT,
+			&stream->stream_packet_context->p);
 
 	/* Only show the event header in verbose mode */
-	if (babeltrace_verbose && stream->stream_event_header) {
-		if (pos->field_nr++ != 0)
-			fprintf(pos->fp, ",");
-		set_field_names_print(pos, ITEM_SCOPE);
-		if (pos->print_names)
-			fprintf(pos->fp, " stream.event.header =");
-		field_nr_saved = pos->field_nr;
-		pos->field_nr = 0;
-		set_field_names_print(pos, ITEM_CONTEXT);
-		ret = generic_rw(ppos, &stream->stream_event_header->p);
-		if (ret)
-			goto error;
-		pos->field_nr = field_nr_saved;
-	}
+	if (babeltrace_verbose && stream->stream_event_header)
+		append_scope(tmpl, "stream.event.header", ITEM_CONTEXT,
+			&stream->stream_event_header->p);
 
 	/* print stream-declared event context */
-	if (stream->stream_event_context) {
-		if (pos->field_nr++ != 0)
-			fprintf(pos->fp, ",");
-		set_field_names_print(pos, ITEM_SCOPE);
-		if (pos->print_names)
-			fprintf(pos->fp, " stream.event.context =");
-		field_nr_saved = pos->field_nr;
-		pos->field_nr = 0;
-		set_field_names_print(pos, ITEM_CONTEXT);
-		ret = generic_rw(ppos, &stream->stream_event_context->p);
-		if (ret)
-			goto error;
-		pos->field_nr = field_nr_saved;
-	}
+	if (stream->stream_event_context)
+		append_scope(tmpl, "stream.event.context", ITEM_CONTEXT,
+			&stream->stream_event_context->p);
 
 	/* print event-declared event context */
-	if (event->event_context) {
-		if (pos->field_nr++ != 0)
-			fprintf(pos->fp, ",");
-		set_field_names_print(pos, ITEM_SCOPE);
+	if (event->event_context)
+		append_scope(tmpl, "event.context", ITEM_CONTEXT,
+			&event->event_context->p);
+
+	/* event payload */
+	if (event->event_fields)
+		append_scope(tmpl, "event.fields", ITEM_PAYLOAD,
+			&event->event_fields->p);
+
+	/* newline */
+	ctf_text_template_puts(tmpl, "\n");
+	ctf_text_template_end(tmpl);
+	return tmpl;
+}
+
+static
+int ctf_text_write_event(struct bt_stream_pos *ppos, struct ctf_stream_definition *stream)
+			 
+{
+	struct ctf_text_stream_pos *pos =
+		container_of(ppos, struct ctf_text_stream_pos, parent);
+	struct ctf_stream_declaration *stream_class = stream->stream_class;
+	struct ctf_event_declaration *event_class;
+	struct ctf_event_definition *event;
+	struct ctf_text_template *tmpl;
+	unsigned int options = template_options();
+	uint64_t id;
+	int ret;
+
+	id = stream->event_id;
+
+	if (id >= stream_class->events_by_id->len) {
+		fprintf(stderr, "[error] Event id %" PRIu64 " is outside range.\n", id);
+		return -EINVAL;
+	}
+	event = g_ptr_array_index(stream->events_by_id, id);
+	if (!event) {
+		fprintf(stderr, "[error] Event id %" PRIu64 " is unknown.\n", id);
+		return -EINVAL;
+	}
+	event_class = g_ptr_array_index(stream_class->events_by_id, id);
+	if (!event_class) {
+		fprintf(stderr, "[error] Event class id %" PRIu64 " is unknown.\n", id);
+		return -EINVAL;
+	}
+	ret = ctf_decode_pending_event(stream);
+	if (ret)
+		return ret;
+
+	if (stream->has_timestamp) {
+		set_field_names_print(pos, ITEM_HEADER);
 		if (pos->print_names)
-			fprintf(pos->fp, " event.context =");
-		field_nr_saved = pos->field_nr;
-		pos->field_nr = 0;
-		set_field_names_print(pos, ITEM_CONTEXT);
-		ret = generic_rw(ppos, &event->event_context->p);
-		if (ret)
-			goto error;
-		pos->field_nr = field_nr_saved;
+			ctf_text_puts(&pos->out, "timestamp = ");
+		else
+			ctf_text_putc(&pos->out, '[');
+		if (opt_clock_cycles) {
+			put_timestamp(pos, stream, stream->cycles_timestamp);
+		} else {
+			put_timestamp(pos, stream, stream->real_timestamp);
+		}
+		if (!pos->print_names)
+			ctf_text_putc(&pos->out, ']');
+
+		if (pos->print_names)
+			ctf_text_puts(&pos->out, ", ");
+		else
+			ctf_text_putc(&pos->out, ' ');
 	}
+	if (opt_delta_field && stream->has_timestamp) {
+		uint64_t delta, delta_sec, delta_nsec;
 
-	/* Read and print event payload */
-	if (event->event_fields) {
-		if (pos->field_nr++ != 0)
-			fprintf(pos->fp, ",");
-		set_field_names_print(pos, ITEM_SCOPE);
+		set_field_names_print(pos, ITEM_HEADER);
 		if (pos->print_names)
-			fprintf(pos->fp, " event.fields =");
-		field_nr_saved = pos->field_nr;
-		pos->field_nr = 0;
-		set_field_names_print(pos, ITEM_PAYLOAD);
-		ret = generic_rw(ppos, &event->event_fields->p);
-		if (ret)
-			goto error;
-		pos->field_nr = field_nr_saved;
+			ctf_text_puts(&pos->out, "delta = ");
+		else
+			ctf_text_putc(&pos->out, '(');
+		if (pos->last_real_timestamp != -1ULL) {
+			delta = stream->real_timestamp - pos->last_real_timestamp;
+			delta_sec = delta / NSEC_PER_SEC;
+			delta_nsec = delta % NSEC_PER_SEC;
+			ctf_text_putc(&pos->out, '+');
+			ctf_text_put_u64(&pos->out, delta_sec);
+			ctf_text_putc(&pos->out, '.');
+			ctf_text_put_u64_width(&pos->out, delta_nsec, 9);
+		} else {
+			ctf_text_puts(&pos->out, "+?.?????????");
+		}
+		if (!pos->print_names)
+			ctf_text_putc(&pos->out, ')');
+
+		if (pos->print_names)
+			ctf_text_puts(&pos->out, ", ");
+		else
+			ctf_text_putc(&pos->out, ' ');
+		pos->last_real_timestamp = stream->real_timestamp;
+		pos->last_cycles_timestamp = stream->cycles_timestamp;
 	}
-	/* newline */
-	fprintf(pos->fp, "\n");
-	pos->field_nr = 0;
 
+	tmpl = g_hash_table_lookup(pos->templates, event);
+	if (!tmpl || tmpl->options != options) {
+		tmpl = compile_event_template(stream, event, event_class,
+				options);
+		/* Frees the template compiled for other options */
+		g_hash_table_insert(pos->templates, event, tmpl);
+	}
+	ret = ctf_text_template_write(tmpl, pos);
+	if (ret)
+		goto error;
+
+	if (pos->out.len >= CTF_TEXT_BUFFER_FLUSH_LEN || pos->out.line_buffered)
+		return ctf_text_flush(pos);
 	return 0;
 
 error:
@@ -552,11 +595,18 @@ struct bt_trace_descriptor *ctf_text_open_trace(const char *path, int flags,
 		if (!fp)
 			goto error;
 		pos->fp = fp;
+		pos->out.line_buffered = isatty(fileno(fp));
 		pos->parent.rw_table = write_dispatch_table;
 		pos->parent.event_cb = ctf_text_write_event;
 		pos->parent.trace = &pos->trace_descriptor;
 		pos->print_names = 0;
+		pos->templates = g_hash_table_new_full(g_direct_hash,
+				g_direct_equal, NULL, ctf_text_template_destroy);
 		babeltrace_ctf_console_output++;
+		console_positions = g_list_prepend(console_positions, pos);
+		babeltrace_ctf_console_flush = ctf_text_console_flush;
+		babeltrace_ctf_event_definition_free =
+			ctf_text_event_definition_free;
 		break;
 	case O_RDONLY:
 	default:
@@ -578,15 +628,24 @@ int ctf_text_close_trace(struct bt_trace_descriptor *td)
 		container_of(td, struct ctf_text_stream_pos, trace_descriptor);
 
 	babeltrace_ctf_console_output--;
+	console_positions = g_list_remove(console_positions, pos);
+	if (!console_positions
+	    && babeltrace_ctf_console_flush == ctf_text_console_flush)
+		babeltrace_ctf_console_flush = NULL;
+	if (!console_positions && babeltrace_ctf_event_definition_free
+			== ctf_text_event_definition_free)
+		babeltrace_ctf_event_definition_free = NULL;
+	ret = ctf_text_flush(pos);
+	ctf_text_buffer_free(&pos->out);
+	g_hash_table_destroy(pos->templates);
 	if (pos->fp != stdout) {
-		ret = fclose(pos->fp);
-		if (ret) {
+		if (fclose(pos->fp)) {
 			perror("Error on fclose");
-			return -1;
+			ret = -1;
 		}
 	}
 	g_free(pos);
-	return 0;
+	return ret ? -1 : 0;
 }
 
 static
@@ -0,0 +1,246 @@
+/*
+ * BabelTrace - Common Trace Format (CTF)
+ *
+ * CTF Text Format event templates.
+ *
+ * Copyright 2015 EfficiOS Inc. and Linux Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/ctf-text/template.h>
+#include <babeltrace/ctf-text/types.h>
+#include <babeltrace/babeltrace-internal.h>
+#include <babeltrace/types.h>
+#include <glib.h>
+#include <stdarg.h>
+
+struct ctf_text_template *ctf_text_template_create(unsigned int options)
+{
+	struct ctf_text_template *tmpl;
+
+	tmpl = g_new0(struct ctf_text_template, 1);
+	tmpl->text = g_string_new("");
+	tmpl->ops = g_array_new(FALSE, TRUE,
+			sizeof(struct ctf_text_template_op));
+	tmpl->options = options;
+	return tmpl;
+}
+
+void ctf_text_template_destroy(void *data)
+{
+	struct ctf_text_template *tmpl = data;
+
+	if (!tmpl)
+		return;
+	g_string_free(tmpl->text, TRUE);
+	g_array_free(tmpl->ops, TRUE);
+	g_free(tmpl);
+}
+
+void ctf_text_template_printf(struct ctf_text_template *tmpl,
+		const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	g_string_append_vprintf(tmpl->text, fmt, ap);
+	va_end(ap);
+}
+
+/* Turn the text appended since the last op into a segment. */
+static
+void close_segment(struct ctf_text_template *tmpl)
+{
+	struct ctf_text_template_op op = { 0 };
+
+	if (tmpl->text->len == tmpl->text_start)
+		return;
+	op.type = CTF_TEXT_TEMPLATE_TEXT;
+	op.offset = tmpl->text_start;
+	op.len = tmpl->text->len - tmpl->text_start;
+	g_array_append_val(tmpl->ops, op);
+	tmpl->text_start = tmpl->text->len;
+}
+
+static
+void append_op(struct ctf_text_template *tmpl,
+		enum ctf_text_template_op_type type,
+		struct bt_definition *definition)
+{
+	struct ctf_text_template_op op = { 0 };
+
+	close_segment(tmpl);
+	op.type = type;
+	op.definition = definition;
+	op.field_nr = tmpl->field_nr;
+	op.depth = tmpl->depth;
+	op.print_names = tmpl->print_names;
+	g_array_append_val(tmpl->ops, op);
+}
+
+/* Separator and name printed before a field by the write functions. */
+static
+void append_field_name(struct ctf_text_template *tmpl,
+		struct bt_definition *definition)
+{
+	if (tmpl->field_nr++ != 0)
+		ctf_text_template_puts(tmpl, ",");
+	ctf_text_template_puts(tmpl, " ");
+	if (tmpl->print_names) {
+		ctf_text_template_puts(tmpl,
+			rem_(g_quark_to_string(definition->name)));
+		ctf_text_template_puts(tmpl, " = ");
+	}
+}
+
+static
+int integer_base_supported(struct bt_definition *definition)
+{
+	struct definition_integer *integer_definition =
+		container_of(definition, struct definition_integer, p);
+
+	switch (integer_definition->declaration->base) {
+	case 0:
+	case 2:
+	case 8:
+	case 10:
+	case 16:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/* Same output as ctf_text_struct_write(). */
+static
+void append_struct(struct ctf_text_template *tmpl,
+		struct bt_definition *definition)
+{
+	struct definition_struct *struct_definition =
+		container_of(definition, struct definition_struct, p);
+	int field_nr_saved;
+	unsigned long i;
+
+	if (tmpl->depth >= 0) {
+		if (tmpl->field_nr++ != 0)
+			ctf_text_template_puts(tmpl, ",");
+		ctf_text_template_puts(tmpl, " ");
+		if (tmpl->print_names && definition->name != 0) {
+			ctf_text_template_puts(tmpl,
+				rem_(g_quark_to_string(definition->name)));
+			ctf_text_template_puts(tmpl, " = ");
+		}
+		ctf_text_template_puts(tmpl, "{");
+	}
+	tmpl->depth++;
+	field_nr_saved = tmpl->field_nr;
+	tmpl->field_nr = 0;
+	for (i = 0; i < struct_definition->fields->len; i++)
+		ctf_text_template_append(tmpl,
+			g_ptr_array_index(struct_definition->fields, i));
+	tmpl->depth--;
+	if (tmpl->depth >= 0)
+		ctf_text_template_puts(tmpl, " }");
+	tmpl->field_nr = field_nr_saved;
+}
+
+void ctf_text_template_append(struct ctf_text_template *tmpl,
+		struct bt_definition *definition)
+{
+	if (!print_field(definition))
+		return;
+
+	switch (definition->declaration->id) {
+	case CTF_TYPE_STRUCT:
+		append_struct(tmpl, definition);
+		break;
+	case CTF_TYPE_INTEGER:
+		if (!integer_base_supported(definition))
+			goto call;
+		append_field_name(tmpl, definition);
+		append_op(tmpl, CTF_TEXT_TEMPLATE_INTEGER, definition);
+		break;
+	case CTF_TYPE_FLOAT:
+		append_field_name(tmpl, definition);
+		append_op(tmpl, CTF_TEXT_TEMPLATE_FLOAT, definition);
+		break;
+	case CTF_TYPE_STRING:
+		append_field_name(tmpl, definition);
+		ctf_text_template_puts(tmpl, "\"");
+		append_op(tmpl, CTF_TEXT_TEMPLATE_STRING, definition);
+		ctf_text_template_puts(tmpl, "\"");
+		break;
+	default:
+	call:
+		/* The write function counts the field in field_nr. */
+		append_op(tmpl, CTF_TEXT_TEMPLATE_CALL, definition);
+		tmpl->field_nr++;
+		break;
+	}
+}
+
+void ctf_text_template_end(struct ctf_text_template *tmpl)
+{
+	close_segment(tmpl);
+}
+
+int ctf_text_template_write(const struct ctf_text_template *tmpl,
+		struct ctf_text_stream_pos *pos)
+{
+	const struct ctf_text_template_op *op;
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < tmpl->ops->len; i++) {
+		op = &g_array_index(tmpl->ops, struct ctf_text_template_op, i);
+		switch (op->type) {
+		case CTF_TEXT_TEMPLATE_TEXT:
+			ctf_text_write(&pos->out, tmpl->text->str + op->offset,
+				op->len);
+			break;
+		case CTF_TEXT_TEMPLATE_INTEGER:
+			ret = ctf_text_put_integer(&pos->out,
+				container_of(op->definition,
+					struct definition_integer, p));
+			break;
+		case CTF_TEXT_TEMPLATE_FLOAT:
+			ctf_text_put_g(&pos->out,
+				container_of(op->definition,
+					struct definition_float, p)->value);
+			break;
+		case CTF_TEXT_TEMPLATE_STRING:
+			ctf_text_puts(&pos->out,
+				container_of(op->definition,
+					struct definition_string, p)->value);
+			break;
+		case CTF_TEXT_TEMPLATE_CALL:
+			pos->field_nr = op->field_nr;
+			pos->depth = op->depth;
+			pos->print_names = op->print_names;
+			ret = generic_rw(&pos->parent, op->definition);
+			break;
+		}
+		if (ret)
+			break;
+	}
+	pos->field_nr = 0;
+	pos->depth = 0;
+	return ret;
+}
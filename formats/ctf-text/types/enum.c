@@ -48,15 +48,17 @@ int ctf_text_enum_write(struct bt_stream_pos *ppos, struct bt_definition *defini
 		return 0;
 
 	if (pos->field_nr++ != 0)
-		fprintf(pos->fp, ",");
-	fprintf(pos->fp, " ");
-	if (pos->print_names)
-		fprintf(pos->fp, "%s = ",
+		ctf_text_putc(&pos->out, ',');
+	ctf_text_putc(&pos->out, ' ');
+	if (pos->print_names) {
+		ctf_text_puts(&pos->out,
 			rem_(g_quark_to_string(definition->name)));
+		ctf_text_puts(&pos->out, " = ");
+	}
 
 	field_nr_saved = pos->field_nr;
 	pos->field_nr = 0;
-	fprintf(pos->fp, "(");
+	ctf_text_putc(&pos->out, '(');
 	pos->depth++;
 	qs = enum_definition->value;
 
@@ -69,20 +71,22 @@ int ctf_text_enum_write(struct bt_stream_pos *ppos, struct bt_definition *defini
 
 			assert(str);
 			if (pos->field_nr++ != 0)
-				fprintf(pos->fp, ",");
-			fprintf(pos->fp, " ");
-			fprintf(pos->fp, "\"%s\"", str);
+				ctf_text_putc(&pos->out, ',');
+			ctf_text_putc(&pos->out, ' ');
+			ctf_text_putc(&pos->out, '"');
+			ctf_text_puts(&pos->out, str);
+			ctf_text_putc(&pos->out, '"');
 		}
 	} else {
-		fprintf(pos->fp, " <unknown>");
+		ctf_text_puts(&pos->out, " <unknown>");
 	}
 
 	pos->field_nr = 0;
-	fprintf(pos->fp, " :");
+	ctf_text_puts(&pos->out, " :");
 	ret = generic_rw(ppos, &integer_definition->p);
 
 	pos->depth--;
-	fprintf(pos->fp, " )");
+	ctf_text_puts(&pos->out, " )");
 	pos->field_nr = field_nr_saved;
 	return ret;
 }
@@ -32,49 +32,20 @@
 #include <stdint.h>
 #include <babeltrace/bitfield.h>
 
-int ctf_text_integer_write(struct bt_stream_pos *ppos, struct bt_definition *definition)
+int ctf_text_put_integer(struct ctf_text_buffer *out,
+		const struct definition_integer *integer_definition)
 {
-	struct definition_integer *integer_definition =
-		container_of(definition, struct definition_integer, p);
 	const struct declaration_integer *integer_declaration =
 		integer_definition->declaration;
-	struct ctf_text_stream_pos *pos = ctf_text_pos(ppos);
-
-	if (!print_field(definition))
-		return 0;
-
-	if (pos->dummy)
-		return 0;
-
-	if (pos->field_nr++ != 0)
-		fprintf(pos->fp, ",");
-	fprintf(pos->fp, " ");
-	if (pos->print_names)
-		fprintf(pos->fp, "%s = ",
-			rem_(g_quark_to_string(definition->name)));
-
-	if (pos->string
-	    && (integer_declaration->encoding == CTF_STRING_ASCII
-	      || integer_declaration->encoding == CTF_STRING_UTF8)) {
-
-		if (!integer_declaration->signedness) {
-			g_string_append_c(pos->string,
-				(int) integer_definition->value._unsigned);
-		} else {
-			g_string_append_c(pos->string,
-				(int) integer_definition->value._signed);
-		}
-		return 0;
-	}
 
 	switch (integer_declaration->base) {
 	case 0:	/* default */
 	case 10:
 		if (!integer_declaration->signedness) {
-			fprintf(pos->fp, "%" PRIu64,
+			ctf_text_put_u64(out,
 				integer_definition->value._unsigned);
 		} else {
-			fprintf(pos->fp, "%" PRId64,
+			ctf_text_put_s64(out,
 				integer_definition->value._signed);
 		}
 		break;
@@ -88,10 +59,10 @@ int ctf_text_integer_write(struct bt_stream_pos *ppos, struct bt_definition *def
 		else
 			v = (uint64_t) integer_definition->value._signed;
 
-		fprintf(pos->fp, "0b");
+		ctf_text_puts(out, "0b");
 		v = _bt_piecewise_lshift(v, 64 - integer_declaration->len);
 		for (bitnr = 0; bitnr < integer_declaration->len; bitnr++) {
-			fprintf(pos->fp, "%u", (v & (1ULL << 63)) ? 1 : 0);
+			ctf_text_putc(out, (v & (1ULL << 63)) ? '1' : '0');
 			v = _bt_piecewise_lshift(v, 1);
 		}
 		break;
@@ -105,7 +76,8 @@ int ctf_text_integer_write(struct bt_stream_pos *ppos, struct bt_definition *def
 		else
 			v = (uint64_t) integer_definition->value._signed;
 
-		fprintf(pos->fp, "0%" PRIo64, v);
+		ctf_text_putc(out, '0');
+		ctf_text_put_o64(out, v);
 		break;
 	}
 	case 16:
@@ -122,7 +94,8 @@ int ctf_text_integer_write(struct bt_stream_pos *ppos, struct bt_definition *def
 			v &= ((uint64_t) 1 << rounded_len) - 1;
 		}
 
-		fprintf(pos->fp, "0x%" PRIX64, v);
+		ctf_text_puts(out, "0x");
+		ctf_text_put_X64(out, v);
 		break;
 	}
 	default:
@@ -131,3 +104,43 @@ int ctf_text_integer_write(struct bt_stream_pos *ppos, struct bt_definition *def
 
 	return 0;
 }
+
+int ctf_text_integer_write(struct bt_stream_pos *ppos, struct bt_definition *definition)
+{
+	struct definition_integer *integer_definition =
+		container_of(definition, struct definition_integer, p);
+	const struct declaration_integer *integer_declaration =
+		integer_definition->declaration;
+	struct ctf_text_stream_pos *pos = ctf_text_pos(ppos);
+
+	if (!print_field(definition))
+		return 0;
+
+	if (pos->dummy)
+		return 0;
+
+	if (pos->field_nr++ != 0)
+		ctf_text_putc(&pos->out, ',');
+	ctf_text_putc(&pos->out, ' ');
+	if (pos->print_names) {
+		ctf_text_puts(&pos->out,
+			rem_(g_quark_to_string(definition->name)));
+		ctf_text_puts(&pos->out, " = ");
+	}
+
+	if (pos->string
+	    && (integer_declaration->encoding == CTF_STRING_ASCII
+	      || integer_declaration->encoding == CTF_STRING_UTF8)) {
+
+		if (!integer_declaration->signedness) {
+			g_string_append_c(pos->string,
+				(int) integer_definition->value._unsigned);
+		} else {
+			g_string_append_c(pos->string,
+				(int) integer_definition->value._signed);
+		}
+		return 0;
+	}
+
+	return ctf_text_put_integer(&pos->out, integer_definition);
+}
@@ -45,11 +45,13 @@ int ctf_text_sequence_write(struct bt_stream_pos *ppos, struct bt_definition *de
 
 	if (!pos->dummy) {
 		if (pos->field_nr++ != 0)
-			fprintf(pos->fp, ",");
-		fprintf(pos->fp, " ");
-		if (pos->print_names)
-			fprintf(pos->fp, "%s = ",
+			ctf_text_putc(&pos->out, ',');
+		ctf_text_putc(&pos->out, ' ');
+		if (pos->print_names) {
+			ctf_text_puts(&pos->out,
 				rem_(g_quark_to_string(definition->name)));
+			ctf_text_puts(&pos->out, " = ");
+		}
 	}
 
 	if (elem->id == CTF_TYPE_INTEGER) {
@@ -66,13 +68,15 @@ int ctf_text_sequence_write(struct bt_stream_pos *ppos, struct bt_definition *de
 				ret = bt_sequence_rw(ppos, definition);
 				pos->string = NULL;
 			}
-			fprintf(pos->fp, "\"%s\"", sequence_definition->string->str);
+			ctf_text_putc(&pos->out, '"');
+			ctf_text_puts(&pos->out, sequence_definition->string->str);
+			ctf_text_putc(&pos->out, '"');
 			return ret;
 		}
 	}
 
 	if (!pos->dummy) {
-		fprintf(pos->fp, "[");
+		ctf_text_putc(&pos->out, '[');
 		pos->depth++;
 	}
 	field_nr_saved = pos->field_nr;
@@ -80,7 +84,7 @@ int ctf_text_sequence_write(struct bt_stream_pos *ppos, struct bt_definition *de
 	ret = bt_sequence_rw(ppos, definition);
 	if (!pos->dummy) {
 		pos->depth--;
-		fprintf(pos->fp, " ]");
+		ctf_text_puts(&pos->out, " ]");
 	}
 	pos->field_nr = field_nr_saved;
 	return ret;
@@ -47,12 +47,16 @@ int ctf_text_string_write(struct bt_stream_pos *ppos,
 		return 0;
 
 	if (pos->field_nr++ != 0)
-		fprintf(pos->fp, ",");
-	fprintf(pos->fp, " ");
-	if (pos->print_names)
-		fprintf(pos->fp, "%s = ",
+		ctf_text_putc(&pos->out, ',');
+	ctf_text_putc(&pos->out, ' ');
+	if (pos->print_names) {
+		ctf_text_puts(&pos->out,
 			rem_(g_quark_to_string(definition->name)));
+		ctf_text_puts(&pos->out, " = ");
+	}
 
-	fprintf(pos->fp, "\"%s\"", string_definition->value);
+	ctf_text_putc(&pos->out, '"');
+	ctf_text_puts(&pos->out, string_definition->value);
+	ctf_text_putc(&pos->out, '"');
 	return 0;
 }
@@ -41,12 +41,14 @@ int ctf_text_variant_write(struct bt_stream_pos *ppos, struct bt_definition *def
 	if (!pos->dummy) {
 		if (pos->depth >= 0) {
 			if (pos->field_nr++ != 0)
-				fprintf(pos->fp, ",");
-			fprintf(pos->fp, " ");
-			if (pos->print_names)
-				fprintf(pos->fp, "%s = ",
+				ctf_text_putc(&pos->out, ',');
+			ctf_text_putc(&pos->out, ' ');
+			if (pos->print_names) {
+				ctf_text_puts(&pos->out,
 					rem_(g_quark_to_string(definition->name)));
-			fprintf(pos->fp, "{");
+				ctf_text_puts(&pos->out, " = ");
+			}
+			ctf_text_putc(&pos->out, '{');
 		}
 		pos->depth++;
 	}
@@ -56,7 +58,7 @@ int ctf_text_variant_write(struct bt_stream_pos *ppos, struct bt_definition *def
 	if (!pos->dummy) {
 		pos->depth--;
 		if (pos->depth >= 0) {
-			fprintf(pos->fp, " }");
+			ctf_text_puts(&pos->out, " }");
 		}
 	}
 	pos->field_nr = field_nr_saved;
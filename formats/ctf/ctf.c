@@ -36,6 +36,9 @@
 #include <babeltrace/compat/uuid.h>
 #include <babeltrace/endian.h>
 #include <babeltrace/ctf/ctf-index.h>
+#include <babeltrace/ctf/decode-plan.h>
+#include <babeltrace/ctf/decode-ahead.h>
+#include <babeltrace/ctf-text/buffer.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <sys/mman.h>
@@ -47,6 +50,7 @@
 #include <glib.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #include "metadata/ctf-scanner.h"
 #include "metadata/ctf-parser.h"
@@ -72,15 +76,37 @@
 
 #define NSEC_PER_SEC 1000000000ULL
 
+/*
+ * Default length of the file windows mapped when reading, in bytes.
+ */
+#define DEFAULT_MMAP_WINDOW	(64ULL * 1024 * 1024)
+
+/*
+ * Length of the range advised for readahead ahead of the current
+ * packet, in bytes.
+ */
+#define MMAP_READAHEAD_LEN	(4 * 1024 * 1024)
+
 #define INDEX_PATH "./index/%s.idx"
 
+/*
+ * Packet indexes built by scanning stream files are cached in this
+ * subdirectory of the user cache directory, when opt_index_cache is
+ * set.
+ */
+#define INDEX_CACHE_DIR	"babeltrace/index"
+
 int opt_clock_cycles,
 	opt_clock_seconds,
 	opt_clock_date,
-	opt_clock_gmt;
+	opt_clock_gmt,
+	opt_tree_decoder,
+	opt_index_cache,
+	opt_time_index;
 
 uint64_t opt_clock_offset;
 uint64_t opt_clock_offset_ns;
+uint64_t opt_mmap_window = DEFAULT_MMAP_WINDOW;
 
 extern int yydebug;
 
@@ -90,6 +116,16 @@ extern int yydebug;
  * with the plugin system redesign.
  */
 int babeltrace_ctf_console_output;
+/*
+ * Set by the ctf-text plugin to write out its buffered output, so that
+ * the discarded events warnings appear in order with the events.
+ */
+void (*babeltrace_ctf_console_flush)(void);
+/*
+ * Set by the ctf-text plugin to drop what it compiled for an event
+ * definition, called before the definition is freed.
+ */
+void (*babeltrace_ctf_event_definition_free)(struct ctf_event_definition *event);
 
 static
 struct bt_trace_descriptor *ctf_open_trace(const char *path, int flags,
@@ -119,6 +155,11 @@ uint64_t ctf_timestamp_end(struct bt_trace_descriptor *descriptor,
 		struct bt_trace_handle *handle, enum bt_clock_type type);
 static
 int ctf_convert_index_timestamp(struct bt_trace_descriptor *tdp);
+static
+struct ctf_event_definition *lookup_event_definition(
+		struct ctf_stream_definition *stream, uint64_t id);
+static
+void ctf_destroy_decode_plans(struct ctf_stream_definition *stream);
 
 static
 rw_dispatch read_dispatch_table[] = {
@@ -309,16 +350,92 @@ void ctf_update_timestamp(struct ctf_stream_definition *stream,
 			stream->cycles_timestamp);
 }
 
+static const char digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+/* Write the 9 digits of a nanosecond count below NSEC_PER_SEC at p. */
+static
+size_t format_nsec(char *p, uint32_t v)
+{
+	int i;
+
+	for (i = 7; i > 0; i -= 2) {
+		memcpy(p + i, &digit_pairs[2 * (v % 100)], 2);
+		v /= 100;
+	}
+	p[0] = '0' + v;
+	return 9;
+}
+
+/*
+ * Render the date and time of a second, followed by the nanoseconds
+ * dot, as "[YYYY-MM-DD ]HH:MM:SS.". Returns its length, or 0 if the
+ * broken-down time cannot be computed.
+ */
+static
+size_t format_second(char *buf, uint64_t ts_sec)
+{
+	struct tm tm;
+	time_t time_s = (time_t) ts_sec;
+	size_t len = 0;
+
+	if (!opt_clock_gmt) {
+		struct tm *res;
+
+		res = localtime_r(&time_s, &tm);
+		if (!res) {
+			fprintf(stderr, "[warning] Unable to get localtime.\n");
+			return 0;
+		}
+	} else {
+		struct tm *res;
+
+		res = gmtime_r(&time_s, &tm);
+		if (!res) {
+			fprintf(stderr, "[warning] Unable to get gmtime.\n");
+			return 0;
+		}
+	}
+	if (opt_clock_date) {
+		/* Print date and time */
+		len = strftime(buf, 26, "%F ", &tm);
+		if (!len) {
+			fprintf(stderr, "[warning] Unable to print ascii time.\n");
+			return 0;
+		}
+	}
+	/* Print time in HH:MM:SS. */
+	len += ctf_text_format_u64_width(buf + len, tm.tm_hour, 2);
+	buf[len++] = ':';
+	len += ctf_text_format_u64_width(buf + len, tm.tm_min, 2);
+	buf[len++] = ':';
+	len += ctf_text_format_u64_width(buf + len, tm.tm_sec, 2);
+	buf[len++] = '.';
+	return len;
+}
+
 /*
- * Print timestamp, rescaling clock frequency to nanoseconds and
- * applying offsets as needed (unix time).
+ * Format timestamp, rescaling clock frequency to nanoseconds and
+ * applying offsets as needed (unix time). The date and time of the
+ * second are taken from the cache when it holds the same second.
  */
 static
-void ctf_print_timestamp_real(FILE *fp,
+size_t ctf_format_timestamp_real(char *buf,
+			struct ctf_timestamp_cache *cache,
 			struct ctf_stream_definition *stream,
 			uint64_t timestamp)
 {
 	uint64_t ts_sec = 0, ts_nsec;
+	size_t len = 0;
 
 	ts_nsec = timestamp;
 
@@ -332,74 +449,69 @@ void ctf_print_timestamp_real(FILE *fp,
 	ts_nsec = ts_nsec % NSEC_PER_SEC;
 
 	if (!opt_clock_seconds) {
-		struct tm tm;
-		time_t time_s = (time_t) ts_sec;
-
-		if (!opt_clock_gmt) {
-			struct tm *res;
-
-			res = localtime_r(&time_s, &tm);
-			if (!res) {
-				fprintf(stderr, "[warning] Unable to get localtime.\n");
-				goto seconds;
-			}
+		if (cache && cache->valid && cache->sec == ts_sec
+				&& cache->gmt == opt_clock_gmt
+				&& cache->date == opt_clock_date) {
+			memcpy(buf, cache->prefix, cache->len);
+			len = cache->len;
 		} else {
-			struct tm *res;
-
-			res = gmtime_r(&time_s, &tm);
-			if (!res) {
-				fprintf(stderr, "[warning] Unable to get gmtime.\n");
-				goto seconds;
-			}
-		}
-		if (opt_clock_date) {
-			char timestr[26];
-			size_t res;
-
-			/* Print date and time */
-			res = strftime(timestr, sizeof(timestr),
-				"%F ", &tm);
-			if (!res) {
-				fprintf(stderr, "[warning] Unable to print ascii time.\n");
+			len = format_second(buf, ts_sec);
+			if (!len)
 				goto seconds;
+			if (cache) {
+				memcpy(cache->prefix, buf, len);
+				cache->len = len;
+				cache->sec = ts_sec;
+				cache->gmt = opt_clock_gmt;
+				cache->date = opt_clock_date;
+				cache->valid = 1;
 			}
-			fprintf(fp, "%s", timestr);
 		}
-		/* Print time in HH:MM:SS.ns */
-		fprintf(fp, "%02d:%02d:%02d.%09" PRIu64,
-			tm.tm_hour, tm.tm_min, tm.tm_sec, ts_nsec);
-		goto end;
+		len += format_nsec(buf + len, ts_nsec);
+		return len;
 	}
 seconds:
-	fprintf(fp, "%3" PRIu64 ".%09" PRIu64,
-		ts_sec, ts_nsec);
-
-end:
-	return;
+	len = ctf_text_format_u64_pad(buf, ts_sec, 3, ' ');
+	buf[len++] = '.';
+	len += format_nsec(buf + len, ts_nsec);
+	return len;
 }
 
 /*
- * Print timestamp, in cycles
+ * Format timestamp, in cycles
  */
 static
-void ctf_print_timestamp_cycles(FILE *fp,
+size_t ctf_format_timestamp_cycles(char *buf,
 		struct ctf_stream_definition *stream,
 		uint64_t timestamp)
 {
-	fprintf(fp, "%020" PRIu64, timestamp);
+	return ctf_text_format_u64_width(buf, timestamp, 20);
 }
 
-void ctf_print_timestamp(FILE *fp,
+size_t ctf_format_timestamp(char *buf,
+		struct ctf_timestamp_cache *cache,
 		struct ctf_stream_definition *stream,
 		uint64_t timestamp)
 {
 	if (opt_clock_cycles) {
-		ctf_print_timestamp_cycles(fp, stream, timestamp);
+		return ctf_format_timestamp_cycles(buf, stream, timestamp);
 	} else {
-		ctf_print_timestamp_real(fp, stream, timestamp);
+		return ctf_format_timestamp_real(buf, cache, stream,
+				timestamp);
 	}
 }
 
+void ctf_print_timestamp(FILE *fp,
+		struct ctf_stream_definition *stream,
+		uint64_t timestamp)
+{
+	char buf[CTF_TIMESTAMP_LEN];
+	size_t len;
+
+	len = ctf_format_timestamp(buf, NULL, stream, timestamp);
+	fwrite(buf, 1, len, fp);
+}
+
 static
 void print_uuid(FILE *fp, unsigned char *uuid)
 {
@@ -427,6 +539,8 @@ void ctf_print_discarded(FILE *fp, struct ctf_stream_definition *stream)
 	if (!stream->events_discarded || !babeltrace_ctf_console_output) {
 		return;
 	}
+	if (babeltrace_ctf_console_flush)
+		babeltrace_ctf_console_flush();
 	fflush(stdout);
 	fprintf(fp, "[warning] Tracer discarded %" PRIu64 " events between [",
 		stream->events_discarded);
@@ -458,6 +572,111 @@ void ctf_print_discarded(FILE *fp, struct ctf_stream_definition *stream)
 	fflush(fp);
 }
 
+/*
+ * Read an event header laid out as the LTTng compact/extended header,
+ * without going through the variant.
+ */
+static
+int ctf_read_compact_event_header(struct ctf_stream_pos *pos,
+		struct ctf_stream_definition *stream)
+{
+	struct ctf_compact_event_header *header = stream->compact_header;
+	struct definition_integer *id_integer = header->id->integer;
+	struct ctf_event_header_choice *choice;
+	GArray *qs;
+	int ret;
+
+	if (unlikely(!ctf_align_pos(pos,
+			stream->stream_event_header->p.declaration->alignment)))
+		return -EFAULT;
+	ret = ctf_integer_read(&pos->parent, &id_integer->p);
+	if (unlikely(ret))
+		return ret;
+	if (id_integer->value._unsigned == header->extended_value) {
+		choice = header->extended;
+		qs = header->extended_quarks;
+		header->id->interval = header->extended_interval;
+	} else {
+		choice = header->compact;
+		qs = header->compact_quarks;
+		header->id->interval = header->compact_interval;
+	}
+	if (unlikely(!ctf_align_pos(pos, choice->field->declaration->alignment)))
+		return -EFAULT;
+	if (choice->id) {
+		ret = ctf_integer_read(&pos->parent, &choice->id->p);
+		if (unlikely(ret))
+			return ret;
+	}
+	ret = ctf_integer_read(&pos->parent, &choice->timestamp->p);
+	if (unlikely(ret))
+		return ret;
+
+	/* Keep the header definitions consistent for their readers. */
+	if (header->id->value != qs) {
+		if (header->id->value)
+			g_array_unref(header->id->value);
+		header->id->value = g_array_ref(qs);
+	}
+	stream->header_v->current_field = choice->field;
+	return 0;
+}
+
+static inline
+struct ctf_event_header_choice *lookup_event_header_choice(
+		struct ctf_stream_definition *stream)
+{
+	struct bt_definition *field = stream->header_v->current_field;
+	unsigned int i;
+
+	for (i = 0; i < stream->header_v_choices->len; i++) {
+		struct ctf_event_header_choice *choice =
+			&g_array_index(stream->header_v_choices,
+				struct ctf_event_header_choice, i);
+
+		if (choice->field == field)
+			return choice;
+	}
+	return NULL;
+}
+
+/*
+ * Move past the contexts and payload of an event left out of the
+ * iterator event selection. A static layout is skipped at once; a
+ * dynamic one is scanned for the size of its fields only.
+ */
+static
+int ctf_skip_event(struct bt_stream_pos *ppos,
+		struct ctf_stream_definition *stream,
+		struct ctf_event_definition *event)
+{
+	struct ctf_stream_pos *pos =
+		container_of(ppos, struct ctf_stream_pos, parent);
+	int ret;
+
+	if (event->plan) {
+		if (event->plan->skips)
+			return ctf_decode_plan_skip(event->plan, pos);
+		return ctf_decode_plan_scan(event->plan, pos);
+	}
+	if (stream->stream_event_context) {
+		ret = generic_rw(ppos, &stream->stream_event_context->p);
+		if (ret)
+			return ret;
+	}
+	if (event->event_context) {
+		ret = generic_rw(ppos, &event->event_context->p);
+		if (ret)
+			return ret;
+	}
+	if (event->event_fields) {
+		ret = generic_rw(ppos, &event->event_fields->p);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
 static
 int ctf_read_event(struct bt_stream_pos *ppos, struct ctf_stream_definition *stream)
 {
@@ -465,9 +684,15 @@ int ctf_read_event(struct bt_stream_pos *ppos, struct ctf_stream_definition *str
 		container_of(ppos, struct ctf_stream_pos, parent);
 	struct ctf_stream_declaration *stream_class = stream->stream_class;
 	struct ctf_event_definition *event;
-	uint64_t id = 0;
+	uint64_t id = 0, prev_timestamp;
 	int ret;
 
+	/* The previous event can no longer be accessed. */
+	if (unlikely(stream->decode_state != CTF_DECODE_IDLE))
+		ctf_decode_ahead_cancel(stream);
+	stream->pending_event = NULL;
+
+retry:
 	/* We need to check for EOF here for empty files. */
 	if (unlikely(pos->offset == EOF))
 		return EOF;
@@ -498,82 +723,109 @@ int ctf_read_event(struct bt_stream_pos *ppos, struct ctf_stream_definition *str
 
 	assert(pos->offset < pos->content_size);
 
+	prev_timestamp = stream->cycles_timestamp;
+
 	/* Read event header */
 	if (likely(stream->stream_event_header)) {
+		struct ctf_event_header_choice *choice = NULL;
 		struct definition_integer *integer_definition;
-		struct bt_definition *variant;
 
-		ret = generic_rw(ppos, &stream->stream_event_header->p);
+		if (stream->compact_header)
+			ret = ctf_read_compact_event_header(pos, stream);
+		else if (stream->event_header_plan)
+			ret = ctf_decode_plan_execute(stream->event_header_plan, pos);
+		else
+			ret = generic_rw(ppos, &stream->stream_event_header->p);
 		if (unlikely(ret))
 			goto error;
-		/* lookup event id */
-		integer_definition = bt_lookup_integer(&stream->stream_event_header->p, "id", FALSE);
-		if (integer_definition) {
-			id = integer_definition->value._unsigned;
-		} else {
-			struct definition_enum *enum_definition;
+		if (stream->header_v)
+			choice = lookup_event_header_choice(stream);
 
-			enum_definition = bt_lookup_enum(&stream->stream_event_header->p, "id", FALSE);
-			if (enum_definition) {
-				id = enum_definition->integer->value._unsigned;
-			}
-		}
-
-		variant = bt_lookup_variant(&stream->stream_event_header->p, "v");
-		if (variant) {
-			integer_definition = bt_lookup_integer(variant, "id", FALSE);
-			if (integer_definition) {
-				id = integer_definition->value._unsigned;
-			}
-		}
+		/* lookup event id */
+		if (stream->header_id)
+			id = stream->header_id->value._unsigned;
+		if (choice && choice->id)
+			id = choice->id->value._unsigned;
 		stream->event_id = id;
 
 		/* lookup timestamp */
-		stream->has_timestamp = 0;
-		integer_definition = bt_lookup_integer(&stream->stream_event_header->p, "timestamp", FALSE);
+		integer_definition = stream->header_timestamp;
+		if (!integer_definition && choice)
+			integer_definition = choice->timestamp;
 		if (integer_definition) {
 			ctf_update_timestamp(stream, integer_definition);
 			stream->has_timestamp = 1;
 		} else {
-			if (variant) {
-				integer_definition = bt_lookup_integer(variant, "timestamp", FALSE);
-				if (integer_definition) {
-					ctf_update_timestamp(stream, integer_definition);
-					stream->has_timestamp = 1;
-				}
-			}
+			stream->has_timestamp = 0;
 		}
 	}
 
-	/* Read stream-declared event context */
-	if (stream->stream_event_context) {
-		ret = generic_rw(ppos, &stream->stream_event_context->p);
-		if (ret)
-			goto error;
+	if (unlikely(pos->record_seek_points) && stream->has_timestamp
+			&& !(pos->packet_events++ % CTF_SEEK_POINT_INTERVAL)) {
+		struct packet_seek_point point;
+
+		point.offset = pos->last_offset;
+		point.cycles_timestamp = prev_timestamp;
+		point.event_timestamp = stream->cycles_timestamp;
+		point.real_timestamp = stream->real_timestamp;
+		ctf_pos_add_seek_point(pos, &point);
 	}
 
 	if (unlikely(id >= stream_class->events_by_id->len)) {
 		fprintf(stderr, "[error] Event id %" PRIu64 " is outside range.\n", id);
 		return -EINVAL;
 	}
-	event = g_ptr_array_index(stream->events_by_id, id);
-	if (unlikely(!event)) {
-		fprintf(stderr, "[error] Event id %" PRIu64 " is unknown.\n", id);
+	event = lookup_event_definition(stream, id);
+	if (unlikely(!event))
 		return -EINVAL;
-	}
 
-	/* Read event-declared event context */
-	if (event->event_context) {
-		ret = generic_rw(ppos, &event->event_context->p);
+	if (unlikely(event->filtered)) {
+		ret = ctf_skip_event(ppos, stream, event);
 		if (ret)
 			goto error;
+		if (pos->last_offset == pos->offset) {
+			fprintf(stderr, "[error] Invalid 0 byte event encountered.\n");
+			return -EINVAL;
+		}
+		goto retry;
 	}
 
-	/* Read event payload */
-	if (likely(event->event_fields)) {
-		ret = generic_rw(ppos, &event->event_fields->p);
+	if (stream->lazy_decode && event->plan && event->plan->skips) {
+		/* Defer decoding of stream and event contexts, and payload */
+		stream->pending_offset = pos->offset;
+		ret = ctf_decode_plan_skip(event->plan, pos);
+		if (ret)
+			goto error;
+		stream->pending_event = event;
+		if (stream->decode_ahead)
+			(void) ctf_decode_ahead_submit(stream->decode_ahead,
+				stream);
+	} else if (likely(event->plan)) {
+		/* Read stream and event contexts, and payload */
+		ret = ctf_decode_plan_execute(event->plan, pos);
 		if (ret)
 			goto error;
+	} else {
+		/* Read stream-declared event context */
+		if (stream->stream_event_context) {
+			ret = generic_rw(ppos, &stream->stream_event_context->p);
+			if (ret)
+				goto error;
+		}
+
+		/* Read event-declared event context */
+		if (event->event_context) {
+			ret = generic_rw(ppos, &event->event_context->p);
+			if (ret)
+				goto error;
+		}
+
+		/* Read event payload */
+		if (likely(event->event_fields)) {
+			ret = generic_rw(ppos, &event->event_fields->p);
+			if (ret)
+				goto error;
+		}
 	}
 
 	if (pos->last_offset == pos->offset) {
@@ -588,6 +840,39 @@ error:
 	return ret;
 }
 
+/*
+ * Decode the contexts and payload of the last event read from a stream
+ * when their decoding has been deferred. The stream position has not
+ * left the packet since the event was read.
+ */
+int ctf_decode_pending_event(struct ctf_stream_definition *stream)
+{
+	if (stream->decode_state != CTF_DECODE_IDLE)
+		return ctf_decode_ahead_wait(stream);
+	return ctf_decode_pending_payload(stream);
+}
+
+int ctf_decode_pending_payload(struct ctf_stream_definition *stream)
+{
+	struct ctf_file_stream *file_stream =
+		container_of(stream, struct ctf_file_stream, parent);
+	struct ctf_event_definition *event = stream->pending_event;
+	struct ctf_stream_pos pos;
+	int ret;
+
+	if (!event)
+		return 0;
+	stream->pending_event = NULL;
+	pos = file_stream->pos;
+	pos.offset = stream->pending_offset;
+	ret = ctf_decode_plan_execute(event->plan, &pos);
+	if (ret) {
+		fprintf(stderr, "[error] Unable to decode deferred event payload.\n");
+		return ret;
+	}
+	return 0;
+}
+
 static
 int ctf_write_event(struct bt_stream_pos *pos, struct ctf_stream_definition *stream)
 {
@@ -616,11 +901,9 @@ int ctf_write_event(struct bt_stream_pos *pos, struct ctf_stream_definition *str
 		fprintf(stderr, "[error] Event id %" PRIu64 " is outside range.\n", id);
 		return -EINVAL;
 	}
-	event = g_ptr_array_index(stream->events_by_id, id);
-	if (unlikely(!event)) {
-		fprintf(stderr, "[error] Event id %" PRIu64 " is unknown.\n", id);
+	event = lookup_event_definition(stream, id);
+	if (unlikely(!event))
 		return -EINVAL;
-	}
 
 	/* print event-declared event context */
 	if (event->event_context) {
@@ -643,104 +926,160 @@ error:
 	return ret;
 }
 
+static
+int ctf_pos_unmap(struct ctf_stream_pos *pos)
+{
+	int ret;
+
+	if (!pos->base_mma)
+		return 0;
+	/* unmap old base */
+	ret = munmap_align(pos->base_mma);
+	if (ret) {
+		fprintf(stderr, "[error] Unable to unmap old base: %s.\n",
+			strerror(errno));
+		return ret;
+	}
+	pos->unmap_count++;
+	pos->base_mma = NULL;
+	pos->window_len = 0;
+	return 0;
+}
+
 /*
- * One side-effect of this function is to unmap pos mmap base if one is
- * mapped.
+ * Advise the kernel to read ahead the file range following the start
+ * of the current packet, unless it has already been advised.
  */
 static
-int find_data_offset(struct ctf_stream_pos *pos,
-		struct ctf_file_stream *file_stream,
-		struct packet_index *packet_index)
+void ctf_pos_readahead(struct ctf_stream_pos *pos)
 {
-	uint64_t packet_map_len = DEFAULT_HEADER_LEN, tmp_map_len;
-	struct stat filestats;
-	size_t filesize;
+	off_t packet_end = pos->mmap_offset + pos->packet_size / CHAR_BIT;
+	off_t window_end = pos->window_offset + pos->window_len;
+	off_t start, end;
+	char *addr, *aligned_addr;
+
+	if (packet_end <= pos->readahead_offset)
+		return;
+	start = pos->mmap_offset;
+	if (start < pos->readahead_offset)
+		start = pos->readahead_offset;
+	end = min(window_end, packet_end + MMAP_READAHEAD_LEN);
+	addr = (char *) mmap_align_addr(pos->base_mma)
+		+ (start - pos->window_offset);
+	aligned_addr = (char *) ALIGN_FLOOR((unsigned long) addr, PAGE_SIZE);
+	/* Advice only, failure is harmless. */
+	(void) madvise(aligned_addr, addr - aligned_addr + (end - start),
+		MADV_WILLNEED);
+	pos->readahead_offset = end;
+}
+
+/*
+ * Map the current packet for reading. Packets are handed out from a
+ * window spanning several packets of the file, which is only remapped
+ * when the packet falls outside of it.
+ */
+static
+int ctf_pos_map_packet(struct ctf_stream_pos *pos)
+{
+	off_t packet_offset = pos->mmap_offset;
+	size_t packet_len = pos->packet_size / CHAR_BIT;
+	struct packet_index *last_index;
+	off_t file_end;
+	size_t window_len;
 	int ret;
 
-	pos = &file_stream->pos;
+	if (pos->base_mma && pos->window_len
+			&& packet_offset >= pos->window_offset
+			&& packet_offset + packet_len
+				<= pos->window_offset + pos->window_len)
+		goto end;
 
-	ret = fstat(pos->fd, &filestats);
-	if (ret < 0)
+	ret = ctf_pos_unmap(pos);
+	if (ret)
 		return ret;
-	filesize = filestats.st_size;
-
-	/* Deal with empty files */
-	if (!filesize) {
-		return 0;
-	}
 
-begin:
-	if (filesize - pos->mmap_offset < (packet_map_len >> LOG2_CHAR_BIT)) {
-		packet_map_len = (filesize - pos->mmap_offset) << LOG2_CHAR_BIT;
+	/* Do not map past the last packet of the file. */
+	last_index = &g_array_index(pos->packet_index, struct packet_index,
+			pos->packet_index->len - 1);
+	file_end = last_index->offset + last_index->packet_size / CHAR_BIT;
+	window_len = packet_len;
+	if (opt_mmap_window > window_len)
+		window_len = min(opt_mmap_window, file_end - packet_offset);
+	if (window_len < packet_len)
+		window_len = packet_len;
+
+	pos->base_mma = mmap_align(window_len, pos->prot, pos->flags,
+			pos->fd, packet_offset);
+	if (pos->base_mma == MAP_FAILED && errno == ENOMEM
+			&& window_len > packet_len) {
+		/*
+		 * Out of address space, e.g. with many streams or on a
+		 * 32-bit host: map the packet alone.
+		 */
+		window_len = packet_len;
+		pos->base_mma = mmap_align(window_len, pos->prot, pos->flags,
+				pos->fd, packet_offset);
 	}
-
-	if (pos->base_mma) {
-		/* unmap old base */
-		ret = munmap_align(pos->base_mma);
-		if (ret) {
-			fprintf(stderr, "[error] Unable to unmap old base: %s.\n",
-					strerror(errno));
-			return ret;
-		}
+	if (pos->base_mma == MAP_FAILED) {
+		ret = -errno;
+		fprintf(stderr, "[error] mmap error %s.\n",
+			strerror(-ret));
 		pos->base_mma = NULL;
+		return ret;
 	}
-	/* map new base. Need mapping length from header. */
-	pos->base_mma = mmap_align(packet_map_len >> LOG2_CHAR_BIT, PROT_READ,
-			MAP_PRIVATE, pos->fd, pos->mmap_offset);
-	assert(pos->base_mma != MAP_FAILED);
+	pos->map_count++;
+	pos->window_offset = packet_offset;
+	pos->window_len = window_len;
+	pos->readahead_offset = packet_offset;
+	/* Advice only, failure is harmless. */
+	(void) madvise(pos->base_mma->page_aligned_addr,
+		pos->base_mma->page_aligned_length, MADV_SEQUENTIAL);
+end:
+	pos->mmap_base_offset = packet_offset - pos->window_offset;
+	ctf_pos_readahead(pos);
+	return 0;
+}
 
-	pos->content_size = packet_map_len;
-	pos->packet_size = packet_map_len;
+/*
+ * Find the offset of the data of a packet whose index does not provide
+ * it, e.g. when imported from an index file, by reading its header and
+ * context. The packet stays mapped.
+ */
+static
+int find_data_offset(struct ctf_stream_pos *pos,
+		struct ctf_file_stream *file_stream,
+		struct packet_index *packet_index)
+{
+	int ret;
+
+	pos->mmap_offset = packet_index->offset;
+	pos->packet_size = packet_index->packet_size;
+	/* Headers are within the content; bound reads by the packet. */
+	pos->content_size = packet_index->packet_size;
+	ret = ctf_pos_map_packet(pos);
+	if (ret)
+		return ret;
 	pos->offset = 0;	/* Position of the packet header */
 
-	/* update trace_packet_header and stream_packet_context */
-	if (pos->prot == PROT_READ && file_stream->parent.trace_packet_header) {
+	if (file_stream->parent.trace_packet_header) {
 		/* Read packet header */
 		ret = generic_rw(&pos->parent, &file_stream->parent.trace_packet_header->p);
-		if (ret) {
-			if (ret == -EFAULT)
-				goto retry;
-		}
+		if (ret)
+			goto error;
 	}
-	if (pos->prot == PROT_READ && file_stream->parent.stream_packet_context) {
+	if (file_stream->parent.stream_packet_context) {
 		/* Read packet context */
 		ret = generic_rw(&pos->parent, &file_stream->parent.stream_packet_context->p);
-		if (ret) {
-			if (ret == -EFAULT)
-				goto retry;
-		}
+		if (ret)
+			goto error;
 	}
 	packet_index->data_offset = pos->offset;
-
-	/* unmap old base */
-	ret = munmap_align(pos->base_mma);
-	if (ret) {
-		fprintf(stderr, "[error] Unable to unmap old base: %s.\n",
-				strerror(errno));
-		return ret;
-	}
-	pos->base_mma = NULL;
-
 	return 0;
 
-	/* Retry with larger mapping */
-retry:
-	if (packet_map_len == ((filesize - pos->mmap_offset) << LOG2_CHAR_BIT)) {
-		/*
-		 * Reached EOF, but still expecting header/context data.
-		 */
-		fprintf(stderr, "[error] Reached end of file, but still expecting header or context fields.\n");
-		return -EFAULT;
-	}
-	/* Double the mapping len, and retry */
-	tmp_map_len = packet_map_len << 1;
-	if (tmp_map_len >> 1 != packet_map_len) {
-		/* Overflow */
-		fprintf(stderr, "[error] Packet mapping length overflow\n");
-		return -EFAULT;
-	}
-	packet_map_len = tmp_map_len;
-	goto begin;
+error:
+	fprintf(stderr, "[error] Unable to read packet header or context at file offset %zd.\n",
+		(ssize_t) packet_index->offset);
+	return ret;
 }
 
 
@@ -781,22 +1120,56 @@ int ctf_fini_pos(struct ctf_stream_pos *pos)
 {
 	if ((pos->prot & PROT_WRITE) && pos->content_size_loc)
 		*pos->content_size_loc = pos->offset;
-	if (pos->base_mma) {
-		int ret;
-
-		/* unmap old base */
-		ret = munmap_align(pos->base_mma);
-		if (ret) {
-			fprintf(stderr, "[error] Unable to unmap old base: %s.\n",
-				strerror(errno));
-			return -1;
-		}
-	}
+	if (ctf_pos_unmap(pos))
+		return -1;
 	if (pos->packet_index)
 		(void) g_array_free(pos->packet_index, TRUE);
+	if (pos->seek_points)
+		g_hash_table_destroy(pos->seek_points);
 	return 0;
 }
 
+static
+void free_seek_points(gpointer data)
+{
+	g_array_free(data, TRUE);
+}
+
+static
+GArray *get_packet_seek_points(struct ctf_stream_pos *pos, uint64_t packet)
+{
+	gpointer key = GUINT_TO_POINTER(packet);
+	GArray *points;
+
+	if (!pos->seek_points)
+		pos->seek_points = g_hash_table_new_full(g_direct_hash,
+				g_direct_equal, NULL, free_seek_points);
+	points = g_hash_table_lookup(pos->seek_points, key);
+	if (!points) {
+		points = g_array_new(FALSE, FALSE,
+				sizeof(struct packet_seek_point));
+		g_hash_table_insert(pos->seek_points, key, points);
+	}
+	return points;
+}
+
+GArray *ctf_pos_get_seek_points(struct ctf_stream_pos *pos)
+{
+	return get_packet_seek_points(pos, pos->cur_index);
+}
+
+void ctf_pos_add_seek_point(struct ctf_stream_pos *pos,
+		const struct packet_seek_point *point)
+{
+	GArray *points = ctf_pos_get_seek_points(pos);
+
+	if (points->len && g_array_index(points, struct packet_seek_point,
+			points->len - 1).offset >= point->offset)
+		return;
+	g_array_append_val(points, *point);
+	pos->seek_points_dirty = 1;
+}
+
 void ctf_update_current_packet_index(struct ctf_stream_definition *stream,
 		struct packet_index *prev_index,
 		struct packet_index *cur_index)
@@ -876,22 +1249,14 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 	if ((pos->prot & PROT_WRITE) && pos->content_size_loc)
 		*pos->content_size_loc = pos->offset;
 
-	if (pos->base_mma) {
-		/* unmap old base */
-		ret = munmap_align(pos->base_mma);
-		if (ret) {
-			fprintf(stderr, "[error] Unable to unmap old base: %s.\n",
-				strerror(errno));
-			assert(0);
-		}
-		pos->base_mma = NULL;
-	}
-
 	/*
 	 * The caller should never ask for ctf_move_pos across packets,
 	 * except to get exactly at the beginning of the next packet.
 	 */
 	if (pos->prot & PROT_WRITE) {
+		ret = ctf_pos_unmap(pos);
+		if (ret)
+			assert(0);
 		switch (whence) {
 		case SEEK_CUR:
 			/* The writer will add padding */
@@ -910,7 +1275,21 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 				      pos->packet_size / CHAR_BIT);
 		assert(off >= 0);
 		pos->offset = 0;
+
+		/* map new base. Need mapping length from header. */
+		pos->base_mma = mmap_align(pos->packet_size / CHAR_BIT, pos->prot,
+				pos->flags, pos->fd, pos->mmap_offset);
+		if (pos->base_mma == MAP_FAILED) {
+			fprintf(stderr, "[error] mmap error %s.\n",
+				strerror(errno));
+			assert(0);
+		}
+		pos->map_count++;
 	} else {
+		/* Workers decode from the mapping about to change. */
+		if (unlikely(file_stream->parent.decode_state
+				!= CTF_DECODE_IDLE))
+			ctf_decode_ahead_cancel(&file_stream->parent);
 	read_next_packet:
 		switch (whence) {
 		case SEEK_CUR:
@@ -965,6 +1344,7 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 				struct packet_index,
 				pos->cur_index);
 		file_stream->parent.cycles_timestamp = packet_index->ts_cycles.timestamp_begin;
+		pos->packet_events = 0;
 
 		file_stream->parent.real_timestamp = packet_index->ts_real.timestamp_begin;
 
@@ -990,14 +1370,9 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 			pos->offset = EOF;
 			return;
 		}
-	}
-	/* map new base. Need mapping length from header. */
-	pos->base_mma = mmap_align(pos->packet_size / CHAR_BIT, pos->prot,
-			pos->flags, pos->fd, pos->mmap_offset);
-	if (pos->base_mma == MAP_FAILED) {
-		fprintf(stderr, "[error] mmap error %s.\n",
-			strerror(errno));
-		assert(0);
+		ret = ctf_pos_map_packet(pos);
+		if (ret)
+			assert(0);
 	}
 
 	/* update trace_packet_header and stream_packet_context */
@@ -1354,10 +1729,27 @@ struct ctf_event_definition *create_event_definitions(struct ctf_trace *td,
 					struct definition_struct, p);
 		stream->parent_def_scope = stream_event->event_fields->p.scope;
 	}
+	if (!opt_tree_decoder) {
+		int ret = 0;
+
+		stream_event->plan = ctf_decode_plan_create();
+		if (stream->stream_event_context)
+			ret = ctf_decode_plan_append(stream_event->plan,
+					&stream->stream_event_context->p);
+		if (!ret && stream_event->event_context)
+			ret = ctf_decode_plan_append(stream_event->plan,
+					&stream_event->event_context->p);
+		if (!ret && stream_event->event_fields)
+			ret = ctf_decode_plan_append(stream_event->plan,
+					&stream_event->event_fields->p);
+		if (ret)
+			goto error;
+	}
 	stream_event->stream = stream;
 	return stream_event;
 
 error:
+	ctf_decode_plan_destroy(stream_event->plan);
 	if (stream_event->event_fields)
 		bt_definition_unref(&stream_event->event_fields->p);
 	if (stream_event->event_context)
@@ -1367,34 +1759,219 @@ error:
 	return NULL;
 }
 
+/*
+ * Event definitions are created on the first occurrence of their id in
+ * the stream by lookup_event_definition(): only make room for the event
+ * classes of the stream class.
+ */
 static
-int copy_event_declarations_stream_class_to_stream(struct ctf_trace *td,
-		struct ctf_stream_declaration *stream_class,
+void resize_event_definitions(struct ctf_stream_declaration *stream_class,
 		struct ctf_stream_definition *stream)
 {
-	size_t def_size, class_size, i;
-	int ret = 0;
-
-	def_size = stream->events_by_id->len;
-	class_size = stream_class->events_by_id->len;
+	if (stream->events_by_id->len < stream_class->events_by_id->len)
+		g_ptr_array_set_size(stream->events_by_id,
+			stream_class->events_by_id->len);
+}
 
-	g_ptr_array_set_size(stream->events_by_id, class_size);
-	for (i = def_size; i < class_size; i++) {
-		struct ctf_event_declaration *event =
-			g_ptr_array_index(stream_class->events_by_id, i);
-		struct ctf_event_definition *stream_event;
+/*
+ * Return the definition of event id of the stream, creating it if this
+ * is the first occurrence of the id. The event is filtered out if the
+ * stream has an event selection which does not include it.
+ */
+static
+struct ctf_event_definition *lookup_event_definition(
+		struct ctf_stream_definition *stream, uint64_t id)
+{
+	struct ctf_stream_declaration *stream_class = stream->stream_class;
+	struct ctf_event_declaration *event_class;
+	struct ctf_event_definition *event;
+	int i;
 
-		if (!event)
-			continue;
-		stream_event = create_event_definitions(td, stream, event);
-		if (!stream_event) {
-			ret = -EINVAL;
-			goto error;
+	if (unlikely(id >= stream->events_by_id->len))
+		resize_event_definitions(stream_class, stream);
+	event = g_ptr_array_index(stream->events_by_id, id);
+	if (likely(event))
+		return event;
+	event_class = g_ptr_array_index(stream_class->events_by_id, id);
+	if (!event_class) {
+		fprintf(stderr, "[error] Event id %" PRIu64 " is unknown.\n", id);
+		return NULL;
+	}
+	event = create_event_definitions(stream_class->trace, stream,
+			event_class);
+	if (!event)
+		return NULL;
+	if (stream->event_selection) {
+		event->filtered = 1;
+		for (i = 0; i < stream->selected_events->len; i++) {
+			if (g_array_index(stream->selected_events, GQuark, i)
+					== event_class->name) {
+				event->filtered = 0;
+				break;
+			}
 		}
-		g_ptr_array_index(stream->events_by_id, i) = stream_event;
 	}
-error:
-	return ret;
+	g_ptr_array_index(stream->events_by_id, id) = event;
+	return event;
+}
+
+/*
+ * Detect the LTTng compact/extended event header layout, which can be
+ * read without going through the variant.
+ */
+static
+struct ctf_compact_event_header *create_compact_event_header(
+		struct ctf_stream_definition *stream)
+{
+	struct definition_struct *header = stream->stream_event_header;
+	struct ctf_compact_event_header *compact_header;
+	struct ctf_event_header_choice *compact = NULL, *extended = NULL;
+	struct definition_enum *id_enum;
+	struct declaration_integer *id_declaration;
+	struct bt_definition *field;
+	GArray *compact_ranges, *extended_ranges;
+	struct enum_range *range;
+	uint64_t extended_value, max_value;
+	unsigned int i;
+
+	if (!stream->header_v || header->fields->len != 2
+			|| g_ptr_array_index(header->fields, 1) != &stream->header_v->p)
+		return NULL;
+	field = g_ptr_array_index(header->fields, 0);
+	if (field->declaration->id != CTF_TYPE_ENUM
+			|| field != stream->header_v->enum_tag)
+		return NULL;
+	id_enum = container_of(field, struct definition_enum, p);
+	id_declaration = id_enum->integer->declaration;
+	if (id_declaration->signedness || stream->header_id != id_enum->integer)
+		return NULL;
+
+	for (i = 0; i < stream->header_v_choices->len; i++) {
+		struct ctf_event_header_choice *choice =
+			&g_array_index(stream->header_v_choices,
+				struct ctf_event_header_choice, i);
+
+		if (choice->field->name == g_quark_from_static_string("compact"))
+			compact = choice;
+		else if (choice->field->name == g_quark_from_static_string("extended"))
+			extended = choice;
+	}
+	if (stream->header_v_choices->len != 2 || !compact || !extended)
+		return NULL;
+	if (compact->field->declaration->id != CTF_TYPE_STRUCT
+			|| extended->field->declaration->id != CTF_TYPE_STRUCT)
+		return NULL;
+	if (container_of(compact->field, struct definition_struct, p)->fields->len != 1
+			|| compact->id || !compact->timestamp)
+		return NULL;
+	if (container_of(extended->field, struct definition_struct, p)->fields->len != 2
+			|| !extended->id || !extended->timestamp
+			|| extended->id->p.index != 0)
+		return NULL;
+
+	/*
+	 * The extended header is selected by the largest "id" value, all
+	 * others select the compact header.
+	 */
+	if (bt_enum_get_nr_enumerators(id_enum->declaration) != 2)
+		return NULL;
+	compact_ranges = bt_enum_quark_to_range_set(id_enum->declaration,
+			g_quark_from_static_string("compact"));
+	extended_ranges = bt_enum_quark_to_range_set(id_enum->declaration,
+			g_quark_from_static_string("extended"));
+	if (!compact_ranges || compact_ranges->len != 1
+			|| !extended_ranges || extended_ranges->len != 1)
+		return NULL;
+	if (id_declaration->len == 64)
+		max_value = UINT64_MAX;
+	else
+		max_value = (1ULL << id_declaration->len) - 1;
+	range = &g_array_index(extended_ranges, struct enum_range, 0);
+	extended_value = range->start._unsigned;
+	if (range->end._unsigned != extended_value || extended_value != max_value
+			|| extended_value == 0)
+		return NULL;
+	range = &g_array_index(compact_ranges, struct enum_range, 0);
+	if (range->start._unsigned != 0
+			|| range->end._unsigned != extended_value - 1)
+		return NULL;
+
+	compact_header = g_new0(struct ctf_compact_event_header, 1);
+	compact_header->id = id_enum;
+	compact_header->extended_value = extended_value;
+	compact_header->compact = compact;
+	compact_header->extended = extended;
+	compact_header->compact_quarks =
+		bt_enum_uint_to_quark_set(id_enum->declaration, 0);
+	compact_header->extended_quarks =
+		bt_enum_uint_to_quark_set(id_enum->declaration, extended_value);
+	compact_header->compact_interval =
+		bt_enum_value_to_interval(id_enum->declaration, 0);
+	compact_header->extended_interval =
+		bt_enum_value_to_interval(id_enum->declaration, extended_value);
+	return compact_header;
+}
+
+static
+void resolve_event_header_fields(struct ctf_stream_definition *stream)
+{
+	struct bt_definition *header = &stream->stream_event_header->p;
+	struct bt_definition *v;
+
+	stream->header_id = bt_lookup_integer(header, "id", FALSE);
+	if (!stream->header_id) {
+		struct definition_enum *enum_definition;
+
+		enum_definition = bt_lookup_enum(header, "id", FALSE);
+		if (enum_definition)
+			stream->header_id = enum_definition->integer;
+	}
+	stream->header_timestamp = bt_lookup_integer(header, "timestamp", FALSE);
+
+	v = bt_lookup_definition(header, "v");
+	if (v && v->declaration->id == CTF_TYPE_VARIANT) {
+		struct definition_variant *variant =
+			container_of(v, struct definition_variant, p);
+		unsigned int i;
+
+		stream->header_v = variant;
+		stream->header_v_choices = g_array_sized_new(FALSE, TRUE,
+				sizeof(struct ctf_event_header_choice),
+				variant->fields->len);
+		g_array_set_size(stream->header_v_choices, variant->fields->len);
+		for (i = 0; i < variant->fields->len; i++) {
+			struct ctf_event_header_choice *choice =
+				&g_array_index(stream->header_v_choices,
+					struct ctf_event_header_choice, i);
+
+			choice->field = g_ptr_array_index(variant->fields, i);
+			choice->id = bt_lookup_integer(choice->field, "id", FALSE);
+			choice->timestamp = bt_lookup_integer(choice->field,
+					"timestamp", FALSE);
+		}
+	}
+	if (!opt_tree_decoder)
+		stream->compact_header = create_compact_event_header(stream);
+}
+
+static
+void free_event_header_fields(struct ctf_stream_definition *stream)
+{
+	if (stream->compact_header) {
+		if (stream->compact_header->compact_quarks)
+			g_array_unref(stream->compact_header->compact_quarks);
+		if (stream->compact_header->extended_quarks)
+			g_array_unref(stream->compact_header->extended_quarks);
+		g_free(stream->compact_header);
+		stream->compact_header = NULL;
+	}
+	if (stream->header_v_choices) {
+		g_array_free(stream->header_v_choices, TRUE);
+		stream->header_v_choices = NULL;
+	}
+	stream->header_v = NULL;
+	stream->header_id = NULL;
+	stream->header_timestamp = NULL;
 }
 
 static
@@ -1402,7 +1979,6 @@ int create_stream_definitions(struct ctf_trace *td, struct ctf_stream_definition
 {
 	struct ctf_stream_declaration *stream_class;
 	int ret;
-	int i;
 
 	if (stream->stream_definitions_created)
 		return 0;
@@ -1432,6 +2008,14 @@ int create_stream_definitions(struct ctf_trace *td, struct ctf_stream_definition
 		stream->stream_event_header =
 			container_of(definition, struct definition_struct, p);
 		stream->parent_def_scope = stream->stream_event_header->p.scope;
+		if (!opt_tree_decoder) {
+			stream->event_header_plan = ctf_decode_plan_create();
+			ret = ctf_decode_plan_append(stream->event_header_plan,
+					&stream->stream_event_header->p);
+			if (ret)
+				goto error;
+		}
+		resolve_event_header_fields(stream);
 	}
 	if (stream_class->event_context_decl) {
 		struct bt_definition *definition =
@@ -1446,20 +2030,13 @@ int create_stream_definitions(struct ctf_trace *td, struct ctf_stream_definition
 		stream->parent_def_scope = stream->stream_event_context->p.scope;
 	}
 	stream->events_by_id = g_ptr_array_new();
-	ret = copy_event_declarations_stream_class_to_stream(td,
-			stream_class, stream);
-	if (ret)
-		goto error_event;
+	resize_event_definitions(stream_class, stream);
 	return 0;
 
-error_event:
-	for (i = 0; i < stream->events_by_id->len; i++) {
-		struct ctf_event_definition *stream_event = g_ptr_array_index(stream->events_by_id, i);
-		if (stream_event)
-			g_free(stream_event);
-	}
-	g_ptr_array_free(stream->events_by_id, TRUE);
 error:
+	free_event_header_fields(stream);
+	ctf_decode_plan_destroy(stream->event_header_plan);
+	stream->event_header_plan = NULL;
 	if (stream->stream_event_context)
 		bt_definition_unref(&stream->stream_event_context->p);
 	if (stream->stream_event_header)
@@ -1514,24 +2091,19 @@ begin:
 		first_packet = 1;
 	}
 
-	if (filesize - pos->mmap_offset < (packet_map_len >> LOG2_CHAR_BIT)) {
-		packet_map_len = (filesize - pos->mmap_offset) << LOG2_CHAR_BIT;
-	}
-
-	if (pos->base_mma) {
-		/* unmap old base */
-		ret = munmap_align(pos->base_mma);
-		if (ret) {
-			fprintf(stderr, "[error] Unable to unmap old base: %s.\n",
-				strerror(errno));
-			return ret;
-		}
-		pos->base_mma = NULL;
+	if (filesize - pos->mmap_offset < (packet_map_len >> LOG2_CHAR_BIT)) {
+		packet_map_len = (filesize - pos->mmap_offset) << LOG2_CHAR_BIT;
 	}
+
+	ret = ctf_pos_unmap(pos);
+	if (ret)
+		return ret;
 	/* map new base. Need mapping length from header. */
 	pos->base_mma = mmap_align(packet_map_len >> LOG2_CHAR_BIT, PROT_READ,
 			 MAP_PRIVATE, pos->fd, pos->mmap_offset);
 	assert(pos->base_mma != MAP_FAILED);
+	pos->map_count++;
+	pos->mmap_base_offset = 0;
 	/*
 	 * Use current mapping size as temporary content and packet
 	 * size.
@@ -1755,8 +2327,13 @@ retry:
 	goto begin;
 }
 
+/*
+ * Index the first packet of a stream file, which assigns the stream
+ * class of the file and creates its definitions. Following packets are
+ * indexed by create_stream_next_packet_index().
+ */
 static
-int create_stream_packet_index(struct ctf_trace *td,
+int create_stream_first_packet_index(struct ctf_trace *td,
 			struct ctf_file_stream *file_stream)
 {
 	struct ctf_stream_pos *pos;
@@ -1793,7 +2370,32 @@ int create_stream_packet_index(struct ctf_trace *td,
 		}
 	}
 
-	for (pos->mmap_offset = 0; pos->mmap_offset < filestats.st_size; ) {
+	pos->mmap_offset = 0;
+	return create_stream_one_packet_index(pos, td, file_stream,
+		filestats.st_size);
+}
+
+/*
+ * Index the packets following the first one. This only reads into the
+ * stream's own definitions, so it can run concurrently for distinct
+ * stream files, provided their packet headers and contexts contain no
+ * sequence (growing a sequence creates definitions).
+ */
+static
+int create_stream_next_packet_index(struct ctf_trace *td,
+			struct ctf_file_stream *file_stream)
+{
+	struct ctf_stream_pos *pos;
+	struct stat filestats;
+	int ret;
+
+	pos = &file_stream->pos;
+
+	ret = fstat(pos->fd, &filestats);
+	if (ret < 0)
+		return ret;
+
+	while (pos->mmap_offset < filestats.st_size) {
 		ret = create_stream_one_packet_index(pos, td, file_stream,
 			filestats.st_size);
 		if (ret)
@@ -1802,6 +2404,146 @@ int create_stream_packet_index(struct ctf_trace *td,
 	return 0;
 }
 
+static
+int declaration_has_sequence(struct bt_declaration *declaration)
+{
+	GArray *fields;
+	unsigned int i;
+
+	switch (declaration->id) {
+	case CTF_TYPE_SEQUENCE:
+		return 1;
+	case CTF_TYPE_ARRAY:
+		return declaration_has_sequence(container_of(declaration,
+				struct declaration_array, p)->elem);
+	case CTF_TYPE_STRUCT:
+		fields = container_of(declaration,
+				struct declaration_struct, p)->fields;
+		break;
+	case CTF_TYPE_VARIANT:
+		fields = container_of(declaration,
+				struct declaration_variant, p)->untagged_variant->fields;
+		break;
+	default:
+		return 0;
+	}
+	for (i = 0; i < fields->len; i++) {
+		struct declaration_field *field =
+			&g_array_index(fields, struct declaration_field, i);
+
+		if (declaration_has_sequence(field->declaration))
+			return 1;
+	}
+	return 0;
+}
+
+static
+int stream_index_is_concurrent(struct ctf_file_stream *file_stream)
+{
+	struct ctf_stream_definition *stream = &file_stream->parent;
+
+	if (stream->trace_packet_header
+			&& declaration_has_sequence(&stream->trace_packet_header->declaration->p))
+		return 0;
+	if (stream->stream_packet_context
+			&& declaration_has_sequence(&stream->stream_packet_context->declaration->p))
+		return 0;
+	return 1;
+}
+
+struct packet_index_jobs {
+	struct ctf_trace *td;
+	GPtrArray *file_streams;	/* struct ctf_file_stream to index */
+	int *ret;			/* Result for each file stream */
+	unsigned int next;		/* Next file stream to index */
+};
+
+static
+void *packet_index_worker(void *data)
+{
+	struct packet_index_jobs *jobs = data;
+
+	for (;;) {
+		unsigned int i = __sync_fetch_and_add(&jobs->next, 1);
+
+		if (i >= jobs->file_streams->len)
+			break;
+		jobs->ret[i] = create_stream_next_packet_index(jobs->td,
+			g_ptr_array_index(jobs->file_streams, i));
+	}
+	return NULL;
+}
+
+/*
+ * Index the packets following the first one of each stream file, one
+ * file per task, on as many threads as there are online processors.
+ * Streams whose packet layout prevents concurrent indexing are indexed
+ * by the calling thread.
+ */
+static
+int create_packet_indexes(struct ctf_trace *td, GPtrArray *file_streams)
+{
+	struct packet_index_jobs jobs;
+	GPtrArray *serial_streams;
+	pthread_t *threads = NULL;
+	long nr_threads = 0, nr_cpus, i;
+	int ret = 0;
+
+	jobs.td = td;
+	jobs.file_streams = g_ptr_array_new();
+	jobs.next = 0;
+	serial_streams = g_ptr_array_new();
+	for (i = 0; i < file_streams->len; i++) {
+		struct ctf_file_stream *file_stream =
+			g_ptr_array_index(file_streams, i);
+
+		if (stream_index_is_concurrent(file_stream))
+			g_ptr_array_add(jobs.file_streams, file_stream);
+		else
+			g_ptr_array_add(serial_streams, file_stream);
+	}
+	jobs.ret = g_new0(int, jobs.file_streams->len);
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_cpus > 1 && jobs.file_streams->len > 1) {
+		nr_threads = min(nr_cpus, (long) jobs.file_streams->len);
+		threads = g_new0(pthread_t, nr_threads);
+		for (i = 0; i < nr_threads; i++) {
+			if (pthread_create(&threads[i], NULL,
+					packet_index_worker, &jobs))
+				break;
+		}
+		nr_threads = i;
+	}
+	/* The calling thread also works, and finishes if no thread started. */
+	packet_index_worker(&jobs);
+	for (i = 0; i < nr_threads; i++) {
+		int join_ret;
+
+		join_ret = pthread_join(threads[i], NULL);
+		assert(!join_ret);
+	}
+	g_free(threads);
+
+	for (i = 0; i < jobs.file_streams->len; i++) {
+		if (jobs.ret[i]) {
+			ret = jobs.ret[i];
+			goto end;
+		}
+	}
+	for (i = 0; i < serial_streams->len; i++) {
+		ret = create_stream_next_packet_index(td,
+			g_ptr_array_index(serial_streams, i));
+		if (ret)
+			goto end;
+	}
+end:
+	g_free(jobs.ret);
+	g_ptr_array_free(jobs.file_streams, TRUE);
+	g_ptr_array_free(serial_streams, TRUE);
+	return ret;
+}
+
 static
 int create_trace_definitions(struct ctf_trace *td, struct ctf_stream_definition *stream)
 {
@@ -1827,9 +2569,13 @@ error:
 	return ret;
 }
 
+/*
+ * Import a packet index from an index file, or from the index cache if
+ * cached is set.
+ */
 static
 int import_stream_packet_index(struct ctf_trace *td,
-		struct ctf_file_stream *file_stream)
+		struct ctf_file_stream *file_stream, int cached)
 {
 	struct ctf_stream_pos *pos;
 	struct ctf_packet_index *ctf_index = NULL;
@@ -1845,21 +2591,25 @@ int import_stream_packet_index(struct ctf_trace *td,
 	len = fread(&index_hdr, sizeof(index_hdr), 1, pos->index_fp);
 	if (len != 1) {
 		perror("read index file header");
+		ret = -1;
 		goto error;
 	}
 
 	/* Check the index header */
-	if (be32toh(index_hdr.magic) != CTF_INDEX_MAGIC) {
+	if (be32toh(index_hdr.magic)
+			!= (cached ? CTF_CACHED_INDEX_MAGIC : CTF_INDEX_MAGIC)) {
 		fprintf(stderr, "[error] wrong index magic\n");
 		ret = -1;
 		goto error;
 	}
-	if (be32toh(index_hdr.index_major) != CTF_INDEX_MAJOR) {
-		fprintf(stderr, "[error] Incompatible index file %" PRIu64
-				".%" PRIu64 ", supported %d.%d\n",
-				be64toh(index_hdr.index_major),
-				be64toh(index_hdr.index_minor), CTF_INDEX_MAJOR,
-				CTF_INDEX_MINOR);
+	if (be32toh(index_hdr.index_major)
+			!= (cached ? CTF_CACHED_INDEX_MAJOR : CTF_INDEX_MAJOR)) {
+		fprintf(stderr, "[error] Incompatible index file %" PRIu32
+				".%" PRIu32 ", supported %d.%d\n",
+				be32toh(index_hdr.index_major),
+				be32toh(index_hdr.index_minor),
+				cached ? CTF_CACHED_INDEX_MAJOR : CTF_INDEX_MAJOR,
+				cached ? CTF_CACHED_INDEX_MINOR : CTF_INDEX_MINOR);
 		ret = -1;
 		goto error;
 	}
@@ -1869,6 +2619,11 @@ int import_stream_packet_index(struct ctf_trace *td,
 		ret = -1;
 		goto error;
 	}
+	if (cached && packet_index_len < sizeof(struct ctf_cached_packet_index)) {
+		fprintf(stderr, "[error] Cached packet index length too small.\n");
+		ret = -1;
+		goto error;
+	}
 	/*
 	 * Allocate the index length found in header, not internal
 	 * representation.
@@ -1886,7 +2641,19 @@ int import_stream_packet_index(struct ctf_trace *td,
 		index.ts_cycles.timestamp_begin = be64toh(ctf_index->timestamp_begin);
 		index.ts_cycles.timestamp_end = be64toh(ctf_index->timestamp_end);
 		index.events_discarded = be64toh(ctf_index->events_discarded);
-		index.events_discarded_len = 64;
+		if (cached) {
+			index.events_discarded_len = be64toh(((struct ctf_cached_packet_index *)
+					ctf_index)->events_discarded_len);
+			if (index.events_discarded_len > 64) {
+				fprintf(stderr, "[error] Invalid events discarded length %" PRIu64 ".\n",
+					index.events_discarded_len);
+				ret = -1;
+				goto error;
+			}
+		} else {
+			/* Index files do not hold the field size. */
+			index.events_discarded_len = 64;
+		}
 		index.data_offset = -1;
 		stream_id = be64toh(ctf_index->stream_id);
 
@@ -1930,13 +2697,349 @@ error:
 }
 
 /*
+ * Path of a cached index of a stream file, keyed by trace UUID, stream
+ * file path, size and modification time, with extension ext. The
+ * absolute path of the stream file is hashed, its name kept readable.
+ * Return NULL if the trace has no UUID.
+ */
+static
+char *index_cache_path(struct ctf_trace *td,
+		struct ctf_file_stream *file_stream, const char *ext)
+{
+	char uuid_str[BABELTRACE_UUID_STR_LEN];
+	char *trace_path, *stream_path, *path_hash, *path;
+	struct stat statbuf;
+
+	if (!CTF_TRACE_FIELD_IS_SET(td, uuid))
+		return NULL;
+	if (fstat(file_stream->pos.fd, &statbuf))
+		return NULL;
+	if (babeltrace_uuid_unparse(td->uuid, uuid_str))
+		return NULL;
+	trace_path = realpath(td->parent.path, NULL);
+	if (!trace_path)
+		return NULL;
+	stream_path = g_build_filename(trace_path, file_stream->parent.path,
+			NULL);
+	path_hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1,
+			stream_path, -1);
+	path = g_strdup_printf("%s/" INDEX_CACHE_DIR "/%s-%s-%s-%" PRIu64 "-%" PRIu64 ".%s",
+		g_get_user_cache_dir(), uuid_str, path_hash,
+		file_stream->parent.path, (uint64_t) statbuf.st_size,
+		(uint64_t) statbuf.st_mtime, ext);
+	g_free(path_hash);
+	g_free(stream_path);
+	free(trace_path);
+	return path;
+}
+
+/*
+ * Import the cached packet index of a stream file. Return 0 on success,
+ * a negative value if there is no valid cached index.
+ */
+static
+int import_cached_packet_index(struct ctf_trace *td,
+		struct ctf_file_stream *file_stream)
+{
+	struct ctf_stream_pos *pos = &file_stream->pos;
+	char *path;
+	int ret;
+
+	path = index_cache_path(td, file_stream, "idx");
+	if (!path)
+		return -ENOENT;
+	pos->index_fp = fopen(path, "r");
+	if (!pos->index_fp) {
+		ret = -ENOENT;
+		goto end;
+	}
+	/* The stream class is only assigned once the index is valid. */
+	ret = import_stream_packet_index(td, file_stream, 1);
+	if (ret) {
+		fprintf(stderr, "[warning] Ignoring invalid cached index \"%s\".\n",
+			path);
+		g_array_set_size(pos->packet_index, 0);
+	} else {
+		printf_verbose("Using cached index \"%s\".\n", path);
+	}
+	if (fclose(pos->index_fp))
+		perror("close cached index");
+	pos->index_fp = NULL;
+end:
+	g_free(path);
+	return ret;
+}
+
+/*
+ * Create a temporary file in the index cache, to be renamed to path by
+ * close_cache_file() once complete. Return NULL on error.
+ */
+static
+FILE *create_cache_file(const char *path, char **tmp_path)
+{
+	char *dir;
+	FILE *fp = NULL;
+	int fd;
+
+	*tmp_path = NULL;
+	dir = g_path_get_dirname(path);
+	if (g_mkdir_with_parents(dir, 0700)) {
+		fprintf(stderr, "[warning] Unable to create index cache directory \"%s\": %s.\n",
+			dir, strerror(errno));
+		goto end;
+	}
+	*tmp_path = g_strdup_printf("%s.XXXXXX", path);
+	fd = mkstemp(*tmp_path);
+	if (fd < 0) {
+		fprintf(stderr, "[warning] Unable to create cached index \"%s\": %s.\n",
+			*tmp_path, strerror(errno));
+		goto error;
+	}
+	fp = fdopen(fd, "w");
+	if (!fp) {
+		perror("fdopen() error");
+		(void) close(fd);
+		(void) unlink(*tmp_path);
+		goto error;
+	}
+	goto end;
+
+error:
+	g_free(*tmp_path);
+	*tmp_path = NULL;
+end:
+	g_free(dir);
+	return fp;
+}
+
+/*
+ * Close a file created by create_cache_file() and rename it to path,
+ * or remove it if error is set or it cannot be completed. Return 0 if
+ * the file was renamed.
+ */
+static
+int close_cache_file(FILE *fp, const char *path, char *tmp_path, int error)
+{
+	int ret = -1;
+
+	if (error) {
+		(void) fclose(fp);
+		goto error_write;
+	}
+	if (fclose(fp))
+		goto error_write;
+	if (rename(tmp_path, path)) {
+		fprintf(stderr, "[warning] Unable to rename cached index \"%s\": %s.\n",
+			tmp_path, strerror(errno));
+		goto error_unlink;
+	}
+	ret = 0;
+	goto end;
+
+error_write:
+	fprintf(stderr, "[warning] Unable to write cached index \"%s\".\n",
+		tmp_path);
+error_unlink:
+	(void) unlink(tmp_path);
+end:
+	g_free(tmp_path);
+	return ret;
+}
+
+/*
+ * Write the packet index of a stream file to the index cache, in the
+ * format of the trace index files. Failures only prevent caching.
+ */
+static
+void write_cached_packet_index(struct ctf_trace *td,
+		struct ctf_file_stream *file_stream)
+{
+	struct ctf_stream_pos *pos = &file_stream->pos;
+	struct ctf_packet_index_file_hdr index_hdr;
+	char *path, *tmp_path;
+	FILE *fp;
+	unsigned int i;
+	int error = 0;
+
+	path = index_cache_path(td, file_stream, "idx");
+	if (!path)
+		return;
+	fp = create_cache_file(path, &tmp_path);
+	if (!fp)
+		goto end;
+
+	index_hdr.magic = htobe32(CTF_CACHED_INDEX_MAGIC);
+	index_hdr.index_major = htobe32(CTF_CACHED_INDEX_MAJOR);
+	index_hdr.index_minor = htobe32(CTF_CACHED_INDEX_MINOR);
+	index_hdr.packet_index_len = htobe32(sizeof(struct ctf_cached_packet_index));
+	if (fwrite(&index_hdr, sizeof(index_hdr), 1, fp) != 1)
+		error = 1;
+	for (i = 0; !error && i < pos->packet_index->len; i++) {
+		struct packet_index *index = &g_array_index(pos->packet_index,
+				struct packet_index, i);
+		struct ctf_cached_packet_index ctf_index;
+
+		ctf_index.index.offset = htobe64(index->offset);
+		ctf_index.index.packet_size = htobe64(index->packet_size);
+		ctf_index.index.content_size = htobe64(index->content_size);
+		ctf_index.index.timestamp_begin = htobe64(index->ts_cycles.timestamp_begin);
+		ctf_index.index.timestamp_end = htobe64(index->ts_cycles.timestamp_end);
+		ctf_index.index.events_discarded = htobe64(index->events_discarded);
+		ctf_index.index.stream_id = htobe64(file_stream->parent.stream_id);
+		ctf_index.events_discarded_len = htobe64(index->events_discarded_len);
+		if (fwrite(&ctf_index, sizeof(ctf_index), 1, fp) != 1)
+			error = 1;
+	}
+	if (!close_cache_file(fp, path, tmp_path, error))
+		printf_verbose("Wrote cached index \"%s\".\n", path);
+end:
+	g_free(path);
+}
+
+/*
+ * Import the time index of a stream file, holding the seek points
+ * recorded by previous reads. Seek points are only kept if all of them
+ * are valid.
+ */
+static
+void import_time_index(struct ctf_trace *td,
+		struct ctf_file_stream *file_stream)
+{
+	struct ctf_stream_pos *pos = &file_stream->pos;
+	struct ctf_time_index_file_hdr index_hdr;
+	struct ctf_time_index ctf_index;
+	uint64_t prev_packet = 0;
+	int64_t prev_offset = -1;
+	char *path;
+	FILE *fp;
+
+	path = index_cache_path(td, file_stream, "tidx");
+	if (!path)
+		return;
+	fp = fopen(path, "r");
+	if (!fp)
+		goto end;
+	if (fread(&index_hdr, sizeof(index_hdr), 1, fp) != 1
+			|| be32toh(index_hdr.magic) != CTF_TIME_INDEX_MAGIC
+			|| be32toh(index_hdr.index_major) != CTF_TIME_INDEX_MAJOR
+			|| be32toh(index_hdr.time_index_len) != sizeof(ctf_index))
+		goto error;
+	while (fread(&ctf_index, sizeof(ctf_index), 1, fp) == 1) {
+		struct packet_seek_point point;
+		struct packet_index *index;
+		uint64_t packet = be64toh(ctf_index.packet);
+
+		point.offset = be64toh(ctf_index.offset);
+		point.cycles_timestamp = be64toh(ctf_index.cycles_timestamp);
+		point.event_timestamp = be64toh(ctf_index.timestamp);
+		if (packet >= pos->packet_index->len || packet < prev_packet
+				|| (packet == prev_packet
+					&& point.offset <= prev_offset))
+			goto error;
+		index = &g_array_index(pos->packet_index,
+				struct packet_index, packet);
+		if (point.offset < 0 || point.offset >= index->content_size)
+			goto error;
+		/*
+		 * The clock offsets are only resolved once the trace is
+		 * added to its collection: the real timestamp is set by
+		 * ctf_convert_index_timestamp().
+		 */
+		point.real_timestamp = 0;
+		g_array_append_val(get_packet_seek_points(pos, packet), point);
+		prev_packet = packet;
+		prev_offset = point.offset;
+	}
+	if (ferror(fp))
+		goto error;
+	printf_verbose("Using time index \"%s\".\n", path);
+	goto close;
+
+error:
+	fprintf(stderr, "[warning] Ignoring invalid time index \"%s\".\n",
+		path);
+	if (pos->seek_points) {
+		g_hash_table_destroy(pos->seek_points);
+		pos->seek_points = NULL;
+	}
+close:
+	if (fclose(fp))
+		perror("close time index");
+end:
+	g_free(path);
+}
+
+/*
+ * Write the seek points of a stream file to its time index when new
+ * ones were recorded. Failures only prevent caching.
+ */
+static
+void write_time_index(struct ctf_trace *td,
+		struct ctf_file_stream *file_stream)
+{
+	struct ctf_stream_pos *pos = &file_stream->pos;
+	struct ctf_time_index_file_hdr index_hdr;
+	char *path, *tmp_path;
+	uint64_t packet;
+	FILE *fp;
+	int error = 0;
+
+	if (!pos->seek_points_dirty)
+		return;
+	path = index_cache_path(td, file_stream, "tidx");
+	if (!path)
+		return;
+	fp = create_cache_file(path, &tmp_path);
+	if (!fp)
+		goto end;
+
+	index_hdr.magic = htobe32(CTF_TIME_INDEX_MAGIC);
+	index_hdr.index_major = htobe32(CTF_TIME_INDEX_MAJOR);
+	index_hdr.index_minor = htobe32(CTF_TIME_INDEX_MINOR);
+	index_hdr.time_index_len = htobe32(sizeof(struct ctf_time_index));
+	if (fwrite(&index_hdr, sizeof(index_hdr), 1, fp) != 1)
+		error = 1;
+	for (packet = 0; !error && packet < pos->packet_index->len; packet++) {
+		GArray *points;
+		unsigned int i;
+
+		points = g_hash_table_lookup(pos->seek_points,
+				GUINT_TO_POINTER(packet));
+		for (i = 0; points && i < points->len; i++) {
+			struct packet_seek_point *point = &g_array_index(points,
+					struct packet_seek_point, i);
+			struct ctf_time_index ctf_index;
+
+			ctf_index.packet = htobe64(packet);
+			ctf_index.offset = htobe64(point->offset);
+			ctf_index.cycles_timestamp = htobe64(point->cycles_timestamp);
+			ctf_index.timestamp = htobe64(point->event_timestamp);
+			if (fwrite(&ctf_index, sizeof(ctf_index), 1, fp) != 1) {
+				error = 1;
+				break;
+			}
+		}
+	}
+	if (!close_cache_file(fp, path, tmp_path, error))
+		printf_verbose("Wrote time index \"%s\".\n", path);
+end:
+	g_free(path);
+}
+
+/*
+ * Open a stream file. The opened file stream is appended to
+ * file_streams; when it has no index file, it is also appended to
+ * unindexed_streams with only its first packet indexed, and the caller
+ * has to index its following packets.
+ *
  * Note: many file streams can inherit from the same stream class
  * description (metadata).
  */
 static
 int ctf_open_file_stream_read(struct ctf_trace *td, const char *path, int flags,
 		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
-			int whence))
+			int whence), GPtrArray *file_streams,
+		GPtrArray *unindexed_streams)
 {
 	int ret, fd, closeret;
 	struct ctf_file_stream *file_stream;
@@ -2004,11 +3107,15 @@ int ctf_open_file_stream_read(struct ctf_trace *td, const char *path, int flags,
 			INDEX_PATH, path);
 
 	if (faccessat(td->dirfd, index_name, O_RDONLY, flags) < 0) {
-		ret = create_stream_packet_index(td, file_stream);
+		if (opt_index_cache
+				&& !import_cached_packet_index(td, file_stream))
+			goto index_done;
+		ret = create_stream_first_packet_index(td, file_stream);
 		if (ret) {
 			fprintf(stderr, "[error] Stream index creation error.\n");
 			goto error_index;
 		}
+		g_ptr_array_add(unindexed_streams, file_stream);
 	} else {
 		ret = openat(td->dirfd, index_name, flags);
 		if (ret < 0) {
@@ -2021,7 +3128,7 @@ int ctf_open_file_stream_read(struct ctf_trace *td, const char *path, int flags,
 			perror("fdopen() error");
 			goto error_free;
 		}
-		ret = import_stream_packet_index(td, file_stream);
+		ret = import_stream_packet_index(td, file_stream, 0);
 		if (ret) {
 			ret = -1;
 			goto error_index;
@@ -2032,11 +3139,10 @@ int ctf_open_file_stream_read(struct ctf_trace *td, const char *path, int flags,
 			goto error_free;
 		}
 	}
+index_done:
 	free(index_name);
 
-	/* Add stream file to stream class */
-	g_ptr_array_add(file_stream->parent.stream_class->streams,
-			&file_stream->parent);
+	g_ptr_array_add(file_streams, file_stream);
 	return 0;
 
 error_index:
@@ -2066,6 +3172,58 @@ error:
 	return ret;
 }
 
+/*
+ * Free a file stream opened by ctf_open_file_stream_read() which is not
+ * part of its stream class yet, on trace open error.
+ */
+static
+void ctf_free_file_stream(struct ctf_file_stream *file_stream)
+{
+	struct ctf_stream_definition *stream = &file_stream->parent;
+	int i, ret;
+
+	ctf_destroy_decode_plans(stream);
+	free_event_header_fields(stream);
+	if (stream->events_by_id) {
+		for (i = 0; i < stream->events_by_id->len; i++) {
+			struct ctf_event_definition *event =
+				g_ptr_array_index(stream->events_by_id, i);
+
+			if (!event)
+				continue;
+			if (babeltrace_ctf_event_definition_free)
+				babeltrace_ctf_event_definition_free(event);
+			if (event->event_fields)
+				bt_definition_unref(&event->event_fields->p);
+			if (event->event_context)
+				bt_definition_unref(&event->event_context->p);
+			g_free(event);
+		}
+		g_ptr_array_free(stream->events_by_id, TRUE);
+	}
+	if (stream->stream_event_context)
+		bt_definition_unref(&stream->stream_event_context->p);
+	if (stream->stream_event_header)
+		bt_definition_unref(&stream->stream_event_header->p);
+	if (stream->stream_packet_context)
+		bt_definition_unref(&stream->stream_packet_context->p);
+	if (stream->trace_packet_header)
+		bt_definition_unref(&stream->trace_packet_header->p);
+	if (stream->selected_events)
+		g_array_free(stream->selected_events, TRUE);
+	ret = ctf_fini_pos(&file_stream->pos);
+	if (ret) {
+		fprintf(stderr, "Error on ctf_fini_pos\n");
+	}
+	if (file_stream->pos.fd >= 0) {
+		ret = close(file_stream->pos.fd);
+		if (ret) {
+			perror("Error on fd close");
+		}
+	}
+	g_free(file_stream);
+}
+
 static
 int ctf_open_trace_read(struct ctf_trace *td,
 		const char *path, int flags,
@@ -2078,6 +3236,8 @@ int ctf_open_trace_read(struct ctf_trace *td,
 	struct dirent *diriter;
 	size_t dirent_len;
 	char *ext;
+	GPtrArray *file_streams, *unindexed_streams;
+	unsigned int i;
 
 	td->flags = flags;
 
@@ -2130,6 +3290,8 @@ int ctf_open_trace_read(struct ctf_trace *td,
 			fpathconf(td->dirfd, _PC_NAME_MAX) + 1;
 
 	dirent = malloc(dirent_len);
+	file_streams = g_ptr_array_new();
+	unindexed_streams = g_ptr_array_new();
 
 	for (;;) {
 		ret = readdir_r(td->dir, dirent, &diriter);
@@ -2152,17 +3314,53 @@ int ctf_open_trace_read(struct ctf_trace *td,
 		}
 
 		ret = ctf_open_file_stream_read(td, diriter->d_name,
-					flags, packet_seek);
+					flags, packet_seek, file_streams,
+					unindexed_streams);
 		if (ret) {
 			fprintf(stderr, "[error] Open file stream error.\n");
 			goto readdir_error;
 		}
 	}
 
+	ret = create_packet_indexes(td, unindexed_streams);
+	if (ret) {
+		fprintf(stderr, "[error] Stream index creation error.\n");
+		goto readdir_error;
+	}
+	if (opt_index_cache) {
+		for (i = 0; i < unindexed_streams->len; i++)
+			write_cached_packet_index(td,
+				g_ptr_array_index(unindexed_streams, i));
+	}
+	if (opt_time_index) {
+		for (i = 0; i < file_streams->len; i++) {
+			struct ctf_file_stream *file_stream =
+				g_ptr_array_index(file_streams, i);
+
+			import_time_index(td, file_stream);
+			file_stream->pos.record_seek_points = 1;
+		}
+	}
+
+	/* Add stream files to stream classes, in directory order */
+	for (i = 0; i < file_streams->len; i++) {
+		struct ctf_file_stream *file_stream =
+			g_ptr_array_index(file_streams, i);
+
+		g_ptr_array_add(file_stream->parent.stream_class->streams,
+				&file_stream->parent);
+	}
+
+	g_ptr_array_free(unindexed_streams, TRUE);
+	g_ptr_array_free(file_streams, TRUE);
 	free(dirent);
 	return 0;
 
 readdir_error:
+	for (i = 0; i < file_streams->len; i++)
+		ctf_free_file_stream(g_ptr_array_index(file_streams, i));
+	g_ptr_array_free(unindexed_streams, TRUE);
+	g_ptr_array_free(file_streams, TRUE);
 	free(dirent);
 error_metadata:
 	closeret = close(td->dirfd);
@@ -2421,16 +3619,29 @@ int ctf_append_trace_metadata(struct bt_trace_descriptor *tdp,
 			stream = g_ptr_array_index(stream_class->streams, j);
 			if (!stream)
 				continue;
-			ret = copy_event_declarations_stream_class_to_stream(td,
-				stream_class, stream);
-			if (ret)
-				return ret;
+			resize_event_definitions(stream_class, stream);
 		}
 	}
 	return 0;
 }
 
 static
+void convert_seek_points_timestamp(gpointer key, gpointer value,
+		gpointer data)
+{
+	struct ctf_stream_definition *stream = data;
+	GArray *points = value;
+	int i;
+
+	for (i = 0; i < points->len; i++) {
+		struct packet_seek_point *point;
+
+		point = &g_array_index(points, struct packet_seek_point, i);
+		point->real_timestamp = ctf_get_real_timestamp(stream,
+				point->event_timestamp);
+	}
+}
+
 int ctf_convert_index_timestamp(struct bt_trace_descriptor *tdp)
 {
 	int i, j, k;
@@ -2470,16 +3681,51 @@ int ctf_convert_index_timestamp(struct bt_trace_descriptor *tdp)
 					ctf_get_real_timestamp(stream,
 							index->ts_cycles.timestamp_end);
 			}
+			/* seek points imported from the time index */
+			if (stream_pos->seek_points)
+				g_hash_table_foreach(stream_pos->seek_points,
+					convert_seek_points_timestamp, stream);
 		}
 	}
 	return 0;
 }
 
+static
+void ctf_destroy_decode_plans(struct ctf_stream_definition *stream)
+{
+	int i;
+
+	ctf_decode_plan_destroy(stream->event_header_plan);
+	stream->event_header_plan = NULL;
+	if (!stream->events_by_id)
+		return;
+	for (i = 0; i < stream->events_by_id->len; i++) {
+		struct ctf_event_definition *event =
+			g_ptr_array_index(stream->events_by_id, i);
+
+		if (!event)
+			continue;
+		ctf_decode_plan_destroy(event->plan);
+		event->plan = NULL;
+	}
+}
+
 static
 int ctf_close_file_stream(struct ctf_file_stream *file_stream)
 {
 	int ret;
 
+	ctf_destroy_decode_plans(&file_stream->parent);
+	free_event_header_fields(&file_stream->parent);
+
+	if (opt_time_index && file_stream->parent.stream_class)
+		write_time_index(file_stream->parent.stream_class->trace,
+				file_stream);
+	if (file_stream->pos.fd >= 0)
+		printf_verbose("Stream %s: %" PRIu64 " mmap and %" PRIu64 " munmap calls.\n",
+			file_stream->parent.path, file_stream->pos.map_count,
+			file_stream->pos.unmap_count);
+
 	ret = ctf_fini_pos(&file_stream->pos);
 	if (ret) {
 		fprintf(stderr, "Error on ctf_fini_pos\n");
@@ -0,0 +1,172 @@
+/*
+ * Common Trace Format
+ *
+ * Decode-ahead worker threads.
+ *
+ * Copyright 2015 EfficiOS Inc. and Linux Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/ctf/decode-ahead.h>
+#include <babeltrace/ctf/types.h>
+#include <babeltrace/babeltrace-internal.h>
+#include <assert.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <glib.h>
+
+/* Take the next job of the ring, NULL if it is empty. */
+static
+struct ctf_stream_definition *ring_take(struct ctf_decode_ahead *decode_ahead)
+{
+	for (;;) {
+		unsigned long head = decode_ahead->head;
+		struct ctf_stream_definition *stream;
+
+		__sync_synchronize();
+		if (head == decode_ahead->tail)
+			return NULL;
+		stream = decode_ahead->ring[head & (CTF_DECODE_AHEAD_RING - 1)];
+		if (__sync_bool_compare_and_swap(&decode_ahead->head,
+				head, head + 1))
+			return stream;
+	}
+}
+
+static
+void *decode_ahead_worker(void *data)
+{
+	struct ctf_decode_ahead *decode_ahead = data;
+
+	for (;;) {
+		struct ctf_stream_definition *stream;
+		int ret;
+
+		if (sem_wait(&decode_ahead->jobs)) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (decode_ahead->stop)
+			break;
+		stream = ring_take(decode_ahead);
+		if (!stream)
+			continue;
+		/* Stale entry: the job was taken back by the reader. */
+		if (!__sync_bool_compare_and_swap(&stream->decode_state,
+				CTF_DECODE_QUEUED, CTF_DECODE_RUNNING))
+			continue;
+		ret = ctf_decode_pending_payload(stream);
+		stream->decode_ret = ret;
+		__sync_synchronize();
+		stream->decode_state = CTF_DECODE_IDLE;
+	}
+	return NULL;
+}
+
+struct ctf_decode_ahead *ctf_decode_ahead_create(unsigned int nr_threads)
+{
+	struct ctf_decode_ahead *decode_ahead;
+	unsigned int i;
+
+	decode_ahead = g_new0(struct ctf_decode_ahead, 1);
+	if (sem_init(&decode_ahead->jobs, 0, 0)) {
+		perror("sem_init");
+		g_free(decode_ahead);
+		return NULL;
+	}
+	decode_ahead->threads = g_new0(pthread_t, nr_threads);
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&decode_ahead->threads[i], NULL,
+				decode_ahead_worker, decode_ahead))
+			break;
+	}
+	decode_ahead->nr_threads = i;
+	if (!i) {
+		fprintf(stderr, "[error] Unable to create decode threads.\n");
+		ctf_decode_ahead_destroy(decode_ahead);
+		return NULL;
+	}
+	return decode_ahead;
+}
+
+void ctf_decode_ahead_destroy(struct ctf_decode_ahead *decode_ahead)
+{
+	unsigned int i;
+
+	decode_ahead->stop = 1;
+	__sync_synchronize();
+	for (i = 0; i < decode_ahead->nr_threads; i++)
+		(void) sem_post(&decode_ahead->jobs);
+	for (i = 0; i < decode_ahead->nr_threads; i++) {
+		int ret;
+
+		ret = pthread_join(decode_ahead->threads[i], NULL);
+		assert(!ret);
+	}
+	(void) sem_destroy(&decode_ahead->jobs);
+	g_free(decode_ahead->threads);
+	g_free(decode_ahead);
+}
+
+int ctf_decode_ahead_submit(struct ctf_decode_ahead *decode_ahead,
+		struct ctf_stream_definition *stream)
+{
+	unsigned long tail = decode_ahead->tail;
+
+	if (tail - decode_ahead->head >= CTF_DECODE_AHEAD_RING)
+		return -EAGAIN;
+	stream->decode_state = CTF_DECODE_QUEUED;
+	decode_ahead->ring[tail & (CTF_DECODE_AHEAD_RING - 1)] = stream;
+	/* Publish the stream state and entry before the new tail. */
+	__sync_synchronize();
+	decode_ahead->tail = tail + 1;
+	(void) sem_post(&decode_ahead->jobs);
+	return 0;
+}
+
+/*
+ * Take back a job not yet taken by a worker, or wait for the worker
+ * decoding it. Returns 1 if the job was taken back.
+ */
+static
+int take_back_or_wait(struct ctf_stream_definition *stream)
+{
+	if (__sync_bool_compare_and_swap(&stream->decode_state,
+			CTF_DECODE_QUEUED, CTF_DECODE_IDLE))
+		return 1;
+	while (*(volatile int *) &stream->decode_state != CTF_DECODE_IDLE)
+		sched_yield();
+	__sync_synchronize();
+	return 0;
+}
+
+int ctf_decode_ahead_wait(struct ctf_stream_definition *stream)
+{
+	if (take_back_or_wait(stream))
+		return ctf_decode_pending_payload(stream);
+	return stream->decode_ret;
+}
+
+void ctf_decode_ahead_cancel(struct ctf_stream_definition *stream)
+{
+	(void) take_back_or_wait(stream);
+}
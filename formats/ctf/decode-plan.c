@@ -0,0 +1,618 @@
+/*
+ * Common Trace Format
+ *
+ * Compiled decode plans.
+ *
+ * Copyright 2015 EfficiOS Inc. and Linux Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/ctf/decode-plan.h>
+#include <babeltrace/ctf/types.h>
+#include <babeltrace/bitfield.h>
+#include <babeltrace/endian.h>
+#include <babeltrace/align.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <glib.h>
+
+/*
+ * Fixed-size arrays up to this length are unrolled in the plan. Longer
+ * ones are read element by element by ctf_array_read().
+ */
+#define CTF_DECODE_PLAN_MAX_UNROLL	64
+
+static
+rw_dispatch plan_read_table[] = {
+	[ CTF_TYPE_INTEGER ] = ctf_integer_read,
+	[ CTF_TYPE_FLOAT ] = ctf_float_read,
+	[ CTF_TYPE_ENUM ] = ctf_enum_read,
+	[ CTF_TYPE_STRING ] = ctf_string_read,
+	[ CTF_TYPE_STRUCT ] = ctf_struct_rw,
+	[ CTF_TYPE_VARIANT ] = ctf_variant_rw,
+	[ CTF_TYPE_ARRAY ] = ctf_array_read,
+	[ CTF_TYPE_SEQUENCE ] = ctf_sequence_read,
+};
+
+static
+int plan_add_definition(struct ctf_decode_plan *plan,
+		struct bt_definition *definition);
+
+struct ctf_decode_plan *ctf_decode_plan_create(void)
+{
+	struct ctf_decode_plan *plan;
+
+	plan = g_new0(struct ctf_decode_plan, 1);
+	plan->ops = g_array_new(FALSE, TRUE, sizeof(struct ctf_decode_op));
+	plan->run = -1;
+	plan->pending_alignment = 1;
+	return plan;
+}
+
+void ctf_decode_plan_destroy(struct ctf_decode_plan *plan)
+{
+	if (!plan)
+		return;
+	g_array_free(plan->ops, TRUE);
+	if (plan->skips)
+		g_array_free(plan->skips, TRUE);
+	g_free(plan);
+}
+
+static
+struct ctf_decode_op *plan_add_op(struct ctf_decode_plan *plan,
+		enum ctf_decode_op_type type)
+{
+	struct ctf_decode_op op = { .type = type };
+
+	g_array_append_val(plan->ops, op);
+	return &g_array_index(plan->ops, struct ctf_decode_op,
+			plan->ops->len - 1);
+}
+
+static
+struct ctf_decode_op *plan_run(struct ctf_decode_plan *plan)
+{
+	if (plan->run < 0)
+		return NULL;
+	return &g_array_index(plan->ops, struct ctf_decode_op, plan->run);
+}
+
+/*
+ * Apply the pending alignment. It is folded into the open run when the
+ * run alignment guarantees its placement.
+ */
+static
+void plan_flush_alignment(struct ctf_decode_plan *plan)
+{
+	struct ctf_decode_op *run = plan_run(plan);
+	uint64_t alignment = plan->pending_alignment;
+
+	plan->pending_alignment = 1;
+	if (alignment <= 1)
+		return;
+	if (run && alignment <= run->alignment) {
+		run->len = ALIGN(run->len, alignment);
+	} else {
+		struct ctf_decode_op *op;
+
+		op = plan_add_op(plan, CTF_DECODE_OP_ALIGN);
+		op->alignment = alignment;
+		plan->run = -1;
+	}
+}
+
+static
+void plan_add_integer(struct ctf_decode_plan *plan,
+		struct definition_integer *integer_definition)
+{
+	const struct declaration_integer *integer_declaration =
+		integer_definition->declaration;
+	uint64_t alignment = integer_declaration->p.alignment;
+	struct ctf_decode_op *run = plan_run(plan);
+	struct ctf_decode_op *op;
+	uint64_t offset;
+
+	if (plan->pending_alignment > alignment)
+		alignment = plan->pending_alignment;
+	plan->pending_alignment = 1;
+	if (run && alignment <= run->alignment) {
+		offset = ALIGN(run->len, alignment);
+	} else {
+		run = plan_add_op(plan, CTF_DECODE_OP_RUN);
+		run->alignment = alignment;
+		plan->run = plan->ops->len - 1;
+		offset = 0;
+	}
+	run->len = offset + integer_declaration->len;
+
+	if (!(run->alignment % CHAR_BIT) && !(offset % CHAR_BIT)
+			&& (integer_declaration->len == 8
+				|| integer_declaration->len == 16
+				|| integer_declaration->len == 32
+				|| integer_declaration->len == 64)) {
+		op = plan_add_op(plan, CTF_DECODE_OP_INTEGER);
+		op->rbo = (integer_declaration->byte_order != BYTE_ORDER);
+	} else {
+		op = plan_add_op(plan, CTF_DECODE_OP_BITFIELD);
+		op->byte_order = integer_declaration->byte_order;
+	}
+	op->offset = offset;
+	op->len = integer_declaration->len;
+	op->signedness = integer_declaration->signedness;
+	op->definition = &integer_definition->p;
+}
+
+/*
+ * A static length (len != 0) lets the field be skipped without calling
+ * its read function.
+ */
+static
+void plan_add_call(struct ctf_decode_plan *plan,
+		struct bt_definition *definition, uint64_t alignment,
+		uint64_t len)
+{
+	struct ctf_decode_op *op;
+
+	plan_flush_alignment(plan);
+	op = plan_add_op(plan, CTF_DECODE_OP_CALL);
+	op->call = plan_read_table[definition->declaration->id];
+	op->definition = definition;
+	op->alignment = alignment;
+	op->len = len;
+	plan->run = -1;
+	if (!len)
+		plan->dynamic = 1;
+}
+
+static
+int plan_add_array(struct ctf_decode_plan *plan,
+		struct definition_array *array_definition)
+{
+	uint64_t i;
+	int ret;
+
+	/*
+	 * Text and packed arrays need ctf_array_read() to fill their
+	 * string or buffer.
+	 */
+	if (array_definition->string || array_definition->packed
+			|| array_definition->elems->len > CTF_DECODE_PLAN_MAX_UNROLL) {
+		struct bt_declaration *elem =
+			array_definition->declaration->elem;
+		uint64_t len = 0;
+
+		if (elem->id == CTF_TYPE_INTEGER) {
+			struct declaration_integer *integer_declaration =
+				container_of(elem, struct declaration_integer, p);
+
+			/* Elements are contiguous if their size is aligned. */
+			if (!(integer_declaration->len % elem->alignment))
+				len = integer_declaration->len
+					* array_definition->elems->len;
+		}
+		plan_add_call(plan, &array_definition->p, elem->alignment, len);
+		return 0;
+	}
+	for (i = 0; i < array_definition->elems->len; i++) {
+		ret = plan_add_definition(plan,
+			g_ptr_array_index(array_definition->elems, i));
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static
+int plan_add_definition(struct ctf_decode_plan *plan,
+		struct bt_definition *definition)
+{
+	int ret;
+
+	switch (definition->declaration->id) {
+	case CTF_TYPE_INTEGER:
+		plan_add_integer(plan, container_of(definition,
+				struct definition_integer, p));
+		return 0;
+	case CTF_TYPE_ENUM:
+	{
+		struct definition_enum *enum_definition =
+			container_of(definition, struct definition_enum, p);
+		struct ctf_decode_op *op;
+
+		plan_add_integer(plan, enum_definition->integer);
+		op = plan_add_op(plan, CTF_DECODE_OP_ENUM);
+		op->definition = definition;
+		return 0;
+	}
+	case CTF_TYPE_STRUCT:
+	{
+		struct definition_struct *struct_definition =
+			container_of(definition, struct definition_struct, p);
+		unsigned int i;
+
+		if (definition->declaration->alignment > plan->pending_alignment)
+			plan->pending_alignment = definition->declaration->alignment;
+		for (i = 0; i < struct_definition->fields->len; i++) {
+			ret = plan_add_definition(plan,
+				g_ptr_array_index(struct_definition->fields, i));
+			if (ret)
+				return ret;
+		}
+		return 0;
+	}
+	case CTF_TYPE_ARRAY:
+		return plan_add_array(plan, container_of(definition,
+				struct definition_array, p));
+	case CTF_TYPE_FLOAT:
+	{
+		struct declaration_float *float_declaration =
+			container_of(definition->declaration,
+				struct declaration_float, p);
+
+		/* Float components are bit-packed after the float alignment. */
+		plan_add_call(plan, definition,
+			float_declaration->p.alignment,
+			float_declaration->sign->len
+				+ float_declaration->mantissa->len
+				+ float_declaration->exp->len);
+		return 0;
+	}
+	case CTF_TYPE_STRING:
+	case CTF_TYPE_VARIANT:
+	case CTF_TYPE_SEQUENCE:
+		plan_add_call(plan, definition, 1, 0);
+		return 0;
+	default:
+		fprintf(stderr, "[error] %s: unknown type id %d\n", __func__,
+			(int) definition->declaration->id);
+		return -EINVAL;
+	}
+}
+
+static
+void plan_update_skips(struct ctf_decode_plan *plan)
+{
+	unsigned int i;
+
+	if (plan->skips) {
+		g_array_free(plan->skips, TRUE);
+		plan->skips = NULL;
+	}
+	if (plan->dynamic)
+		return;
+	plan->skips = g_array_new(FALSE, TRUE, sizeof(struct ctf_decode_skip));
+	for (i = 0; i < plan->ops->len; i++) {
+		struct ctf_decode_op *op =
+			&g_array_index(plan->ops, struct ctf_decode_op, i);
+		struct ctf_decode_skip skip;
+
+		switch (op->type) {
+		case CTF_DECODE_OP_RUN:
+			skip.alignment = op->alignment;
+			skip.len = op->len;
+			break;
+		case CTF_DECODE_OP_ALIGN:
+			skip.alignment = op->alignment;
+			skip.len = 0;
+			break;
+		case CTF_DECODE_OP_CALL:
+			skip.alignment = op->alignment;
+			skip.len = op->len;
+			break;
+		default:
+			continue;
+		}
+		g_array_append_val(plan->skips, skip);
+	}
+}
+
+int ctf_decode_plan_append(struct ctf_decode_plan *plan,
+		struct bt_definition *definition)
+{
+	int ret;
+
+	ret = plan_add_definition(plan, definition);
+	if (ret)
+		return ret;
+	/* Empty structures still need to be aligned. */
+	plan_flush_alignment(plan);
+	plan_update_skips(plan);
+	return 0;
+}
+
+static inline
+void plan_read_integer(const struct ctf_decode_op *op, const char *addr)
+{
+	struct definition_integer *integer_definition =
+		container_of(op->definition, struct definition_integer, p);
+
+	switch (op->len) {
+	case 8:
+	{
+		uint8_t v;
+
+		memcpy(&v, addr, sizeof(v));
+		if (!op->signedness)
+			integer_definition->value._unsigned = v;
+		else
+			integer_definition->value._signed = (int8_t) v;
+		break;
+	}
+	case 16:
+	{
+		uint16_t v;
+
+		memcpy(&v, addr, sizeof(v));
+		if (op->rbo)
+			v = GUINT16_SWAP_LE_BE(v);
+		if (!op->signedness)
+			integer_definition->value._unsigned = v;
+		else
+			integer_definition->value._signed = (int16_t) v;
+		break;
+	}
+	case 32:
+	{
+		uint32_t v;
+
+		memcpy(&v, addr, sizeof(v));
+		if (op->rbo)
+			v = GUINT32_SWAP_LE_BE(v);
+		if (!op->signedness)
+			integer_definition->value._unsigned = v;
+		else
+			integer_definition->value._signed = (int32_t) v;
+		break;
+	}
+	case 64:
+	{
+		uint64_t v;
+
+		memcpy(&v, addr, sizeof(v));
+		if (op->rbo)
+			v = GUINT64_SWAP_LE_BE(v);
+		if (!op->signedness)
+			integer_definition->value._unsigned = v;
+		else
+			integer_definition->value._signed = (int64_t) v;
+		break;
+	}
+	default:
+		assert(0);
+	}
+}
+
+static inline
+void plan_read_bitfield(const struct ctf_decode_op *op,
+		const unsigned char *base, uint64_t bit_offset)
+{
+	struct definition_integer *integer_definition =
+		container_of(op->definition, struct definition_integer, p);
+
+	if (!op->signedness) {
+		if (op->byte_order == LITTLE_ENDIAN)
+			bt_bitfield_read_le(base, unsigned char, bit_offset,
+				op->len, &integer_definition->value._unsigned);
+		else
+			bt_bitfield_read_be(base, unsigned char, bit_offset,
+				op->len, &integer_definition->value._unsigned);
+	} else {
+		if (op->byte_order == LITTLE_ENDIAN)
+			bt_bitfield_read_le(base, unsigned char, bit_offset,
+				op->len, &integer_definition->value._signed);
+		else
+			bt_bitfield_read_be(base, unsigned char, bit_offset,
+				op->len, &integer_definition->value._signed);
+	}
+}
+
+int ctf_decode_plan_execute(const struct ctf_decode_plan *plan,
+		struct ctf_stream_pos *pos)
+{
+	const struct ctf_decode_op *op, *end;
+	const unsigned char *base = NULL;
+	uint64_t run_offset = 0;
+	int ret;
+
+	op = &g_array_index(plan->ops, struct ctf_decode_op, 0);
+	end = op + plan->ops->len;
+	for (; op < end; op++) {
+		switch (op->type) {
+		case CTF_DECODE_OP_RUN:
+			if (unlikely(!ctf_align_pos(pos, op->alignment)))
+				return -EFAULT;
+			if (unlikely(!ctf_pos_access_ok(pos, op->len)))
+				return -EFAULT;
+			base = (const unsigned char *) mmap_align_addr(pos->base_mma)
+				+ pos->mmap_base_offset;
+			run_offset = pos->offset;
+			pos->offset += op->len;
+			break;
+		case CTF_DECODE_OP_INTEGER:
+			plan_read_integer(op, (const char *) base
+				+ ((run_offset + op->offset) / CHAR_BIT));
+			break;
+		case CTF_DECODE_OP_BITFIELD:
+			plan_read_bitfield(op, base, run_offset + op->offset);
+			break;
+		case CTF_DECODE_OP_ENUM:
+			ctf_enum_update_value(container_of(op->definition,
+					struct definition_enum, p));
+			break;
+		case CTF_DECODE_OP_ALIGN:
+			if (unlikely(!ctf_align_pos(pos, op->alignment)))
+				return -EFAULT;
+			break;
+		case CTF_DECODE_OP_CALL:
+			ret = op->call(&pos->parent, op->definition);
+			if (unlikely(ret))
+				return ret;
+			break;
+		}
+	}
+	return 0;
+}
+
+int ctf_decode_plan_skip(const struct ctf_decode_plan *plan,
+		struct ctf_stream_pos *pos)
+{
+	unsigned int i;
+
+	for (i = 0; i < plan->skips->len; i++) {
+		const struct ctf_decode_skip *skip =
+			&g_array_index(plan->skips, struct ctf_decode_skip, i);
+
+		if (unlikely(!ctf_align_pos(pos, skip->alignment)))
+			return -EFAULT;
+		if (unlikely(!ctf_move_pos(pos, skip->len)))
+			return -EFAULT;
+	}
+	return 0;
+}
+
+/*
+ * Move past a field read by a CALL op without filling its definition,
+ * when its size can be found without decoding its content. Return 1 if
+ * the field has been skipped, 0 if it needs to be read, a negative
+ * value on error.
+ */
+static
+int plan_skip_call(const struct ctf_decode_op *op, struct ctf_stream_pos *pos)
+{
+	struct bt_definition *definition = op->definition;
+
+	if (op->len) {
+		if (unlikely(!ctf_align_pos(pos, op->alignment)))
+			return -EFAULT;
+		if (unlikely(!ctf_move_pos(pos, op->len)))
+			return -EFAULT;
+		return 1;
+	}
+
+	switch (definition->declaration->id) {
+	case CTF_TYPE_STRING:
+	{
+		ssize_t max_len_bits;
+		const char *srcaddr;
+		size_t len;
+
+		if (unlikely(!ctf_align_pos(pos, definition->declaration->alignment)))
+			return -EFAULT;
+		if (unlikely(pos->offset == EOF))
+			return -EFAULT;
+		srcaddr = ctf_get_pos_addr(pos);
+		/* Not counting \0. Counting in bits. */
+		max_len_bits = pos->packet_size - pos->offset - CHAR_BIT;
+		if (unlikely(max_len_bits < 0))
+			return -EFAULT;
+		/* Add \0, counting in bytes. */
+		len = strnlen(srcaddr, (size_t) max_len_bits / CHAR_BIT) + 1;
+		if (unlikely(srcaddr[len - 1] != '\0'))
+			return -EFAULT;
+		if (unlikely(!ctf_move_pos(pos, len * CHAR_BIT)))
+			return -EFAULT;
+		return 1;
+	}
+	case CTF_TYPE_SEQUENCE:
+	{
+		struct definition_sequence *sequence_definition =
+			container_of(definition, struct definition_sequence, p);
+		struct bt_declaration *elem =
+			sequence_definition->declaration->elem;
+		struct declaration_integer *integer_declaration;
+		uint64_t len;
+
+		if (elem->id != CTF_TYPE_INTEGER)
+			return 0;
+		integer_declaration =
+			container_of(elem, struct declaration_integer, p);
+		/* Elements are contiguous if their size is aligned. */
+		if (integer_declaration->len % elem->alignment)
+			return 0;
+		len = bt_sequence_len(sequence_definition);
+		if (unlikely(!ctf_align_pos(pos, elem->alignment)))
+			return -EFAULT;
+		if (unlikely(len > (uint64_t) (pos->packet_size - pos->offset)
+				/ integer_declaration->len))
+			return -EFAULT;
+		if (unlikely(!ctf_move_pos(pos, len * integer_declaration->len)))
+			return -EFAULT;
+		return 1;
+	}
+	default:
+		return 0;
+	}
+}
+
+int ctf_decode_plan_scan(const struct ctf_decode_plan *plan,
+		struct ctf_stream_pos *pos)
+{
+	const struct ctf_decode_op *op, *end;
+	const unsigned char *base = NULL;
+	uint64_t run_offset = 0;
+	int ret;
+
+	op = &g_array_index(plan->ops, struct ctf_decode_op, 0);
+	end = op + plan->ops->len;
+	for (; op < end; op++) {
+		switch (op->type) {
+		case CTF_DECODE_OP_RUN:
+			if (unlikely(!ctf_align_pos(pos, op->alignment)))
+				return -EFAULT;
+			if (unlikely(!ctf_pos_access_ok(pos, op->len)))
+				return -EFAULT;
+			base = (const unsigned char *) mmap_align_addr(pos->base_mma)
+				+ pos->mmap_base_offset;
+			run_offset = pos->offset;
+			pos->offset += op->len;
+			break;
+		case CTF_DECODE_OP_INTEGER:
+			/* Integers may give the length of following fields. */
+			plan_read_integer(op, (const char *) base
+				+ ((run_offset + op->offset) / CHAR_BIT));
+			break;
+		case CTF_DECODE_OP_BITFIELD:
+			plan_read_bitfield(op, base, run_offset + op->offset);
+			break;
+		case CTF_DECODE_OP_ENUM:
+			/* Only variant tags need the enum mapping. */
+			ctf_enum_update_value(container_of(op->definition,
+					struct definition_enum, p));
+			break;
+		case CTF_DECODE_OP_ALIGN:
+			if (unlikely(!ctf_align_pos(pos, op->alignment)))
+				return -EFAULT;
+			break;
+		case CTF_DECODE_OP_CALL:
+			ret = plan_skip_call(op, pos);
+			if (unlikely(ret < 0))
+				return ret;
+			if (ret)
+				break;
+			ret = op->call(&pos->parent, op->definition);
+			if (unlikely(ret))
+				return ret;
+			break;
+		}
+	}
+	return 0;
+}
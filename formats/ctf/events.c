@@ -35,6 +35,7 @@
 #include <babeltrace/iterator-internal.h>
 #include <babeltrace/ctf/events-internal.h>
 #include <babeltrace/ctf/metadata.h>
+#include <babeltrace/ctf/decode-ahead.h>
 #include <glib.h>
 
 #include "events-private.h"
@@ -56,6 +57,22 @@ const struct bt_definition *bt_ctf_get_top_level_scope(const struct bt_ctf_event
 		return NULL;
 
 	event = ctf_event->parent;
+	switch (scope) {
+	case BT_STREAM_EVENT_CONTEXT:
+	case BT_EVENT_CONTEXT:
+	case BT_EVENT_FIELDS:
+		/* Decode the event if it has been deferred. */
+		if (event->stream
+				&& (event->stream->decode_state != CTF_DECODE_IDLE
+					|| event->stream->pending_event == event)) {
+			if (ctf_decode_pending_event(event->stream))
+				goto error;
+		}
+		break;
+	default:
+		break;
+	}
+
 	switch (scope) {
 	case BT_TRACE_PACKET_HEADER:
 		if (!event->stream)
@@ -237,6 +254,7 @@ int bt_ctf_get_field_list(const struct bt_ctf_event *ctf_event,
 		def_array = container_of(scope, const struct definition_array, p);
 		if (!def_array)
 			goto error;
+		bt_array_unpack((struct definition_array *) def_array);
 		if (def_array->elems->pdata) {
 			*list = (struct bt_definition const* const*) def_array->elems->pdata;
 			*count = def_array->elems->len;
@@ -253,6 +271,7 @@ int bt_ctf_get_field_list(const struct bt_ctf_event *ctf_event,
 		def_sequence = container_of(scope, const struct definition_sequence, p);
 		if (!def_sequence)
 			goto error;
+		bt_sequence_unpack((struct definition_sequence *) def_sequence);
 		if (def_sequence->elems->pdata) {
 			*list = (struct bt_definition const* const*) def_sequence->elems->pdata;
 			*count = (unsigned int) def_sequence->length->value._unsigned;
@@ -343,6 +362,75 @@ uint64_t bt_ctf_get_cycles(const struct bt_ctf_event *ctf_event)
 		return -1ULL;
 }
 
+/*
+ * Copy the borrowed string values of a definition tree into buffers
+ * owned by their definitions.
+ */
+static
+void copy_strings(struct bt_definition *definition)
+{
+	GPtrArray *fields = NULL;
+	int i;
+
+	switch (definition->declaration->id) {
+	case CTF_TYPE_STRING:
+	{
+		struct definition_string *string =
+			container_of(definition, struct definition_string, p);
+
+		if (string->borrowed) {
+			string->value = g_strdup(string->value);
+			string->alloc_len = string->len;
+			string->borrowed = 0;
+		}
+		return;
+	}
+	case CTF_TYPE_STRUCT:
+		fields = container_of(definition, struct definition_struct,
+				p)->fields;
+		break;
+	case CTF_TYPE_VARIANT:
+	{
+		struct definition_variant *variant =
+			container_of(definition, struct definition_variant, p);
+
+		if (variant->current_field)
+			copy_strings(variant->current_field);
+		return;
+	}
+	case CTF_TYPE_ARRAY:
+		fields = container_of(definition, struct definition_array,
+				p)->elems;
+		break;
+	case CTF_TYPE_SEQUENCE:
+		fields = container_of(definition, struct definition_sequence,
+				p)->elems;
+		break;
+	default:
+		return;
+	}
+	for (i = 0; fields && i < fields->len; i++)
+		copy_strings(g_ptr_array_index(fields, i));
+}
+
+int bt_ctf_event_copy_strings(const struct bt_ctf_event *ctf_event)
+{
+	enum bt_ctf_scope scope;
+
+	if (!ctf_event)
+		return -EINVAL;
+
+	for (scope = BT_TRACE_PACKET_HEADER; scope <= BT_EVENT_FIELDS;
+			scope++) {
+		const struct bt_definition *top;
+
+		top = bt_ctf_get_top_level_scope(ctf_event, scope);
+		if (top)
+			copy_strings((struct bt_definition *) top);
+	}
+	return 0;
+}
+
 static void bt_ctf_field_set_error(int error)
 {
 	bt_ctf_last_field_error = error;
@@ -608,6 +696,44 @@ char *bt_ctf_get_string(const struct bt_definition *field)
 	return ret;
 }
 
+const void *bt_ctf_get_int_array(const struct bt_definition *field,
+		uint64_t *len)
+{
+	const GByteArray *packed = NULL;
+
+	if (field && len) {
+		switch (bt_ctf_field_type(bt_ctf_get_decl_from_def(field))) {
+		case CTF_TYPE_ARRAY:
+		{
+			const struct definition_array *array_definition =
+				container_of(field, struct definition_array, p);
+
+			packed = array_definition->packed;
+			if (packed)
+				*len = array_definition->declaration->len;
+			break;
+		}
+		case CTF_TYPE_SEQUENCE:
+		{
+			const struct definition_sequence *sequence_definition =
+				container_of(field, struct definition_sequence, p);
+
+			packed = sequence_definition->packed;
+			if (packed)
+				*len = sequence_definition->length->value._unsigned;
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	if (!packed) {
+		bt_ctf_field_set_error(-EINVAL);
+		return NULL;
+	}
+	return packed->data;
+}
+
 double bt_ctf_get_float(const struct bt_definition *field)
 {
 	double ret = 0.0;
@@ -30,18 +30,30 @@
 #include <babeltrace/babeltrace.h>
 #include <babeltrace/format.h>
 #include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf/iterator.h>
 #include <babeltrace/ctf-ir/metadata.h>
 #include <babeltrace/prio_heap.h>
 #include <babeltrace/iterator-internal.h>
 #include <babeltrace/ctf/events-internal.h>
 #include <babeltrace/ctf/metadata.h>
+#include <babeltrace/ctf/decode-ahead.h>
 #include <glib.h>
+#include <errno.h>
 
 #include "events-private.h"
 
 struct bt_ctf_iter *bt_ctf_iter_create(struct bt_context *ctx,
 		const struct bt_iter_pos *begin_pos,
 		const struct bt_iter_pos *end_pos)
+{
+	return bt_ctf_iter_create_merge(ctx, begin_pos, end_pos,
+			BT_ITER_MERGE_HEAP);
+}
+
+struct bt_ctf_iter *bt_ctf_iter_create_merge(struct bt_context *ctx,
+		const struct bt_iter_pos *begin_pos,
+		const struct bt_iter_pos *end_pos,
+		enum bt_iter_merge merge)
 {
 	struct bt_ctf_iter *iter;
 	int ret;
@@ -50,7 +62,7 @@ struct bt_ctf_iter *bt_ctf_iter_create(struct bt_context *ctx,
 		return NULL;
 
 	iter = g_new0(struct bt_ctf_iter, 1);
-	ret = bt_iter_init(&iter->parent, ctx, begin_pos, end_pos);
+	ret = bt_iter_init(&iter->parent, ctx, begin_pos, end_pos, merge);
 	if (ret) {
 		g_free(iter);
 		return NULL;
@@ -93,10 +105,244 @@ void bt_ctf_iter_destroy(struct bt_ctf_iter *iter)
 	g_array_free(iter->callbacks, TRUE);
 	g_ptr_array_free(iter->dep_gc, TRUE);
 
+	/* Streams outlive the iterator: restore their defaults. */
+	(void) bt_ctf_iter_set_decode_threads(iter, 0);
+	(void) bt_ctf_iter_set_lazy_decode(iter, 0);
+	(void) bt_ctf_iter_set_zero_copy_strings(iter, 0);
+	(void) bt_ctf_iter_clear_event_selection(iter);
+
 	bt_iter_fini(&iter->parent);
 	g_free(iter);
 }
 
+/*
+ * Call cb on each stream definition of the traces in the iterator's
+ * context. Stop at the first error.
+ */
+static
+int iter_for_each_stream(struct bt_ctf_iter *iter,
+		int (*cb)(struct ctf_stream_definition *stream_def, void *data),
+		void *data)
+{
+	struct trace_collection *tc = iter->parent.ctx->tc;
+	int i, ret;
+
+	for (i = 0; i < tc->array->len; i++) {
+		struct ctf_trace *tin;
+		int stream_id;
+
+		tin = container_of(g_ptr_array_index(tc->array, i),
+				struct ctf_trace, parent);
+		for (stream_id = 0; stream_id < tin->streams->len;
+				stream_id++) {
+			struct ctf_stream_declaration *stream;
+			int filenr;
+
+			stream = g_ptr_array_index(tin->streams, stream_id);
+			if (!stream)
+				continue;
+			for (filenr = 0; filenr < stream->streams->len;
+					filenr++) {
+				struct ctf_stream_definition *stream_def;
+
+				stream_def = g_ptr_array_index(stream->streams,
+						filenr);
+				if (!stream_def)
+					continue;
+				ret = cb(stream_def, data);
+				if (ret)
+					return ret;
+			}
+		}
+	}
+	return 0;
+}
+
+static
+int set_lazy_decode(struct ctf_stream_definition *stream_def, void *data)
+{
+	int lazy = *(int *) data;
+
+	stream_def->lazy_decode = lazy;
+	/* Events already read stay accessible. */
+	if (!lazy && ctf_decode_pending_event(stream_def))
+		return -EINVAL;
+	return 0;
+}
+
+int bt_ctf_iter_set_lazy_decode(struct bt_ctf_iter *iter, int lazy)
+{
+	if (!iter)
+		return -EINVAL;
+
+	lazy = !!lazy;
+	iter->lazy_decode = lazy;
+	/* Decode-ahead relies on lazy decoding until it is stopped. */
+	if (iter->decode_ahead)
+		return 0;
+	return iter_for_each_stream(iter, set_lazy_decode, &lazy);
+}
+
+static
+int start_decode_ahead(struct ctf_stream_definition *stream_def, void *data)
+{
+	stream_def->decode_ahead = data;
+	stream_def->lazy_decode = 1;
+	return 0;
+}
+
+struct stop_decode_ahead_data {
+	int lazy;
+	int ret;
+};
+
+/*
+ * Never fails, so that all streams stop using the workers: errors are
+ * reported in data->ret.
+ */
+static
+int stop_decode_ahead(struct ctf_stream_definition *stream_def, void *data)
+{
+	struct stop_decode_ahead_data *stop_data = data;
+
+	/* Events already read stay accessible. */
+	if (stream_def->decode_state != CTF_DECODE_IDLE
+			&& ctf_decode_ahead_wait(stream_def))
+		stop_data->ret = -EINVAL;
+	stream_def->decode_ahead = NULL;
+	if (set_lazy_decode(stream_def, &stop_data->lazy))
+		stop_data->ret = -EINVAL;
+	return 0;
+}
+
+int bt_ctf_iter_set_decode_threads(struct bt_ctf_iter *iter, int nr_threads)
+{
+	int ret = 0;
+
+	if (!iter || nr_threads < 0)
+		return -EINVAL;
+
+	if (iter->decode_ahead) {
+		struct stop_decode_ahead_data stop_data = {
+			.lazy = iter->lazy_decode,
+			.ret = 0,
+		};
+
+		(void) iter_for_each_stream(iter, stop_decode_ahead,
+				&stop_data);
+		ctf_decode_ahead_destroy(iter->decode_ahead);
+		iter->decode_ahead = NULL;
+		ret = stop_data.ret;
+	}
+	if (!nr_threads || ret)
+		return ret;
+	iter->decode_ahead = ctf_decode_ahead_create(nr_threads);
+	if (!iter->decode_ahead)
+		return -ENOMEM;
+	return iter_for_each_stream(iter, start_decode_ahead,
+			iter->decode_ahead);
+}
+
+static
+int set_zero_copy_strings(struct ctf_stream_definition *stream_def,
+		void *data)
+{
+	struct ctf_file_stream *file_stream =
+		container_of(stream_def, struct ctf_file_stream, parent);
+
+	file_stream->pos.zero_copy_strings = *(int *) data;
+	return 0;
+}
+
+int bt_ctf_iter_set_zero_copy_strings(struct bt_ctf_iter *iter, int zero_copy)
+{
+	if (!iter)
+		return -EINVAL;
+
+	zero_copy = !!zero_copy;
+	return iter_for_each_stream(iter, set_zero_copy_strings, &zero_copy);
+}
+
+struct event_selection {
+	GQuark name;
+	int matched;		/* Set if an event class has that name */
+};
+
+/*
+ * Set the filtered flag of the events of a stream: events named after
+ * the selection in data are selected, others are filtered out. A NULL
+ * data selects all events. The selected names are kept for the event
+ * definitions created afterwards.
+ */
+static
+int set_event_filter(struct ctf_stream_definition *stream_def, void *data)
+{
+	struct ctf_stream_declaration *stream_class = stream_def->stream_class;
+	struct event_selection *selection = data;
+	int i;
+
+	for (i = 0; i < stream_class->events_by_id->len; i++) {
+		struct ctf_event_declaration *event_class;
+
+		event_class = g_ptr_array_index(stream_class->events_by_id, i);
+		if (selection && event_class
+				&& event_class->name == selection->name)
+			selection->matched = 1;
+	}
+	for (i = 0; i < stream_def->events_by_id->len; i++) {
+		struct ctf_event_definition *event;
+		struct ctf_event_declaration *event_class;
+
+		event = g_ptr_array_index(stream_def->events_by_id, i);
+		if (!event)
+			continue;
+		if (!selection) {
+			event->filtered = 0;
+			continue;
+		}
+		event_class = g_ptr_array_index(stream_class->events_by_id, i);
+		if (event_class->name == selection->name)
+			event->filtered = 0;
+		else if (!stream_def->event_selection)
+			event->filtered = 1;
+	}
+	if (selection) {
+		if (!stream_def->selected_events)
+			stream_def->selected_events =
+				g_array_new(FALSE, FALSE, sizeof(GQuark));
+		g_array_append_val(stream_def->selected_events,
+			selection->name);
+	} else if (stream_def->selected_events) {
+		g_array_set_size(stream_def->selected_events, 0);
+	}
+	stream_def->event_selection = !!selection;
+	return 0;
+}
+
+int bt_ctf_iter_select_event(struct bt_ctf_iter *iter, const char *name)
+{
+	struct event_selection selection;
+	int ret;
+
+	if (!iter || !name)
+		return -EINVAL;
+
+	selection.name = g_quark_from_string(name);
+	selection.matched = 0;
+	ret = iter_for_each_stream(iter, set_event_filter, &selection);
+	if (ret)
+		return ret;
+	return selection.matched ? 0 : -ENOENT;
+}
+
+int bt_ctf_iter_clear_event_selection(struct bt_ctf_iter *iter)
+{
+	if (!iter)
+		return -EINVAL;
+
+	return iter_for_each_stream(iter, set_event_filter, NULL);
+}
+
 struct bt_iter *bt_ctf_get_iter(struct bt_ctf_iter *iter)
 {
 	if (!iter)
@@ -123,7 +369,8 @@ struct bt_ctf_event *bt_ctf_iter_read_event_flags(struct bt_ctf_iter *iter,
 		*flags = 0;
 
 	ret = &iter->current_ctf_event;
-	file_stream = bt_heap_maximum(iter->parent.stream_heap);
+retry:
+	file_stream = bt_iter_current_stream(&iter->parent);
 	if (!file_stream) {
 		/* end of file for all streams */
 		goto stop;
@@ -144,13 +391,25 @@ struct bt_ctf_event *bt_ctf_iter_read_event_flags(struct bt_ctf_iter *iter,
 	}
 
 	stream = &file_stream->parent;
+	ret->parent = g_ptr_array_index(stream->events_by_id,
+			stream->event_id);
+	/*
+	 * Events read before the event selection was set are not
+	 * skipped by the reader.
+	 */
+	if (unlikely(ret->parent->filtered)) {
+		if (bt_iter_next(&iter->parent) < 0)
+			goto stop;
+		goto retry;
+	}
 	if (iter->parent.end_pos &&
 		iter->parent.end_pos->type == BT_SEEK_TIME &&
 		stream->real_timestamp > iter->parent.end_pos->u.seek_time) {
 		goto stop;
 	}
-	ret->parent = g_ptr_array_index(stream->events_by_id,
-			stream->event_id);
+	/* Hand out decoded events, waiting for the workers if needed. */
+	if (stream->decode_ahead && ctf_decode_pending_event(stream))
+		goto stop;
 
 	if (!file_stream->pos.packet_index)
 		packet_index = NULL;
@@ -39,6 +39,7 @@
 #include <babeltrace/compat/uuid.h>
 #include <babeltrace/endian.h>
 #include <babeltrace/ctf/events-internal.h>
+#include <babeltrace/clock-internal.h>
 #include "ctf-scanner.h"
 #include "ctf-parser.h"
 #include "ctf-ast.h"
@@ -1152,6 +1153,7 @@ struct bt_declaration *ctf_declaration_enum_visit(FILE *fd, int depth,
 			if (ret)
 				goto error;
 		}
+		bt_enum_build_index(enum_declaration);
 		if (name) {
 			int ret;
 
@@ -2486,6 +2488,7 @@ int ctf_clock_visit(FILE *fd, int depth, struct ctf_node *node, struct ctf_trace
 		fprintf(fd, "[error] %s: missing name field in clock declaration\n", __func__);
 		goto error;
 	}
+	clock_init_conversion(clock);
 	if (g_hash_table_size(trace->parent.clocks) > 0) {
 		fprintf(fd, "[error] Only CTF traces with a single clock description are supported by this babeltrace version.\n");
 		ret = -EINVAL;
@@ -2525,6 +2528,7 @@ void ctf_clock_default(FILE *fd, int depth, struct ctf_trace *trace)
 	} else {
 		clock->absolute = 0;	/* Not an absolute reference across traces */
 	}
+	clock_init_conversion(clock);
 
 	trace->parent.single_clock = clock;
 	g_hash_table_insert(trace->parent.clocks, (gpointer) (unsigned long) clock->name, clock);
@@ -2959,6 +2963,222 @@ int ctf_root_declaration_visit(FILE *fd, int depth, struct ctf_node *node, struc
 	return 0;
 }
 
+struct tag_root {
+	const char *name;
+	struct declaration_struct *declaration;
+};
+
+/*
+ * Find the declaration of an absolute field path within a dynamic scope
+ * root, going down structure fields. Returns NULL if not found.
+ */
+static
+struct bt_declaration *lookup_root_path(GArray *path,
+		const struct tag_root *root)
+{
+	struct bt_declaration *declaration = NULL;
+	GArray *root_path;
+	unsigned int i;
+
+	if (!root->declaration)
+		return NULL;
+	root_path = g_array_new(FALSE, TRUE, sizeof(GQuark));
+	bt_append_scope_path(root->name, root_path);
+	if (path->len <= root_path->len)
+		goto end;
+	for (i = 0; i < root_path->len; i++) {
+		if (g_array_index(root_path, GQuark, i)
+				!= g_array_index(path, GQuark, i))
+			goto end;
+	}
+	declaration = &root->declaration->p;
+	for (; i < path->len; i++) {
+		struct declaration_struct *struct_declaration;
+		int index;
+
+		if (declaration->id != CTF_TYPE_STRUCT) {
+			declaration = NULL;
+			break;
+		}
+		struct_declaration = container_of(declaration,
+				struct declaration_struct, p);
+		index = bt_struct_declaration_lookup_field_index(struct_declaration,
+				g_array_index(path, GQuark, i));
+		if (index < 0) {
+			declaration = NULL;
+			break;
+		}
+		declaration = bt_struct_declaration_get_field_from_index(
+				struct_declaration, index)->declaration;
+	}
+end:
+	g_array_free(root_path, TRUE);
+	return declaration;
+}
+
+/*
+ * Find the enumeration declaration of a variant tag the way
+ * bt_lookup_path_definition() finds its definition: a single name is a
+ * prior field of the enclosing structure, longer paths are absolute.
+ */
+static
+struct declaration_enum *lookup_tag_enum(GArray *tag_name,
+		struct declaration_struct *parent, unsigned long index,
+		const struct tag_root *roots, unsigned int nr_roots)
+{
+	struct bt_declaration *declaration = NULL;
+	unsigned int i;
+
+	if (tag_name->len == 1) {
+		int tag_index;
+
+		if (!parent)
+			return NULL;
+		tag_index = bt_struct_declaration_lookup_field_index(parent,
+				g_array_index(tag_name, GQuark, 0));
+		if (tag_index < 0 || tag_index >= index)
+			return NULL;
+		declaration = bt_struct_declaration_get_field_from_index(parent,
+				tag_index)->declaration;
+	} else {
+		for (i = 0; i < nr_roots && !declaration; i++)
+			declaration = lookup_root_path(tag_name, &roots[i]);
+	}
+	if (!declaration || declaration->id != CTF_TYPE_ENUM)
+		return NULL;
+	return container_of(declaration, struct declaration_enum, p);
+}
+
+/*
+ * Build the enumeration indexes and variant tag tables of a declaration
+ * and its fields. parent is the structure holding the declaration at
+ * field index, if any.
+ */
+static
+void ctf_lookup_tables_visit(struct bt_declaration *declaration,
+		struct declaration_struct *parent, unsigned long index,
+		const struct tag_root *roots, unsigned int nr_roots)
+{
+	unsigned long i;
+
+	switch (declaration->id) {
+	case CTF_TYPE_ENUM:
+	{
+		struct declaration_enum *enum_declaration =
+			container_of(declaration, struct declaration_enum, p);
+
+		if (!enum_declaration->table.intervals)
+			bt_enum_build_index(enum_declaration);
+		break;
+	}
+	case CTF_TYPE_STRUCT:
+	{
+		struct declaration_struct *struct_declaration =
+			container_of(declaration, struct declaration_struct, p);
+
+		for (i = 0; i < struct_declaration->fields->len; i++) {
+			struct declaration_field *field =
+				&g_array_index(struct_declaration->fields,
+					struct declaration_field, i);
+
+			ctf_lookup_tables_visit(field->declaration,
+				struct_declaration, i, roots, nr_roots);
+		}
+		break;
+	}
+	case CTF_TYPE_VARIANT:
+	{
+		struct declaration_variant *variant_declaration =
+			container_of(declaration, struct declaration_variant, p);
+		struct declaration_untagged_variant *untagged_variant =
+			variant_declaration->untagged_variant;
+		struct declaration_enum *enum_declaration;
+
+		enum_declaration = lookup_tag_enum(variant_declaration->tag_name,
+				parent, index, roots, nr_roots);
+		if (enum_declaration)
+			bt_variant_declaration_set_tag_enum(variant_declaration,
+				enum_declaration);
+		for (i = 0; i < untagged_variant->fields->len; i++) {
+			struct declaration_field *field =
+				&g_array_index(untagged_variant->fields,
+					struct declaration_field, i);
+
+			ctf_lookup_tables_visit(field->declaration, NULL, 0,
+				roots, nr_roots);
+		}
+		break;
+	}
+	case CTF_TYPE_ARRAY:
+		ctf_lookup_tables_visit(container_of(declaration,
+				struct declaration_array, p)->elem,
+			NULL, 0, roots, nr_roots);
+		break;
+	case CTF_TYPE_SEQUENCE:
+		ctf_lookup_tables_visit(container_of(declaration,
+				struct declaration_sequence, p)->elem,
+			NULL, 0, roots, nr_roots);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Build the lookup tables of the declarations once the metadata is
+ * complete, rather than when definitions are created: declarations are
+ * shared by all the streams of the trace. Each scope may refer to the
+ * scopes before it.
+ */
+static
+void ctf_build_lookup_tables(struct ctf_trace *trace)
+{
+	struct tag_root roots[] = {
+		{ "trace.packet.header", trace->packet_header_decl },
+		{ "stream.packet.context", NULL },
+		{ "stream.event.header", NULL },
+		{ "stream.event.context", NULL },
+		{ "event.context", NULL },
+		{ "event.fields", NULL },
+	};
+	unsigned int i, j, k;
+
+	if (roots[0].declaration)
+		ctf_lookup_tables_visit(&roots[0].declaration->p, NULL, 0,
+			roots, 1);
+	if (!trace->streams)
+		return;
+	for (i = 0; i < trace->streams->len; i++) {
+		struct ctf_stream_declaration *stream =
+			g_ptr_array_index(trace->streams, i);
+
+		if (!stream)
+			continue;
+		roots[1].declaration = stream->packet_context_decl;
+		roots[2].declaration = stream->event_header_decl;
+		roots[3].declaration = stream->event_context_decl;
+		for (k = 1; k < 4; k++) {
+			if (roots[k].declaration)
+				ctf_lookup_tables_visit(&roots[k].declaration->p,
+					NULL, 0, roots, k + 1);
+		}
+		for (j = 0; j < stream->events_by_id->len; j++) {
+			struct ctf_event_declaration *event =
+				g_ptr_array_index(stream->events_by_id, j);
+
+			if (!event)
+				continue;
+			roots[4].declaration = event->context_decl;
+			roots[5].declaration = event->fields_decl;
+			for (k = 4; k < 6; k++) {
+				if (roots[k].declaration)
+					ctf_lookup_tables_visit(&roots[k].declaration->p,
+						NULL, 0, roots, k + 1);
+			}
+		}
+	}
+}
+
 int ctf_visitor_construct_metadata(FILE *fd, int depth, struct ctf_node *node,
 		struct ctf_trace *trace, int byte_order)
 {
@@ -3055,6 +3275,7 @@ retry:
 				goto error;
 			}
 		}
+		ctf_build_lookup_tables(trace);
 		break;
 	case NODE_UNKNOWN:
 	default:
@@ -3099,6 +3320,8 @@ int ctf_destroy_metadata(struct ctf_trace *trace)
 					event = g_ptr_array_index(stream_def->events_by_id, k);
 					if (!event)
 						continue;
+					if (babeltrace_ctf_event_definition_free)
+						babeltrace_ctf_event_definition_free(event);
 					if (&event->event_fields->p)
 						bt_definition_unref(&event->event_fields->p);
 					if (&event->event_context->p)
@@ -3114,6 +3337,8 @@ int ctf_destroy_metadata(struct ctf_trace *trace)
 				if (&stream_def->stream_event_context->p)
 					bt_definition_unref(&stream_def->stream_event_context->p);
 				g_ptr_array_free(stream_def->events_by_id, TRUE);
+				if (stream_def->selected_events)
+					g_array_free(stream_def->selected_events, TRUE);
 				g_free(stream_def);
 			}
 			if (stream->event_header_decl)
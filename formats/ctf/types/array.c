@@ -38,6 +38,13 @@ int ctf_array_read(struct bt_stream_pos *ppos, struct bt_definition *definition)
 	struct ctf_stream_pos *pos =
 		container_of(ppos, struct ctf_stream_pos, parent);
 
+	if (array_definition->packed) {
+		array_definition->elems_stale = 1;
+		return ctf_packed_integers_read(pos,
+			container_of(elem, struct declaration_integer, p),
+			array_declaration->len, array_definition->packed);
+	}
+
 	if (elem->id == CTF_TYPE_INTEGER) {
 		struct declaration_integer *integer_declaration =
 			container_of(elem, struct declaration_integer, p);
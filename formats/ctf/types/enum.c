@@ -31,41 +31,48 @@
 #include <stdint.h>
 #include <glib.h>
 
-int ctf_enum_read(struct bt_stream_pos *ppos, struct bt_definition *definition)
+void ctf_enum_update_value(struct definition_enum *enum_definition)
 {
-	struct definition_enum *enum_definition =
-		container_of(definition, struct definition_enum, p);
 	const struct declaration_enum *enum_declaration =
 		enum_definition->declaration;
 	struct definition_integer *integer_definition =
 		enum_definition->integer;
 	const struct declaration_integer *integer_declaration =
 		integer_definition->declaration;
-	GArray *qs;
-	int ret;
+	GArray *qs = NULL;
+	int interval;
 
-	ret = ctf_integer_read(ppos, &integer_definition->p);
-	if (ret)
-		return ret;
-	if (!integer_declaration->signedness) {
-		qs = bt_enum_uint_to_quark_set(enum_declaration,
+	interval = bt_enum_value_to_interval(enum_declaration,
+		integer_definition->value._unsigned);
+	if (interval >= 0) {
+		qs = g_array_index(enum_declaration->table.intervals,
+			struct enum_interval, interval).quarks;
+	} else if (!integer_declaration->signedness) {
+		fprintf(stderr, "[warning] Unknown value %" PRIu64 " in enum.\n",
 			integer_definition->value._unsigned);
-		if (!qs) {
-			fprintf(stderr, "[warning] Unknown value %" PRIu64 " in enum.\n",
-				integer_definition->value._unsigned);
-		}
 	} else {
-		qs = bt_enum_int_to_quark_set(enum_declaration,
+		fprintf(stderr, "[warning] Unknown value %" PRId64 " in enum.\n",
 			integer_definition->value._signed);
-		if (!qs) {
-			fprintf(stderr, "[warning] Unknown value %" PRId64 " in enum.\n",
-				integer_definition->value._signed);
-		}
 	}
-	/* unref previous quark set */
+	enum_definition->interval = interval;
+	/* Quark sets are shared: only move the reference when it changes. */
+	if (enum_definition->value == qs)
+		return;
 	if (enum_definition->value)
 		g_array_unref(enum_definition->value);
-	enum_definition->value = qs;
+	enum_definition->value = qs ? g_array_ref(qs) : NULL;
+}
+
+int ctf_enum_read(struct bt_stream_pos *ppos, struct bt_definition *definition)
+{
+	struct definition_enum *enum_definition =
+		container_of(definition, struct definition_enum, p);
+	int ret;
+
+	ret = ctf_integer_read(ppos, &enum_definition->integer->p);
+	if (ret)
+		return ret;
+	ctf_enum_update_value(enum_definition);
 	return 0;
 }
 
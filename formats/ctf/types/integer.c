@@ -343,3 +343,64 @@ end:
 		return -EFAULT;
 	return 0;
 }
+
+/*
+ * Reverse the byte order of packed integers. Iterations are
+ * independent, so that compilers vectorize these loops.
+ */
+static
+void swap_packed_integers(void *data, uint64_t len, size_t size)
+{
+	uint64_t i;
+
+	switch (size) {
+	case 2:
+	{
+		uint16_t *v = data;
+
+		for (i = 0; i < len; i++)
+			v[i] = GUINT16_SWAP_LE_BE(v[i]);
+		break;
+	}
+	case 4:
+	{
+		uint32_t *v = data;
+
+		for (i = 0; i < len; i++)
+			v[i] = GUINT32_SWAP_LE_BE(v[i]);
+		break;
+	}
+	case 8:
+	{
+		uint64_t *v = data;
+
+		for (i = 0; i < len; i++)
+			v[i] = GUINT64_SWAP_LE_BE(v[i]);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+int ctf_packed_integers_read(struct ctf_stream_pos *pos,
+		const struct declaration_integer *integer_declaration,
+		uint64_t len, GByteArray *packed)
+{
+	size_t size = integer_declaration->len / CHAR_BIT;
+
+	if (!ctf_align_pos(pos, integer_declaration->p.alignment))
+		return -EFAULT;
+	/* Guard the bit length computation against corrupt lengths. */
+	if (len > UINT64_MAX / integer_declaration->len)
+		return -EFAULT;
+	if (!ctf_pos_access_ok(pos, len * integer_declaration->len))
+		return -EFAULT;
+	g_byte_array_set_size(packed, len * size);
+	memcpy(packed->data, ctf_get_pos_addr(pos), len * size);
+	if (integer_declaration->byte_order != BYTE_ORDER)
+		swap_packed_integers(packed->data, len, size);
+	if (!ctf_move_pos(pos, len * integer_declaration->len))
+		return -EFAULT;
+	return 0;
+}
@@ -37,6 +37,14 @@ int ctf_sequence_read(struct bt_stream_pos *ppos, struct bt_definition *definiti
 	struct bt_declaration *elem = sequence_declaration->elem;
 	struct ctf_stream_pos *pos = ctf_pos(ppos);
 
+	if (sequence_definition->packed) {
+		sequence_definition->elems_stale = 1;
+		return ctf_packed_integers_read(pos,
+			container_of(elem, struct declaration_integer, p),
+			bt_sequence_len(sequence_definition),
+			sequence_definition->packed);
+	}
+
 	if (elem->id == CTF_TYPE_INTEGER) {
 		struct declaration_integer *integer_declaration =
 			container_of(elem, struct declaration_integer, p);
@@ -58,13 +58,27 @@ int ctf_string_read(struct bt_stream_pos *ppos, struct bt_definition *definition
 	if (srcaddr[len - 1] != '\0')
 		return -EFAULT;
 
-	if (string_definition->alloc_len < len) {
-		string_definition->value =
-			g_realloc(string_definition->value, len);
-		string_definition->alloc_len = len;
-	}
 	printf_debug("CTF string read %s\n", srcaddr);
-	memcpy(string_definition->value, srcaddr, len);
+	if (pos->zero_copy_strings) {
+		/* Valid until the stream position leaves the mapping. */
+		if (!string_definition->borrowed) {
+			g_free(string_definition->value);
+			string_definition->alloc_len = 0;
+			string_definition->borrowed = 1;
+		}
+		string_definition->value = srcaddr;
+	} else {
+		if (string_definition->borrowed) {
+			string_definition->value = NULL;
+			string_definition->borrowed = 0;
+		}
+		if (string_definition->alloc_len < len) {
+			string_definition->value =
+				g_realloc(string_definition->value, len);
+			string_definition->alloc_len = len;
+		}
+		memcpy(string_definition->value, srcaddr, len);
+	}
 	string_definition->len = len;
 	if (!ctf_move_pos(pos, len * CHAR_BIT))
 		return -EFAULT;
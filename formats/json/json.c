@@ -0,0 +1,441 @@
+/*
+ * BabelTrace - JSON Format
+ *
+ * JSON Lines output: one JSON object per event.
+ *
+ * Copyright 2015 EfficiOS Inc. and Linux Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/format.h>
+#include <babeltrace/format-internal.h>
+#include <babeltrace/ctf/types.h>
+#include <babeltrace/ctf/metadata.h>
+#include <babeltrace/babeltrace-internal.h>
+#include <babeltrace/ctf-text/types.h>
+#include <babeltrace/ctf-text/buffer.h>
+#include <babeltrace/json/string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <math.h>
+#include <unistd.h>
+
+static
+struct bt_trace_descriptor *json_open_trace(const char *path, int flags,
+		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
+			int whence), FILE *metadata_fp);
+static
+int json_close_trace(struct bt_trace_descriptor *descriptor);
+
+static
+struct bt_format json_format = {
+	.open_trace = json_open_trace,
+	.close_trace = json_close_trace,
+};
+
+/* Open output positions, written out before warnings */
+static GList *console_positions;
+
+static
+int json_write_definition(struct ctf_text_buffer *out,
+		struct bt_definition *definition);
+
+static
+void put_key(struct ctf_text_buffer *out, GQuark name)
+{
+	json_put_string(out, rem_(g_quark_to_string(name)));
+	ctf_text_putc(out, ':');
+}
+
+static
+void put_integer(struct ctf_text_buffer *out,
+		const struct definition_integer *integer_definition)
+{
+	if (!integer_definition->declaration->signedness)
+		ctf_text_put_u64(out, integer_definition->value._unsigned);
+	else
+		ctf_text_put_s64(out, integer_definition->value._signed);
+}
+
+static
+int write_struct(struct ctf_text_buffer *out,
+		struct definition_struct *struct_definition)
+{
+	unsigned long i;
+	int ret;
+
+	ctf_text_putc(out, '{');
+	for (i = 0; i < struct_definition->fields->len; i++) {
+		struct bt_definition *field =
+			g_ptr_array_index(struct_definition->fields, i);
+
+		if (i != 0)
+			ctf_text_putc(out, ',');
+		put_key(out, field->name);
+		ret = json_write_definition(out, field);
+		if (ret)
+			return ret;
+	}
+	ctf_text_putc(out, '}');
+	return 0;
+}
+
+/*
+ * Enumerations are written as their label when the value maps to
+ * exactly one, as their integer value otherwise.
+ */
+static
+int write_enum(struct ctf_text_buffer *out,
+		struct definition_enum *enum_definition)
+{
+	GArray *qs = enum_definition->value;
+
+	if (qs && qs->len == 1)
+		json_put_string(out,
+			g_quark_to_string(g_array_index(qs, GQuark, 0)));
+	else
+		put_integer(out, enum_definition->integer);
+	return 0;
+}
+
+/*
+ * Arrays and sequences of characters are written as strings, up to
+ * their first null character, other ones as JSON arrays.
+ */
+static
+int write_elements(struct ctf_text_buffer *out, struct bt_declaration *elem,
+		GString *string, uint64_t len,
+		struct bt_definition *(*get_index)(void *container, uint64_t i),
+		void *container)
+{
+	uint64_t i;
+	int ret;
+
+	if (elem->id == CTF_TYPE_INTEGER) {
+		struct declaration_integer *integer_declaration =
+			container_of(elem, struct declaration_integer, p);
+
+		if (integer_declaration->encoding == CTF_STRING_UTF8
+		      || integer_declaration->encoding == CTF_STRING_ASCII) {
+
+			/* Bytes are read into the string directly. */
+			if (!(integer_declaration->len == CHAR_BIT
+			    && integer_declaration->p.alignment == CHAR_BIT)) {
+				g_string_assign(string, "");
+				for (i = 0; i < len; i++) {
+					struct definition_integer *c =
+						container_of(get_index(container, i),
+							struct definition_integer, p);
+
+					g_string_append_c(string,
+						(int) c->value._unsigned);
+				}
+			}
+			json_put_string(out, string->str);
+			return 0;
+		}
+	}
+
+	ctf_text_putc(out, '[');
+	for (i = 0; i < len; i++) {
+		if (i != 0)
+			ctf_text_putc(out, ',');
+		ret = json_write_definition(out, get_index(container, i));
+		if (ret)
+			return ret;
+	}
+	ctf_text_putc(out, ']');
+	return 0;
+}
+
+static
+struct bt_definition *array_index(void *container, uint64_t i)
+{
+	return bt_array_index(container, i);
+}
+
+static
+struct bt_definition *sequence_index(void *container, uint64_t i)
+{
+	return bt_sequence_index(container, i);
+}
+
+static
+int json_write_definition(struct ctf_text_buffer *out,
+		struct bt_definition *definition)
+{
+	switch (definition->declaration->id) {
+	case CTF_TYPE_INTEGER:
+		put_integer(out, container_of(definition,
+			struct definition_integer, p));
+		return 0;
+	case CTF_TYPE_FLOAT:
+	{
+		double v = container_of(definition,
+			struct definition_float, p)->value;
+
+		/* JSON has no representation for NaN and infinities. */
+		if (isfinite(v))
+			ctf_text_put_g(out, v);
+		else
+			ctf_text_puts(out, "null");
+		return 0;
+	}
+	case CTF_TYPE_ENUM:
+		return write_enum(out, container_of(definition,
+			struct definition_enum, p));
+	case CTF_TYPE_STRING:
+		json_put_string(out, container_of(definition,
+			struct definition_string, p)->value);
+		return 0;
+	case CTF_TYPE_STRUCT:
+		return write_struct(out, container_of(definition,
+			struct definition_struct, p));
+	case CTF_TYPE_VARIANT:
+	{
+		struct bt_definition *field;
+
+		field = bt_variant_get_current_field(container_of(definition,
+			struct definition_variant, p));
+		if (!field) {
+			ctf_text_puts(out, "null");
+			return 0;
+		}
+		return json_write_definition(out, field);
+	}
+	case CTF_TYPE_ARRAY:
+	{
+		struct definition_array *array_definition =
+			container_of(definition, struct definition_array, p);
+
+		return write_elements(out, array_definition->declaration->elem,
+			array_definition->string,
+			array_definition->declaration->len,
+			array_index, array_definition);
+	}
+	case CTF_TYPE_SEQUENCE:
+	{
+		struct definition_sequence *sequence_definition =
+			container_of(definition, struct definition_sequence, p);
+
+		return write_elements(out,
+			sequence_definition->declaration->elem,
+			sequence_definition->string,
+			bt_sequence_len(sequence_definition),
+			sequence_index, sequence_definition);
+	}
+	default:
+		return -EINVAL;
+	}
+}
+
+static
+int write_scope(struct ctf_text_buffer *out, const char *name,
+		struct definition_struct *scope)
+{
+	ctf_text_putc(out, ',');
+	json_put_string(out, name);
+	ctf_text_putc(out, ':');
+	return write_struct(out, scope);
+}
+
+static
+int json_flush(struct ctf_text_stream_pos *pos)
+{
+	return ctf_text_buffer_flush(&pos->out, pos->fp);
+}
+
+static
+void json_console_flush(void)
+{
+	GList *node;
+
+	for (node = console_positions; node; node = node->next)
+		(void) json_flush(node->data);
+}
+
+static
+int json_write_event(struct bt_stream_pos *ppos,
+		struct ctf_stream_definition *stream)
+{
+	struct ctf_text_stream_pos *pos =
+		container_of(ppos, struct ctf_text_stream_pos, parent);
+	struct ctf_stream_declaration *stream_class = stream->stream_class;
+	struct ctf_event_declaration *event_class;
+	struct ctf_event_definition *event;
+	struct ctf_text_buffer *out = &pos->out;
+	size_t start_len;
+	uint64_t id;
+	int ret;
+
+	id = stream->event_id;
+
+	if (id >= stream_class->events_by_id->len) {
+		fprintf(stderr, "[error] Event id %" PRIu64 " is outside range.\n", id);
+		return -EINVAL;
+	}
+	event = g_ptr_array_index(stream->events_by_id, id);
+	if (!event) {
+		fprintf(stderr, "[error] Event id %" PRIu64 " is unknown.\n", id);
+		return -EINVAL;
+	}
+	event_class = g_ptr_array_index(stream_class->events_by_id, id);
+	if (!event_class) {
+		fprintf(stderr, "[error] Event class id %" PRIu64 " is unknown.\n", id);
+		return -EINVAL;
+	}
+	ret = ctf_decode_pending_event(stream);
+	if (ret)
+		return ret;
+
+	/* Drop the partial object of an event which cannot be written. */
+	start_len = out->len;
+	ctf_text_puts(out, "{\"name\":");
+	json_put_string(out, g_quark_to_string(event_class->name));
+	if (stream->has_timestamp) {
+		ctf_text_puts(out, ",\"timestamp\":");
+		ctf_text_put_u64(out, stream->real_timestamp);
+		ctf_text_puts(out, ",\"cycles\":");
+		ctf_text_put_u64(out, stream->cycles_timestamp);
+	}
+	ctf_text_puts(out, ",\"stream_id\":");
+	ctf_text_put_u64(out, stream_class->stream_id);
+
+	if (stream->stream_packet_context) {
+		ret = write_scope(out, "stream.packet.context",
+			stream->stream_packet_context);
+		if (ret)
+			goto error;
+	}
+	/* Only show the event header in verbose mode */
+	if (babeltrace_verbose && stream->stream_event_header) {
+		ret = write_scope(out, "stream.event.header",
+			stream->stream_event_header);
+		if (ret)
+			goto error;
+	}
+	if (stream->stream_event_context) {
+		ret = write_scope(out, "stream.event.context",
+			stream->stream_event_context);
+		if (ret)
+			goto error;
+	}
+	if (event->event_context) {
+		ret = write_scope(out, "event.context", event->event_context);
+		if (ret)
+			goto error;
+	}
+	if (event->event_fields) {
+		ret = write_scope(out, "event.fields", event->event_fields);
+		if (ret)
+			goto error;
+	}
+	ctf_text_puts(out, "}\n");
+
+	if (out->len >= CTF_TEXT_BUFFER_FLUSH_LEN || out->line_buffered)
+		return json_flush(pos);
+	return 0;
+
+error:
+	out->len = start_len;
+	fprintf(stderr, "[error] Unexpected field type in event \"%s\".\n",
+		g_quark_to_string(event_class->name));
+	return ret;
+}
+
+static
+struct bt_trace_descriptor *json_open_trace(const char *path, int flags,
+		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
+			int whence), FILE *metadata_fp)
+{
+	struct ctf_text_stream_pos *pos;
+	FILE *fp;
+
+	pos = g_new0(struct ctf_text_stream_pos, 1);
+
+	switch (flags & O_ACCMODE) {
+	case O_RDWR:
+		if (!path)
+			fp = stdout;
+		else
+			fp = fopen(path, "w");
+		if (!fp)
+			goto error;
+		pos->fp = fp;
+		pos->out.line_buffered = isatty(fileno(fp));
+		pos->parent.event_cb = json_write_event;
+		pos->parent.trace = &pos->trace_descriptor;
+		babeltrace_ctf_console_output++;
+		console_positions = g_list_prepend(console_positions, pos);
+		babeltrace_ctf_console_flush = json_console_flush;
+		break;
+	case O_RDONLY:
+	default:
+		fprintf(stderr, "[error] Incorrect open flags.\n");
+		goto error;
+	}
+
+	return &pos->trace_descriptor;
+error:
+	g_free(pos);
+	return NULL;
+}
+
+static
+int json_close_trace(struct bt_trace_descriptor *td)
+{
+	int ret;
+	struct ctf_text_stream_pos *pos =
+		container_of(td, struct ctf_text_stream_pos, trace_descriptor);
+
+	babeltrace_ctf_console_output--;
+	console_positions = g_list_remove(console_positions, pos);
+	if (!console_positions
+	    && babeltrace_ctf_console_flush == json_console_flush)
+		babeltrace_ctf_console_flush = NULL;
+	ret = json_flush(pos);
+	ctf_text_buffer_free(&pos->out);
+	if (pos->fp != stdout) {
+		if (fclose(pos->fp)) {
+			perror("Error on fclose");
+			ret = -1;
+		}
+	}
+	g_free(pos);
+	return ret ? -1 : 0;
+}
+
+static
+void __attribute__((constructor)) json_init(void)
+{
+	int ret;
+
+	json_format.name = g_quark_from_static_string("json");
+	ret = bt_register_format(&json_format);
+	assert(!ret);
+}
+
+static
+void __attribute__((destructor)) json_exit(void)
+{
+	bt_unregister_format(&json_format);
+}
@@ -0,0 +1,121 @@
+/*
+ * BabelTrace - JSON Format
+ *
+ * String escaping.
+ *
+ * Copyright 2015 EfficiOS Inc. and Linux Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/json/string.h>
+#include <stdint.h>
+#include <string.h>
+
+#define ONES	0x0101010101010101ULL
+#define HIGHS	0x8080808080808080ULL
+
+/*
+ * Non-zero if any byte of the word is a quote, a backslash or a control
+ * character. Only tells whether the word needs escaping: which byte
+ * does is found byte by byte.
+ */
+static inline
+uint64_t word_needs_escape(uint64_t w)
+{
+	uint64_t quote = w ^ (ONES * '"');
+	uint64_t backslash = w ^ (ONES * '\\');
+
+	return ((w - ONES * 0x20) & ~w & HIGHS)		/* byte < 0x20 */
+		| ((quote - ONES) & ~quote & HIGHS)
+		| ((backslash - ONES) & ~backslash & HIGHS);
+}
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static inline
+int byte_needs_escape(unsigned char c)
+{
+	return c < 0x20 || c == '"' || c == '\\';
+}
+
+static
+void put_escape(struct ctf_text_buffer *buf, unsigned char c)
+{
+	char *p;
+
+	switch (c) {
+	case '"':
+		ctf_text_puts(buf, "\\\"");
+		break;
+	case '\\':
+		ctf_text_puts(buf, "\\\\");
+		break;
+	case '\n':
+		ctf_text_puts(buf, "\\n");
+		break;
+	case '\t':
+		ctf_text_puts(buf, "\\t");
+		break;
+	case '\r':
+		ctf_text_puts(buf, "\\r");
+		break;
+	case '\b':
+		ctf_text_puts(buf, "\\b");
+		break;
+	case '\f':
+		ctf_text_puts(buf, "\\f");
+		break;
+	default:
+		p = ctf_text_reserve(buf, 6);
+		memcpy(p, "\\u00", 4);
+		p[4] = hex_digits[c >> 4];
+		p[5] = hex_digits[c & 0xf];
+		buf->len += 6;
+		break;
+	}
+}
+
+void json_put_string_len(struct ctf_text_buffer *buf, const char *str,
+		size_t len)
+{
+	const char *p = str, *end = str + len;
+
+	ctf_text_putc(buf, '"');
+	while (p < end) {
+		const char *run = p;
+
+		/* Skip the bytes copied as is, a word at a time. */
+		while (end - p >= sizeof(uint64_t)) {
+			uint64_t w;
+
+			memcpy(&w, p, sizeof(w));
+			if (word_needs_escape(w))
+				break;
+			p += sizeof(w);
+		}
+		while (p < end && !byte_needs_escape(*p))
+			p++;
+		ctf_text_write(buf, run, p - run);
+		if (p == end)
+			break;
+		put_escape(buf, *p++);
+	}
+	ctf_text_putc(buf, '"');
+}
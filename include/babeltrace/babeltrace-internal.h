@@ -191,10 +191,17 @@ extern int opt_all_field_names,
 	opt_clock_seconds,
 	opt_clock_date,
 	opt_clock_gmt,
-	opt_clock_force_correlate;
+	opt_clock_force_correlate,
+	opt_tree_decoder,
+	opt_index_cache,
+	opt_time_index;
 
 extern uint64_t opt_clock_offset;
 extern uint64_t opt_clock_offset_ns;
+extern uint64_t opt_mmap_window;
 extern int babeltrace_ctf_console_output;
+extern void (*babeltrace_ctf_console_flush)(void);
+struct ctf_event_definition;
+extern void (*babeltrace_ctf_event_definition_free)(struct ctf_event_definition *event);
 
 #endif
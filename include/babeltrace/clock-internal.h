@@ -30,16 +30,85 @@
  * SOFTWARE.
  */
 
+#include <babeltrace/ctf-ir/metadata.h>
+#include <stdint.h>
+
+/*
+ * Precompute the cycles to ns conversion of a clock, once its frequency
+ * is known.
+ *
+ * Cycles are converted to floor(cycles * 1e9 / freq) as
+ * (cycles * mult) >> shift, with a 128-bit intermediate. mult is
+ * 1e9 * 2^shift / freq rounded up, with the largest shift keeping it
+ * within 64 bits. The rounding error stays below the distance to the
+ * next integer result as long as cycles <= max_cycles; larger values,
+ * only reached with frequencies sharing few factors with 1e9, go
+ * through a 128-bit division.
+ */
+static inline
+void clock_init_conversion(struct ctf_clock *clock)
+{
+#ifdef __SIZEOF_INT128__
+	const unsigned __int128 ns_per_s = 1000000000ULL;
+	unsigned __int128 mult, err, max_cycles;
+	uint64_t gcd = 1000000000ULL, rem = clock->freq, tmp;
+	unsigned int shift = 0;
+
+	if (!clock->freq) {
+		clock->mult = 0;
+		clock->shift = 0;
+		clock->max_cycles = UINT64_MAX;
+		return;
+	}
+	while (shift < 96) {
+		mult = ((ns_per_s << (shift + 1)) + clock->freq - 1)
+				/ clock->freq;
+		if (mult >> 64)
+			break;
+		shift++;
+	}
+	mult = ((ns_per_s << shift) + clock->freq - 1) / clock->freq;
+	err = mult * clock->freq - (ns_per_s << shift);
+
+	/*
+	 * Fractional parts of cycles * 1e9 / freq are multiples of
+	 * gcd(1e9, freq) / freq: the result is exact while
+	 * cycles * err < gcd * 2^shift.
+	 */
+	while (rem) {
+		tmp = gcd % rem;
+		gcd = rem;
+		rem = tmp;
+	}
+	if (!err) {
+		max_cycles = UINT64_MAX;
+	} else {
+		max_cycles = (((unsigned __int128) gcd << shift) - 1) / err;
+		if (max_cycles >> 64)
+			max_cycles = UINT64_MAX;
+	}
+	clock->mult = mult;
+	clock->shift = shift;
+	clock->max_cycles = max_cycles;
+#endif /* __SIZEOF_INT128__ */
+}
+
 static inline
 uint64_t clock_cycles_to_ns(struct ctf_clock *clock, uint64_t cycles)
 {
 	if (clock->freq == 1000000000ULL) {
 		/* 1GHZ freq, no need to scale cycles value */
 		return cycles;
-	} else {
-		return (double) cycles * 1000000000.0
-				/ (double) clock->freq;
 	}
+#ifdef __SIZEOF_INT128__
+	if (cycles <= clock->max_cycles)
+		return ((unsigned __int128) cycles * clock->mult)
+				>> clock->shift;
+	return (unsigned __int128) cycles * 1000000000ULL / clock->freq;
+#else /* __SIZEOF_INT128__ */
+	return (double) cycles * 1000000000.0
+			/ (double) clock->freq;
+#endif /* __SIZEOF_INT128__ */
 }
 
 /*
@@ -43,6 +43,7 @@ struct ctf_event_declaration;
 struct ctf_clock;
 struct ctf_callsite;
 struct ctf_scanner;
+struct ctf_decode_plan;
 
 struct ctf_stream_packet_limits {
 	uint64_t begin;
@@ -54,6 +55,32 @@ struct ctf_stream_packet_timestamp {
 	struct ctf_stream_packet_limits real;
 };
 
+/* Fields of one choice of the event header "v" variant */
+struct ctf_event_header_choice {
+	struct bt_definition *field;
+	struct definition_integer *id;
+	struct definition_integer *timestamp;
+};
+
+/*
+ * LTTng compact/extended event header layout:
+ *   enum { compact = 0 ... N - 1, extended = N } id;
+ *   variant <id> {
+ *     struct { integer timestamp; } compact;
+ *     struct { integer id; integer timestamp; } extended;
+ *   } v;
+ */
+struct ctf_compact_event_header {
+	struct definition_enum *id;
+	uint64_t extended_value;	/* "id" value selecting the extended header */
+	struct ctf_event_header_choice *compact;
+	struct ctf_event_header_choice *extended;
+	GArray *compact_quarks;		/* "id" quark set of compact headers */
+	GArray *extended_quarks;	/* "id" quark set of extended headers */
+	int compact_interval;		/* "id" enum interval of compact headers */
+	int extended_interval;		/* "id" enum interval of extended headers */
+};
+
 struct ctf_stream_definition {
 	struct ctf_stream_declaration *stream_class;
 	uint64_t real_timestamp;		/* Current timestamp, in ns */
@@ -66,7 +93,31 @@ struct ctf_stream_definition {
 	struct definition_struct *stream_packet_context;
 	struct definition_struct *stream_event_header;
 	struct definition_struct *stream_event_context;
-	GPtrArray *events_by_id;		/* Array of struct ctf_event_definition pointers indexed by id */
+	struct ctf_decode_plan *event_header_plan;	/* NULL when decoding the tree */
+	/* Event header fields, resolved when the header definition is created */
+	struct definition_integer *header_id;
+	struct definition_integer *header_timestamp;
+	struct definition_variant *header_v;
+	GArray *header_v_choices;		/* Array of struct ctf_event_header_choice */
+	struct ctf_compact_event_header *compact_header;	/* NULL if not LTTng layout */
+	/*
+	 * Lazy decoding: contexts and payload of the last event read
+	 * are only decoded when accessed, by ctf_decode_pending_event().
+	 */
+	int lazy_decode;
+	struct ctf_event_definition *pending_event;	/* NULL if decoded */
+	int64_t pending_offset;			/* Position of its contexts, in bits */
+	/* Workers decoding pending events ahead, NULL if disabled */
+	struct ctf_decode_ahead *decode_ahead;
+	int decode_state;			/* enum ctf_decode_state */
+	int decode_ret;				/* Result of the worker decoding */
+	int event_selection;			/* Only read events not filtered out */
+	GArray *selected_events;		/* GQuark names of the selected events */
+	/*
+	 * Array of struct ctf_event_definition pointers indexed by id,
+	 * created on the first occurrence of their id in the stream.
+	 */
+	GPtrArray *events_by_id;
 	struct definition_scope *parent_def_scope;	/* for initialization */
 	int stream_definitions_created;
 
@@ -83,6 +134,16 @@ struct ctf_event_definition {
 	struct ctf_stream_definition *stream;
 	struct definition_struct *event_context;
 	struct definition_struct *event_fields;
+	/*
+	 * Stream event context, event context and payload, in this
+	 * order. NULL when decoding the tree.
+	 */
+	struct ctf_decode_plan *plan;
+	/*
+	 * Not part of the iterator event selection: the event is moved
+	 * past without decoding its contexts and payload.
+	 */
+	int filtered;
 };
 
 #define CTF_CLOCK_SET_FIELD(ctf_clock, field)				\
@@ -114,6 +175,10 @@ struct ctf_clock {
 	/* Fine clock offset from Epoch, in (1/freq) units. */
 	uint64_t offset;
 	int absolute;
+	/* Cycles to ns conversion, see clock_init_conversion() */
+	uint64_t mult;
+	unsigned int shift;
+	uint64_t max_cycles;
 
 	enum {					/* Fields populated mask */
 		CTF_CLOCK_name		=	(1U << 0),
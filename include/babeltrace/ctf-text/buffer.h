@@ -0,0 +1,248 @@
+#ifndef _BABELTRACE_CTF_TEXT_BUFFER_H
+#define _BABELTRACE_CTF_TEXT_BUFFER_H
+
+/*
+ * BabelTrace
+ *
+ * CTF Text Format - Output buffer
+ *
+ * Copyright 2015 EfficiOS Inc. and Linux Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/babeltrace-internal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * The text output is formatted in memory and written to the output
+ * file descriptor in large chunks, rather than going through stdio
+ * token by token. Numbers are converted by the routines below, which
+ * produce the same text as the printf conversions named after them.
+ */
+
+/* Pending output written out at the end of an event */
+#define CTF_TEXT_BUFFER_FLUSH_LEN	(64 * 1024)
+
+/* Room needed by the number conversions: 64 binary digits, or %g */
+#define CTF_TEXT_NUMBER_LEN		64
+
+struct ctf_text_buffer {
+	char *data;
+	size_t len;		/* Pending output, in bytes */
+	size_t alloc_len;
+	int line_buffered;	/* Write out each line (terminal output) */
+};
+
+BT_HIDDEN
+void ctf_text_buffer_grow(struct ctf_text_buffer *buf, size_t len);
+BT_HIDDEN
+void ctf_text_buffer_free(struct ctf_text_buffer *buf);
+/*
+ * Write the pending output to fp, after what was written to it through
+ * stdio. Returns 0 on success, negative errno on error.
+ */
+BT_HIDDEN
+int ctf_text_buffer_flush(struct ctf_text_buffer *buf, FILE *fp);
+/*
+ * Append formatted text. Returns 0 on success, negative errno if the
+ * text cannot be formatted, in which case nothing is appended.
+ */
+BT_HIDDEN
+int ctf_text_printf(struct ctf_text_buffer *buf, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+/* Return room for len more bytes at the end of the buffer. */
+static inline
+char *ctf_text_reserve(struct ctf_text_buffer *buf, size_t len)
+{
+	if (unlikely(buf->alloc_len - buf->len < len))
+		ctf_text_buffer_grow(buf, len);
+	return buf->data + buf->len;
+}
+
+static inline
+void ctf_text_write(struct ctf_text_buffer *buf, const char *str, size_t len)
+{
+	memcpy(ctf_text_reserve(buf, len), str, len);
+	buf->len += len;
+}
+
+static inline
+void ctf_text_puts(struct ctf_text_buffer *buf, const char *str)
+{
+	ctf_text_write(buf, str, strlen(str));
+}
+
+static inline
+void ctf_text_putc(struct ctf_text_buffer *buf, char c)
+{
+	*ctf_text_reserve(buf, 1) = c;
+	buf->len++;
+}
+
+/*
+ * Number conversions: write the text of v at p, without terminating
+ * null byte, and return its length.
+ */
+
+/* "%*" PRIu64, with width up to 20, left-padded with pad */
+static inline
+size_t ctf_text_format_u64_pad(char *p, uint64_t v, unsigned int width,
+		char pad)
+{
+	char digits[20];
+	size_t len = 0, i;
+
+	do {
+		digits[len++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	for (i = 0; len + i < width; i++)
+		p[i] = pad;
+	while (len)
+		p[i++] = digits[--len];
+	return i;
+}
+
+/* "%0*" PRIu64, with width up to 20 */
+static inline
+size_t ctf_text_format_u64_width(char *p, uint64_t v, unsigned int width)
+{
+	return ctf_text_format_u64_pad(p, v, width, '0');
+}
+
+/* "%" PRIu64 */
+static inline
+size_t ctf_text_format_u64(char *p, uint64_t v)
+{
+	return ctf_text_format_u64_width(p, v, 0);
+}
+
+/* "%" PRId64 */
+static inline
+size_t ctf_text_format_s64(char *p, int64_t v)
+{
+	if (v >= 0)
+		return ctf_text_format_u64(p, v);
+	*p = '-';
+	return 1 + ctf_text_format_u64(p + 1, -(uint64_t) v);
+}
+
+/* "%" PRIo64 */
+static inline
+size_t ctf_text_format_o64(char *p, uint64_t v)
+{
+	char digits[22];
+	size_t len = 0, i = 0;
+
+	do {
+		digits[len++] = '0' + (v & 7);
+		v >>= 3;
+	} while (v);
+	while (len)
+		p[i++] = digits[--len];
+	return i;
+}
+
+/* "%" PRIX64 */
+static inline
+size_t ctf_text_format_X64(char *p, uint64_t v)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	char digits[16];
+	size_t len = 0, i = 0;
+
+	do {
+		digits[len++] = hex[v & 0xF];
+		v >>= 4;
+	} while (v);
+	while (len)
+		p[i++] = digits[--len];
+	return i;
+}
+
+/*
+ * "%g". Integral values below 1e6 in magnitude, which %g prints without
+ * exponent nor fraction, are converted directly; others go through
+ * snprintf().
+ */
+static inline
+size_t ctf_text_format_g(char *p, double v)
+{
+	if (v > -1e6 && v < 1e6 && v == (double) (int64_t) v
+			&& (v != 0 || !signbit(v)))
+		return ctf_text_format_s64(p, (int64_t) v);
+	return snprintf(p, CTF_TEXT_NUMBER_LEN, "%g", v);
+}
+
+static inline
+void ctf_text_put_u64(struct ctf_text_buffer *buf, uint64_t v)
+{
+	char *p = ctf_text_reserve(buf, CTF_TEXT_NUMBER_LEN);
+
+	buf->len += ctf_text_format_u64(p, v);
+}
+
+static inline
+void ctf_text_put_s64(struct ctf_text_buffer *buf, int64_t v)
+{
+	char *p = ctf_text_reserve(buf, CTF_TEXT_NUMBER_LEN);
+
+	buf->len += ctf_text_format_s64(p, v);
+}
+
+static inline
+void ctf_text_put_u64_width(struct ctf_text_buffer *buf, uint64_t v,
+		unsigned int width)
+{
+	char *p = ctf_text_reserve(buf, CTF_TEXT_NUMBER_LEN);
+
+	buf->len += ctf_text_format_u64_width(p, v, width);
+}
+
+static inline
+void ctf_text_put_o64(struct ctf_text_buffer *buf, uint64_t v)
+{
+	char *p = ctf_text_reserve(buf, CTF_TEXT_NUMBER_LEN);
+
+	buf->len += ctf_text_format_o64(p, v);
+}
+
+static inline
+void ctf_text_put_X64(struct ctf_text_buffer *buf, uint64_t v)
+{
+	char *p = ctf_text_reserve(buf, CTF_TEXT_NUMBER_LEN);
+
+	buf->len += ctf_text_format_X64(p, v);
+}
+
+static inline
+void ctf_text_put_g(struct ctf_text_buffer *buf, double v)
+{
+	char *p = ctf_text_reserve(buf, CTF_TEXT_NUMBER_LEN);
+
+	buf->len += ctf_text_format_g(p, v);
+}
+
+#endif /* _BABELTRACE_CTF_TEXT_BUFFER_H */
@@ -0,0 +1,113 @@
+#ifndef _BABELTRACE_CTF_TEXT_TEMPLATE_H
+#define _BABELTRACE_CTF_TEXT_TEMPLATE_H
+
+/*
+ * BabelTrace
+ *
+ * CTF Text Format - Event templates
+ *
+ * Copyright 2015 EfficiOS Inc. and Linux Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/babeltrace-internal.h>
+#include <babeltrace/types.h>
+#include <glib.h>
+
+/*
+ * An event template is the text of an event, except its timestamp and
+ * delta, compiled for the output options: static text segments (header
+ * fields, field names and separators) interleaved with the slots of the
+ * values read for each event. Integers, floats and strings, within
+ * structures, are filled in directly; other fields, whose text depends
+ * on their value or length, are written by their regular write
+ * function.
+ */
+enum ctf_text_template_op_type {
+	CTF_TEXT_TEMPLATE_TEXT,		/* static text segment */
+	CTF_TEXT_TEMPLATE_INTEGER,	/* integer value */
+	CTF_TEXT_TEMPLATE_FLOAT,	/* floating point value */
+	CTF_TEXT_TEMPLATE_STRING,	/* string value, without quotes */
+	CTF_TEXT_TEMPLATE_CALL,		/* write a definition */
+};
+
+struct ctf_text_template_op {
+	enum ctf_text_template_op_type type;
+	size_t offset;			/* TEXT: segment offset in text */
+	size_t len;			/* TEXT: segment length */
+	struct bt_definition *definition;	/* Value slots, CALL */
+	/* CALL: writer state in the position */
+	int field_nr;
+	int depth;
+	int print_names;
+};
+
+struct ctf_text_template {
+	GString *text;			/* Static text of the segments */
+	GArray *ops;			/* Array of struct ctf_text_template_op */
+	unsigned int options;		/* Output options compiled for */
+
+	/* Compilation state, as the writers keep it in the position */
+	size_t text_start;		/* Start of the pending segment */
+	int field_nr;
+	int depth;
+	int print_names;
+};
+
+struct ctf_text_stream_pos;
+
+BT_HIDDEN
+struct ctf_text_template *ctf_text_template_create(unsigned int options);
+/* Takes a void pointer to be used as a GDestroyNotify. */
+BT_HIDDEN
+void ctf_text_template_destroy(void *tmpl);
+
+static inline
+void ctf_text_template_puts(struct ctf_text_template *tmpl, const char *str)
+{
+	g_string_append(tmpl->text, str);
+}
+
+BT_HIDDEN
+void ctf_text_template_printf(struct ctf_text_template *tmpl,
+		const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+/*
+ * Append the text of a definition, as printed by generic_rw() with the
+ * text format write functions.
+ */
+BT_HIDDEN
+void ctf_text_template_append(struct ctf_text_template *tmpl,
+		struct bt_definition *definition);
+
+/* Close the last text segment, once all the event is appended. */
+BT_HIDDEN
+void ctf_text_template_end(struct ctf_text_template *tmpl);
+
+/*
+ * Write an event through its template, with the values read last.
+ * Returns 0 on success, or the error of a write function.
+ */
+BT_HIDDEN
+int ctf_text_template_write(const struct ctf_text_template *tmpl,
+		struct ctf_text_stream_pos *pos);
+
+#endif /* _BABELTRACE_CTF_TEXT_TEMPLATE_H */
@@ -36,6 +36,8 @@
 #include <babeltrace/types.h>
 #include <babeltrace/format.h>
 #include <babeltrace/format-internal.h>
+#include <babeltrace/ctf-text/buffer.h>
+#include <babeltrace/ctf/types.h>
 
 /*
  * Inherit from both struct bt_stream_pos and struct bt_trace_descriptor.
@@ -44,13 +46,22 @@ struct ctf_text_stream_pos {
 	struct bt_stream_pos parent;
 	struct bt_trace_descriptor trace_descriptor;
 	FILE *fp;		/* File pointer. NULL if unset. */
+	struct ctf_text_buffer out;	/* Output not yet written to fp */
 	int depth;
 	int dummy;		/* disable output */
 	int print_names;	/* print field names */
 	int field_nr;
 	uint64_t last_real_timestamp;	/* to print delta */
 	uint64_t last_cycles_timestamp;	/* to print delta */
+	struct ctf_timestamp_cache timestamp_cache;
 	GString *string;	/* Current string */
+	/*
+	 * struct ctf_text_template of the events written, keyed by
+	 * struct ctf_event_definition. Entries are removed before their
+	 * event definition is freed, e.g. when a trace is removed from
+	 * its context.
+	 */
+	GHashTable *templates;
 };
 
 static inline
@@ -59,6 +70,12 @@ struct ctf_text_stream_pos *ctf_text_pos(struct bt_stream_pos *pos)
 	return container_of(pos, struct ctf_text_stream_pos, parent);
 }
 
+/*
+ * Write the output buffered by the text format to pos->fp. Returns 0
+ * on success, negative errno on error.
+ */
+int ctf_text_flush(struct ctf_text_stream_pos *pos);
+
 /*
  * Write only is supported for now.
  */
@@ -79,13 +96,21 @@ int ctf_text_array_write(struct bt_stream_pos *pos, struct bt_definition *defini
 BT_HIDDEN
 int ctf_text_sequence_write(struct bt_stream_pos *pos, struct bt_definition *definition);
 
+/*
+ * Print the value of an integer as ctf_text_integer_write() does.
+ * Returns -EINVAL if its base is not supported.
+ */
+BT_HIDDEN
+int ctf_text_put_integer(struct ctf_text_buffer *out,
+		const struct definition_integer *integer_definition);
+
 static inline
 void print_pos_tabs(struct ctf_text_stream_pos *pos)
 {
 	int i;
 
 	for (i = 0; i < pos->depth; i++)
-		fprintf(pos->fp, "\t");
+		ctf_text_putc(&pos->out, '\t');
 }
 
 /*
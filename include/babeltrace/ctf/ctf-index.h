@@ -57,4 +57,47 @@ struct ctf_packet_index {
 	uint64_t stream_id;
 } __attribute__((__packed__));
 
+#define CTF_CACHED_INDEX_MAGIC 0xC1F1DCC3
+#define CTF_CACHED_INDEX_MAJOR 1
+#define CTF_CACHED_INDEX_MINOR 0
+
+/*
+ * Packet index of the index cache, following a
+ * struct ctf_packet_index_file_hdr with the cached index magic. Holds
+ * the fields read from packet contexts which index files leave out.
+ * All integer fields are stored in big endian.
+ */
+struct ctf_cached_packet_index {
+	struct ctf_packet_index index;
+	uint64_t events_discarded_len;	/* events_discarded size, in bits */
+} __attribute__((__packed__));
+
+#define CTF_TIME_INDEX_MAGIC 0xC1F1DCC2
+#define CTF_TIME_INDEX_MAJOR 1
+#define CTF_TIME_INDEX_MINOR 0
+
+/*
+ * Header at the beginning of each time index file, which holds the seek
+ * points recorded within the packets of a stream file.
+ * All integer fields are stored in big endian.
+ */
+struct ctf_time_index_file_hdr {
+	uint32_t magic;
+	uint32_t index_major;
+	uint32_t index_minor;
+	/* struct ctf_time_index_len, in bytes */
+	uint32_t time_index_len;
+} __attribute__((__packed__));
+
+/*
+ * Seek point within a packet, in increasing packet then offset order.
+ * All integer fields are stored in big endian.
+ */
+struct ctf_time_index {
+	uint64_t packet;		/* packet number in the stream file */
+	uint64_t offset;		/* offset of the event in the packet, in bits */
+	uint64_t cycles_timestamp;	/* stream timestamp before the event */
+	uint64_t timestamp;		/* timestamp of the event, in cycles */
+} __attribute__((__packed__));
+
 #endif /* LTTNG_INDEX_H */
@@ -0,0 +1,110 @@
+#ifndef _BABELTRACE_CTF_DECODE_AHEAD_H
+#define _BABELTRACE_CTF_DECODE_AHEAD_H
+
+/*
+ * BabelTrace
+ *
+ * Common Trace Format - Decode-ahead worker threads
+ *
+ * Copyright 2015 EfficiOS Inc. and Linux Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/ctf-ir/metadata.h>
+#include <babeltrace/babeltrace-internal.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+/*
+ * Decode-ahead: when a stream reads the header of its next event, the
+ * decoding of the contexts and payload left pending by lazy decoding is
+ * queued to a pool of worker threads. The reading thread goes on merging
+ * the other streams, and only waits for a stream when handing out its
+ * event, by which time a worker has usually decoded it.
+ *
+ * Only events whose contexts and payload have a static layout are left
+ * pending (see ctf_read_event()). Decoding them reads into the stream's
+ * own definitions without allocating, so workers never touch state
+ * shared between streams other than reference counts and the float
+ * reader, which are thread-safe. A stream is not touched by the reading
+ * thread while its event is queued or being decoded.
+ */
+
+/* Jobs queued at once, power of 2 */
+#define CTF_DECODE_AHEAD_RING	1024
+
+enum ctf_decode_state {
+	CTF_DECODE_IDLE = 0,	/* No job queued */
+	CTF_DECODE_QUEUED,	/* Pending event queued */
+	CTF_DECODE_RUNNING,	/* Pending event being decoded by a worker */
+};
+
+struct ctf_decode_ahead {
+	pthread_t *threads;
+	unsigned int nr_threads;
+	sem_t jobs;			/* Counts the queued jobs */
+	int stop;
+	/*
+	 * Lock-free job ring: the reading thread is the only producer,
+	 * advancing tail; workers take jobs by advancing head with a
+	 * compare-and-swap. A stream whose job is taken back by the
+	 * reading thread leaves a stale entry, skipped by the worker
+	 * taking it.
+	 */
+	struct ctf_stream_definition *ring[CTF_DECODE_AHEAD_RING];
+	unsigned long head;
+	unsigned long tail;
+};
+
+BT_HIDDEN
+struct ctf_decode_ahead *ctf_decode_ahead_create(unsigned int nr_threads);
+
+/*
+ * Stop and join the worker threads. Streams must have been waited for
+ * or cancelled beforehand.
+ */
+BT_HIDDEN
+void ctf_decode_ahead_destroy(struct ctf_decode_ahead *decode_ahead);
+
+/*
+ * Queue the decoding of the pending event of a stream. Returns -EAGAIN
+ * if the ring is full, in which case the event stays pending and is
+ * decoded by the reading thread when accessed.
+ */
+BT_HIDDEN
+int ctf_decode_ahead_submit(struct ctf_decode_ahead *decode_ahead,
+		struct ctf_stream_definition *stream);
+
+/*
+ * Wait for the queued decoding of a stream's pending event. A job not
+ * yet taken by a worker is decoded by the calling thread. Returns the
+ * result of the decoding.
+ */
+BT_HIDDEN
+int ctf_decode_ahead_wait(struct ctf_stream_definition *stream);
+
+/*
+ * Same as ctf_decode_ahead_wait(), for a pending event that is being
+ * discarded: a job not yet taken by a worker is dropped.
+ */
+BT_HIDDEN
+void ctf_decode_ahead_cancel(struct ctf_stream_definition *stream);
+
+#endif /* _BABELTRACE_CTF_DECODE_AHEAD_H */
@@ -0,0 +1,121 @@
+#ifndef _BABELTRACE_CTF_DECODE_PLAN_H
+#define _BABELTRACE_CTF_DECODE_PLAN_H
+
+/*
+ * BabelTrace
+ *
+ * Common Trace Format - Compiled decode plans
+ *
+ * Copyright 2015 EfficiOS Inc. and Linux Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/ctf/types.h>
+#include <babeltrace/babeltrace-internal.h>
+#include <stdint.h>
+#include <glib.h>
+
+/*
+ * A decode plan is the flattened form of a definition tree: structures
+ * are expanded in place, fixed-size arrays are unrolled, and runs of
+ * consecutive integers whose relative placement is known at compile
+ * time are grouped so that alignment and bounds checking happen once
+ * per run rather than once per field. Fields whose layout depends on
+ * the data (strings, variants, sequences, ...) are read through their
+ * regular read function.
+ */
+enum ctf_decode_op_type {
+	CTF_DECODE_OP_RUN,	/* align, check bounds and skip a run of integers */
+	CTF_DECODE_OP_INTEGER,	/* byte-aligned 8/16/32/64-bit integer within run */
+	CTF_DECODE_OP_BITFIELD,	/* any other integer within run */
+	CTF_DECODE_OP_ENUM,	/* map the enum integer just read to its quarks */
+	CTF_DECODE_OP_ALIGN,	/* align position */
+	CTF_DECODE_OP_CALL,	/* read a dynamically sized field */
+};
+
+struct ctf_decode_op {
+	enum ctf_decode_op_type type;
+	uint64_t alignment;		/* RUN, ALIGN, CALL: alignment, in bits */
+	uint64_t offset;		/* INTEGER, BITFIELD: offset from run start, in bits */
+	uint64_t len;			/* RUN, INTEGER, BITFIELD, CALL: length, in bits (0: dynamic) */
+	int signedness;			/* INTEGER, BITFIELD */
+	int rbo;			/* INTEGER: reverse byte order */
+	int byte_order;			/* BITFIELD */
+	rw_dispatch call;		/* CALL */
+	struct bt_definition *definition;
+};
+
+/* Step of a static layout: align, then move by len bits */
+struct ctf_decode_skip {
+	uint64_t alignment;
+	uint64_t len;
+};
+
+struct ctf_decode_plan {
+	GArray *ops;			/* Array of struct ctf_decode_op */
+	/*
+	 * Array of struct ctf_decode_skip allowing to move past the
+	 * fields without reading them. NULL if the layout depends on
+	 * the data.
+	 */
+	GArray *skips;
+
+	/* Compilation state */
+	int run;			/* Index of the open run op, -1 if none */
+	uint64_t pending_alignment;	/* Alignment not yet applied, in bits */
+	int dynamic;			/* Contains ops of dynamic length */
+};
+
+BT_HIDDEN
+struct ctf_decode_plan *ctf_decode_plan_create(void);
+BT_HIDDEN
+void ctf_decode_plan_destroy(struct ctf_decode_plan *plan);
+
+/*
+ * Append the read of a definition tree to a plan. Definitions appended
+ * one after the other are read in sequence, as with successive calls to
+ * generic_rw().
+ */
+BT_HIDDEN
+int ctf_decode_plan_append(struct ctf_decode_plan *plan,
+		struct bt_definition *definition);
+BT_HIDDEN
+int ctf_decode_plan_execute(const struct ctf_decode_plan *plan,
+		struct ctf_stream_pos *pos);
+
+/*
+ * Move the position past the fields of a plan with a static layout
+ * (plan->skips != NULL), without reading them.
+ */
+BT_HIDDEN
+int ctf_decode_plan_skip(const struct ctf_decode_plan *plan,
+		struct ctf_stream_pos *pos);
+
+/*
+ * Move the position past the fields of a plan with a dynamic layout,
+ * reading only what is needed to find their size: integers, which may
+ * be sequence lengths or variant tags, and variants. Strings and
+ * integer sequences are skipped without being copied.
+ */
+BT_HIDDEN
+int ctf_decode_plan_scan(const struct ctf_decode_plan *plan,
+		struct ctf_stream_pos *pos);
+
+#endif /* _BABELTRACE_CTF_DECODE_PLAN_H */
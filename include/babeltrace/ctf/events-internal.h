@@ -77,6 +77,8 @@ struct bt_ctf_iter {
 	 */
 	GPtrArray *dep_gc;
 	uint64_t events_lost;
+	int lazy_decode;			/* Set by bt_ctf_iter_set_lazy_decode() */
+	struct ctf_decode_ahead *decode_ahead;	/* NULL if disabled */
 };
 
 void ctf_update_current_packet_index(struct ctf_stream_definition *stream,
@@ -114,6 +114,17 @@ uint64_t bt_ctf_get_cycles(const struct bt_ctf_event *event);
  */
 uint64_t bt_ctf_get_timestamp(const struct bt_ctf_event *event);
 
+/*
+ * bt_ctf_event_copy_strings: copy the string fields of an event read
+ * with zero-copy strings (see bt_ctf_iter_set_zero_copy_strings()).
+ *
+ * Their values then stay valid once the iterator moves on, until the
+ * next event of the same class is read from the same stream, as with
+ * strings copied on read. Return 0 on success, a negative value on
+ * error.
+ */
+int bt_ctf_event_copy_strings(const struct bt_ctf_event *event);
+
 /*
  * bt_ctf_get_field_list: obtain the list of fields for compound type
  *
@@ -237,6 +248,21 @@ const struct bt_definition *bt_ctf_get_enum_int(const struct bt_definition *fiel
 const char *bt_ctf_get_enum_str(const struct bt_definition *field);
 char *bt_ctf_get_char_array(const struct bt_definition *field);
 char *bt_ctf_get_string(const struct bt_definition *field);
+
+/*
+ * bt_ctf_get_int_array: get the elements of an array or sequence of
+ * integers read packed, as a buffer of *len contiguous native-endian
+ * integers.
+ *
+ * Integers have the size and signedness of the element declaration
+ * (see bt_ctf_get_int_len() and bt_ctf_get_int_signedness()). The
+ * buffer stays valid as long as the event is unchanged. If the field
+ * elements are not read packed (see bt_integer_declaration_packable()),
+ * NULL is returned and the field error is set; access them with
+ * bt_ctf_get_index() instead.
+ */
+const void *bt_ctf_get_int_array(const struct bt_definition *field,
+		uint64_t *len);
 double bt_ctf_get_float(const struct bt_definition *field);
 const struct bt_definition *bt_ctf_get_variant(const struct bt_definition *field);
 const struct bt_definition *bt_ctf_get_struct_field_index(
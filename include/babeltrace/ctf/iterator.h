@@ -63,6 +63,82 @@ struct bt_ctf_iter *bt_ctf_iter_create(struct bt_context *ctx,
 		const struct bt_iter_pos *begin_pos,
 		const struct bt_iter_pos *end_pos);
 
+/*
+ * bt_ctf_iter_create_merge - Allocate a CTF trace collection iterator
+ * merging the streams with the given structure.
+ *
+ * Same as bt_ctf_iter_create(), which uses BT_ITER_MERGE_HEAP. See enum
+ * bt_iter_merge.
+ */
+struct bt_ctf_iter *bt_ctf_iter_create_merge(struct bt_context *ctx,
+		const struct bt_iter_pos *begin_pos,
+		const struct bt_iter_pos *end_pos,
+		enum bt_iter_merge merge);
+
+/*
+ * bt_ctf_iter_set_lazy_decode - Enable or disable lazy decoding.
+ *
+ * When enabled, the contexts and payload of events are only decoded
+ * when first accessed through bt_ctf_get_top_level_scope(). This
+ * applies to events whose layout allows to find the next event without
+ * decoding them; others are decoded as usual. Only the streams of the
+ * traces currently in the iterator's context are affected.
+ *
+ * Return 0 on success, a negative value on error.
+ */
+int bt_ctf_iter_set_lazy_decode(struct bt_ctf_iter *iter, int lazy);
+
+/*
+ * bt_ctf_iter_set_zero_copy_strings - Enable or disable zero-copy
+ * strings.
+ *
+ * When enabled, string fields point directly into the mapped trace
+ * data instead of being copied. Their values are only valid until the
+ * iterator moves on, unless copied with bt_ctf_event_copy_strings().
+ * Only the streams of the traces currently in the iterator's context
+ * are affected.
+ *
+ * Return 0 on success, a negative value on error.
+ */
+int bt_ctf_iter_set_zero_copy_strings(struct bt_ctf_iter *iter, int zero_copy);
+
+/*
+ * bt_ctf_iter_set_decode_threads - Decode events ahead on worker threads.
+ *
+ * With nr_threads > 0, the contexts and payload of the next event of
+ * each stream are decoded by a pool of nr_threads worker threads while
+ * the iterator merges the streams. Events returned by
+ * bt_ctf_iter_read_event() are fully decoded. This applies to events
+ * eligible for lazy decoding (see bt_ctf_iter_set_lazy_decode()); others
+ * are decoded by the calling thread. 0 stops the worker threads. Only
+ * the streams of the traces currently in the iterator's context are
+ * affected.
+ *
+ * Return 0 on success, a negative value on error.
+ */
+int bt_ctf_iter_set_decode_threads(struct bt_ctf_iter *iter, int nr_threads);
+
+/*
+ * bt_ctf_iter_select_event - Add an event class to the event selection.
+ *
+ * Once an event selection is set, the iterator only returns events
+ * whose name is part of it. Other events are moved past without
+ * decoding their contexts and payload. Only the streams of the traces
+ * currently in the iterator's context are affected.
+ *
+ * Return 0 on success, -ENOENT if no event class of these traces has
+ * that name (the name is added to the selection nonetheless), another
+ * negative value on error.
+ */
+int bt_ctf_iter_select_event(struct bt_ctf_iter *iter, const char *name);
+
+/*
+ * bt_ctf_iter_clear_event_selection - Return events of all classes.
+ *
+ * Return 0 on success, a negative value on error.
+ */
+int bt_ctf_iter_clear_event_selection(struct bt_ctf_iter *iter);
+
 /*
  * bt_ctf_get_iter - get iterator from ctf iterator.
  */
@@ -44,6 +44,7 @@
 struct ctf_file_stream {
 	struct ctf_stream_definition parent;
 	struct ctf_stream_pos pos;	/* current stream position */
+	uint64_t rank;			/* order among events of equal timestamps */
 };
 
 #define HEADER_END		char end_field
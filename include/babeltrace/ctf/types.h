@@ -60,6 +60,21 @@ struct packet_index {
 	struct packet_index_time ts_real;	/* realtime timestamp */
 };
 
+/*
+ * Point within a packet from which events can be read without reading
+ * the preceding ones, recorded by time seeks, and by event reads when
+ * the time index is enabled.
+ */
+struct packet_seek_point {
+	int64_t offset;			/* offset of the event in the packet, in bits */
+	uint64_t cycles_timestamp;	/* stream timestamp before the event, in cycles */
+	uint64_t event_timestamp;	/* timestamp of the event, in cycles */
+	uint64_t real_timestamp;	/* timestamp of the event, in ns */
+};
+
+/* Seek points are recorded every CTF_SEEK_POINT_INTERVAL events. */
+#define CTF_SEEK_POINT_INTERVAL	32
+
 /*
  * Always update ctf_stream_pos with ctf_move_pos and ctf_init_pos.
  */
@@ -78,6 +93,25 @@ struct ctf_stream_pos {
 	uint64_t content_size;	/* current content size, in bits */
 	uint64_t *content_size_loc; /* pointer to current content size */
 	struct mmap_align *base_mma;/* mmap base address */
+	/*
+	 * When reading, base_mma maps a window of several packets and
+	 * mmap_base_offset locates the current packet within it.
+	 */
+	off_t window_offset;	/* offset of the window in the file, in bytes */
+	size_t window_len;	/* length of the window, in bytes. 0 if unset */
+	off_t readahead_offset;	/* end of the range advised for readahead, in bytes */
+	uint64_t map_count;	/* number of mmap calls */
+	uint64_t unmap_count;	/* number of munmap calls */
+	/*
+	 * Packet number to GArray of struct packet_seek_point, in
+	 * increasing offset order. Only holds the packets seeked into,
+	 * or read when record_seek_points is set.
+	 */
+	GHashTable *seek_points;
+	int record_seek_points;	/* record seek points while reading events */
+	int seek_points_dirty;	/* seek points added since opening */
+	uint64_t packet_events;	/* events read since the last packet switch */
+	int zero_copy_strings;	/* strings read point into the mapping */
 	int64_t offset;		/* offset from base, in bits. EOF for end of file. */
 	int64_t last_offset;	/* offset before the last read_event */
 	int64_t data_offset;	/* offset of data in current packet */
@@ -101,6 +135,13 @@ BT_HIDDEN
 int ctf_integer_read(struct bt_stream_pos *pos, struct bt_definition *definition);
 BT_HIDDEN
 int ctf_integer_write(struct bt_stream_pos *pos, struct bt_definition *definition);
+/*
+ * Read len integers into packed (see bt_integer_declaration_packable()).
+ */
+BT_HIDDEN
+int ctf_packed_integers_read(struct ctf_stream_pos *pos,
+		const struct declaration_integer *integer_declaration,
+		uint64_t len, GByteArray *packed);
 BT_HIDDEN
 int ctf_float_read(struct bt_stream_pos *pos, struct bt_definition *definition);
 BT_HIDDEN
@@ -112,6 +153,8 @@ int ctf_string_write(struct bt_stream_pos *pos, struct bt_definition *definition
 BT_HIDDEN
 int ctf_enum_read(struct bt_stream_pos *pos, struct bt_definition *definition);
 BT_HIDDEN
+void ctf_enum_update_value(struct definition_enum *enum_definition);
+BT_HIDDEN
 int ctf_enum_write(struct bt_stream_pos *pos, struct bt_definition *definition);
 BT_HIDDEN
 int ctf_struct_rw(struct bt_stream_pos *pos, struct bt_definition *definition);
@@ -242,9 +285,51 @@ void ctf_pos_get_event(struct ctf_stream_pos *pos)
 	}
 }
 
+/* Room needed by ctf_format_timestamp(): date, time and nanoseconds */
+#define CTF_TIMESTAMP_LEN	64
+
+/*
+ * Date and time of the last second formatted by ctf_format_timestamp(),
+ * kept by each output so that broken-down time is computed once per
+ * second rather than once per event.
+ */
+struct ctf_timestamp_cache {
+	int valid;
+	uint64_t sec;		/* Seconds since epoch, offsets applied */
+	int gmt, date;		/* Clock options the prefix is rendered for */
+	size_t len;
+	char prefix[48];	/* [YYYY-MM-DD ]HH:MM:SS. */
+};
+
 void ctf_print_timestamp(FILE *fp, struct ctf_stream_definition *stream,
 			uint64_t timestamp);
+/*
+ * Write the text printed by ctf_print_timestamp() at buf, without
+ * terminating null byte, and return its length. cache may be NULL.
+ */
+size_t ctf_format_timestamp(char *buf, struct ctf_timestamp_cache *cache,
+			struct ctf_stream_definition *stream,
+			uint64_t timestamp);
 int ctf_append_trace_metadata(struct bt_trace_descriptor *tdp,
 			FILE *metadata_fp);
+int ctf_decode_pending_event(struct ctf_stream_definition *stream);
+/*
+ * Decode the pending event of a stream on the calling thread, used by
+ * decode-ahead workers.
+ */
+BT_HIDDEN
+int ctf_decode_pending_payload(struct ctf_stream_definition *stream);
+
+/*
+ * Return the seek points of the current packet of a position, creating
+ * them if needed.
+ */
+GArray *ctf_pos_get_seek_points(struct ctf_stream_pos *pos);
+/*
+ * Append a seek point to the seek points of the current packet. Points
+ * which are not past the last one are ignored.
+ */
+void ctf_pos_add_seek_point(struct ctf_stream_pos *pos,
+		const struct packet_seek_point *point);
 
 #endif /* _BABELTRACE_CTF_TYPES_H */
@@ -45,6 +45,7 @@ struct bt_trace_descriptor {
 	struct trace_collection *collection;	/* Container of this trace */
 	GHashTable *clocks;
 	struct ctf_clock *single_clock;		/* currently supports only one clock */
+	uint64_t offset_ns;			/* Clock offset within the collection */
 };
 
 #ifdef __cplusplus
@@ -30,13 +30,24 @@
  */
 
 #include <babeltrace/ctf/events.h>
+#include <babeltrace/iterator.h>
+
+struct ctf_file_stream;
 
 /*
  * struct bt_iter: data structure representing an iterator on a trace
  * collection.
  */
 struct bt_iter {
-	struct ptr_heap *stream_heap;
+	enum bt_iter_merge merge;
+	struct ptr_heap *stream_heap;		/* BT_ITER_MERGE_HEAP */
+	struct loser_tree *stream_tree;		/* BT_ITER_MERGE_LOSER_TREE */
+	/*
+	 * The current stream stays current while its timestamp is below
+	 * run_bound, the smallest timestamp of the other streams. 0 if
+	 * not known.
+	 */
+	uint64_t run_bound;
 	struct bt_context *ctx;
 	const struct bt_iter_pos *end_pos;
 };
@@ -65,9 +76,16 @@ void bt_iter_destroy(struct bt_iter *iter);
 int bt_iter_init(struct bt_iter *iter,
 		struct bt_context *ctx,
 		const struct bt_iter_pos *begin_pos,
-		const struct bt_iter_pos *end_pos);
+		const struct bt_iter_pos *end_pos,
+		enum bt_iter_merge merge);
 void bt_iter_fini(struct bt_iter *iter);
 int bt_iter_add_trace(struct bt_iter *iter,
 		struct bt_trace_descriptor *td_read);
 
+/*
+ * bt_iter_current_stream - Return the stream of the next event, NULL
+ * at the end of the trace collection.
+ */
+struct ctf_file_stream *bt_iter_current_stream(struct bt_iter *iter);
+
 #endif /* _BABELTRACE_ITERATOR_INTERNAL_H */
@@ -38,6 +38,17 @@ enum {
 	BT_ITER_FLAG_RETRY		= (1 << 1),
 };
 
+/*
+ * Structure merging the streams of the trace collection by timestamp.
+ * The binary heap suits a few streams; the loser tree takes fewer and
+ * cheaper comparisons per event, which matters with many streams.
+ * Both give events of equal timestamps in stream path order.
+ */
+enum bt_iter_merge {
+	BT_ITER_MERGE_HEAP = 0,
+	BT_ITER_MERGE_LOSER_TREE,
+};
+
 /* Forward declarations */
 struct bt_iter;
 struct bt_saved_pos;
@@ -0,0 +1,49 @@
+#ifndef _BABELTRACE_JSON_STRING_H
+#define _BABELTRACE_JSON_STRING_H
+
+/*
+ * BabelTrace
+ *
+ * JSON Format - String escaping
+ *
+ * Copyright 2015 EfficiOS Inc. and Linux Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/babeltrace-internal.h>
+#include <babeltrace/ctf-text/buffer.h>
+#include <stddef.h>
+
+/*
+ * Append str, of len bytes, to buf as a quoted JSON string. Quotes,
+ * backslashes and control characters are escaped; other bytes,
+ * including UTF-8 sequences, are copied as is.
+ */
+BT_HIDDEN
+void json_put_string_len(struct ctf_text_buffer *buf, const char *str,
+		size_t len);
+
+static inline
+void json_put_string(struct ctf_text_buffer *buf, const char *str)
+{
+	json_put_string_len(buf, str, strlen(str));
+}
+
+#endif /* _BABELTRACE_JSON_STRING_H */
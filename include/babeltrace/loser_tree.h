@@ -0,0 +1,159 @@
+#ifndef _BABELTRACE_LOSER_TREE_H
+#define _BABELTRACE_LOSER_TREE_H
+
+/*
+ * loser_tree.h
+ *
+ * Tournament tree of losers merging pointers by 64-bit key. Based on
+ * Knuth, TAOCP vol. 3, section 5.4.1.
+ *
+ * Copyright 2015 EfficiOS Inc. and Linux Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <unistd.h>
+#include <babeltrace/babeltrace-internal.h>
+
+/*
+ * The elements are held by the leaves. Each node of the tournament
+ * holds the key of the loser of its match, along with its rank in the
+ * tie-break order among the elements of the tree, so that replaying the
+ * matches of a leaf only compares integers found along its path. The
+ * tie-break function is called when the tree is rebuilt after
+ * insertions, to sort the elements.
+ */
+struct loser_tree_leaf {
+	uint64_t key;
+	void *ptr;		/* NULL for an empty leaf */
+};
+
+struct loser_tree_node {
+	uint64_t key;
+	uint32_t rank;		/* UINT32_MAX for an empty leaf */
+	uint32_t leaf;
+};
+
+struct loser_tree {
+	size_t len;		/* number of elements */
+	size_t nr_leaves;	/* leaves in use, including emptied ones */
+	size_t width;		/* leaves of the tournament, power of 2 */
+	size_t alloc_len;	/* allocated leaves */
+	struct loser_tree_leaf *leaves;
+	/* nodes[0]: winner, nodes[1..width-1]: loser of each match */
+	struct loser_tree_node *nodes;
+	struct loser_tree_node *winners;	/* rebuild scratch, 2 * alloc_len */
+	int dirty;		/* elements inserted since last rebuild */
+	int (*tie_break)(void *a, void *b);
+};
+
+/**
+ * bt_loser_tree_init - initialize the tree
+ * @tree: the tree to initialize
+ * @alloc_len: number of elements initially allocated
+ * @tie_break: function ordering elements of equal key, strcmp-like
+ *
+ * Returns -ENOMEM if out of memory.
+ */
+extern int bt_loser_tree_init(struct loser_tree *tree, size_t alloc_len,
+		int tie_break(void *a, void *b));
+
+/**
+ * bt_loser_tree_free - free the tree
+ * @tree: the tree to free
+ */
+extern void bt_loser_tree_free(struct loser_tree *tree);
+
+/**
+ * bt_loser_tree_insert - insert an element into the tree
+ * @tree: the tree to be operated on
+ * @p: the element to add
+ * @key: the key of the element
+ *
+ * The tree is rebuilt on its next access. Returns -ENOMEM if out of
+ * memory.
+ */
+extern int bt_loser_tree_insert(struct loser_tree *tree, void *p,
+		uint64_t key);
+
+/**
+ * bt_loser_tree_rebuild - play all the matches of the tree again
+ * @tree: the tree to be operated on
+ *
+ * Called on access after insertions. It never allocates memory.
+ */
+extern void bt_loser_tree_rebuild(struct loser_tree *tree);
+
+/**
+ * bt_loser_tree_winner - return the element of smallest key
+ * @tree: the tree to be operated on
+ *
+ * Returns NULL if the tree is empty.
+ */
+static inline void *bt_loser_tree_winner(struct loser_tree *tree)
+{
+	if (unlikely(tree->dirty))
+		bt_loser_tree_rebuild(tree);
+	return likely(tree->len) ? tree->leaves[tree->nodes[0].leaf].ptr : NULL;
+}
+
+/**
+ * bt_loser_tree_remove - remove the element of smallest key
+ * @tree: the tree to be operated on
+ *
+ * Returns the removed element, NULL if the tree is empty.
+ */
+extern void *bt_loser_tree_remove(struct loser_tree *tree);
+
+/**
+ * bt_loser_tree_update_winner - set the key of the winner element
+ * @tree: the tree to be operated on
+ * @key: the new key of the element
+ *
+ * Only the matches on the path of the winner leaf are played again,
+ * which takes log2(n) key comparisons. The tree must not be empty.
+ */
+extern void bt_loser_tree_update_winner(struct loser_tree *tree,
+		uint64_t key);
+
+/**
+ * bt_loser_tree_runner_up_key - return the smallest key of the elements
+ * other than the winner
+ * @tree: the tree to be operated on
+ *
+ * Looks at the losers of the matches played by the winner, which takes
+ * log2(n) steps. Returns UINT64_MAX if there is no other element.
+ */
+extern uint64_t bt_loser_tree_runner_up_key(struct loser_tree *tree);
+
+/**
+ * bt_loser_tree_get - return an element of the tree
+ * @tree: the tree to be operated on
+ * @i: index of the leaf, in [0, tree->nr_leaves)
+ *
+ * Allows to walk the elements in no particular order. Returns NULL for
+ * an empty leaf.
+ */
+static inline void *bt_loser_tree_get(struct loser_tree *tree, size_t i)
+{
+	return tree->leaves[i].ptr;
+}
+
+#endif /* _BABELTRACE_LOSER_TREE_H */
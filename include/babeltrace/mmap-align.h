@@ -26,6 +26,7 @@
  */
 
 #include <babeltrace/align.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <sys/mman.h>
 
@@ -68,7 +69,10 @@ struct mmap_align *mmap_align(size_t length, int prot,
 	mma->page_aligned_addr = mmap(NULL, mma->page_aligned_length,
 		prot, flags, fd, page_aligned_offset);
 	if (mma->page_aligned_addr == (void *) -1UL) {
+		int err = errno;	/* Kept for the caller */
+
 		free(mma);
+		errno = err;
 		return MAP_FAILED;
 	}
 	mma->addr = mma->page_aligned_addr + (offset - page_aligned_offset);
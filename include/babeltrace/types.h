@@ -198,21 +198,28 @@ struct enum_range_to_quark {
 };
 
 /*
- * We optimize the common case (range of size 1: single value) by creating a
- * hash table mapping values to quark sets. We then lookup the ranges to
- * complete the quark set.
- *
- * TODO: The proper structure to hold the range to quark set mapping would be an
- * interval tree, with O(n) size, O(n*log(n)) build time and O(log(n)) query
- * time. Using a simple O(n) list search for now for implementation speed and
- * given that we can expect to have a _relatively_ small number of enumeration
- * ranges. This might become untrue if we are fed with symbol tables often
- * required to lookup function names from instruction pointer value.
+ * Single values are kept in a hash table mapping values to quark sets, and
+ * ranges in a list. Once all mappings are inserted, both are flattened into
+ * a sorted array of non-overlapping intervals, each holding the complete
+ * quark set of the values it covers. Lookups are then a binary search
+ * returning a reference on a precomputed quark set, with O(log(n)) time and
+ * no allocation.
  */
+struct enum_interval {
+	/*
+	 * Lowest value of the interval, as a lookup key: signed values
+	 * have their sign bit flipped so that keys sort as unsigned. The
+	 * interval ends where the next one starts.
+	 */
+	uint64_t start;
+	GArray *quarks;		/* GQuark set, NULL if no mapping */
+};
+
 struct enum_table {
 	GHashTable *value_to_quark_set;		/* (value, GQuark GArray) */
 	struct bt_list_head range_to_quark;	/* (range, GQuark) */
 	GHashTable *quark_to_range_set;		/* (GQuark, range GArray) */
+	GArray *intervals;	/* struct enum_interval, NULL if not built */
 };
 
 struct declaration_enum {
@@ -227,6 +234,8 @@ struct definition_enum {
 	struct declaration_enum *declaration;
 	/* Last GQuark values read. Keeping a reference on the GQuark array. */
 	GArray *value;
+	/* Index of the last value read in the interval index, -1 if unmapped */
+	int interval;
 };
 
 struct declaration_string {
@@ -237,8 +246,9 @@ struct declaration_string {
 struct definition_string {
 	struct bt_definition p;
 	struct declaration_string *declaration;
-	char *value;	/* freed at definition_string teardown */
+	char *value;	/* freed at definition_string teardown unless borrowed */
 	size_t len, alloc_len;
+	int borrowed;	/* value points into the trace mapping */
 };
 
 struct declaration_field {
@@ -270,6 +280,14 @@ struct declaration_variant {
 	struct bt_declaration p;
 	struct declaration_untagged_variant *untagged_variant;
 	GArray *tag_name;		/* Array of GQuark */
+	/*
+	 * Field index selected by each interval of the tag enumeration
+	 * interval index, -1 if the interval does not select exactly one
+	 * field. Built for tag_enum once the metadata is complete, NULL
+	 * if the tag enumeration is unknown.
+	 */
+	struct declaration_enum *tag_enum;
+	GArray *tag_fields;		/* Array of long */
 };
 
 /* A variant needs to be tagged to be defined. */
@@ -293,6 +311,8 @@ struct definition_array {
 	struct declaration_array *declaration;
 	GPtrArray *elems;		/* Array of pointers to struct bt_definition */
 	GString *string;		/* String for encoded integer children */
+	GByteArray *packed;		/* Packed integer children, NULL if unused */
+	int elems_stale;		/* elems not updated from packed yet */
 };
 
 struct declaration_sequence {
@@ -308,6 +328,8 @@ struct definition_sequence {
 	struct definition_integer *length;
 	GPtrArray *elems;		/* Array of pointers to struct bt_definition */
 	GString *string;		/* String for encoded integer children */
+	GByteArray *packed;		/* Packed integer children, NULL if unused */
+	int elems_stale;		/* elems not updated from packed yet */
 };
 
 int bt_register_declaration(GQuark declaration_name,
@@ -381,6 +403,21 @@ struct declaration_integer *bt_integer_declaration_new(size_t len, int byte_orde
 				  struct ctf_clock *clock);
 uint64_t bt_get_unsigned_int(const struct bt_definition *field);
 int64_t bt_get_signed_int(const struct bt_definition *field);
+
+/*
+ * Arrays and sequences of unencoded 8, 16, 32 or 64-bit integers,
+ * aligned on bytes and whose size is a multiple of their alignment,
+ * are read packed: into a buffer of contiguous native-endian integers
+ * of their size. Their element definitions are only updated from the
+ * buffer when accessed.
+ */
+int bt_integer_declaration_packable(struct bt_declaration *declaration);
+/*
+ * Set the values of the first len integer definitions of elems from
+ * packed integers.
+ */
+void bt_integer_unpack(struct bt_definition **elems, uint64_t len,
+		const GByteArray *packed);
 int bt_get_int_signedness(const struct bt_definition *field);
 int bt_get_int_byte_order(const struct bt_definition *field);
 int bt_get_int_base(const struct bt_definition *field);
@@ -401,19 +438,29 @@ struct declaration_float *bt_float_declaration_new(size_t mantissa_len,
  */
 
 /*
- * Returns a GArray of GQuark or NULL.
+ * Returns a GArray of GQuark or NULL. The set is shared with other
+ * lookups and must not be modified.
  * Caller must release the GArray with g_array_unref().
  */
 GArray *bt_enum_uint_to_quark_set(const struct declaration_enum *enum_declaration,
 			       uint64_t v);
 
 /*
- * Returns a GArray of GQuark or NULL.
+ * Returns a GArray of GQuark or NULL. The set is shared with other
+ * lookups and must not be modified.
  * Caller must release the GArray with g_array_unref().
  */
 GArray *bt_enum_int_to_quark_set(const struct declaration_enum *enum_declaration,
 			      int64_t v);
 
+/*
+ * Returns the index of the interval holding value v (signed values
+ * passed as their two's complement representation) in the interval
+ * index, or -1 if v is not mapped.
+ */
+int bt_enum_value_to_interval(const struct declaration_enum *enum_declaration,
+			uint64_t v);
+
 /*
  * Returns a GArray of struct enum_range or NULL.
  * Callers do _not_ own the returned GArray (and therefore _don't_ need to
@@ -427,6 +474,12 @@ void bt_enum_unsigned_insert(struct declaration_enum *enum_declaration,
 			  uint64_t start, uint64_t end, GQuark q);
 size_t bt_enum_get_nr_enumerators(struct declaration_enum *enum_declaration);
 
+/*
+ * Build the interval index used by lookups. Called once all mappings are
+ * inserted; lookups on an enumeration modified afterwards rebuild it.
+ */
+void bt_enum_build_index(struct declaration_enum *enum_declaration);
+
 struct declaration_enum *
 	bt_enum_declaration_new(struct declaration_integer *integer_declaration);
 
@@ -478,6 +531,12 @@ void bt_untagged_variant_declaration_add_field(struct declaration_untagged_varia
 struct declaration_field *
 	bt_untagged_variant_declaration_get_field_from_tag(struct declaration_untagged_variant *untagged_variant_declaration,
 		GQuark tag);
+/*
+ * Build the table selecting the field of each interval of the tag
+ * enumeration. Does nothing if a tag enumeration is already set.
+ */
+void bt_variant_declaration_set_tag_enum(struct declaration_variant *variant_declaration,
+		struct declaration_enum *enum_declaration);
 /*
  * Returns 0 on success, -EPERM on error.
  */
@@ -502,6 +561,7 @@ struct declaration_array *
 uint64_t bt_array_len(struct definition_array *array);
 struct bt_definition *bt_array_index(struct definition_array *array, uint64_t i);
 int bt_array_rw(struct bt_stream_pos *pos, struct bt_definition *definition);
+void bt_array_unpack(struct definition_array *array);
 GString *bt_get_char_array(const struct bt_definition *field);
 int bt_get_array_len(const struct bt_definition *field);
 
@@ -516,6 +576,7 @@ struct declaration_sequence *
 uint64_t bt_sequence_len(struct definition_sequence *sequence);
 struct bt_definition *bt_sequence_index(struct definition_sequence *sequence, uint64_t i);
 int bt_sequence_rw(struct bt_stream_pos *pos, struct bt_definition *definition);
+void bt_sequence_unpack(struct definition_sequence *sequence);
 
 /*
  * in: path (dot separated), out: q (GArray of GQuark)
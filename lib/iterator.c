@@ -33,6 +33,7 @@
 #include <babeltrace/iterator-internal.h>
 #include <babeltrace/iterator.h>
 #include <babeltrace/prio_heap.h>
+#include <babeltrace/loser_tree.h>
 #include <babeltrace/ctf/metadata.h>
 #include <babeltrace/ctf/events.h>
 #include <inttypes.h>
@@ -77,22 +78,211 @@ static int stream_read_event(struct ctf_file_stream *sin)
 
 /*
  * Return true if a < b, false otherwise.
- * If time stamps are exactly the same, compare by stream path. This
+ * If time stamps are exactly the same, compare by stream rank. This
  * ensures we get the same result between runs on the same trace
  * collection on different environments.
- * The result will be random for memory-mapped traces since there is no
- * fixed path leading to those (they have empty path string).
  */
 static int stream_compare(void *a, void *b)
 {
 	struct ctf_file_stream *s_a = a, *s_b = b;
 
-	if (s_a->parent.real_timestamp < s_b->parent.real_timestamp) {
+#ifdef __SIZEOF_INT128__
+	return (((unsigned __int128) s_a->parent.real_timestamp << 64) | s_a->rank)
+		< (((unsigned __int128) s_b->parent.real_timestamp << 64) | s_b->rank);
+#else
+	if (s_a->parent.real_timestamp < s_b->parent.real_timestamp)
 		return 1;
-	} else if (likely(s_a->parent.real_timestamp > s_b->parent.real_timestamp)) {
+	else if (likely(s_a->parent.real_timestamp > s_b->parent.real_timestamp))
 		return 0;
-	} else {
-		return strcmp(s_a->parent.path, s_b->parent.path);
+	else
+		return s_a->rank < s_b->rank;
+#endif
+}
+
+static int stream_tie_break(void *a, void *b)
+{
+	struct ctf_file_stream *s_a = a, *s_b = b;
+
+	if (s_a->rank < s_b->rank)
+		return -1;
+	return s_a->rank > s_b->rank;
+}
+
+static gint compare_stream_paths(gconstpointer a, gconstpointer b)
+{
+	const struct ctf_file_stream *s_a = *(const struct ctf_file_stream **) a;
+	const struct ctf_file_stream *s_b = *(const struct ctf_file_stream **) b;
+	int ret;
+
+	ret = strcmp(s_a->parent.path, s_b->parent.path);
+	if (ret)
+		return ret;
+	if (s_a->parent.stream_id < s_b->parent.stream_id)
+		return -1;
+	return s_a->parent.stream_id > s_b->parent.stream_id;
+}
+
+/*
+ * Rank the streams of the collection by path, then by stream id.
+ * Memory-mapped traces have no path: their streams of the same id keep
+ * the order in which they were added (stable sort).
+ */
+static void rank_streams(struct trace_collection *tc)
+{
+	GPtrArray *streams;
+	int i, j, k;
+
+	streams = g_ptr_array_new();
+	for (i = 0; i < tc->array->len; i++) {
+		struct bt_trace_descriptor *td_read;
+		struct ctf_trace *tin;
+
+		td_read = g_ptr_array_index(tc->array, i);
+		if (!td_read)
+			continue;
+		tin = container_of(td_read, struct ctf_trace, parent);
+		for (j = 0; j < tin->streams->len; j++) {
+			struct ctf_stream_declaration *stream;
+
+			stream = g_ptr_array_index(tin->streams, j);
+			if (!stream)
+				continue;
+			for (k = 0; k < stream->streams->len; k++) {
+				struct ctf_file_stream *file_stream;
+
+				file_stream = g_ptr_array_index(stream->streams, k);
+				if (file_stream)
+					g_ptr_array_add(streams, file_stream);
+			}
+		}
+	}
+	g_ptr_array_sort(streams, compare_stream_paths);
+	for (i = 0; i < streams->len; i++) {
+		struct ctf_file_stream *file_stream;
+
+		file_stream = g_ptr_array_index(streams, i);
+		file_stream->rank = i;
+	}
+	g_ptr_array_free(streams, TRUE);
+}
+
+/*
+ * Operations on the structure merging the streams. The loser tree keeps
+ * a copy of the timestamp of each stream: it must only change for the
+ * current stream, followed by a call to merge_update_current().
+ */
+static int merge_init(struct bt_iter *iter)
+{
+	iter->run_bound = 0;
+	switch (iter->merge) {
+	case BT_ITER_MERGE_LOSER_TREE:
+		return bt_loser_tree_init(iter->stream_tree, 0,
+				stream_tie_break);
+	case BT_ITER_MERGE_HEAP:
+	default:
+		return bt_heap_init(iter->stream_heap, 0, stream_compare);
+	}
+}
+
+static void merge_free(struct bt_iter *iter)
+{
+	switch (iter->merge) {
+	case BT_ITER_MERGE_LOSER_TREE:
+		bt_loser_tree_free(iter->stream_tree);
+		break;
+	case BT_ITER_MERGE_HEAP:
+	default:
+		bt_heap_free(iter->stream_heap);
+		break;
+	}
+}
+
+/* Remove all the streams. */
+static int merge_reset(struct bt_iter *iter)
+{
+	merge_free(iter);
+	return merge_init(iter);
+}
+
+static void merge_update_current(struct bt_iter *iter,
+		struct ctf_file_stream *cfs);
+
+static int merge_insert(struct bt_iter *iter, struct ctf_file_stream *cfs)
+{
+	/* The tree must know the timestamp of the current stream. */
+	if (iter->run_bound) {
+		merge_update_current(iter, bt_iter_current_stream(iter));
+		iter->run_bound = 0;
+	}
+	switch (iter->merge) {
+	case BT_ITER_MERGE_LOSER_TREE:
+		return bt_loser_tree_insert(iter->stream_tree, cfs,
+				cfs->parent.real_timestamp);
+	case BT_ITER_MERGE_HEAP:
+	default:
+		return bt_heap_insert(iter->stream_heap, cfs);
+	}
+}
+
+struct ctf_file_stream *bt_iter_current_stream(struct bt_iter *iter)
+{
+	switch (iter->merge) {
+	case BT_ITER_MERGE_LOSER_TREE:
+		return bt_loser_tree_winner(iter->stream_tree);
+	case BT_ITER_MERGE_HEAP:
+	default:
+		return bt_heap_maximum(iter->stream_heap);
+	}
+}
+
+static struct ctf_file_stream *merge_remove_current(struct bt_iter *iter)
+{
+	switch (iter->merge) {
+	case BT_ITER_MERGE_LOSER_TREE:
+		return bt_loser_tree_remove(iter->stream_tree);
+	case BT_ITER_MERGE_HEAP:
+	default:
+		return bt_heap_remove(iter->stream_heap);
+	}
+}
+
+/* The current stream moved to its next event: find the next current. */
+static void merge_update_current(struct bt_iter *iter,
+		struct ctf_file_stream *cfs)
+{
+	struct ctf_file_stream *removed;
+
+	switch (iter->merge) {
+	case BT_ITER_MERGE_LOSER_TREE:
+		bt_loser_tree_update_winner(iter->stream_tree,
+				cfs->parent.real_timestamp);
+		break;
+	case BT_ITER_MERGE_HEAP:
+	default:
+		removed = bt_heap_replace_max(iter->stream_heap, cfs);
+		assert(removed == cfs);
+		break;
+	}
+}
+
+/* Smallest timestamp of the streams other than the current one. */
+static uint64_t merge_next_timestamp(struct bt_iter *iter)
+{
+	struct ptr_heap *heap = iter->stream_heap;
+	struct ctf_file_stream *next;
+
+	switch (iter->merge) {
+	case BT_ITER_MERGE_LOSER_TREE:
+		return bt_loser_tree_runner_up_key(iter->stream_tree);
+	case BT_ITER_MERGE_HEAP:
+	default:
+		/* The next stream is a child of the current one. */
+		if (heap->len < 2)
+			return UINT64_MAX;
+		next = heap->ptrs[1];
+		if (heap->len > 2 && stream_compare(heap->ptrs[2], next))
+			next = heap->ptrs[2];
+		return next->parent.real_timestamp;
 	}
 }
 
@@ -112,6 +302,30 @@ void bt_iter_free_pos(struct bt_iter_pos *iter_pos)
 	g_free(iter_pos);
 }
 
+/*
+ * Find the first packet whose end is not before timestamp. Packets are
+ * in increasing timestamp order within a stream.
+ */
+static
+int find_packet_by_timestamp(struct ctf_stream_pos *stream_pos,
+		uint64_t timestamp)
+{
+	int low = 0, high = stream_pos->packet_index->len;
+
+	while (low < high) {
+		int mid = low + (high - low) / 2;
+		struct packet_index *index;
+
+		index = &g_array_index(stream_pos->packet_index,
+				struct packet_index, mid);
+		if (index->ts_real.timestamp_end < timestamp)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
 /*
  * seek_file_stream_by_timestamp
  *
@@ -120,40 +334,67 @@ void bt_iter_free_pos(struct bt_iter_pos *iter_pos)
  * are looking for (either the exact timestamp or the event just after the
  * timestamp).
  *
+ * The packet is found by binary search. Within the packet, reading
+ * starts from the last seek point recorded before the timestamp by
+ * previous seeks or reads, or loaded from the time index, and seek
+ * points are recorded along the events read.
+ *
  * Return 0 if the seek succeded, EOF if we didn't find any packet
  * containing the timestamp, or a positive integer for error.
- *
- * TODO: this should be turned into a binary search! It is currently
- * doing a linear search in the packets. This is a O(n) operation on a
- * very frequent code path.
  */
 static int seek_file_stream_by_timestamp(struct ctf_file_stream *cfs,
 		uint64_t timestamp)
 {
 	struct ctf_stream_pos *stream_pos;
-	struct packet_index *index;
-	int i, ret;
+	int i, ret, record_seek_points;
 
 	stream_pos = &cfs->pos;
-	for (i = 0; i < stream_pos->packet_index->len; i++) {
-		index = &g_array_index(stream_pos->packet_index,
-				struct packet_index, i);
-		if (index->ts_real.timestamp_end < timestamp)
-			continue;
+	i = find_packet_by_timestamp(stream_pos, timestamp);
+	if (i >= stream_pos->packet_index->len) {
+		/*
+		 * Cannot find the timestamp within the stream packets,
+		 * return EOF.
+		 */
+		return EOF;
+	}
 
-		stream_pos->packet_seek(&stream_pos->parent, i, SEEK_SET);
-		do {
-			ret = stream_read_event(cfs);
-		} while (cfs->parent.real_timestamp < timestamp && ret == 0);
+	stream_pos->packet_seek(&stream_pos->parent, i, SEEK_SET);
+	if (stream_pos->offset != EOF && stream_pos->cur_index == i) {
+		GArray *points = ctf_pos_get_seek_points(stream_pos);
+		int low = 0, high = points->len;
 
-		/* Can return either EOF, 0, or error (> 0). */
-		return ret;
+		/* Find the last seek point before the timestamp */
+		while (low < high) {
+			int mid = low + (high - low) / 2;
+
+			if (g_array_index(points, struct packet_seek_point,
+					mid).real_timestamp < timestamp)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+		if (low > 0) {
+			struct packet_seek_point *point;
+
+			point = &g_array_index(points, struct packet_seek_point,
+					low - 1);
+			stream_pos->offset = point->offset;
+			stream_pos->last_offset = LAST_OFFSET_POISON;
+			stream_pos->packet_events = 0;
+			cfs->parent.cycles_timestamp = point->cycles_timestamp;
+		}
 	}
-	/*
-	 * Cannot find the timestamp within the stream packets, return
-	 * EOF.
-	 */
-	return EOF;
+
+	/* Record seek points along the events read */
+	record_seek_points = stream_pos->record_seek_points;
+	stream_pos->record_seek_points = 1;
+	do {
+		ret = stream_read_event(cfs);
+	} while (cfs->parent.real_timestamp < timestamp && ret == 0);
+	stream_pos->record_seek_points = record_seek_points;
+
+	/* Can return either EOF, 0, or error (> 0). */
+	return ret;
 }
 
 /*
@@ -166,7 +407,7 @@ static int seek_file_stream_by_timestamp(struct ctf_file_stream *cfs,
  * On other errors, return positive value.
  */
 static int seek_ctf_trace_by_timestamp(struct ctf_trace *tin,
-		uint64_t timestamp, struct ptr_heap *stream_heap)
+		uint64_t timestamp, struct bt_iter *iter)
 {
 	int i, j, ret;
 	int found = 0;
@@ -191,7 +432,7 @@ static int seek_ctf_trace_by_timestamp(struct ctf_trace *tin,
 			ret = seek_file_stream_by_timestamp(cfs, timestamp);
 			if (ret == 0) {
 				/* Add to heap */
-				ret = bt_heap_insert(stream_heap, cfs);
+				ret = merge_insert(iter, cfs);
 				if (ret) {
 					/* Return positive error. */
 					return -ret;
@@ -369,8 +610,7 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 		if (!iter_pos->u.restore)
 			return -EINVAL;
 
-		bt_heap_free(iter->stream_heap);
-		ret = bt_heap_init(iter->stream_heap, 0, stream_compare);
+		ret = merge_reset(iter);
 		if (ret < 0)
 			goto error_heap_init;
 
@@ -420,8 +660,7 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 			}
 
 			/* Add to heap */
-			ret = bt_heap_insert(iter->stream_heap,
-					saved_pos->file_stream);
+			ret = merge_insert(iter, saved_pos->file_stream);
 			if (ret)
 				goto error;
 		}
@@ -429,8 +668,7 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 	case BT_SEEK_TIME:
 		tc = iter->ctx->tc;
 
-		bt_heap_free(iter->stream_heap);
-		ret = bt_heap_init(iter->stream_heap, 0, stream_compare);
+		ret = merge_reset(iter);
 		if (ret < 0)
 			goto error_heap_init;
 
@@ -446,7 +684,7 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 
 			ret = seek_ctf_trace_by_timestamp(tin,
 					iter_pos->u.seek_time,
-					iter->stream_heap);
+					iter);
 			/*
 			 * Positive errors are failure. Negative value
 			 * is EOF (for which we continue with other
@@ -460,8 +698,7 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 		return 0;
 	case BT_SEEK_BEGIN:
 		tc = iter->ctx->tc;
-		bt_heap_free(iter->stream_heap);
-		ret = bt_heap_init(iter->stream_heap, 0, stream_compare);
+		ret = merge_reset(iter);
 		if (ret < 0)
 			goto error_heap_init;
 
@@ -503,7 +740,7 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 						/* Do not add EOF streams */
 						continue;
 					}
-					ret = bt_heap_insert(iter->stream_heap, file_stream);
+					ret = merge_insert(iter, file_stream);
 					if (ret)
 						goto error;
 				}
@@ -519,13 +756,11 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 		if (ret != 0 || !cfs)
 			goto error;
 		/* remove all streams from the heap */
-		bt_heap_free(iter->stream_heap);
-		/* Create a new empty heap */
-		ret = bt_heap_init(iter->stream_heap, 0, stream_compare);
+		ret = merge_reset(iter);
 		if (ret < 0)
 			goto error;
 		/* Insert the stream that contains the last event */
-		ret = bt_heap_insert(iter->stream_heap, cfs);
+		ret = merge_insert(iter, cfs);
 		if (ret)
 			goto error;
 		break;
@@ -538,18 +773,43 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 	return 0;
 
 error:
-	bt_heap_free(iter->stream_heap);
+	merge_free(iter);
 error_heap_init:
-	if (bt_heap_init(iter->stream_heap, 0, stream_compare) < 0) {
-		bt_heap_free(iter->stream_heap);
+	if (merge_init(iter) < 0) {
+		merge_free(iter);
 		g_free(iter->stream_heap);
+		g_free(iter->stream_tree);
 		iter->stream_heap = NULL;
+		iter->stream_tree = NULL;
 		ret = -ENOMEM;
 	}
 
 	return ret;
 }
 
+static void save_stream_pos(struct bt_saved_pos *restore,
+		struct ctf_file_stream *file_stream)
+{
+	struct stream_saved_pos saved_pos;
+
+	assert(file_stream->pos.last_offset != LAST_OFFSET_POISON);
+	saved_pos.offset = file_stream->pos.last_offset;
+	saved_pos.file_stream = file_stream;
+	saved_pos.cur_index = file_stream->pos.cur_index;
+
+	saved_pos.current_real_timestamp = file_stream->parent.real_timestamp;
+	saved_pos.current_cycles_timestamp = file_stream->parent.cycles_timestamp;
+
+	g_array_append_val(restore->stream_saved_pos, saved_pos);
+
+	printf_debug("stream : %" PRIu64 ", cur_index : %zd, "
+			"offset : %zd, "
+			"timestamp = %" PRIu64 "\n",
+			file_stream->parent.stream_id,
+			saved_pos.cur_index, saved_pos.offset,
+			saved_pos.current_real_timestamp);
+}
+
 struct bt_iter_pos *bt_iter_get_pos(struct bt_iter *iter)
 {
 	struct bt_iter_pos *pos;
@@ -571,6 +831,18 @@ struct bt_iter_pos *bt_iter_get_pos(struct bt_iter *iter)
 	if (!pos->u.restore->stream_saved_pos)
 		goto error;
 
+	if (iter->merge == BT_ITER_MERGE_LOSER_TREE) {
+		size_t i;
+
+		/* iterate over each stream in the tree */
+		for (i = 0; i < iter->stream_tree->nr_leaves; i++) {
+			file_stream = bt_loser_tree_get(iter->stream_tree, i);
+			if (file_stream)
+				save_stream_pos(pos->u.restore, file_stream);
+		}
+		return pos;
+	}
+
 	ret = bt_heap_copy(&iter_heap_copy, iter->stream_heap);
 	if (ret < 0)
 		goto error_heap;
@@ -578,26 +850,7 @@ struct bt_iter_pos *bt_iter_get_pos(struct bt_iter *iter)
 	/* iterate over each stream in the heap */
 	file_stream = bt_heap_maximum(&iter_heap_copy);
 	while (file_stream != NULL) {
-		struct stream_saved_pos saved_pos;
-
-		assert(file_stream->pos.last_offset != LAST_OFFSET_POISON);
-		saved_pos.offset = file_stream->pos.last_offset;
-		saved_pos.file_stream = file_stream;
-		saved_pos.cur_index = file_stream->pos.cur_index;
-
-		saved_pos.current_real_timestamp = file_stream->parent.real_timestamp;
-		saved_pos.current_cycles_timestamp = file_stream->parent.cycles_timestamp;
-
-		g_array_append_val(
-				pos->u.restore->stream_saved_pos,
-				saved_pos);
-
-		printf_debug("stream : %" PRIu64 ", cur_index : %zd, "
-				"offset : %zd, "
-				"timestamp = %" PRIu64 "\n",
-				file_stream->parent.stream_id,
-				saved_pos.cur_index, saved_pos.offset,
-				saved_pos.current_real_timestamp);
+		save_stream_pos(pos->u.restore, file_stream);
 
 		/* remove the stream from the heap copy */
 		removed = bt_heap_remove(&iter_heap_copy);
@@ -664,7 +917,7 @@ static int babeltrace_filestream_seek(struct ctf_file_stream *file_stream,
 	return ret;
 }
 
-int bt_iter_add_trace(struct bt_iter *iter,
+static int iter_add_trace(struct bt_iter *iter,
 		struct bt_trace_descriptor *td_read)
 {
 	struct ctf_trace *tin;
@@ -702,7 +955,7 @@ int bt_iter_add_trace(struct bt_iter *iter,
 				goto error;
 			}
 			/* Add to heap */
-			ret = bt_heap_insert(iter->stream_heap, file_stream);
+			ret = merge_insert(iter, file_stream);
 			if (ret)
 				goto error;
 		}
@@ -712,10 +965,22 @@ error:
 	return ret;
 }
 
+int bt_iter_add_trace(struct bt_iter *iter,
+		struct bt_trace_descriptor *td_read)
+{
+	/*
+	 * The streams already merged keep their relative order, so
+	 * they do not need to be merged again.
+	 */
+	rank_streams(iter->ctx->tc);
+	return iter_add_trace(iter, td_read);
+}
+
 int bt_iter_init(struct bt_iter *iter,
 		struct bt_context *ctx,
 		const struct bt_iter_pos *begin_pos,
-		const struct bt_iter_pos *end_pos)
+		const struct bt_iter_pos *end_pos,
+		enum bt_iter_merge merge)
 {
 	int i;
 	int ret = 0;
@@ -728,22 +993,29 @@ int bt_iter_init(struct bt_iter *iter,
 		goto error_ctx;
 	}
 
-	iter->stream_heap = g_new(struct ptr_heap, 1);
+	iter->merge = merge;
+	iter->stream_heap = NULL;
+	iter->stream_tree = NULL;
+	if (merge == BT_ITER_MERGE_LOSER_TREE)
+		iter->stream_tree = g_new(struct loser_tree, 1);
+	else
+		iter->stream_heap = g_new(struct ptr_heap, 1);
 	iter->end_pos = end_pos;
 	bt_context_get(ctx);
 	iter->ctx = ctx;
 
-	ret = bt_heap_init(iter->stream_heap, 0, stream_compare);
+	ret = merge_init(iter);
 	if (ret < 0)
 		goto error_heap_init;
 
+	rank_streams(ctx->tc);
 	for (i = 0; i < ctx->tc->array->len; i++) {
 		struct bt_trace_descriptor *td_read;
 
 		td_read = g_ptr_array_index(ctx->tc->array, i);
 		if (!td_read)
 			continue;
-		ret = bt_iter_add_trace(iter, td_read);
+		ret = iter_add_trace(iter, td_read);
 		if (ret < 0)
 			goto error;
 	}
@@ -756,10 +1028,12 @@ int bt_iter_init(struct bt_iter *iter,
 	return ret;
 
 error:
-	bt_heap_free(iter->stream_heap);
+	merge_free(iter);
 error_heap_init:
 	g_free(iter->stream_heap);
+	g_free(iter->stream_tree);
 	iter->stream_heap = NULL;
+	iter->stream_tree = NULL;
 error_ctx:
 	return ret;
 }
@@ -775,7 +1049,7 @@ struct bt_iter *bt_iter_create(struct bt_context *ctx,
 		return NULL;
 
 	iter = g_new0(struct bt_iter, 1);
-	ret = bt_iter_init(iter, ctx, begin_pos, end_pos);
+	ret = bt_iter_init(iter, ctx, begin_pos, end_pos, BT_ITER_MERGE_HEAP);
 	if (ret) {
 		g_free(iter);
 		return NULL;
@@ -786,9 +1060,10 @@ struct bt_iter *bt_iter_create(struct bt_context *ctx,
 void bt_iter_fini(struct bt_iter *iter)
 {
 	assert(iter);
-	if (iter->stream_heap) {
-		bt_heap_free(iter->stream_heap);
+	if (iter->stream_heap || iter->stream_tree) {
+		merge_free(iter);
 		g_free(iter->stream_heap);
+		g_free(iter->stream_tree);
 	}
 	iter->ctx->current_iterator = NULL;
 	bt_context_put(iter->ctx);
@@ -809,7 +1084,7 @@ int bt_iter_next(struct bt_iter *iter)
 	if (!iter)
 		return -EINVAL;
 
-	file_stream = bt_heap_maximum(iter->stream_heap);
+	file_stream = bt_iter_current_stream(iter);
 	if (!file_stream) {
 		/* end of file for all streams */
 		ret = 0;
@@ -818,7 +1093,8 @@ int bt_iter_next(struct bt_iter *iter)
 
 	ret = stream_read_event(file_stream);
 	if (ret == EOF) {
-		removed = bt_heap_remove(iter->stream_heap);
+		iter->run_bound = 0;
+		removed = merge_remove_current(iter);
 		assert(removed == file_stream);
 		ret = 0;
 		goto end;
@@ -841,10 +1117,26 @@ int bt_iter_next(struct bt_iter *iter)
 		goto end;
 	}
 
+	/*
+	 * The other streams did not move: the stream remains the
+	 * current one while it is before all of them, typically up to
+	 * the end of a packet which does not overlap the packets of the
+	 * other streams.
+	 */
+	if (file_stream->parent.real_timestamp < iter->run_bound)
+		goto end;
+
 reinsert:
 	/* Reinsert the file stream into the heap, and rebalance. */
-	removed = bt_heap_replace_max(iter->stream_heap, file_stream);
-	assert(removed == file_stream);
+	merge_update_current(iter, file_stream);
+	/*
+	 * When the stream is still the current one, it may be at the
+	 * beginning of a run: find out how far it goes.
+	 */
+	if (bt_iter_current_stream(iter) == file_stream)
+		iter->run_bound = merge_next_timestamp(iter);
+	else
+		iter->run_bound = 0;
 end:
 	return ret;
 }
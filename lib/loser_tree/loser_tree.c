@@ -0,0 +1,244 @@
+/*
+ * loser_tree.c
+ *
+ * Tournament tree of losers merging pointers by 64-bit key. Based on
+ * Knuth, TAOCP vol. 3, section 5.4.1.
+ *
+ * Copyright 2015 EfficiOS Inc. and Linux Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/loser_tree.h>
+#include <babeltrace/babeltrace-internal.h>
+#include <glib.h>
+#include <errno.h>
+#include <assert.h>
+
+static
+void set_empty(struct loser_tree_leaf *leaf)
+{
+	leaf->key = UINT64_MAX;
+	leaf->ptr = NULL;
+}
+
+/*
+ * Empty leaves have the largest rank, so that they lose against any
+ * element, even one of key UINT64_MAX.
+ */
+static inline
+int before(const struct loser_tree_node *a, const struct loser_tree_node *b)
+{
+	return a->key < b->key || (a->key == b->key && a->rank < b->rank);
+}
+
+/*
+ * Play the matches from a leaf up to the root: the loser stays in the
+ * node, the winner moves on.
+ */
+static inline
+void replay(struct loser_tree *tree, struct loser_tree_node winner)
+{
+	struct loser_tree_node *nodes = tree->nodes;
+	size_t node;
+
+	for (node = (tree->width + winner.leaf) >> 1; node; node >>= 1) {
+		if (before(&nodes[node], &winner)) {
+			struct loser_tree_node loser = nodes[node];
+
+			nodes[node] = winner;
+			winner = loser;
+		}
+	}
+	nodes[0] = winner;
+}
+
+static
+int tree_grow(struct loser_tree *tree, size_t new_len)
+{
+	size_t alloc_len = MAX(tree->alloc_len, (size_t) 1), i;
+	struct loser_tree_leaf *leaves;
+	struct loser_tree_node *nodes, *winners;
+
+	if (likely(alloc_len >= new_len && tree->leaves))
+		return 0;
+	while (alloc_len < new_len)
+		alloc_len <<= 1;
+	/* Leaf indexes and ranks are 32-bit */
+	if (alloc_len > UINT32_MAX)
+		return -ENOMEM;
+	leaves = g_try_renew(struct loser_tree_leaf, tree->leaves, alloc_len);
+	if (!leaves)
+		return -ENOMEM;
+	tree->leaves = leaves;
+	nodes = g_try_renew(struct loser_tree_node, tree->nodes, alloc_len);
+	if (!nodes)
+		return -ENOMEM;
+	tree->nodes = nodes;
+	winners = g_try_renew(struct loser_tree_node, tree->winners,
+			2 * alloc_len);
+	if (!winners)
+		return -ENOMEM;
+	tree->winners = winners;
+	for (i = tree->alloc_len; i < alloc_len; i++)
+		set_empty(&tree->leaves[i]);
+	tree->alloc_len = alloc_len;
+	return 0;
+}
+
+int bt_loser_tree_init(struct loser_tree *tree, size_t alloc_len,
+		int tie_break(void *a, void *b))
+{
+	tree->len = 0;
+	tree->nr_leaves = 0;
+	tree->alloc_len = 0;
+	tree->leaves = NULL;
+	tree->nodes = NULL;
+	tree->winners = NULL;
+	tree->tie_break = tie_break;
+	/*
+	 * Minimum size allocated is 1 leaf so that an empty tree has
+	 * a winner node.
+	 */
+	if (tree_grow(tree, MAX(alloc_len, (size_t) 1)))
+		return -ENOMEM;
+	bt_loser_tree_rebuild(tree);
+	return 0;
+}
+
+void bt_loser_tree_free(struct loser_tree *tree)
+{
+	g_free(tree->leaves);
+	g_free(tree->nodes);
+	g_free(tree->winners);
+}
+
+int bt_loser_tree_insert(struct loser_tree *tree, void *p, uint64_t key)
+{
+	struct loser_tree_leaf *leaf;
+
+	if (tree_grow(tree, tree->nr_leaves + 1))
+		return -ENOMEM;
+	leaf = &tree->leaves[tree->nr_leaves++];
+	leaf->key = key;
+	leaf->ptr = p;
+	tree->len++;
+	tree->dirty = 1;
+	return 0;
+}
+
+static
+gint compare_leaves(gconstpointer a, gconstpointer b, gpointer data)
+{
+	const struct loser_tree_leaf *la = a, *lb = b;
+	struct loser_tree *tree = data;
+
+	return tree->tie_break(la->ptr, lb->ptr);
+}
+
+void bt_loser_tree_rebuild(struct loser_tree *tree)
+{
+	struct loser_tree_node *nodes = tree->nodes, *winners = tree->winners;
+	size_t i, len, width;
+
+	/* Drop the emptied leaves */
+	for (i = 0, len = 0; i < tree->nr_leaves; i++) {
+		if (tree->leaves[i].ptr)
+			tree->leaves[len++] = tree->leaves[i];
+	}
+	assert(len == tree->len);
+	tree->nr_leaves = len;
+
+	/*
+	 * Sort the elements in tie-break order (stable sort): the rank
+	 * of an element is then the index of its leaf.
+	 */
+	g_qsort_with_data(tree->leaves, len, sizeof(struct loser_tree_leaf),
+			compare_leaves, tree);
+
+	for (width = 1; width < len; width <<= 1)
+		;
+	for (i = len; i < width; i++)
+		set_empty(&tree->leaves[i]);
+	tree->width = width;
+
+	/* Play all the matches, bottom-up */
+	for (i = 0; i < width; i++) {
+		winners[width + i].key = tree->leaves[i].key;
+		winners[width + i].rank = i < len ? i : UINT32_MAX;
+		winners[width + i].leaf = i;
+	}
+	for (i = width - 1; i > 0; i--) {
+		struct loser_tree_node *l = &winners[2 * i],
+			*r = &winners[2 * i + 1];
+
+		if (before(r, l)) {
+			winners[i] = *r;
+			nodes[i] = *l;
+		} else {
+			winners[i] = *l;
+			nodes[i] = *r;
+		}
+	}
+	nodes[0] = winners[1];
+	tree->dirty = 0;
+}
+
+void *bt_loser_tree_remove(struct loser_tree *tree)
+{
+	struct loser_tree_node winner;
+	void *p;
+
+	if (unlikely(tree->dirty))
+		bt_loser_tree_rebuild(tree);
+	if (unlikely(!tree->len))
+		return NULL;
+	winner = tree->nodes[0];
+	p = tree->leaves[winner.leaf].ptr;
+	set_empty(&tree->leaves[winner.leaf]);
+	tree->len--;
+	winner.key = UINT64_MAX;
+	winner.rank = UINT32_MAX;
+	replay(tree, winner);
+	return p;
+}
+
+void bt_loser_tree_update_winner(struct loser_tree *tree, uint64_t key)
+{
+	struct loser_tree_node winner;
+
+	assert(!tree->dirty && tree->len);
+	winner = tree->nodes[0];
+	winner.key = key;
+	tree->leaves[winner.leaf].key = key;
+	replay(tree, winner);
+}
+
+uint64_t bt_loser_tree_runner_up_key(struct loser_tree *tree)
+{
+	uint64_t key = UINT64_MAX;
+	size_t node;
+
+	if (unlikely(tree->dirty))
+		bt_loser_tree_rebuild(tree);
+	for (node = (tree->width + tree->nodes[0].leaf) >> 1; node;
+			node >>= 1)
+		key = MIN(key, tree->nodes[node].key);
+	return key;
+}
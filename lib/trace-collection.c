@@ -137,6 +137,26 @@ static void clock_add(gpointer key, gpointer value, gpointer user_data)
 	}
 }
 
+/*
+ * Resolve the clock offset applied to the timestamps of each trace of the
+ * collection, which changes as traces are added.
+ */
+static void resolve_clock_offsets(struct trace_collection *tc)
+{
+	unsigned int i;
+
+	for (i = 0; i < tc->array->len; i++) {
+		struct bt_trace_descriptor *td = g_ptr_array_index(tc->array, i);
+
+		if (tc->clock_use_offset_avg)
+			td->offset_ns = tc->single_clock_offset_avg;
+		else if (td->single_clock)
+			td->offset_ns = clock_offset_ns(td->single_clock);
+		else
+			td->offset_ns = 0;
+	}
+}
+
 /*
  * Whenever we add a trace to the trace collection, check that we can
  * correlate this trace with at least one other clock in the trace and
@@ -189,6 +209,7 @@ int bt_trace_collection_add(struct trace_collection *tc,
 				clock_add,
 				&clock_match);
 	}
+	resolve_clock_offsets(tc);
 
 	return 0;
 error:
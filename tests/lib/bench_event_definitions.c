@@ -0,0 +1,258 @@
+/*
+ * bench_event_definitions.c
+ *
+ * BabelTrace - measure the memory used by the stream and event
+ * definitions of a trace with many event classes and streams, where
+ * each stream only holds events of a few classes.
+ *
+ * usage: bench_event_definitions [EVENT_CLASSES [STREAMS]]
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <babeltrace/ctf-writer/writer.h>
+#include <babeltrace/ctf-writer/clock.h>
+#include <babeltrace/ctf-writer/stream.h>
+#include <babeltrace/ctf-writer/event.h>
+#include <babeltrace/ctf-writer/event-types.h>
+#include <babeltrace/ctf-writer/event-fields.h>
+#include <babeltrace/context.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/babeltrace-internal.h>	/* For symbol side-effects */
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define DEFAULT_NR_EVENT_CLASSES	2000
+#define DEFAULT_NR_STREAMS		512
+#define CLASSES_PER_STREAM		8	/* Event classes found in a stream */
+#define EVENTS_PER_CLASS		16
+
+static const char *field_names[] = { "a", "b", "c", "d" };
+
+static
+int write_events(struct bt_ctf_stream *stream, struct bt_ctf_clock *clock,
+		struct bt_ctf_event_class *event_class,
+		struct bt_ctf_field_type *uint_type,
+		struct bt_ctf_field_type *string_type, uint64_t *time)
+{
+	unsigned int i, j;
+	int ret = 0;
+
+	for (i = 0; i < EVENTS_PER_CLASS && !ret; i++) {
+		struct bt_ctf_event *event;
+		struct bt_ctf_field *field;
+
+		event = bt_ctf_event_create(event_class);
+		if (!event)
+			return -1;
+		for (j = 0; j < sizeof(field_names) / sizeof(field_names[0]); j++) {
+			field = bt_ctf_field_create(uint_type);
+			ret |= bt_ctf_field_unsigned_integer_set_value(field, i + j);
+			ret |= bt_ctf_event_set_payload(event, field_names[j],
+				field);
+			bt_ctf_field_put(field);
+		}
+		field = bt_ctf_field_create(string_type);
+		ret |= bt_ctf_field_string_set_value(field, "payload");
+		ret |= bt_ctf_event_set_payload(event, "s", field);
+		bt_ctf_field_put(field);
+		ret |= bt_ctf_clock_set_time(clock, ++(*time));
+		ret |= bt_ctf_stream_append_event(stream, event);
+		bt_ctf_event_put(event);
+	}
+	return ret;
+}
+
+/*
+ * Write a trace of nr_streams streams of the same class declaring
+ * nr_classes event classes. Stream i holds events of CLASSES_PER_STREAM
+ * classes, starting at class i * CLASSES_PER_STREAM.
+ */
+static
+int write_trace(const char *path, unsigned int nr_classes,
+		unsigned int nr_streams)
+{
+	struct bt_ctf_writer *writer;
+	struct bt_ctf_clock *clock;
+	struct bt_ctf_stream_class *stream_class;
+	struct bt_ctf_field_type *uint_type, *string_type;
+	struct bt_ctf_event_class **event_classes;
+	uint64_t time = 0;
+	unsigned int i, j;
+	int ret = 0;
+
+	writer = bt_ctf_writer_create(path);
+	clock = bt_ctf_clock_create("bench_clock");
+	stream_class = bt_ctf_stream_class_create("bench_stream");
+	uint_type = bt_ctf_field_type_integer_create(32);
+	string_type = bt_ctf_field_type_string_create();
+	event_classes = calloc(nr_classes, sizeof(*event_classes));
+	if (!writer || !clock || !stream_class || !uint_type
+			|| !string_type || !event_classes)
+		return -1;
+	ret |= bt_ctf_writer_add_clock(writer, clock);
+	ret |= bt_ctf_stream_class_set_clock(stream_class, clock);
+	for (i = 0; i < nr_classes && !ret; i++) {
+		char name[32];
+
+		snprintf(name, sizeof(name), "event_%u", i);
+		event_classes[i] = bt_ctf_event_class_create(name);
+		if (!event_classes[i])
+			return -1;
+		for (j = 0; j < sizeof(field_names) / sizeof(field_names[0]); j++)
+			ret |= bt_ctf_event_class_add_field(event_classes[i],
+				uint_type, field_names[j]);
+		ret |= bt_ctf_event_class_add_field(event_classes[i],
+			string_type, "s");
+		ret |= bt_ctf_stream_class_add_event_class(stream_class,
+			event_classes[i]);
+	}
+	for (i = 0; i < nr_streams && !ret; i++) {
+		struct bt_ctf_stream *stream;
+
+		stream = bt_ctf_writer_create_stream(writer, stream_class);
+		if (!stream)
+			return -1;
+		for (j = 0; j < CLASSES_PER_STREAM && !ret; j++) {
+			unsigned int id = (i * CLASSES_PER_STREAM + j) % nr_classes;
+
+			ret = write_events(stream, clock, event_classes[id],
+				uint_type, string_type, &time);
+		}
+		ret |= bt_ctf_stream_flush(stream);
+		bt_ctf_stream_put(stream);
+	}
+	bt_ctf_writer_flush_metadata(writer);
+
+	for (i = 0; i < nr_classes; i++) {
+		if (event_classes[i])
+			bt_ctf_event_class_put(event_classes[i]);
+	}
+	free(event_classes);
+	bt_ctf_field_type_put(uint_type);
+	bt_ctf_field_type_put(string_type);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	return ret;
+}
+
+/* Resident set size, in KiB. */
+static
+long rss_kib(void)
+{
+	FILE *fp;
+	long size, resident;
+
+	fp = fopen("/proc/self/statm", "r");
+	if (!fp)
+		return -1;
+	if (fscanf(fp, "%ld %ld", &size, &resident) != 2)
+		resident = -1;
+	fclose(fp);
+	if (resident < 0)
+		return -1;
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static
+int remove_entry(const char *path, const struct stat *sb, int type,
+		struct FTW *ftwbuf)
+{
+	return remove(path);
+}
+
+int main(int argc, char **argv)
+{
+	char trace_path[] = "/tmp/bench_definitions_XXXXXX";
+	unsigned int nr_classes = DEFAULT_NR_EVENT_CLASSES;
+	unsigned int nr_streams = DEFAULT_NR_STREAMS;
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	unsigned long nr_events = 0;
+	long rss_begin, rss_open, rss_read;
+	int status, ret = EXIT_FAILURE;
+	pid_t pid;
+
+	if (argc > 1)
+		nr_classes = strtoul(argv[1], NULL, 0);
+	if (argc > 2)
+		nr_streams = strtoul(argv[2], NULL, 0);
+	if (!nr_classes || !nr_streams || argc > 3) {
+		fprintf(stderr, "usage: %s [EVENT_CLASSES [STREAMS]]\n",
+			argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (!mkdtemp(trace_path)) {
+		perror("mkdtemp");
+		return EXIT_FAILURE;
+	}
+
+	/* Keep the memory of the writer out of the measure. */
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		goto end;
+	}
+	if (!pid)
+		_exit(write_trace(trace_path, nr_classes, nr_streams) ?
+			EXIT_FAILURE : EXIT_SUCCESS);
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)
+			|| WEXITSTATUS(status)) {
+		fprintf(stderr, "Unable to write trace %s\n", trace_path);
+		goto end;
+	}
+
+	rss_begin = rss_kib();
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, trace_path, "ctf", NULL,
+			NULL, NULL) < 0) {
+		fprintf(stderr, "Unable to open trace %s\n", trace_path);
+		goto end;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		fprintf(stderr, "Unable to create iterator\n");
+		goto end;
+	}
+	rss_open = rss_kib();
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		nr_events++;
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0)
+			break;
+	}
+	rss_read = rss_kib();
+	bt_ctf_iter_destroy(iter);
+	bt_context_put(ctx);
+
+	printf("%u event classes, %u streams, %lu events\n", nr_classes,
+		nr_streams, nr_events);
+	printf("%-24s %10ld KiB\n", "open and iterator:", rss_open - rss_begin);
+	printf("%-24s %10ld KiB\n", "after reading:", rss_read - rss_begin);
+	ret = EXIT_SUCCESS;
+end:
+	(void) nftw(trace_path, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+	return ret;
+}
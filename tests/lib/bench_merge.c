@@ -0,0 +1,191 @@
+/*
+ * bench_merge.c
+ *
+ * BabelTrace - compare the binary heap and the loser tree merging
+ * streams by timestamp, as bt_iter_next() does.
+ *
+ * usage: bench_merge [EVENTS]
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <babeltrace/prio_heap.h>
+#include <babeltrace/loser_tree.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_NR_EVENTS	(1UL << 22)
+#define NR_STEPS		4096	/* power of 2 */
+
+static const unsigned int nr_streams[] = { 8, 64, 1024, 8192 };
+
+/* The fields of a file stream the merge looks at. */
+struct stream {
+	uint64_t real_timestamp;
+	uint64_t rank;
+};
+
+static uint64_t rand_state = 42;
+
+/* Timestamp increments, drawn before the measure. */
+static uint64_t steps[NR_STEPS];
+
+static
+uint64_t next_rand(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+	return rand_state;
+}
+
+/* Same as stream_compare() in lib/iterator.c */
+static
+int stream_compare(void *a, void *b)
+{
+	struct stream *s_a = a, *s_b = b;
+
+#ifdef __SIZEOF_INT128__
+	return (((unsigned __int128) s_a->real_timestamp << 64) | s_a->rank)
+		< (((unsigned __int128) s_b->real_timestamp << 64) | s_b->rank);
+#else
+	if (s_a->real_timestamp < s_b->real_timestamp)
+		return 1;
+	else if (s_a->real_timestamp > s_b->real_timestamp)
+		return 0;
+	else
+		return s_a->rank < s_b->rank;
+#endif
+}
+
+static
+int stream_tie_break(void *a, void *b)
+{
+	struct stream *s_a = a, *s_b = b;
+
+	if (s_a->rank < s_b->rank)
+		return -1;
+	return s_a->rank > s_b->rank;
+}
+
+static
+struct stream *create_streams(unsigned int n)
+{
+	struct stream *streams;
+	unsigned int i;
+
+	streams = calloc(n, sizeof(*streams));
+	if (!streams)
+		return NULL;
+	rand_state = 42;
+	for (i = 0; i < NR_STEPS; i++)
+		steps[i] = 1 + next_rand() % (1000 * n);
+	for (i = 0; i < n; i++) {
+		streams[i].real_timestamp = next_rand() % 1000000;
+		streams[i].rank = i;
+	}
+	return streams;
+}
+
+static
+double elapsed_ns(const struct timespec *begin, const struct timespec *end)
+{
+	return (end->tv_sec - begin->tv_sec) * 1e9
+		+ (end->tv_nsec - begin->tv_nsec);
+}
+
+/* Return the time per event, in ns, or a negative value on error. */
+static
+double bench_heap(unsigned int n, unsigned long nr_events)
+{
+	struct ptr_heap heap;
+	struct stream *streams, *s;
+	struct timespec begin, end;
+	unsigned long i;
+
+	streams = create_streams(n);
+	if (!streams || bt_heap_init(&heap, n, stream_compare))
+		return -1;
+	for (i = 0; i < n; i++)
+		bt_heap_insert(&heap, &streams[i]);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < nr_events; i++) {
+		s = bt_heap_maximum(&heap);
+		s->real_timestamp += steps[i & (NR_STEPS - 1)];
+		bt_heap_replace_max(&heap, s);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	bt_heap_free(&heap);
+	free(streams);
+	return elapsed_ns(&begin, &end) / nr_events;
+}
+
+static
+double bench_loser_tree(unsigned int n, unsigned long nr_events)
+{
+	struct loser_tree tree;
+	struct stream *streams, *s;
+	struct timespec begin, end;
+	unsigned long i;
+
+	streams = create_streams(n);
+	if (!streams || bt_loser_tree_init(&tree, n, stream_tie_break))
+		return -1;
+	for (i = 0; i < n; i++)
+		bt_loser_tree_insert(&tree, &streams[i],
+			streams[i].real_timestamp);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < nr_events; i++) {
+		s = bt_loser_tree_winner(&tree);
+		s->real_timestamp += steps[i & (NR_STEPS - 1)];
+		bt_loser_tree_update_winner(&tree, s->real_timestamp);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	bt_loser_tree_free(&tree);
+	free(streams);
+	return elapsed_ns(&begin, &end) / nr_events;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long nr_events = DEFAULT_NR_EVENTS;
+	unsigned int i;
+
+	if (argc > 1)
+		nr_events = strtoul(argv[1], NULL, 0);
+	if (!nr_events) {
+		fprintf(stderr, "usage: %s [EVENTS]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	printf("%8s %14s %14s %8s\n", "streams", "heap ns/ev",
+		"tree ns/ev", "speedup");
+	for (i = 0; i < sizeof(nr_streams) / sizeof(nr_streams[0]); i++) {
+		double heap, tree;
+
+		heap = bench_heap(nr_streams[i], nr_events);
+		tree = bench_loser_tree(nr_streams[i], nr_events);
+		if (heap < 0 || tree < 0) {
+			fprintf(stderr, "Out of memory\n");
+			return EXIT_FAILURE;
+		}
+		printf("%8u %14.1f %14.1f %7.2fx\n", nr_streams[i], heap,
+			tree, heap / tree);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,178 @@
+/*
+ * test_clock_conversion.c
+ *
+ * BabelTrace - clock cycles to nanoseconds conversion test program
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <babeltrace/ctf-ir/metadata.h>
+#include <babeltrace/clock-internal.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <tap/tap.h>
+
+#define NR_TESTS	4
+#define NR_RANDOM	100000
+
+static const uint64_t freqs[] = {
+	1ULL,
+	1000ULL,
+	32768ULL,
+	1000000ULL,
+	19200000ULL,		/* ARM architected timer */
+	999999999ULL,
+	1000000000ULL,
+	1000000007ULL,
+	2400000000ULL,		/* TSC */
+	3579545ULL,		/* ACPI PM timer */
+	4000000001ULL,
+	1ULL << 40,
+	UINT64_MAX,
+};
+
+#ifdef __SIZEOF_INT128__
+
+static uint64_t rand_state = 42;
+
+/* Deterministic 64-bit random values (xorshift64). */
+static
+uint64_t next_rand(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+	return rand_state;
+}
+
+/* floor(cycles * 1e9 / freq), truncated to 64 bits. */
+static
+uint64_t reference_ns(uint64_t freq, uint64_t cycles)
+{
+	return (unsigned __int128) cycles * 1000000000ULL / freq;
+}
+
+/* Conversion as it was done before the precomputed multiplier. */
+static
+uint64_t double_ns(uint64_t freq, uint64_t cycles)
+{
+	if (freq == 1000000000ULL)
+		return cycles;
+	return (double) cycles * 1000000000.0 / (double) freq;
+}
+
+/*
+ * Check one value, counting mismatches with the exact result and, while
+ * the result is small enough for a double to hold it to the nanosecond,
+ * differences of more than 1 ns with the floating point conversion.
+ */
+static
+void check_value(struct ctf_clock *clock, uint64_t cycles,
+		unsigned int *nr_exact_errors, unsigned int *nr_double_errors,
+		unsigned int *nr_double_checks)
+{
+	uint64_t ns = clock_cycles_to_ns(clock, cycles);
+	uint64_t ref = reference_ns(clock->freq, cycles);
+
+	if (ns != ref) {
+		if (!*nr_exact_errors)
+			diag("freq %" PRIu64 " cycles %" PRIu64 ": got %" PRIu64
+				", expected %" PRIu64, clock->freq, cycles,
+				ns, ref);
+		(*nr_exact_errors)++;
+	}
+	if ((unsigned __int128) cycles * 1000000000ULL / clock->freq
+			< (1ULL << 52)) {
+		uint64_t dns = double_ns(clock->freq, cycles);
+
+		(*nr_double_checks)++;
+		if (ns > dns + 1 || dns > ns + 1)
+			(*nr_double_errors)++;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int nr_exact_errors = 0, nr_double_errors = 0;
+	unsigned int nr_double_checks = 0, nr_slow = 0;
+	unsigned int i, j;
+
+	plan_tests(NR_TESTS);
+
+	for (i = 0; i < sizeof(freqs) / sizeof(freqs[0]); i++) {
+		struct ctf_clock clock = { 0 };
+		const uint64_t edges[] = {
+			0, 1, 2, freqs[i] - 1, freqs[i], freqs[i] + 1,
+			(1ULL << 32) - 1, 1ULL << 32,
+			(1ULL << 53) - 1, 1ULL << 53, (1ULL << 53) + 1,
+			UINT64_MAX - 1, UINT64_MAX,
+		};
+
+		clock.freq = freqs[i];
+		clock_init_conversion(&clock);
+		for (j = 0; j < sizeof(edges) / sizeof(edges[0]); j++)
+			check_value(&clock, edges[j], &nr_exact_errors,
+				&nr_double_errors, &nr_double_checks);
+		/* Both sides of the exact multiplier range. */
+		if (clock.max_cycles != UINT64_MAX) {
+			nr_slow++;
+			check_value(&clock, clock.max_cycles, &nr_exact_errors,
+				&nr_double_errors, &nr_double_checks);
+			check_value(&clock, clock.max_cycles + 1,
+				&nr_exact_errors, &nr_double_errors,
+				&nr_double_checks);
+		}
+		for (j = 0; j < NR_RANDOM; j++) {
+			uint64_t cycles = next_rand();
+
+			/* Cover small magnitudes as well as large ones. */
+			cycles >>= next_rand() % 64;
+			check_value(&clock, cycles, &nr_exact_errors,
+				&nr_double_errors, &nr_double_checks);
+		}
+	}
+	ok(nr_exact_errors == 0,
+		"Conversion matches 128-bit arithmetic (%u errors)",
+		nr_exact_errors);
+	ok(nr_double_checks > 0 && nr_double_errors == 0,
+		"Conversion within 1 ns of floating point arithmetic (%u of %u differ)",
+		nr_double_errors, nr_double_checks);
+	ok(nr_slow > 0, "Division fallback exercised for %u frequencies",
+		nr_slow);
+
+	{
+		struct ctf_clock clock = { 0 };
+
+		clock.freq = 2400000000ULL;
+		clock.offset_s = 1400000000ULL;
+		clock.offset = 1200000000ULL;
+		clock_init_conversion(&clock);
+		ok(clock_offset_ns(&clock) == 1400000000500000000ULL,
+			"Clock offset resolved to the nanosecond");
+	}
+	return exit_status();
+}
+
+#else /* __SIZEOF_INT128__ */
+
+int main(int argc, char **argv)
+{
+	plan_skip_all("No 128-bit integer support");
+	return exit_status();
+}
+
+#endif /* __SIZEOF_INT128__ */
@@ -0,0 +1,252 @@
+/*
+ * test_enum.c
+ *
+ * Lib BabelTrace - Enumeration lookup test program
+ *
+ * Check the labels found through the interval index of enumerations
+ * against a linear search of their mappings, around the boundaries of
+ * overlapping ranges and at the limits of signed and unsigned values.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <babeltrace/types.h>
+#include <babeltrace/babeltrace-internal.h>	/* For symbol side-effects */
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <endian.h>
+#include <glib.h>
+
+#include <tap/tap.h>
+
+#define NR_TESTS	5
+
+struct mapping {
+	const char *label;
+	uint64_t start, end;	/* signed values as two's complement */
+};
+
+static const struct mapping unsigned_mappings[] = {
+	{ "zero", 0, 0 },
+	{ "low", 0, 9 },
+	{ "mid", 5, 15 },
+	{ "five", 5, 5 },
+	{ "five_again", 5, 5 },
+	{ "huge", 1ULL << 63, UINT64_MAX - 1 },
+	{ "top", UINT64_MAX - 10, UINT64_MAX },
+	{ "max", UINT64_MAX, UINT64_MAX },
+};
+
+static const struct mapping signed_mappings[] = {
+	{ "min", (uint64_t) INT64_MIN, (uint64_t) INT64_MIN },
+	{ "negative", (uint64_t) INT64_MIN, (uint64_t) -1LL },
+	{ "minus_one", (uint64_t) -1LL, (uint64_t) -1LL },
+	{ "around_zero", (uint64_t) -5LL, 5 },
+	{ "positive", 0, INT64_MAX },
+	{ "max", INT64_MAX, INT64_MAX },
+};
+
+/* Unmapped values between and around the ranges */
+static const struct mapping sparse_mappings[] = {
+	{ "a", (uint64_t) -10LL, (uint64_t) -3LL },
+	{ "b", 3, 10 },
+	{ "c", 20, 20 },
+};
+
+static
+int contains(const struct mapping *mapping, uint64_t v, int signedness)
+{
+	if (signedness)
+		return (int64_t) mapping->start <= (int64_t) v
+			&& (int64_t) v <= (int64_t) mapping->end;
+	return mapping->start <= v && v <= mapping->end;
+}
+
+static
+gint compare_quarks(gconstpointer a, gconstpointer b)
+{
+	GQuark qa = *(const GQuark *) a, qb = *(const GQuark *) b;
+
+	if (qa < qb)
+		return -1;
+	return qa > qb;
+}
+
+static
+struct declaration_enum *create_enum(const struct mapping *mappings,
+		unsigned int nr_mappings, int signedness)
+{
+	struct declaration_integer *integer_declaration;
+	struct declaration_enum *enum_declaration;
+	unsigned int i;
+
+	integer_declaration = bt_integer_declaration_new(64, BYTE_ORDER,
+		signedness, 8, 10, CTF_STRING_NONE, NULL);
+	enum_declaration = bt_enum_declaration_new(integer_declaration);
+	bt_declaration_unref(&integer_declaration->p);
+	for (i = 0; i < nr_mappings; i++) {
+		GQuark q = g_quark_from_static_string(mappings[i].label);
+
+		if (signedness)
+			bt_enum_signed_insert(enum_declaration,
+				(int64_t) mappings[i].start,
+				(int64_t) mappings[i].end, q);
+		else
+			bt_enum_unsigned_insert(enum_declaration,
+				mappings[i].start, mappings[i].end, q);
+	}
+	return enum_declaration;
+}
+
+/*
+ * Compare the labels of value v with those of the mappings holding it,
+ * as sets. Returns 0 if they match.
+ */
+static
+int check_value(const struct declaration_enum *enum_declaration,
+		const struct mapping *mappings, unsigned int nr_mappings,
+		int signedness, uint64_t v)
+{
+	GArray *expected, *found;
+	unsigned int i;
+	int interval, ret = 0;
+
+	expected = g_array_new(FALSE, FALSE, sizeof(GQuark));
+	for (i = 0; i < nr_mappings; i++) {
+		if (contains(&mappings[i], v, signedness)) {
+			GQuark q = g_quark_from_static_string(mappings[i].label);
+
+			g_array_append_val(expected, q);
+		}
+	}
+	if (signedness)
+		found = bt_enum_int_to_quark_set(enum_declaration, (int64_t) v);
+	else
+		found = bt_enum_uint_to_quark_set(enum_declaration, v);
+	interval = bt_enum_value_to_interval(enum_declaration, v);
+
+	if (!found) {
+		ret = expected->len != 0 || interval >= 0;
+	} else {
+		GArray *sorted;
+
+		sorted = g_array_sized_new(FALSE, FALSE, sizeof(GQuark),
+			found->len);
+		g_array_append_vals(sorted, found->data, found->len);
+		g_array_sort(sorted, compare_quarks);
+		g_array_sort(expected, compare_quarks);
+		ret = interval < 0 || sorted->len != expected->len
+			|| memcmp(sorted->data, expected->data,
+				sorted->len * sizeof(GQuark));
+		g_array_free(sorted, TRUE);
+		g_array_unref(found);
+	}
+	if (ret)
+		diag("Value %" PRIu64 " (%" PRId64 "): %u labels expected",
+			v, (int64_t) v, expected->len);
+	g_array_free(expected, TRUE);
+	return ret;
+}
+
+/*
+ * Check the values around the boundaries of each mapping, and at the
+ * limits of the value range. Returns the number of mismatches.
+ */
+static
+unsigned int check_enum(const struct declaration_enum *enum_declaration,
+		const struct mapping *mappings, unsigned int nr_mappings,
+		int signedness)
+{
+	static const uint64_t limits[] = {
+		0, 1, (uint64_t) -1LL, INT64_MAX, (uint64_t) INT64_MIN,
+	};
+	unsigned int i, j, nr_errors = 0;
+
+	for (i = 0; i < nr_mappings; i++) {
+		const uint64_t probes[] = {
+			mappings[i].start - 1, mappings[i].start,
+			mappings[i].start + 1, mappings[i].end - 1,
+			mappings[i].end, mappings[i].end + 1,
+		};
+
+		for (j = 0; j < G_N_ELEMENTS(probes); j++)
+			nr_errors += check_value(enum_declaration, mappings,
+				nr_mappings, signedness, probes[j]);
+	}
+	for (j = 0; j < G_N_ELEMENTS(limits); j++)
+		nr_errors += check_value(enum_declaration, mappings,
+			nr_mappings, signedness, limits[j]);
+	return nr_errors;
+}
+
+static
+void test_mappings(const char *name, const struct mapping *mappings,
+		unsigned int nr_mappings, int signedness)
+{
+	struct declaration_enum *enum_declaration;
+	unsigned int nr_errors;
+
+	enum_declaration = create_enum(mappings, nr_mappings, signedness);
+	nr_errors = check_enum(enum_declaration, mappings, nr_mappings,
+		signedness);
+	ok(nr_errors == 0, "%s: labels match the mappings (%u errors)",
+		name, nr_errors);
+	bt_declaration_unref(&enum_declaration->p);
+}
+
+/* Mappings inserted after a lookup are found by the next lookups. */
+static
+void test_insert_after_lookup(void)
+{
+	struct declaration_enum *enum_declaration;
+	struct mapping mappings[] = {
+		{ "first", 10, 20 },
+		{ "second", 15, 30 },
+	};
+	unsigned int nr_errors;
+
+	enum_declaration = create_enum(mappings, 1, 0);
+	nr_errors = check_enum(enum_declaration, mappings, 1, 0);
+	bt_enum_unsigned_insert(enum_declaration, mappings[1].start,
+		mappings[1].end, g_quark_from_static_string(mappings[1].label));
+	nr_errors += check_enum(enum_declaration, mappings, 2, 0);
+	ok(nr_errors == 0, "Mappings inserted after a lookup (%u errors)",
+		nr_errors);
+	bt_declaration_unref(&enum_declaration->p);
+}
+
+int main(int argc, char **argv)
+{
+	/*
+	 * Side-effects ensuring libs are not optimized away by static
+	 * linking.
+	 */
+	babeltrace_debug = 0;	/* libbabeltrace.la */
+
+	plan_tests(NR_TESTS);
+
+	test_mappings("Overlapping unsigned mappings up to UINT64_MAX",
+		unsigned_mappings, G_N_ELEMENTS(unsigned_mappings), 0);
+	test_mappings("Overlapping signed mappings from INT64_MIN to INT64_MAX",
+		signed_mappings, G_N_ELEMENTS(signed_mappings), 1);
+	test_mappings("Sparse signed mappings", sparse_mappings,
+		G_N_ELEMENTS(sparse_mappings), 1);
+	test_mappings("Sparse unsigned mappings", sparse_mappings,
+		G_N_ELEMENTS(sparse_mappings), 0);
+	test_insert_after_lookup();
+	return exit_status();
+}
@@ -0,0 +1,153 @@
+/*
+ * test_json_string.c
+ *
+ * BabelTrace - JSON string escaping test program
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <babeltrace/json/string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <tap/tap.h>
+
+#define NR_TESTS	3
+#define NR_RANDOM	100000
+#define MAX_LEN		100
+
+static uint64_t rand_state = 42;
+
+/* Deterministic 64-bit random values (xorshift64). */
+static
+uint64_t next_rand(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+	return rand_state;
+}
+
+/* Reference escaping, one byte at a time. */
+static
+size_t escape_ref(char *out, const unsigned char *str, size_t len)
+{
+	size_t i, o = 0;
+
+	out[o++] = '"';
+	for (i = 0; i < len; i++) {
+		switch (str[i]) {
+		case '"':
+			o += sprintf(out + o, "\\\"");
+			break;
+		case '\\':
+			o += sprintf(out + o, "\\\\");
+			break;
+		case '\n':
+			o += sprintf(out + o, "\\n");
+			break;
+		case '\t':
+			o += sprintf(out + o, "\\t");
+			break;
+		case '\r':
+			o += sprintf(out + o, "\\r");
+			break;
+		case '\b':
+			o += sprintf(out + o, "\\b");
+			break;
+		case '\f':
+			o += sprintf(out + o, "\\f");
+			break;
+		default:
+			if (str[i] < 0x20)
+				o += sprintf(out + o, "\\u%04x", str[i]);
+			else
+				out[o++] = str[i];
+		}
+	}
+	out[o++] = '"';
+	return o;
+}
+
+/* Mostly plain text, with the bytes needing escaping now and then. */
+static
+unsigned char next_byte(void)
+{
+	static const char special[] = "\"\\\n\t\r\b\f\x01\x1f\x7f\x80\xff ";
+	uint64_t r = next_rand();
+
+	if (r % 8)
+		return 'a' + (r >> 8) % 26;
+	return special[(r >> 8) % (sizeof(special) - 1)];
+}
+
+static
+int check(struct ctf_text_buffer *buf, const unsigned char *str, size_t len)
+{
+	char ref[6 * MAX_LEN + 2];
+	size_t ref_len;
+
+	buf->len = 0;
+	json_put_string_len(buf, (const char *) str, len);
+	ref_len = escape_ref(ref, str, len);
+	if (buf->len == ref_len && !memcmp(buf->data, ref, ref_len))
+		return 0;
+	diag("got %.*s, expected %.*s", (int) buf->len, buf->data,
+		(int) ref_len, ref);
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	struct ctf_text_buffer buf = { 0 };
+	unsigned char str[MAX_LEN];
+	unsigned int i, nr_errors = 0, nr_bytes = 0;
+	size_t len, j;
+
+	plan_tests(NR_TESTS);
+
+	buf.len = 0;
+	json_put_string(&buf, "plain text, long enough to span words");
+	ok(buf.len == strlen("\"plain text, long enough to span words\"")
+		&& !memcmp(buf.data, "\"plain text, long enough to span words\"",
+			buf.len),
+		"Plain text is only quoted");
+
+	/* Each byte value, at each position within a word. */
+	for (i = 0; i < 256; i++) {
+		for (j = 0; j < 16; j++) {
+			memset(str, 'x', 16);
+			str[j] = i;
+			if (check(&buf, str, 16) && !nr_bytes++)
+				diag("byte 0x%02x at %zu", i, j);
+		}
+	}
+	ok(nr_bytes == 0, "Every byte value is escaped as expected (%u errors)",
+		nr_bytes);
+
+	for (i = 0; i < NR_RANDOM; i++) {
+		len = next_rand() % MAX_LEN;
+		for (j = 0; j < len; j++)
+			str[j] = next_byte();
+		if (check(&buf, str, len) && nr_errors++ > 10)
+			break;
+	}
+	ok(nr_errors == 0, "Random strings are escaped as expected (%u errors)",
+		nr_errors);
+	ctf_text_buffer_free(&buf);
+
+	return exit_status();
+}
@@ -0,0 +1,215 @@
+/*
+ * test_lazy_decode.c
+ *
+ * Lib BabelTrace - Lazy event decoding test program
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#define _GNU_SOURCE
+#include <babeltrace/context.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/babeltrace-internal.h>	/* For symbol side-effects */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include <tap/tap.h>
+#include "common.h"
+
+#define NR_TESTS	8
+
+static
+uint64_t hash_value(uint64_t hash, uint64_t value)
+{
+	/* FNV-1a over the value bytes */
+	int i;
+
+	for (i = 0; i < sizeof(value); i++) {
+		hash ^= (value >> (i * 8)) & 0xFF;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static
+uint64_t hash_scope(const struct bt_ctf_event *event, enum bt_ctf_scope scope,
+		uint64_t hash)
+{
+	const struct bt_definition *top, * const *list;
+	unsigned int count, i;
+
+	top = bt_ctf_get_top_level_scope(event, scope);
+	if (!top)
+		return hash;
+	if (bt_ctf_get_field_list(event, top, &list, &count))
+		return hash;
+	for (i = 0; i < count; i++) {
+		const struct bt_definition *def = list[i];
+		const struct bt_declaration *decl = bt_ctf_get_decl_from_def(def);
+		const char *str;
+
+		switch (bt_ctf_field_type(decl)) {
+		case CTF_TYPE_INTEGER:
+			if (bt_ctf_get_int_signedness(decl))
+				hash = hash_value(hash, bt_ctf_get_int64(def));
+			else
+				hash = hash_value(hash, bt_ctf_get_uint64(def));
+			break;
+		case CTF_TYPE_ENUM:
+			hash = hash_value(hash,
+				bt_ctf_get_uint64(bt_ctf_get_enum_int(def)));
+			break;
+		case CTF_TYPE_FLOAT:
+		{
+			double v = bt_ctf_get_float(def);
+			uint64_t bits;
+
+			memcpy(&bits, &v, sizeof(bits));
+			hash = hash_value(hash, bits);
+			break;
+		}
+		case CTF_TYPE_STRING:
+			str = bt_ctf_get_string(def);
+			while (str && *str)
+				hash = hash_value(hash, *str++);
+			break;
+		default:
+			break;
+		}
+	}
+	return hash;
+}
+
+/*
+ * Iterate on the trace, appending the hash of the fields of each event
+ * to hashes. With zero-copy strings, the strings of every other event
+ * are copied before being hashed. Events are decoded ahead by
+ * decode_threads worker threads, if any. Return 0 on success.
+ */
+static
+int hash_events(const char *path, int lazy, int zero_copy,
+		int decode_threads, GArray *hashes)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	int ret = 0;
+
+	ctx = create_context_with_path(path);
+	if (!ctx)
+		return -1;
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		ret = -1;
+		goto end;
+	}
+	if (bt_ctf_iter_set_lazy_decode(iter, lazy)
+			|| bt_ctf_iter_set_zero_copy_strings(iter, zero_copy)
+			|| bt_ctf_iter_set_decode_threads(iter, decode_threads)) {
+		ret = -1;
+		goto end_iter;
+	}
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		uint64_t hash = 14695981039346656037ULL;
+
+		if (zero_copy && (hashes->len & 1)
+				&& bt_ctf_event_copy_strings(event)) {
+			ret = -1;
+			break;
+		}
+
+		hash = hash_value(hash, bt_ctf_get_timestamp(event));
+		hash = hash_scope(event, BT_STREAM_EVENT_CONTEXT, hash);
+		hash = hash_scope(event, BT_EVENT_CONTEXT, hash);
+		hash = hash_scope(event, BT_EVENT_FIELDS, hash);
+		g_array_append_val(hashes, hash);
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+end_iter:
+	bt_ctf_iter_destroy(iter);
+end:
+	bt_context_put(ctx);
+	return ret;
+}
+
+/*
+ * Compare the fields read with lazy decoding, zero-copy strings and
+ * decode-ahead threads with eager decoding.
+ */
+static
+void test_trace(const char *path)
+{
+	GArray *eager, *lazy, *zero_copy, *ahead;
+
+	eager = g_array_new(FALSE, TRUE, sizeof(uint64_t));
+	lazy = g_array_new(FALSE, TRUE, sizeof(uint64_t));
+	zero_copy = g_array_new(FALSE, TRUE, sizeof(uint64_t));
+	ahead = g_array_new(FALSE, TRUE, sizeof(uint64_t));
+
+	diag("Trace %s", path);
+	ok(hash_events(path, 0, 0, 0, eager) == 0, "Read trace with eager decoding");
+	ok(hash_events(path, 1, 0, 0, lazy) == 0, "Read trace with lazy decoding");
+	ok(eager->len == lazy->len && eager->len > 0,
+		"Same number of events (%u, %u)", eager->len, lazy->len);
+	ok(eager->len == lazy->len
+		&& !memcmp(eager->data, lazy->data,
+			eager->len * sizeof(uint64_t)),
+		"Same field values with lazy decoding");
+	ok(hash_events(path, 1, 1, 0, zero_copy) == 0,
+		"Read trace with zero-copy strings");
+	ok(eager->len == zero_copy->len
+		&& !memcmp(eager->data, zero_copy->data,
+			eager->len * sizeof(uint64_t)),
+		"Same field values with zero-copy strings");
+	ok(hash_events(path, 0, 0, 4, ahead) == 0,
+		"Read trace with decode-ahead threads");
+	ok(eager->len == ahead->len
+		&& !memcmp(eager->data, ahead->data,
+			eager->len * sizeof(uint64_t)),
+		"Same field values with decode-ahead threads");
+
+	g_array_free(eager, TRUE);
+	g_array_free(lazy, TRUE);
+	g_array_free(zero_copy, TRUE);
+	g_array_free(ahead, TRUE);
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	/*
+	 * Side-effects ensuring libs are not optimized away by static
+	 * linking.
+	 */
+	babeltrace_debug = 0;	/* libbabeltrace.la */
+	opt_clock_offset = 0;	/* libbabeltrace-ctf.la */
+
+	if (argc < 2) {
+		plan_skip_all("Invalid arguments: need trace paths");
+	}
+
+	plan_tests(NR_TESTS * (argc - 1));
+
+	for (i = 1; i < argc; i++)
+		test_trace(argv[i]);
+	return exit_status();
+}
@@ -0,0 +1,228 @@
+/*
+ * test_loser_tree.c
+ *
+ * BabelTrace - loser tree merge test program
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <babeltrace/loser_tree.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <tap/tap.h>
+
+#define NR_TESTS	6
+#define NR_STREAMS	1000
+#define NR_EVENTS	100
+
+struct stream {
+	char name[16];
+	uint64_t key;
+	unsigned int left;
+};
+
+static struct stream streams[NR_STREAMS];
+
+static uint64_t rand_state = 42;
+
+/* Deterministic 64-bit random values (xorshift64). */
+static
+uint64_t next_rand(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+	return rand_state;
+}
+
+static
+int compare_names(void *a, void *b)
+{
+	struct stream *s_a = a, *s_b = b;
+
+	return strcmp(s_a->name, s_b->name);
+}
+
+/* Smallest key of the streams other than s, brute force. */
+static
+uint64_t other_min_key(struct stream *s)
+{
+	uint64_t key = UINT64_MAX;
+	unsigned int i;
+
+	for (i = 0; i < NR_STREAMS; i++) {
+		if (&streams[i] != s && streams[i].left && streams[i].key < key)
+			key = streams[i].key;
+	}
+	return key;
+}
+
+/*
+ * Merge streams of small key increments, so that many keys are equal:
+ * the output must be in key order, then name order, and the runner-up
+ * key the smallest key of the other streams.
+ */
+static
+void test_merge(void)
+{
+	struct loser_tree tree;
+	struct stream *s, *prev = NULL;
+	uint64_t prev_key = 0;
+	unsigned int i, nr_events = 0, nr_errors = 0, nr_runner_up_errors = 0;
+
+	bt_loser_tree_init(&tree, 0, compare_names);
+	/* Insert in reverse name order. */
+	for (i = NR_STREAMS; i-- > 0;) {
+		s = &streams[i];
+		snprintf(s->name, sizeof(s->name), "stream%04u", i);
+		s->key = next_rand() % 4;
+		s->left = 1 + next_rand() % NR_EVENTS;
+		bt_loser_tree_insert(&tree, s, s->key);
+	}
+	while ((s = bt_loser_tree_winner(&tree))) {
+		if (prev && (s->key < prev_key || (s->key == prev_key
+				&& strcmp(s->name, prev->name) < 0)))
+			nr_errors++;
+		if (bt_loser_tree_runner_up_key(&tree) != other_min_key(s))
+			nr_runner_up_errors++;
+		prev = s;
+		prev_key = s->key;
+		nr_events++;
+		if (!--s->left) {
+			if (bt_loser_tree_remove(&tree) != s)
+				nr_errors++;
+			continue;
+		}
+		s->key += next_rand() % 3;
+		bt_loser_tree_update_winner(&tree, s->key);
+	}
+	ok(nr_errors == 0 && nr_events > NR_STREAMS,
+		"Merge of %u streams in key and tie-break order (%u errors)",
+		NR_STREAMS, nr_errors);
+	ok(nr_runner_up_errors == 0,
+		"Runner-up key is the smallest key of the other streams (%u errors)",
+		nr_runner_up_errors);
+	bt_loser_tree_free(&tree);
+}
+
+static
+void test_empty(void)
+{
+	struct loser_tree tree;
+
+	bt_loser_tree_init(&tree, 0, compare_names);
+	ok(!bt_loser_tree_winner(&tree) && !bt_loser_tree_remove(&tree),
+		"Empty tree has no winner");
+	bt_loser_tree_free(&tree);
+}
+
+static
+void test_insert_after_remove(void)
+{
+	struct loser_tree tree;
+	struct stream a = { "a", 10 }, b = { "b", 20 }, c = { "c", 30 },
+		d = { "d", 5 };
+	int ret = 0;
+
+	bt_loser_tree_init(&tree, 0, compare_names);
+	bt_loser_tree_insert(&tree, &c, c.key);
+	bt_loser_tree_insert(&tree, &b, b.key);
+	bt_loser_tree_insert(&tree, &a, a.key);
+	ret |= bt_loser_tree_remove(&tree) != &a;
+	bt_loser_tree_insert(&tree, &d, d.key);
+	ret |= bt_loser_tree_winner(&tree) != &d;
+	d.key = 25;
+	bt_loser_tree_update_winner(&tree, d.key);
+	ret |= bt_loser_tree_remove(&tree) != &b;
+	ret |= bt_loser_tree_remove(&tree) != &d;
+	ret |= bt_loser_tree_remove(&tree) != &c;
+	ret |= bt_loser_tree_remove(&tree) != NULL;
+	ok(!ret, "Insertion after removal");
+	bt_loser_tree_free(&tree);
+}
+
+/* Empty leaves must lose even against the largest key. */
+static
+void test_largest_key(void)
+{
+	struct loser_tree tree;
+	struct stream a = { "a", UINT64_MAX }, b = { "b", UINT64_MAX },
+		c = { "c", 1 };
+	int ret = 0;
+
+	bt_loser_tree_init(&tree, 0, compare_names);
+	bt_loser_tree_insert(&tree, &b, b.key);
+	bt_loser_tree_insert(&tree, &a, a.key);
+	bt_loser_tree_insert(&tree, &c, c.key);
+	ret |= bt_loser_tree_remove(&tree) != &c;
+	ret |= bt_loser_tree_remove(&tree) != &a;
+	ret |= bt_loser_tree_winner(&tree) != &b;
+	ret |= bt_loser_tree_remove(&tree) != &b;
+	ret |= bt_loser_tree_winner(&tree) != NULL;
+	ok(!ret, "Elements of largest key win over empty leaves");
+	bt_loser_tree_free(&tree);
+}
+
+/*
+ * The iterator keeps reading the winner while its key is below the
+ * runner-up key: check the runner-up key when keys are equal, when the
+ * winner reaches it, and when a single element remains.
+ */
+static
+void test_runner_up(void)
+{
+	struct loser_tree tree;
+	struct stream a = { "a", 5 }, b = { "b", 5 }, c = { "c", 9 };
+	int ret = 0;
+
+	bt_loser_tree_init(&tree, 0, compare_names);
+	bt_loser_tree_insert(&tree, &c, c.key);
+	ret |= bt_loser_tree_runner_up_key(&tree) != UINT64_MAX;
+	bt_loser_tree_insert(&tree, &b, b.key);
+	bt_loser_tree_insert(&tree, &a, a.key);
+	/* Equal keys: the runner-up key is the winner key. */
+	ret |= bt_loser_tree_winner(&tree) != &a;
+	ret |= bt_loser_tree_runner_up_key(&tree) != 5;
+	/* The winner reaches the runner-up key: the tie-break decides. */
+	bt_loser_tree_update_winner(&tree, 5);
+	ret |= bt_loser_tree_winner(&tree) != &a;
+	ret |= bt_loser_tree_runner_up_key(&tree) != 5;
+	bt_loser_tree_update_winner(&tree, 9);
+	ret |= bt_loser_tree_winner(&tree) != &b;
+	ret |= bt_loser_tree_runner_up_key(&tree) != 9;
+	bt_loser_tree_update_winner(&tree, 9);
+	ret |= bt_loser_tree_winner(&tree) != &a;
+	ret |= bt_loser_tree_runner_up_key(&tree) != 9;
+	/* A single remaining element has no runner-up. */
+	ret |= bt_loser_tree_remove(&tree) != &a;
+	ret |= bt_loser_tree_remove(&tree) != &b;
+	ret |= bt_loser_tree_winner(&tree) != &c;
+	ret |= bt_loser_tree_runner_up_key(&tree) != UINT64_MAX;
+	ok(!ret, "Runner-up key with equal keys and a single element");
+	bt_loser_tree_free(&tree);
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(NR_TESTS);
+
+	test_merge();
+	test_empty();
+	test_insert_after_remove();
+	test_largest_key();
+	test_runner_up();
+	return exit_status();
+}
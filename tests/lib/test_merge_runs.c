@@ -0,0 +1,403 @@
+/*
+ * test_merge_runs.c
+ *
+ * Lib BabelTrace - Stream merge order test program
+ *
+ * The iterator keeps reading the current stream while its events are
+ * before those of all the other streams, without going through the
+ * merge structure. Check that the events of traces written with known
+ * timestamps come out in timestamp order, then stream order, with both
+ * merge structures, around the edges of these runs.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <babeltrace/ctf-writer/writer.h>
+#include <babeltrace/ctf-writer/clock.h>
+#include <babeltrace/ctf-writer/stream.h>
+#include <babeltrace/ctf-writer/event.h>
+#include <babeltrace/ctf-writer/event-types.h>
+#include <babeltrace/ctf-writer/event-fields.h>
+#include <babeltrace/context.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/babeltrace-internal.h>	/* For symbol side-effects */
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ftw.h>
+#include <glib.h>
+
+#include <tap/tap.h>
+#include "common.h"
+
+#define NR_SCENARIOS	4
+#define NR_TESTS	(NR_SCENARIOS * 3)
+
+/* Streams are named after their index: keep it to one digit. */
+#define MAX_STREAMS	8
+
+/* Events per packet, so that runs cross packet boundaries. */
+#define PACKET_EVENTS	4
+
+#define RANDOM_STREAMS		6
+#define RANDOM_EVENTS		300
+
+struct merged_event {
+	uint64_t timestamp;
+	unsigned int stream;
+	unsigned int seq;	/* index of the event in its stream */
+};
+
+struct scenario {
+	const char *name;
+	unsigned int nr_streams;
+	GArray *timestamps[MAX_STREAMS];	/* uint64_t, per stream */
+};
+
+static uint64_t rand_state = 42;
+
+/* Deterministic 64-bit random values (xorshift64). */
+static
+uint64_t next_rand(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+	return rand_state;
+}
+
+static
+void add_stream(struct scenario *scenario, const uint64_t *timestamps,
+		unsigned int len)
+{
+	GArray *array;
+
+	array = g_array_sized_new(FALSE, FALSE, sizeof(uint64_t), len);
+	g_array_append_vals(array, timestamps, len);
+	scenario->timestamps[scenario->nr_streams++] = array;
+}
+
+static
+void free_scenario(struct scenario *scenario)
+{
+	unsigned int i;
+
+	for (i = 0; i < scenario->nr_streams; i++)
+		g_array_free(scenario->timestamps[i], TRUE);
+}
+
+/*
+ * Events of the streams in the order of the iterator: by timestamp,
+ * then by stream rank, which follows the stream file names.
+ */
+static
+gint compare_merged_events(gconstpointer a, gconstpointer b)
+{
+	const struct merged_event *e_a = a, *e_b = b;
+
+	if (e_a->timestamp != e_b->timestamp)
+		return e_a->timestamp < e_b->timestamp ? -1 : 1;
+	if (e_a->stream != e_b->stream)
+		return e_a->stream < e_b->stream ? -1 : 1;
+	return e_a->seq < e_b->seq ? -1 : e_a->seq > e_b->seq;
+}
+
+static
+GArray *expected_events(struct scenario *scenario)
+{
+	GArray *events;
+	unsigned int i, j;
+
+	events = g_array_new(FALSE, FALSE, sizeof(struct merged_event));
+	for (i = 0; i < scenario->nr_streams; i++) {
+		GArray *timestamps = scenario->timestamps[i];
+
+		for (j = 0; j < timestamps->len; j++) {
+			struct merged_event event;
+
+			event.timestamp = g_array_index(timestamps, uint64_t, j);
+			event.stream = i;
+			event.seq = j;
+			g_array_append_val(events, event);
+		}
+	}
+	g_array_sort(events, compare_merged_events);
+	return events;
+}
+
+/*
+ * Write the streams of a scenario, appending the events in merged
+ * order since the clock only moves forward.
+ */
+static
+int write_trace(const char *path, struct scenario *scenario,
+		GArray *expected)
+{
+	struct bt_ctf_writer *writer;
+	struct bt_ctf_clock *clock;
+	struct bt_ctf_stream_class *stream_class;
+	struct bt_ctf_event_class *event_class;
+	struct bt_ctf_field_type *uint_type;
+	struct bt_ctf_stream *streams[MAX_STREAMS] = { NULL };
+	unsigned int i;
+	int ret = 0;
+
+	writer = bt_ctf_writer_create(path);
+	clock = bt_ctf_clock_create("merge_clock");
+	stream_class = bt_ctf_stream_class_create("stream");
+	event_class = bt_ctf_event_class_create("event");
+	uint_type = bt_ctf_field_type_integer_create(32);
+	if (!writer || !clock || !stream_class || !event_class || !uint_type)
+		return -1;
+	ret |= bt_ctf_writer_add_clock(writer, clock);
+	ret |= bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_event_class_add_field(event_class, uint_type, "stream");
+	ret |= bt_ctf_event_class_add_field(event_class, uint_type, "seq");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	for (i = 0; i < scenario->nr_streams && !ret; i++) {
+		streams[i] = bt_ctf_writer_create_stream(writer, stream_class);
+		if (!streams[i])
+			ret = -1;
+	}
+	for (i = 0; i < expected->len && !ret; i++) {
+		struct merged_event *e =
+			&g_array_index(expected, struct merged_event, i);
+		struct bt_ctf_event *event;
+		struct bt_ctf_field *field;
+
+		event = bt_ctf_event_create(event_class);
+		if (!event)
+			return -1;
+		field = bt_ctf_field_create(uint_type);
+		ret |= bt_ctf_field_unsigned_integer_set_value(field, e->stream);
+		ret |= bt_ctf_event_set_payload(event, "stream", field);
+		bt_ctf_field_put(field);
+		field = bt_ctf_field_create(uint_type);
+		ret |= bt_ctf_field_unsigned_integer_set_value(field, e->seq);
+		ret |= bt_ctf_event_set_payload(event, "seq", field);
+		bt_ctf_field_put(field);
+		ret |= bt_ctf_clock_set_time(clock, e->timestamp);
+		ret |= bt_ctf_stream_append_event(streams[e->stream], event);
+		bt_ctf_event_put(event);
+		if (!((e->seq + 1) % PACKET_EVENTS))
+			ret |= bt_ctf_stream_flush(streams[e->stream]);
+	}
+	for (i = 0; i < scenario->nr_streams; i++) {
+		if (!streams[i])
+			continue;
+		ret |= bt_ctf_stream_flush(streams[i]);
+		bt_ctf_stream_put(streams[i]);
+	}
+	bt_ctf_writer_flush_metadata(writer);
+
+	bt_ctf_field_type_put(uint_type);
+	bt_ctf_event_class_put(event_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	return ret;
+}
+
+static
+uint64_t get_payload(const struct bt_ctf_event *event, const char *name)
+{
+	const struct bt_definition *scope;
+
+	scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
+	return bt_ctf_get_uint64(bt_ctf_get_field(event, scope, name));
+}
+
+/*
+ * Read the trace with the given merge structure, and compare its events
+ * with the expected ones. Returns the number of mismatches.
+ */
+static
+unsigned int check_merge(const char *path, GArray *expected,
+		enum bt_iter_merge merge)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	unsigned int i = 0, nr_errors = 0;
+
+	ctx = create_context_with_path(path);
+	if (!ctx)
+		return 1;
+	iter = bt_ctf_iter_create_merge(ctx, NULL, NULL, merge);
+	if (!iter) {
+		bt_context_put(ctx);
+		return 1;
+	}
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		struct merged_event *e;
+		uint64_t timestamp, stream, seq;
+
+		timestamp = bt_ctf_get_timestamp(event);
+		stream = get_payload(event, "stream");
+		seq = get_payload(event, "seq");
+		if (i >= expected->len) {
+			nr_errors++;
+			break;
+		}
+		e = &g_array_index(expected, struct merged_event, i);
+		if (timestamp != e->timestamp || stream != e->stream
+				|| seq != e->seq) {
+			if (!nr_errors)
+				diag("Event %u: stream %" PRIu64 " event %" PRIu64
+					" at %" PRIu64 ", expected stream %u event %u at %" PRIu64,
+					i, stream, seq, timestamp, e->stream,
+					e->seq, e->timestamp);
+			nr_errors++;
+		}
+		i++;
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+			nr_errors++;
+			break;
+		}
+	}
+	if (i != expected->len) {
+		diag("Read %u events, expected %u", i, expected->len);
+		nr_errors++;
+	}
+	bt_ctf_iter_destroy(iter);
+	bt_context_put(ctx);
+	return nr_errors;
+}
+
+static
+int remove_entry(const char *path, const struct stat *sb, int type,
+		struct FTW *ftwbuf)
+{
+	return remove(path);
+}
+
+static
+void run_scenario(struct scenario *scenario)
+{
+	char trace_path[] = "/tmp/test_merge_runs_XXXXXX";
+	GArray *expected;
+	unsigned int nr_errors;
+
+	expected = expected_events(scenario);
+	if (!mkdtemp(trace_path)) {
+		skip(3, "Cannot create trace directory");
+		goto end;
+	}
+	if (write_trace(trace_path, scenario, expected)) {
+		fail("Write trace: %s", scenario->name);
+		skip(2, "Cannot write trace");
+		goto remove;
+	}
+	pass("Write trace: %s", scenario->name);
+
+	nr_errors = check_merge(trace_path, expected, BT_ITER_MERGE_HEAP);
+	ok(nr_errors == 0, "Heap merge order: %s (%u errors)",
+		scenario->name, nr_errors);
+	nr_errors = check_merge(trace_path, expected,
+		BT_ITER_MERGE_LOSER_TREE);
+	ok(nr_errors == 0, "Loser tree merge order: %s (%u errors)",
+		scenario->name, nr_errors);
+remove:
+	(void) nftw(trace_path, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+end:
+	g_array_free(expected, TRUE);
+	free_scenario(scenario);
+}
+
+/*
+ * The run of a stream ends on an event at the timestamp of the next
+ * stream: the stream of lower rank goes first, whether it is the
+ * running one or the next one.
+ */
+static
+void test_run_end_at_next_timestamp(void)
+{
+	static const uint64_t s0[] = { 5, 10, 11, 20, 40, 41 };
+	static const uint64_t s1[] = { 1, 5, 6, 20, 30, 40 };
+	struct scenario scenario = { "run ending at the next stream timestamp" };
+
+	add_stream(&scenario, s0, G_N_ELEMENTS(s0));
+	add_stream(&scenario, s1, G_N_ELEMENTS(s1));
+	run_scenario(&scenario);
+}
+
+static
+void test_equal_timestamps(void)
+{
+	static const uint64_t s[] = { 100, 100, 200, 200, 200, 300 };
+	struct scenario scenario = { "equal timestamps across streams" };
+	unsigned int i;
+
+	for (i = 0; i < 3; i++)
+		add_stream(&scenario, s, G_N_ELEMENTS(s));
+	run_scenario(&scenario);
+}
+
+/* Once the other streams end, the last one runs up to its end. */
+static
+void test_single_remaining_stream(void)
+{
+	static const uint64_t s0[] = { 1, 2, 4, 4, 6, 10, 10, 11, 12, 20 };
+	static const uint64_t s1[] = { 3, 4 };
+	static const uint64_t s2[] = { 4, 5, 6 };
+	struct scenario scenario = { "single remaining stream" };
+
+	add_stream(&scenario, s0, G_N_ELEMENTS(s0));
+	add_stream(&scenario, s1, G_N_ELEMENTS(s1));
+	add_stream(&scenario, s2, G_N_ELEMENTS(s2));
+	run_scenario(&scenario);
+}
+
+/* Small timestamp increments, so that runs are short and ties many. */
+static
+void test_random(void)
+{
+	struct scenario scenario = { "random streams" };
+	uint64_t timestamps[RANDOM_EVENTS];
+	unsigned int i, j;
+
+	for (i = 0; i < RANDOM_STREAMS; i++) {
+		uint64_t timestamp = next_rand() % 8;
+
+		for (j = 0; j < RANDOM_EVENTS; j++) {
+			timestamp += next_rand() % 3;
+			timestamps[j] = timestamp;
+		}
+		add_stream(&scenario, timestamps, RANDOM_EVENTS);
+	}
+	run_scenario(&scenario);
+}
+
+int main(int argc, char **argv)
+{
+	/*
+	 * Side-effects ensuring libs are not optimized away by static
+	 * linking.
+	 */
+	babeltrace_debug = 0;	/* libbabeltrace.la */
+	opt_clock_offset = 0;	/* libbabeltrace-ctf.la */
+
+	plan_tests(NR_TESTS);
+
+	test_run_end_at_next_timestamp();
+	test_equal_timestamps();
+	test_single_remaining_stream();
+	test_random();
+	return exit_status();
+}
@@ -0,0 +1,200 @@
+/*
+ * test_packed_ints.c
+ *
+ * Lib BabelTrace - Packed integer arrays and sequences test program
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#define _GNU_SOURCE
+#include <babeltrace/context.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/babeltrace-internal.h>	/* For symbol side-effects */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <tap/tap.h>
+#include "common.h"
+
+#define NR_TESTS	5
+
+/* Events of the overrun trace before the one overrunning its packet */
+#define NR_OVERRUN_EVENTS	9
+
+/* Value of the i-th integer of a packed buffer */
+static
+int64_t packed_value(const void *data, uint64_t i, int len, int signedness)
+{
+	switch (len) {
+	case 8:
+		return signedness ? ((const int8_t *) data)[i]
+			: ((const uint8_t *) data)[i];
+	case 16:
+		return signedness ? ((const int16_t *) data)[i]
+			: ((const uint16_t *) data)[i];
+	case 32:
+		return signedness ? ((const int32_t *) data)[i]
+			: ((const uint32_t *) data)[i];
+	default:
+		return ((const int64_t *) data)[i];
+	}
+}
+
+/*
+ * Compare the packed elements of the integer arrays and sequences of a
+ * scope with the values of their element definitions. Count the fields
+ * checked in nr_fields and the mismatches in nr_errors.
+ */
+static
+void check_scope(const struct bt_ctf_event *event, enum bt_ctf_scope scope,
+		unsigned int *nr_fields, unsigned int *nr_errors)
+{
+	const struct bt_definition *top, * const *list;
+	unsigned int count, i;
+
+	top = bt_ctf_get_top_level_scope(event, scope);
+	if (!top)
+		return;
+	if (bt_ctf_get_field_list(event, top, &list, &count))
+		return;
+	for (i = 0; i < count; i++) {
+		const struct bt_definition *def = list[i], *elem;
+		const struct bt_declaration *elem_decl;
+		const void *data;
+		uint64_t len, j;
+		int int_len, signedness;
+
+		data = bt_ctf_get_int_array(def, &len);
+		if (!data) {
+			(void) bt_ctf_field_get_error();
+			continue;
+		}
+		(*nr_fields)++;
+		for (j = 0; j < len; j++) {
+			int64_t value;
+
+			elem = bt_ctf_get_index(event, def, j);
+			if (!elem) {
+				(*nr_errors)++;
+				break;
+			}
+			elem_decl = bt_ctf_get_decl_from_def(elem);
+			int_len = bt_ctf_get_int_len(elem_decl);
+			signedness = bt_ctf_get_int_signedness(elem_decl);
+			if (signedness)
+				value = bt_ctf_get_int64(elem);
+			else
+				value = (int64_t) bt_ctf_get_uint64(elem);
+			if (value != packed_value(data, j, int_len, signedness))
+				(*nr_errors)++;
+		}
+	}
+}
+
+/*
+ * Read a trace whose last event has a packed sequence running past the
+ * packet content, into its padding. Reading it must fail.
+ */
+static
+void run_overrun(const char *path)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	unsigned int nr_events = 0, nr_fields = 0, nr_errors = 0;
+	int ret = 0;
+
+	ctx = create_context_with_path(path);
+	if (!ctx) {
+		skip(2, "Cannot create valid context");
+		return;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		skip(2, "Cannot create valid iterator");
+		bt_context_put(ctx);
+		return;
+	}
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		nr_events++;
+		check_scope(event, BT_EVENT_FIELDS, &nr_fields, &nr_errors);
+		ret = bt_iter_next(bt_ctf_get_iter(iter));
+		if (ret < 0)
+			break;
+	}
+	ok(nr_events == NR_OVERRUN_EVENTS && nr_errors == 0,
+		"Read %u events before the overrun", nr_events);
+	ok(ret < 0, "Packed sequence overrunning the packet content rejected");
+
+	bt_ctf_iter_destroy(iter);
+	bt_context_put(ctx);
+}
+
+int main(int argc, char **argv)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	unsigned int nr_events = 0, nr_fields = 0, nr_errors = 0;
+
+	/*
+	 * Side-effects ensuring libs are not optimized away by static
+	 * linking.
+	 */
+	babeltrace_debug = 0;	/* libbabeltrace.la */
+	opt_clock_offset = 0;	/* libbabeltrace-ctf.la */
+
+	if (argc < 2) {
+		plan_skip_all("Invalid arguments: need a trace path");
+	}
+
+	plan_tests(NR_TESTS);
+
+	ctx = create_context_with_path(argv[1]);
+	if (!ctx) {
+		skip(NR_TESTS, "Cannot create valid context");
+		return exit_status();
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		skip(NR_TESTS, "Cannot create valid iterator");
+		bt_context_put(ctx);
+		return exit_status();
+	}
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		nr_events++;
+		check_scope(event, BT_TRACE_PACKET_HEADER, &nr_fields,
+			&nr_errors);
+		check_scope(event, BT_EVENT_FIELDS, &nr_fields, &nr_errors);
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0)
+			break;
+	}
+	ok(nr_events > 0, "Read %u events", nr_events);
+	ok(nr_fields > 0, "Found %u packed integer fields", nr_fields);
+	ok(nr_errors == 0, "Packed elements match their definitions (%u errors)",
+		nr_errors);
+
+	bt_ctf_iter_destroy(iter);
+	bt_context_put(ctx);
+
+	if (argc < 3)
+		skip(2, "No overrun trace");
+	else
+		run_overrun(argv[2]);
+	return exit_status();
+}
@@ -33,7 +33,7 @@
 #include <tap/tap.h>
 #include "common.h"
 
-#define NR_TESTS	29
+#define NR_TESTS	31
 
 void run_seek_begin(char *path, uint64_t expected_begin)
 {
@@ -204,6 +204,72 @@ void run_seek_time_at_last(char *path, uint64_t expected_last)
 	bt_context_put(ctx);
 }
 
+/*
+ * Seek to the time of events spread over the trace, in increasing then
+ * decreasing order, so that later seeks start from recorded seek points.
+ */
+void run_seek_time_repeated(char *path)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	struct bt_iter_pos newpos;
+	GArray *timestamps;
+	unsigned int nr_events = 0, nr_errors = 0;
+	int i, pass;
+
+	/* Open the trace */
+	ctx = create_context_with_path(path);
+	if (!ctx) {
+		skip(2, "Cannot create valid context");
+		return;
+	}
+
+	/* Create iterator with null last and end */
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		skip(2, "Cannot create valid iterator");
+		return;
+	}
+
+	timestamps = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		if (!(nr_events++ % 97)) {
+			uint64_t timestamp = bt_ctf_get_timestamp(event);
+
+			g_array_append_val(timestamps, timestamp);
+		}
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0)
+			break;
+	}
+
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < timestamps->len; i++) {
+			int index = pass ? timestamps->len - 1 - i : i;
+
+			newpos.type = BT_SEEK_TIME;
+			newpos.u.seek_time = g_array_index(timestamps,
+					uint64_t, index);
+			if (bt_iter_set_pos(bt_ctf_get_iter(iter), &newpos)) {
+				nr_errors++;
+				continue;
+			}
+			event = bt_ctf_iter_read_event(iter);
+			if (!event || bt_ctf_get_timestamp(event)
+					!= newpos.u.seek_time)
+				nr_errors++;
+		}
+		ok(timestamps->len > 0 && nr_errors == 0,
+			"Seek time to %u events in %s order (%u errors)",
+			timestamps->len, pass ? "decreasing" : "increasing",
+			nr_errors);
+	}
+
+	g_array_free(timestamps, TRUE);
+	bt_ctf_iter_destroy(iter);
+	bt_context_put(ctx);
+}
+
 void run_seek_cycles(char *path,
 		uint64_t expected_begin,
 		uint64_t expected_last)
@@ -328,6 +394,7 @@ int main(int argc, char **argv)
 	run_seek_time_at_last(path, expected_last);
 	run_seek_last(path, expected_last);
 	run_seek_cycles(path, expected_begin, expected_last);
+	run_seek_time_repeated(path);
 
 	return exit_status();
 }
@@ -0,0 +1,176 @@
+/*
+ * test_text_format.c
+ *
+ * BabelTrace - text output number conversions test program
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <babeltrace/ctf-text/buffer.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <tap/tap.h>
+
+#define NR_TESTS	8
+#define NR_RANDOM	100000
+
+static uint64_t rand_state = 42;
+
+/* Deterministic 64-bit random values (xorshift64). */
+static
+uint64_t next_rand(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+	return rand_state;
+}
+
+/* Random value of random magnitude. */
+static
+uint64_t next_value(void)
+{
+	uint64_t v = next_rand();
+
+	return v >> (next_rand() % 64);
+}
+
+/*
+ * Compare the text of a conversion with the printf() reference,
+ * reporting the first mismatch of a test.
+ */
+static
+void check_text(const char *what, const char *text, size_t len,
+		const char *ref, unsigned int *nr_errors)
+{
+	if (len == strlen(ref) && !memcmp(text, ref, len))
+		return;
+	if (!*nr_errors)
+		diag("%s: got \"%.*s\", expected \"%s\"", what, (int) len,
+			text, ref);
+	(*nr_errors)++;
+}
+
+static const uint64_t edges[] = {
+	0, 1, 7, 8, 9, 10, 15, 16, 99, 100, 999999999, 1000000000,
+	INT64_MAX, (uint64_t) INT64_MAX + 1, UINT64_MAX - 1, UINT64_MAX,
+};
+
+static const double doubles[] = {
+	0.0, -0.0, 1.0, -1.0, 0.5, 3.1415, 100000.0, 999999.0, 1000000.0,
+	-999999.0, 1e-5, 123456.5, 1e300, -1e-300, 4294967296.0,
+};
+
+int main(int argc, char **argv)
+{
+	char text[CTF_TEXT_NUMBER_LEN], ref[CTF_TEXT_NUMBER_LEN];
+	unsigned int nr_u = 0, nr_s = 0, nr_o = 0, nr_x = 0, nr_w = 0;
+	unsigned int nr_p = 0, nr_g = 0, nr_buf = 0;
+	struct ctf_text_buffer buf = { 0 };
+	unsigned int i;
+	size_t len;
+
+	plan_tests(NR_TESTS);
+
+	for (i = 0; i < sizeof(edges) / sizeof(edges[0]) + NR_RANDOM; i++) {
+		uint64_t v;
+		unsigned int width;
+
+		if (i < sizeof(edges) / sizeof(edges[0]))
+			v = edges[i];
+		else
+			v = next_value();
+
+		len = ctf_text_format_u64(text, v);
+		snprintf(ref, sizeof(ref), "%" PRIu64, v);
+		check_text("u64", text, len, ref, &nr_u);
+
+		len = ctf_text_format_s64(text, (int64_t) v);
+		snprintf(ref, sizeof(ref), "%" PRId64, (int64_t) v);
+		check_text("s64", text, len, ref, &nr_s);
+
+		len = ctf_text_format_o64(text, v);
+		snprintf(ref, sizeof(ref), "%" PRIo64, v);
+		check_text("o64", text, len, ref, &nr_o);
+
+		len = ctf_text_format_X64(text, v);
+		snprintf(ref, sizeof(ref), "%" PRIX64, v);
+		check_text("X64", text, len, ref, &nr_x);
+
+		width = next_rand() % 21;
+		len = ctf_text_format_u64_width(text, v, width);
+		snprintf(ref, sizeof(ref), "%0*" PRIu64, width, v);
+		check_text("u64 width", text, len, ref, &nr_w);
+
+		len = ctf_text_format_u64_pad(text, v, width, ' ');
+		snprintf(ref, sizeof(ref), "%*" PRIu64, width, v);
+		check_text("u64 pad", text, len, ref, &nr_p);
+	}
+	ok(nr_u == 0, "Unsigned decimal matches PRIu64 (%u errors)", nr_u);
+	ok(nr_s == 0, "Signed decimal matches PRId64 (%u errors)", nr_s);
+	ok(nr_o == 0, "Octal matches PRIo64 (%u errors)", nr_o);
+	ok(nr_x == 0, "Hexadecimal matches PRIX64 (%u errors)", nr_x);
+	ok(nr_w == 0, "Zero-padded decimal matches zero-padded PRIu64 (%u errors)",
+		nr_w);
+	ok(nr_p == 0, "Space-padded decimal matches padded PRIu64 (%u errors)",
+		nr_p);
+
+	for (i = 0; i < sizeof(doubles) / sizeof(doubles[0]) + NR_RANDOM; i++) {
+		double v;
+
+		if (i < sizeof(doubles) / sizeof(doubles[0]))
+			v = doubles[i];
+		else if (i & 1)
+			v = (double) ((int64_t) next_rand() % 2000000);
+		else
+			v = ((int64_t) next_rand() % 2000000) / 1024.0;
+		len = ctf_text_format_g(text, v);
+		snprintf(ref, sizeof(ref), "%g", v);
+		check_text("g", text, len, ref, &nr_g);
+	}
+	len = ctf_text_format_g(text, NAN);
+	snprintf(ref, sizeof(ref), "%g", NAN);
+	check_text("g", text, len, ref, &nr_g);
+	len = ctf_text_format_g(text, -INFINITY);
+	snprintf(ref, sizeof(ref), "%g", -INFINITY);
+	check_text("g", text, len, ref, &nr_g);
+	ok(nr_g == 0, "Floating point matches %%g (%u errors)", nr_g);
+
+	/* Grow the buffer well past its initial allocation. */
+	for (i = 0; i < CTF_TEXT_BUFFER_FLUSH_LEN; i++) {
+		ctf_text_puts(&buf, "v=");
+		ctf_text_put_u64(&buf, i);
+		ctf_text_printf(&buf, "%c", ';');
+	}
+	len = 0;
+	for (i = 0; i < CTF_TEXT_BUFFER_FLUSH_LEN && !nr_buf; i++) {
+		size_t item_len;
+
+		item_len = snprintf(ref, sizeof(ref), "v=%u;", i);
+		if (len + item_len > buf.len
+				|| memcmp(buf.data + len, ref, item_len))
+			nr_buf++;
+		len += item_len;
+	}
+	ok(nr_buf == 0 && len == buf.len, "Buffer keeps %zu bytes appended",
+		buf.len);
+	ctf_text_buffer_free(&buf);
+
+	return exit_status();
+}
@@ -0,0 +1,529 @@
+/*
+ * test_text_template.c
+ *
+ * Lib BabelTrace - Text output template test program
+ *
+ * Check that the text of events written through their compiled
+ * templates matches the text of the per-field printer, which walks the
+ * event scopes with the text format write functions, for combinations
+ * of the --names and --fields options.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <babeltrace/context.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/format.h>
+#include <babeltrace/ctf-text/types.h>
+#include <babeltrace/ctf/metadata.h>
+#include <babeltrace/babeltrace-internal.h>	/* For symbol side-effects */
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf/events-internal.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <glib.h>
+
+#include <tap/tap.h>
+#include "common.h"
+
+#define NSEC_PER_SEC	1000000000ULL
+
+struct option_case {
+	const char *names;	/* --names argument */
+	const char *fields;	/* --fields argument, NULL for the default */
+	int verbose;
+};
+
+static const struct option_case cases[] = {
+	{ "payload,context", NULL, 0 },
+	{ "none", NULL, 0 },
+	{ "all", NULL, 0 },
+	{ "scope,header", NULL, 0 },
+	{ "payload", "trace,trace:hostname", 0 },
+	{ "header", "trace:procname,trace:vpid,loglevel", 0 },
+	{ "context", "trace:domain,emf,callsite", 0 },
+	{ "none", "all", 0 },
+	{ "all", "all", 0 },
+	{ "all", NULL, 1 },
+	{ "none", "all", 1 },
+};
+
+#define NR_CASES	G_N_ELEMENTS(cases)
+/* The cases, then closing the trace and writing it again */
+#define NR_TRACE_TESTS	(NR_CASES + 2)
+
+enum field_item {
+	ITEM_SCOPE,
+	ITEM_HEADER,
+	ITEM_CONTEXT,
+	ITEM_PAYLOAD,
+};
+
+static const char *loglevels[] = {
+	"TRACE_EMERG", "TRACE_ALERT", "TRACE_CRIT", "TRACE_ERR",
+	"TRACE_WARNING", "TRACE_NOTICE", "TRACE_INFO",
+	"TRACE_DEBUG_SYSTEM", "TRACE_DEBUG_PROGRAM", "TRACE_DEBUG_PROCESS",
+	"TRACE_DEBUG_MODULE", "TRACE_DEBUG_UNIT", "TRACE_DEBUG_FUNCTION",
+	"TRACE_DEBUG_LINE", "TRACE_DEBUG",
+};
+
+/* Set the options as the converter parses its --names and --fields. */
+static
+void set_options(const struct option_case *c)
+{
+	char *strlist, *str, *strctx;
+
+	opt_all_field_names = 0;
+	opt_scope_field_names = 0;
+	opt_header_field_names = 0;
+	opt_context_field_names = 0;
+	opt_payload_field_names = 0;
+	strlist = strdup(c->names);
+	for (str = strtok_r(strlist, ",", &strctx); str;
+			str = strtok_r(NULL, ",", &strctx)) {
+		if (!strcmp(str, "all"))
+			opt_all_field_names = 1;
+		else if (!strcmp(str, "scope"))
+			opt_scope_field_names = 1;
+		else if (!strcmp(str, "context"))
+			opt_context_field_names = 1;
+		else if (!strcmp(str, "header"))
+			opt_header_field_names = 1;
+		else if (!strcmp(str, "payload"))
+			opt_payload_field_names = 1;
+	}
+	free(strlist);
+
+	opt_all_fields = 0;
+	opt_trace_field = 0;
+	opt_trace_hostname_field = 0;
+	opt_trace_domain_field = 0;
+	opt_trace_procname_field = 0;
+	opt_trace_vpid_field = 0;
+	opt_loglevel_field = 0;
+	opt_emf_field = 0;
+	opt_callsite_field = 0;
+	opt_trace_default_fields = !c->fields;
+	strlist = c->fields ? strdup(c->fields) : NULL;
+	for (str = strlist ? strtok_r(strlist, ",", &strctx) : NULL; str;
+			str = strtok_r(NULL, ",", &strctx)) {
+		if (!strcmp(str, "all"))
+			opt_all_fields = 1;
+		else if (!strcmp(str, "trace"))
+			opt_trace_field = 1;
+		else if (!strcmp(str, "trace:hostname"))
+			opt_trace_hostname_field = 1;
+		else if (!strcmp(str, "trace:domain"))
+			opt_trace_domain_field = 1;
+		else if (!strcmp(str, "trace:procname"))
+			opt_trace_procname_field = 1;
+		else if (!strcmp(str, "trace:vpid"))
+			opt_trace_vpid_field = 1;
+		else if (!strcmp(str, "loglevel"))
+			opt_loglevel_field = 1;
+		else if (!strcmp(str, "emf"))
+			opt_emf_field = 1;
+		else if (!strcmp(str, "callsite"))
+			opt_callsite_field = 1;
+	}
+	free(strlist);
+	babeltrace_verbose = c->verbose;
+}
+
+static
+void set_field_names_print(struct ctf_text_stream_pos *pos,
+		enum field_item item)
+{
+	switch (item) {
+	case ITEM_SCOPE:
+		pos->print_names = opt_all_field_names || opt_scope_field_names;
+		break;
+	case ITEM_HEADER:
+		pos->print_names = opt_all_field_names || opt_header_field_names;
+		break;
+	case ITEM_CONTEXT:
+		pos->print_names = opt_all_field_names || opt_context_field_names;
+		break;
+	case ITEM_PAYLOAD:
+		pos->print_names = opt_all_field_names || opt_payload_field_names;
+		break;
+	}
+}
+
+static
+void put_timestamp(struct ctf_text_stream_pos *pos,
+		struct ctf_stream_definition *stream, uint64_t timestamp)
+{
+	char *p = ctf_text_reserve(&pos->out, CTF_TIMESTAMP_LEN);
+
+	pos->out.len += ctf_format_timestamp(p, &pos->timestamp_cache, stream,
+			timestamp);
+}
+
+/* Separator following a header field */
+static
+void put_header_end(struct ctf_text_stream_pos *pos)
+{
+	if (pos->print_names)
+		ctf_text_puts(&pos->out, ", ");
+}
+
+/* Prefix of a header field printed along the trace domain ones */
+static
+void put_header_start(struct ctf_text_stream_pos *pos, const char *name,
+		int dom_print)
+{
+	set_field_names_print(pos, ITEM_HEADER);
+	if (pos->print_names) {
+		ctf_text_puts(&pos->out, name);
+		ctf_text_puts(&pos->out, " = ");
+	} else if (dom_print) {
+		ctf_text_putc(&pos->out, ':');
+	}
+}
+
+static
+int put_scope(struct ctf_text_stream_pos *pos, const char *scope_name,
+		enum field_item item, struct bt_definition *definition)
+{
+	int field_nr_saved, ret;
+
+	if (pos->field_nr++ != 0)
+		ctf_text_putc(&pos->out, ',');
+	set_field_names_print(pos, ITEM_SCOPE);
+	if (pos->print_names) {
+		ctf_text_putc(&pos->out, ' ');
+		ctf_text_puts(&pos->out, scope_name);
+		ctf_text_puts(&pos->out, " =");
+	}
+	field_nr_saved = pos->field_nr;
+	pos->field_nr = 0;
+	set_field_names_print(pos, item);
+	ret = generic_rw(&pos->parent, definition);
+	pos->field_nr = field_nr_saved;
+	return ret;
+}
+
+/* Print an event field by field, as the text format did before templates. */
+static
+int write_event_fields(struct ctf_text_stream_pos *pos,
+		struct ctf_stream_definition *stream)
+{
+	struct ctf_stream_declaration *stream_class = stream->stream_class;
+	struct ctf_trace *trace = stream_class->trace;
+	struct ctf_event_declaration *event_class;
+	struct ctf_event_definition *event;
+	int dom_print = 0, ret = 0;
+
+	event = g_ptr_array_index(stream->events_by_id, stream->event_id);
+	event_class = g_ptr_array_index(stream_class->events_by_id,
+			stream->event_id);
+
+	if (stream->has_timestamp) {
+		set_field_names_print(pos, ITEM_HEADER);
+		if (pos->print_names)
+			ctf_text_puts(&pos->out, "timestamp = ");
+		else
+			ctf_text_putc(&pos->out, '[');
+		put_timestamp(pos, stream, opt_clock_cycles ?
+			stream->cycles_timestamp : stream->real_timestamp);
+		if (!pos->print_names)
+			ctf_text_putc(&pos->out, ']');
+		ctf_text_puts(&pos->out, pos->print_names ? ", " : " ");
+	}
+	if (opt_delta_field && stream->has_timestamp) {
+		uint64_t delta;
+
+		set_field_names_print(pos, ITEM_HEADER);
+		if (pos->print_names)
+			ctf_text_puts(&pos->out, "delta = ");
+		else
+			ctf_text_putc(&pos->out, '(');
+		if (pos->last_real_timestamp != -1ULL) {
+			delta = stream->real_timestamp - pos->last_real_timestamp;
+			ctf_text_putc(&pos->out, '+');
+			ctf_text_put_u64(&pos->out, delta / NSEC_PER_SEC);
+			ctf_text_putc(&pos->out, '.');
+			ctf_text_put_u64_width(&pos->out, delta % NSEC_PER_SEC, 9);
+		} else {
+			ctf_text_puts(&pos->out, "+?.?????????");
+		}
+		if (!pos->print_names)
+			ctf_text_putc(&pos->out, ')');
+		ctf_text_puts(&pos->out, pos->print_names ? ", " : " ");
+		pos->last_real_timestamp = stream->real_timestamp;
+		pos->last_cycles_timestamp = stream->cycles_timestamp;
+	}
+
+	if ((opt_trace_field || opt_all_fields) && trace->parent.path[0] != '\0') {
+		set_field_names_print(pos, ITEM_HEADER);
+		if (pos->print_names)
+			ctf_text_puts(&pos->out, "trace = ");
+		ctf_text_puts(&pos->out, trace->parent.path);
+		ctf_text_puts(&pos->out, pos->print_names ? ", " : " ");
+	}
+	if ((opt_trace_hostname_field || opt_all_fields || opt_trace_default_fields)
+			&& trace->env.hostname[0] != '\0') {
+		put_header_start(pos, "trace:hostname", 0);
+		ctf_text_puts(&pos->out, trace->env.hostname);
+		put_header_end(pos);
+		dom_print = 1;
+	}
+	if ((opt_trace_domain_field || opt_all_fields)
+			&& trace->env.domain[0] != '\0') {
+		put_header_start(pos, "trace:domain", 0);
+		ctf_text_puts(&pos->out, trace->env.domain);
+		put_header_end(pos);
+		dom_print = 1;
+	}
+	if ((opt_trace_procname_field || opt_all_fields || opt_trace_default_fields)
+			&& trace->env.procname[0] != '\0') {
+		put_header_start(pos, "trace:procname", dom_print);
+		ctf_text_puts(&pos->out, trace->env.procname);
+		put_header_end(pos);
+		dom_print = 1;
+	}
+	if ((opt_trace_vpid_field || opt_all_fields || opt_trace_default_fields)
+			&& trace->env.vpid != -1) {
+		put_header_start(pos, "trace:vpid", dom_print);
+		ctf_text_printf(&pos->out, "%d", trace->env.vpid);
+		put_header_end(pos);
+		dom_print = 1;
+	}
+	if ((opt_loglevel_field || opt_all_fields) && event_class->loglevel != -1) {
+		int loglevel = event_class->loglevel;
+
+		put_header_start(pos, "loglevel", dom_print);
+		ctf_text_printf(&pos->out, "%s (%d)",
+			loglevel >= 0 && loglevel < G_N_ELEMENTS(loglevels) ?
+				loglevels[loglevel] : "<<UNKNOWN>>",
+			loglevel);
+		put_header_end(pos);
+		dom_print = 1;
+	}
+	if ((opt_emf_field || opt_all_fields) && event_class->model_emf_uri) {
+		put_header_start(pos, "model.emf.uri", dom_print);
+		ctf_text_printf(&pos->out, "\"%s\"",
+			g_quark_to_string(event_class->model_emf_uri));
+		put_header_end(pos);
+		dom_print = 1;
+	}
+	if (opt_callsite_field || opt_all_fields) {
+		struct ctf_callsite_dups *cs_dups;
+		struct ctf_callsite *callsite;
+
+		cs_dups = g_hash_table_lookup(trace->callsites,
+				(gpointer) (unsigned long) event_class->name);
+		if (cs_dups) {
+			int i = 0;
+
+			put_header_start(pos, "callsite", dom_print);
+			ctf_text_putc(&pos->out, '[');
+			bt_list_for_each_entry(callsite, &cs_dups->head, node) {
+				if (i++ != 0)
+					ctf_text_putc(&pos->out, ',');
+				if (CTF_CALLSITE_FIELD_IS_SET(callsite, ip))
+					ctf_text_printf(&pos->out,
+						"%s@0x%" PRIx64 ":%s:%" PRIu64,
+						callsite->func, callsite->ip,
+						callsite->file, callsite->line);
+				else
+					ctf_text_printf(&pos->out,
+						"%s:%s:%" PRIu64,
+						callsite->func, callsite->file,
+						callsite->line);
+			}
+			ctf_text_putc(&pos->out, ']');
+			put_header_end(pos);
+			dom_print = 1;
+		}
+	}
+	if (dom_print && !pos->print_names)
+		ctf_text_putc(&pos->out, ' ');
+	set_field_names_print(pos, ITEM_HEADER);
+	if (pos->print_names)
+		ctf_text_puts(&pos->out, "name = ");
+	ctf_text_puts(&pos->out, g_quark_to_string(event_class->name));
+	if (pos->print_names)
+		pos->field_nr++;
+	else
+		ctf_text_putc(&pos->out, ':');
+
+	if (!ret && stream->stream_packet_context)
+		ret = put_scope(pos, "stream.packet.context", ITEM_CONTEXT,
+			&stream->stream_packet_context->p);
+	if (!ret && babeltrace_verbose && stream->stream_event_header)
+		ret = put_scope(pos, "stream.event.header", ITEM_CONTEXT,
+			&stream->stream_event_header->p);
+	if (!ret && stream->stream_event_context)
+		ret = put_scope(pos, "stream.event.context", ITEM_CONTEXT,
+			&stream->stream_event_context->p);
+	if (!ret && event->event_context)
+		ret = put_scope(pos, "event.context", ITEM_CONTEXT,
+			&event->event_context->p);
+	if (!ret && event->event_fields)
+		ret = put_scope(pos, "event.fields", ITEM_PAYLOAD,
+			&event->event_fields->p);
+	ctf_text_putc(&pos->out, '\n');
+	pos->field_nr = 0;
+	return ret;
+}
+
+static
+struct ctf_text_stream_pos *open_text_output(struct bt_format *fmt)
+{
+	struct bt_trace_descriptor *td;
+	struct ctf_text_stream_pos *pos;
+
+	td = fmt->open_trace("/dev/null", O_RDWR, NULL, NULL);
+	if (!td)
+		return NULL;
+	pos = container_of(td, struct ctf_text_stream_pos, trace_descriptor);
+	/* Keep the text of each event in the output buffer. */
+	pos->out.line_buffered = 0;
+	return pos;
+}
+
+/*
+ * Write all the events of the trace through templates and field by
+ * field, and count the events whose text differs.
+ */
+static
+void run_case(const char *path, struct bt_context *ctx,
+		struct ctf_text_stream_pos *tmpl_pos,
+		struct ctf_text_stream_pos *ref_pos, const struct option_case *c)
+{
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	unsigned int nr_events = 0, nr_errors = 0;
+
+	set_options(c);
+	tmpl_pos->last_real_timestamp = ref_pos->last_real_timestamp = -1ULL;
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		skip(1, "Cannot create valid iterator");
+		return;
+	}
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		struct ctf_stream_definition *stream = event->parent->stream;
+		int ret;
+
+		tmpl_pos->out.len = 0;
+		ref_pos->out.len = 0;
+		ret = tmpl_pos->parent.event_cb(&tmpl_pos->parent, stream);
+		ret |= write_event_fields(ref_pos, stream);
+		if (ret || tmpl_pos->out.len != ref_pos->out.len
+				|| memcmp(tmpl_pos->out.data, ref_pos->out.data,
+					ref_pos->out.len)) {
+			if (!nr_errors)
+				diag("Event %u: template \"%.*s\", fields \"%.*s\"",
+					nr_events, (int) tmpl_pos->out.len,
+					tmpl_pos->out.data, (int) ref_pos->out.len,
+					ref_pos->out.data);
+			nr_errors++;
+		}
+		nr_events++;
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0)
+			break;
+	}
+	tmpl_pos->out.len = 0;
+	ref_pos->out.len = 0;
+	ok(nr_events && nr_errors == 0,
+		"%s: --names %s --fields %s%s: %u of %u events match",
+		path, c->names, c->fields ? c->fields : "(default)",
+		c->verbose ? " -v" : "", nr_events - nr_errors, nr_events);
+	bt_ctf_iter_destroy(iter);
+}
+
+static
+void test_trace(const char *path, struct bt_format *fmt)
+{
+	struct ctf_text_stream_pos *tmpl_pos, *ref_pos;
+	struct bt_context *ctx = NULL;
+	unsigned int i;
+
+	tmpl_pos = open_text_output(fmt);
+	ref_pos = open_text_output(fmt);
+	if (!tmpl_pos || !ref_pos) {
+		skip(NR_TRACE_TESTS, "Cannot open text output");
+		goto end;
+	}
+	ctx = create_context_with_path(path);
+	if (!ctx) {
+		skip(NR_TRACE_TESTS, "Cannot create valid context");
+		goto end;
+	}
+	/* The templates of the events are recompiled for each case. */
+	for (i = 0; i < NR_CASES; i++)
+		run_case(path, ctx, tmpl_pos, ref_pos, &cases[i]);
+
+	/*
+	 * Closing the trace while the output stays open, as lttng-live
+	 * does, drops the templates of its event definitions. The event
+	 * definitions of the trace opened again may reuse their addresses.
+	 */
+	bt_context_put(ctx);
+	ok(g_hash_table_size(tmpl_pos->templates) == 0,
+		"%s: templates dropped with the trace", path);
+	ctx = create_context_with_path(path);
+	if (!ctx) {
+		skip(1, "Cannot create valid context");
+		goto end;
+	}
+	run_case(path, ctx, tmpl_pos, ref_pos, &cases[0]);
+end:
+	if (tmpl_pos)
+		fmt->close_trace(&tmpl_pos->trace_descriptor);
+	if (ref_pos)
+		fmt->close_trace(&ref_pos->trace_descriptor);
+	if (ctx)
+		bt_context_put(ctx);
+}
+
+int main(int argc, char **argv)
+{
+	struct bt_format *fmt;
+	int i;
+
+	/*
+	 * Side-effects ensuring libs are not optimized away by static
+	 * linking.
+	 */
+	babeltrace_debug = 0;	/* libbabeltrace.la */
+	opt_clock_offset = 0;	/* libbabeltrace-ctf.la */
+	opt_delta_field = 1;	/* libbabeltrace-ctf-text.la */
+
+	if (argc < 2) {
+		plan_tests(1);
+		diag("Invalid arguments: need trace paths");
+		ok(0, "Trace paths given");
+		return exit_status();
+	}
+	plan_tests(NR_TRACE_TESTS * (argc - 1));
+
+	fmt = bt_lookup_format(g_quark_from_static_string("text"));
+	if (!fmt) {
+		skip(NR_TRACE_TESTS * (argc - 1), "Cannot find text format");
+		return exit_status();
+	}
+	for (i = 1; i < argc; i++)
+		test_trace(argv[i], fmt);
+	return exit_status();
+}
@@ -0,0 +1,188 @@
+/*
+ * test_time_index.c
+ *
+ * Lib BabelTrace - Time index seek test program
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#define _GNU_SOURCE
+#include <babeltrace/context.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/babeltrace-internal.h>	/* For symbol side-effects */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <glib.h>
+
+#include <tap/tap.h>
+#include "common.h"
+
+#define NR_TESTS	5
+
+/* Seek to every SEEK_STRIDE-th event, most of them inside packets. */
+#define SEEK_STRIDE	7
+
+/*
+ * Read the whole trace, returning the timestamps of its events. Closing
+ * the trace writes the time index of its stream files.
+ */
+static
+GArray *read_timestamps(const char *path)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_ctf_event *event;
+	GArray *timestamps;
+
+	ctx = create_context_with_path(path);
+	if (!ctx)
+		return NULL;
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		bt_context_put(ctx);
+		return NULL;
+	}
+	timestamps = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		uint64_t timestamp = bt_ctf_get_timestamp(event);
+
+		g_array_append_val(timestamps, timestamp);
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0)
+			break;
+	}
+	bt_ctf_iter_destroy(iter);
+	bt_context_put(ctx);
+	return timestamps;
+}
+
+static
+int count_time_indexes(void)
+{
+	char *index_dir;
+	struct dirent *entry;
+	DIR *dir;
+	int count = 0;
+
+	index_dir = g_strdup_printf("%s/babeltrace/index",
+			g_get_user_cache_dir());
+	dir = opendir(index_dir);
+	g_free(index_dir);
+	if (!dir)
+		return 0;
+	while ((entry = readdir(dir))) {
+		size_t len = strlen(entry->d_name);
+
+		if (len > 5 && !strcmp(entry->d_name + len - 5, ".tidx"))
+			count++;
+	}
+	closedir(dir);
+	return count;
+}
+
+/*
+ * Seek by time to the timestamps of a sample of the events, and check
+ * that each seek lands on an event with that timestamp.
+ */
+static
+void run_seek_time(const char *path, GArray *timestamps)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter;
+	struct bt_iter_pos newpos;
+	unsigned int i, nr_seeks = 0, nr_errors = 0;
+
+	ctx = create_context_with_path(path);
+	ok(ctx, "Trace reopened with its time index");
+	if (!ctx) {
+		skip(1, "Cannot create valid context");
+		return;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		skip(1, "Cannot create valid iterator");
+		bt_context_put(ctx);
+		return;
+	}
+	newpos.type = BT_SEEK_TIME;
+	for (i = SEEK_STRIDE / 2; i < timestamps->len; i += SEEK_STRIDE) {
+		uint64_t expected = g_array_index(timestamps, uint64_t, i);
+		struct bt_ctf_event *event;
+		uint64_t timestamp = 0;
+
+		newpos.u.seek_time = expected;
+		nr_seeks++;
+		if (bt_iter_set_pos(bt_ctf_get_iter(iter), &newpos)) {
+			diag("Seek to %" PRIu64 " failed", expected);
+			nr_errors++;
+			continue;
+		}
+		event = bt_ctf_iter_read_event(iter);
+		if (event)
+			timestamp = bt_ctf_get_timestamp(event);
+		if (!event || timestamp != expected) {
+			diag("Seek to %" PRIu64 " read event at %" PRIu64,
+				expected, timestamp);
+			nr_errors++;
+		}
+	}
+	ok(nr_errors == 0, "%u of %u seeks by time land on the right event",
+		nr_seeks - nr_errors, nr_seeks);
+	bt_ctf_iter_destroy(iter);
+	bt_context_put(ctx);
+}
+
+int main(int argc, char **argv)
+{
+	char *path;
+	GArray *timestamps;
+
+	/*
+	 * Side-effects ensuring libs are not optimized away by static
+	 * linking.
+	 */
+	babeltrace_debug = 0;	/* libbabeltrace.la */
+
+	plan_tests(NR_TESTS);
+
+	if (argc < 2) {
+		diag("Invalid arguments: need a trace path");
+		goto end;
+	}
+	path = argv[1];
+
+	/* The caller points XDG_CACHE_HOME to an empty directory. */
+	opt_time_index = 1;
+
+	/* Record the time index */
+	timestamps = read_timestamps(path);
+	ok(timestamps && timestamps->len > SEEK_STRIDE,
+		"Trace read while recording its time index");
+	if (!timestamps) {
+		skip(NR_TESTS - 1, "Cannot read trace");
+		goto end;
+	}
+	ok(count_time_indexes() > 0, "Time index recorded");
+
+	/* Seek through the imported time index */
+	run_seek_time(path, timestamps);
+	ok(count_time_indexes() > 0, "Time index kept");
+	g_array_free(timestamps, TRUE);
+end:
+	return exit_status();
+}
@@ -0,0 +1,241 @@
+/*
+ * test_variant.c
+ *
+ * Lib BabelTrace - Variant field selection test program
+ *
+ * Check the field selected by variants through the table built for their
+ * tag enumeration, and through the tag quark lookup used when the table
+ * does not apply.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <babeltrace/types.h>
+#include <babeltrace/babeltrace-internal.h>	/* For symbol side-effects */
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <endian.h>
+#include <glib.h>
+
+#include <tap/tap.h>
+
+#define NR_TESTS	5
+
+struct mapping {
+	const char *label;
+	uint64_t start, end;
+};
+
+/* "c" selects no field of the variant, 10 is unmapped. */
+static const struct mapping mappings_a[] = {
+	{ "a", 0, 0 },
+	{ "b", 1, 2 },
+	{ "c", 3, 3 },
+};
+
+static const struct mapping mappings_b[] = {
+	{ "b", 0, 0 },
+	{ "a", 1, 5 },
+};
+
+/* Expected field for each tag value, NULL if none */
+struct expect {
+	uint64_t value;
+	const char *field;
+};
+
+static const struct expect expect_a[] = {
+	{ 0, "a" }, { 1, "b" }, { 2, "b" }, { 3, NULL }, { 10, NULL },
+};
+
+static const struct expect expect_b[] = {
+	{ 0, "b" }, { 1, "a" }, { 5, "a" }, { 6, NULL },
+};
+
+static
+struct declaration_enum *create_enum(const struct mapping *mappings,
+		unsigned int nr_mappings)
+{
+	struct declaration_integer *integer_declaration;
+	struct declaration_enum *enum_declaration;
+	unsigned int i;
+
+	integer_declaration = bt_integer_declaration_new(8, BYTE_ORDER,
+		0, 8, 10, CTF_STRING_NONE, NULL);
+	enum_declaration = bt_enum_declaration_new(integer_declaration);
+	bt_declaration_unref(&integer_declaration->p);
+	for (i = 0; i < nr_mappings; i++)
+		bt_enum_unsigned_insert(enum_declaration, mappings[i].start,
+			mappings[i].end,
+			g_quark_from_static_string(mappings[i].label));
+	return enum_declaration;
+}
+
+static
+struct declaration_untagged_variant *create_untagged_variant(void)
+{
+	struct declaration_untagged_variant *untagged_variant;
+	struct declaration_integer *integer_declaration;
+
+	integer_declaration = bt_integer_declaration_new(32, BYTE_ORDER,
+		0, 8, 10, CTF_STRING_NONE, NULL);
+	untagged_variant = bt_untagged_bt_variant_declaration_new(NULL);
+	bt_untagged_variant_declaration_add_field(untagged_variant, "a",
+		&integer_declaration->p);
+	bt_untagged_variant_declaration_add_field(untagged_variant, "b",
+		&integer_declaration->p);
+	bt_declaration_unref(&integer_declaration->p);
+	return untagged_variant;
+}
+
+/* struct { enum tag; variant <tag> v; } */
+static
+struct definition_struct *create_definition(struct declaration_enum *tag,
+		struct declaration_variant *variant_declaration)
+{
+	struct declaration_struct *struct_declaration;
+	struct bt_definition *definition;
+
+	struct_declaration = bt_struct_declaration_new(NULL, 1);
+	bt_struct_declaration_add_field(struct_declaration, "tag", &tag->p);
+	bt_struct_declaration_add_field(struct_declaration, "v",
+		&variant_declaration->p);
+	definition = struct_declaration->p.definition_new(&struct_declaration->p,
+		NULL, 0, 0, "event.fields");
+	bt_declaration_unref(&struct_declaration->p);
+	if (!definition)
+		return NULL;
+	return container_of(definition, struct definition_struct, p);
+}
+
+/* Set the tag value as reading it does. */
+static
+void set_tag(struct definition_enum *enum_definition, uint64_t value)
+{
+	enum_definition->integer->value._unsigned = value;
+	enum_definition->interval = bt_enum_value_to_interval(
+		enum_definition->declaration, value);
+	if (enum_definition->value)
+		g_array_unref(enum_definition->value);
+	enum_definition->value = bt_enum_uint_to_quark_set(
+		enum_definition->declaration, value);
+}
+
+/*
+ * Check the field selected for each tag value. With clear_quarks, the
+ * quark set of the tag is dropped, so that only the interval is left
+ * to select the field. Returns the number of mismatches.
+ */
+static
+unsigned int check_fields(struct definition_struct *struct_definition,
+		const struct expect *expect, unsigned int nr_expect,
+		int clear_quarks)
+{
+	struct definition_enum *enum_definition;
+	struct definition_variant *variant;
+	unsigned int i, nr_errors = 0;
+
+	enum_definition = container_of(
+		bt_struct_definition_get_field_from_index(struct_definition, 0),
+		struct definition_enum, p);
+	variant = container_of(
+		bt_struct_definition_get_field_from_index(struct_definition, 1),
+		struct definition_variant, p);
+	for (i = 0; i < nr_expect; i++) {
+		struct bt_definition *field;
+		const char *name;
+
+		set_tag(enum_definition, expect[i].value);
+		if (clear_quarks && enum_definition->value) {
+			g_array_unref(enum_definition->value);
+			enum_definition->value = NULL;
+		}
+		field = bt_variant_get_current_field(variant);
+		name = field ? g_quark_to_string(field->name) : NULL;
+		if (!name != !expect[i].field
+				|| (name && strcmp(name, expect[i].field))) {
+			diag("Tag %" PRIu64 " selects field %s, expected %s",
+				expect[i].value, name ? name : "none",
+				expect[i].field ? expect[i].field : "none");
+			nr_errors++;
+		}
+	}
+	return nr_errors;
+}
+
+int main(int argc, char **argv)
+{
+	struct declaration_untagged_variant *untagged_variant;
+	struct declaration_variant *variant_declaration, *untabled_declaration;
+	struct declaration_enum *enum_a, *enum_b;
+	struct definition_struct *def_a, *def_b, *def_untabled;
+	unsigned int nr_errors;
+
+	/*
+	 * Side-effects ensuring libs are not optimized away by static
+	 * linking.
+	 */
+	babeltrace_debug = 0;	/* libbabeltrace.la */
+
+	plan_tests(NR_TESTS);
+
+	enum_a = create_enum(mappings_a, G_N_ELEMENTS(mappings_a));
+	enum_b = create_enum(mappings_b, G_N_ELEMENTS(mappings_b));
+	untagged_variant = create_untagged_variant();
+	variant_declaration = bt_variant_declaration_new(untagged_variant, "tag");
+	untabled_declaration = bt_variant_declaration_new(untagged_variant, "tag");
+	bt_declaration_unref(&untagged_variant->p);
+
+	/* Only the first tag enumeration gets a table. */
+	bt_variant_declaration_set_tag_enum(variant_declaration, enum_a);
+	bt_variant_declaration_set_tag_enum(variant_declaration, enum_b);
+	ok(variant_declaration->tag_enum == enum_a
+		&& variant_declaration->tag_fields->len
+			== enum_a->table.intervals->len,
+		"Tag table built for the first tag enumeration");
+
+	def_a = create_definition(enum_a, variant_declaration);
+	def_b = create_definition(enum_b, variant_declaration);
+	def_untabled = create_definition(enum_a, untabled_declaration);
+	if (!def_a || !def_b || !def_untabled) {
+		skip(NR_TESTS - 1, "Cannot create definitions");
+		return exit_status();
+	}
+
+	nr_errors = check_fields(def_a, expect_a, G_N_ELEMENTS(expect_a), 1);
+	ok(nr_errors == 0, "Fast path selects fields by tag interval (%u errors)",
+		nr_errors);
+	nr_errors = check_fields(def_a, expect_a, G_N_ELEMENTS(expect_a), 0);
+	ok(nr_errors == 0, "Fallback for unmapped tags and tags without a "
+		"field (%u errors)", nr_errors);
+	nr_errors = check_fields(def_b, expect_b, G_N_ELEMENTS(expect_b), 0);
+	ok(nr_errors == 0, "Fallback for another tag enumeration (%u errors)",
+		nr_errors);
+	nr_errors = check_fields(def_untabled, expect_a,
+		G_N_ELEMENTS(expect_a), 0);
+	ok(nr_errors == 0, "Fallback without tag table (%u errors)",
+		nr_errors);
+
+	bt_definition_unref(&def_a->p);
+	bt_definition_unref(&def_b->p);
+	bt_definition_unref(&def_untabled->p);
+	bt_declaration_unref(&variant_declaration->p);
+	bt_declaration_unref(&untabled_declaration->p);
+	bt_declaration_unref(&enum_a->p);
+	bt_declaration_unref(&enum_b->p);
+	return exit_status();
+}
@@ -47,6 +47,7 @@ int bt_array_rw(struct bt_stream_pos *pos, struct bt_definition *definition)
 	uint64_t i;
 	int ret;
 
+	bt_array_unpack(array_definition);
 	/* No need to align, because the first field will align itself. */
 	for (i = 0; i < array_declaration->len; i++) {
 		struct bt_definition *field =
@@ -122,6 +123,8 @@ struct bt_definition *
 	assert(!ret);
 	array->string = NULL;
 	array->elems = NULL;
+	array->packed = NULL;
+	array->elems_stale = 0;
 
 	if (array_declaration->elem->id == CTF_TYPE_INTEGER) {
 		struct declaration_integer *integer_declaration =
@@ -133,6 +136,8 @@ struct bt_definition *
 			array->string = g_string_new("");
 		}
 	}
+	if (bt_integer_declaration_packable(array_declaration->elem))
+		array->packed = g_byte_array_new();
 
 	array->elems = g_ptr_array_sized_new(array_declaration->len);
 	g_ptr_array_set_size(array->elems, array_declaration->len);
@@ -164,6 +169,8 @@ error:
 		field->declaration->definition_free(field);
 	}
 	(void) g_ptr_array_free(array->elems, TRUE);
+	if (array->packed)
+		(void) g_byte_array_free(array->packed, TRUE);
 	bt_free_definition_scope(array->p.scope);
 	bt_declaration_unref(array->p.declaration);
 	g_free(array);
@@ -188,6 +195,8 @@ void _array_definition_free(struct bt_definition *definition)
 		}
 		(void) g_ptr_array_free(array->elems, TRUE);
 	}
+	if (array->packed)
+		(void) g_byte_array_free(array->packed, TRUE);
 	bt_free_definition_scope(array->p.scope);
 	bt_declaration_unref(array->p.declaration);
 	g_free(array);
@@ -206,9 +215,22 @@ struct bt_definition *bt_array_index(struct definition_array *array, uint64_t i)
 		return NULL;
 	if (i >= array->elems->len)
 		return NULL;
+	bt_array_unpack(array);
 	return g_ptr_array_index(array->elems, i);
 }
 
+/*
+ * Update the element definitions of an array read packed.
+ */
+void bt_array_unpack(struct definition_array *array)
+{
+	if (!array->elems_stale)
+		return;
+	bt_integer_unpack((struct bt_definition **) array->elems->pdata,
+		array->elems->len, array->packed);
+	array->elems_stale = 0;
+}
+
 int bt_get_array_len(const struct bt_definition *field)
 {
 	struct definition_array *array_definition;
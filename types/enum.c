@@ -121,50 +121,234 @@ void enum_val_free(void *ptr)
 #endif /* WORD_SIZE != 32 */
 
 /*
- * Returns a GArray or NULL.
- * Caller must release the GArray with g_array_unref().
+ * Mapping of a range of lookup keys to a quark, ordered by its position
+ * within the quark sets.
  */
-GArray *bt_enum_uint_to_quark_set(const struct declaration_enum *enum_declaration,
-			       uint64_t v)
+struct enum_mapping {
+	uint64_t start;
+	uint64_t end;
+	GQuark quark;
+	unsigned int order;
+};
+
+/* Lookup key of a value (see struct enum_interval). */
+static inline
+uint64_t enum_key(const struct declaration_enum *enum_declaration, uint64_t v)
+{
+	if (enum_declaration->integer_declaration->signedness)
+		return v ^ (1ULL << 63);
+	return v;
+}
+
+static
+gint compare_mapping_start(gconstpointer a, gconstpointer b)
 {
+	const struct enum_mapping *ma = a, *mb = b;
+
+	if (ma->start < mb->start)
+		return -1;
+	return ma->start > mb->start;
+}
+
+static
+gint compare_key(gconstpointer a, gconstpointer b)
+{
+	uint64_t ka = *(const uint64_t *) a, kb = *(const uint64_t *) b;
+
+	if (ka < kb)
+		return -1;
+	return ka > kb;
+}
+
+static
+void enum_add_mapping(GArray *mappings, GArray *keys, uint64_t start,
+		uint64_t end, GQuark quark, unsigned int order)
+{
+	struct enum_mapping mapping;
+
+	mapping.start = start;
+	mapping.end = end;
+	mapping.quark = quark;
+	mapping.order = order;
+	g_array_append_val(mappings, mapping);
+	/* The mapping covers the intervals from start up to end + 1. */
+	g_array_append_val(keys, start);
+	if (end != UINT64_MAX) {
+		end++;
+		g_array_append_val(keys, end);
+	}
+}
+
+static
+void enum_free_index(struct enum_table *table)
+{
+	unsigned int i;
+
+	if (!table->intervals)
+		return;
+	for (i = 0; i < table->intervals->len; i++) {
+		GArray *quarks = g_array_index(table->intervals,
+				struct enum_interval, i).quarks;
+
+		if (quarks)
+			g_array_unref(quarks);
+	}
+	g_array_free(table->intervals, TRUE);
+	table->intervals = NULL;
+}
+
+void bt_enum_build_index(struct declaration_enum *enum_declaration)
+{
+	struct enum_table *table = &enum_declaration->table;
 	struct enum_range_to_quark *iter;
-	GArray *qs, *ranges = NULL;
+	GArray *mappings, *keys, *active;
+	GHashTableIter hash_iter;
+	gpointer key, value;
+	unsigned int i, j, next = 0, order;
 
-	/* Single values lookup */
-	qs = g_hash_table_lookup(enum_declaration->table.value_to_quark_set,
-				 get_uint_v(&v));
+	enum_free_index(table);
+	mappings = g_array_new(FALSE, FALSE, sizeof(struct enum_mapping));
+	keys = g_array_new(FALSE, FALSE, sizeof(uint64_t));
 
-	/* Range lookup */
-	bt_list_for_each_entry(iter, &enum_declaration->table.range_to_quark, node) {
-		if (iter->range.start._unsigned > v || iter->range.end._unsigned < v)
+	/* Single value quarks come first in the sets, then ranges. */
+	g_hash_table_iter_init(&hash_iter, table->value_to_quark_set);
+	while (g_hash_table_iter_next(&hash_iter, &key, &value)) {
+		GArray *qs = value;
+		uint64_t v;
+
+#if (WORD_SIZE == 32)
+		v = *(uint64_t *) key;
+#else  /* WORD_SIZE != 32 */
+		v = (uint64_t) (unsigned long) key;
+#endif /* WORD_SIZE != 32 */
+		v = enum_key(enum_declaration, v);
+		for (i = 0; i < qs->len; i++)
+			enum_add_mapping(mappings, keys, v, v,
+				g_array_index(qs, GQuark, i), i);
+	}
+	order = mappings->len;
+	bt_list_for_each_entry(iter, &table->range_to_quark, node) {
+		enum_add_mapping(mappings, keys,
+			enum_key(enum_declaration, iter->range.start._unsigned),
+			enum_key(enum_declaration, iter->range.end._unsigned),
+			iter->quark, order++);
+	}
+	g_array_sort(mappings, compare_mapping_start);
+	g_array_sort(keys, compare_key);
+	for (i = 0, j = 0; i < keys->len; i++) {
+		if (j && g_array_index(keys, uint64_t, j - 1)
+				== g_array_index(keys, uint64_t, i))
 			continue;
-		if (!ranges) {
-			size_t qs_len = 0;
-
-			if (qs)
-				qs_len = qs->len;
-			ranges = g_array_sized_new(FALSE, TRUE,
-					sizeof(GQuark),
-					qs_len + 1);
-			g_array_set_size(ranges, qs_len + 1);
-			if (qs)
-				memcpy(ranges->data, qs->data,
-				       sizeof(GQuark) * qs_len);
-			g_array_index(ranges, GQuark, qs_len) = iter->quark;
-		} else {
-			size_t qs_len = ranges->len;
-
-			g_array_set_size(ranges, qs_len + 1);
-			g_array_index(ranges, GQuark, qs_len) = iter->quark;
+		g_array_index(keys, uint64_t, j++) =
+			g_array_index(keys, uint64_t, i);
+	}
+	g_array_set_size(keys, j);
+
+	/*
+	 * Sweep the interval boundaries, keeping the set of mappings
+	 * covering the current interval sorted by order.
+	 */
+	active = g_array_new(FALSE, FALSE, sizeof(struct enum_mapping));
+	table->intervals = g_array_sized_new(FALSE, FALSE,
+			sizeof(struct enum_interval), keys->len);
+	for (i = 0; i < keys->len; i++) {
+		struct enum_interval interval;
+
+		interval.start = g_array_index(keys, uint64_t, i);
+		for (j = 0; j < active->len; ) {
+			if (g_array_index(active, struct enum_mapping, j).end
+					< interval.start)
+				g_array_remove_index(active, j);
+			else
+				j++;
+		}
+		while (next < mappings->len
+				&& g_array_index(mappings, struct enum_mapping,
+					next).start == interval.start) {
+			struct enum_mapping *mapping =
+				&g_array_index(mappings, struct enum_mapping,
+					next++);
+
+			for (j = 0; j < active->len; j++) {
+				if (g_array_index(active, struct enum_mapping,
+						j).order > mapping->order)
+					break;
+			}
+			g_array_insert_val(active, j, *mapping);
 		}
+		interval.quarks = NULL;
+		if (active->len) {
+			interval.quarks = g_array_sized_new(FALSE, TRUE,
+					sizeof(GQuark), active->len);
+			for (j = 0; j < active->len; j++)
+				g_array_append_val(interval.quarks,
+					g_array_index(active,
+						struct enum_mapping, j).quark);
+		}
+		g_array_append_val(table->intervals, interval);
 	}
-	if (!ranges) {
-		if (!qs)
-			return NULL;
-		ranges = qs;
-		g_array_ref(ranges);
+	g_array_free(active, TRUE);
+	g_array_free(keys, TRUE);
+	g_array_free(mappings, TRUE);
+}
+
+static
+int enum_key_to_interval(const struct declaration_enum *enum_declaration,
+		uint64_t key)
+{
+	GArray *intervals = enum_declaration->table.intervals;
+	unsigned int low = 0, high;
+
+	if (!intervals) {
+		bt_enum_build_index((struct declaration_enum *) enum_declaration);
+		intervals = enum_declaration->table.intervals;
+	}
+	/* Find the last interval starting at or before key. */
+	high = intervals->len;
+	while (low < high) {
+		unsigned int mid = low + (high - low) / 2;
+
+		if (g_array_index(intervals, struct enum_interval, mid).start
+				<= key)
+			low = mid + 1;
+		else
+			high = mid;
 	}
-	return ranges;
+	if (!low || !g_array_index(intervals, struct enum_interval,
+			low - 1).quarks)
+		return -1;
+	return low - 1;
+}
+
+static
+GArray *enum_key_to_quark_set(const struct declaration_enum *enum_declaration,
+		uint64_t key)
+{
+	int interval;
+
+	interval = enum_key_to_interval(enum_declaration, key);
+	if (interval < 0)
+		return NULL;
+	return g_array_ref(g_array_index(enum_declaration->table.intervals,
+			struct enum_interval, interval).quarks);
+}
+
+int bt_enum_value_to_interval(const struct declaration_enum *enum_declaration,
+			uint64_t v)
+{
+	return enum_key_to_interval(enum_declaration,
+			enum_key(enum_declaration, v));
+}
+
+/*
+ * Returns a GArray or NULL.
+ * Caller must release the GArray with g_array_unref().
+ */
+GArray *bt_enum_uint_to_quark_set(const struct declaration_enum *enum_declaration,
+			       uint64_t v)
+{
+	return enum_key_to_quark_set(enum_declaration,
+			enum_key(enum_declaration, v));
 }
 
 /*
@@ -174,44 +358,8 @@ GArray *bt_enum_uint_to_quark_set(const struct declaration_enum *enum_declaratio
 GArray *bt_enum_int_to_quark_set(const struct declaration_enum *enum_declaration,
 			      int64_t v)
 {
-	struct enum_range_to_quark *iter;
-	GArray *qs, *ranges = NULL;
-
-	/* Single values lookup */
-	qs = g_hash_table_lookup(enum_declaration->table.value_to_quark_set,
-				 get_int_v(&v));
-
-	/* Range lookup */
-	bt_list_for_each_entry(iter, &enum_declaration->table.range_to_quark, node) {
-		if (iter->range.start._signed > v || iter->range.end._signed < v)
-			continue;
-		if (!ranges) {
-			size_t qs_len = 0;
-
-			if (qs)
-				qs_len = qs->len;
-			ranges = g_array_sized_new(FALSE, TRUE,
-					sizeof(GQuark),
-					qs_len + 1);
-			g_array_set_size(ranges, qs_len + 1);
-			if (qs)
-				memcpy(ranges->data, qs->data,
-				       sizeof(GQuark) * qs_len);
-			g_array_index(ranges, GQuark, qs_len) = iter->quark;
-		} else {
-			size_t qs_len = ranges->len;
-
-			g_array_set_size(ranges, qs_len + 1);
-			g_array_index(ranges, GQuark, qs_len) = iter->quark;
-		}
-	}
-	if (!ranges) {
-		if (!qs)
-			return NULL;
-		ranges = qs;
-		g_array_ref(ranges);
-	}
-	return ranges;
+	return enum_key_to_quark_set(enum_declaration,
+			enum_key(enum_declaration, (uint64_t) v));
 }
 
 static
@@ -305,6 +453,8 @@ void bt_enum_signed_insert(struct declaration_enum *enum_declaration,
 	GArray *array;
 	struct enum_range *range;
 
+	enum_free_index(&enum_declaration->table);
+
 	if (start == end) {
 		bt_enum_signed_insert_value_to_quark_set(enum_declaration, start, q);
 	} else {
@@ -339,6 +489,7 @@ void bt_enum_unsigned_insert(struct declaration_enum *enum_declaration,
 	GArray *array;
 	struct enum_range *range;
 
+	enum_free_index(&enum_declaration->table);
 
 	if (start == end) {
 		bt_enum_unsigned_insert_value_to_quark_set(enum_declaration, start, q);
@@ -386,6 +537,7 @@ void _enum_declaration_free(struct bt_declaration *declaration)
 		g_free(iter);
 	}
 	g_hash_table_destroy(enum_declaration->table.quark_to_range_set);
+	enum_free_index(&enum_declaration->table);
 	bt_declaration_unref(&enum_declaration->integer_declaration->p);
 	g_free(enum_declaration);
 }
@@ -405,6 +557,7 @@ struct declaration_enum *
 	enum_declaration->table.quark_to_range_set = g_hash_table_new_full(g_direct_hash,
 							g_direct_equal,
 							NULL, enum_range_set_free);
+	enum_declaration->table.intervals = NULL;
 	bt_declaration_ref(&integer_declaration->p);
 	enum_declaration->integer_declaration = integer_declaration;
 	enum_declaration->p.id = CTF_TYPE_ENUM;
@@ -443,6 +596,7 @@ struct bt_definition *
 	_enum->p.path = bt_new_definition_path(parent_scope, field_name, root_name);
 	_enum->p.scope = bt_new_definition_scope(parent_scope, field_name, root_name);
 	_enum->value = NULL;
+	_enum->interval = -1;
 	ret = bt_register_field_definition(field_name, &_enum->p,
 					parent_scope);
 	assert(!ret);
@@ -201,3 +201,78 @@ int64_t bt_get_signed_int(const struct bt_definition *field)
 		g_quark_to_string(field->name));
 	return (int64_t)integer_definition->value._unsigned;
 }
+
+int bt_integer_declaration_packable(struct bt_declaration *declaration)
+{
+	struct declaration_integer *integer_declaration;
+
+	if (declaration->id != CTF_TYPE_INTEGER)
+		return 0;
+	integer_declaration =
+		container_of(declaration, struct declaration_integer, p);
+	if (integer_declaration->encoding != CTF_STRING_NONE)
+		return 0;
+	switch (integer_declaration->len) {
+	case 8:
+	case 16:
+	case 32:
+	case 64:
+		break;
+	default:
+		return 0;
+	}
+	return !(declaration->alignment % CHAR_BIT)
+		&& !(integer_declaration->len % declaration->alignment);
+}
+
+#define UNPACK_INTEGERS(type, member)					\
+	for (i = 0; i < len; i++)					\
+		container_of(elems[i], struct definition_integer, p)	\
+			->value.member = ((const type *) packed->data)[i]
+
+void bt_integer_unpack(struct bt_definition **elems, uint64_t len,
+		const GByteArray *packed)
+{
+	const struct declaration_integer *integer_declaration;
+	uint64_t i;
+
+	if (!len)
+		return;
+	integer_declaration = container_of(elems[0],
+			struct definition_integer, p)->declaration;
+	if (integer_declaration->signedness) {
+		switch (integer_declaration->len) {
+		case 8:
+			UNPACK_INTEGERS(int8_t, _signed);
+			break;
+		case 16:
+			UNPACK_INTEGERS(int16_t, _signed);
+			break;
+		case 32:
+			UNPACK_INTEGERS(int32_t, _signed);
+			break;
+		case 64:
+			UNPACK_INTEGERS(int64_t, _signed);
+			break;
+		default:
+			assert(0);
+		}
+	} else {
+		switch (integer_declaration->len) {
+		case 8:
+			UNPACK_INTEGERS(uint8_t, _unsigned);
+			break;
+		case 16:
+			UNPACK_INTEGERS(uint16_t, _unsigned);
+			break;
+		case 32:
+			UNPACK_INTEGERS(uint32_t, _unsigned);
+			break;
+		case 64:
+			UNPACK_INTEGERS(uint64_t, _unsigned);
+			break;
+		default:
+			assert(0);
+		}
+	}
+}
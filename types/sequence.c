@@ -39,16 +39,17 @@ struct bt_definition *_sequence_definition_new(struct bt_declaration *declaratio
 static
 void _sequence_definition_free(struct bt_definition *definition);
 
-int bt_sequence_rw(struct bt_stream_pos *pos, struct bt_definition *definition)
+/*
+ * Create the element definitions of a sequence up to len.
+ */
+static
+void sequence_grow(struct definition_sequence *sequence_definition,
+		uint64_t len)
 {
-	struct definition_sequence *sequence_definition =
-		container_of(definition, struct definition_sequence, p);
 	const struct declaration_sequence *sequence_declaration =
 		sequence_definition->declaration;
-	uint64_t len, oldlen, i;
-	int ret;
+	uint64_t oldlen, i;
 
-	len = sequence_definition->length->value._unsigned;
 	/*
 	 * Yes, large sequences could be _painfully slow_ to parse due
 	 * to memory allocation for each event read. At least, never
@@ -76,6 +77,18 @@ int bt_sequence_rw(struct bt_stream_pos *pos, struct bt_definition *definition)
 					  sequence_definition->p.scope,
 					  name, i, NULL);
 	}
+}
+
+int bt_sequence_rw(struct bt_stream_pos *pos, struct bt_definition *definition)
+{
+	struct definition_sequence *sequence_definition =
+		container_of(definition, struct definition_sequence, p);
+	uint64_t len, i;
+	int ret;
+
+	bt_sequence_unpack(sequence_definition);
+	len = sequence_definition->length->value._unsigned;
+	sequence_grow(sequence_definition, len);
 	for (i = 0; i < len; i++) {
 		struct bt_definition **field;
 
@@ -170,6 +183,8 @@ struct bt_definition *_sequence_definition_new(struct bt_declaration *declaratio
 
 	sequence->string = NULL;
 	sequence->elems = NULL;
+	sequence->packed = NULL;
+	sequence->elems_stale = 0;
 
 	if (sequence_declaration->elem->id == CTF_TYPE_INTEGER) {
 		struct declaration_integer *integer_declaration =
@@ -187,6 +202,8 @@ struct bt_definition *_sequence_definition_new(struct bt_declaration *declaratio
 		}
 	}
 
+	if (bt_integer_declaration_packable(sequence_declaration->elem))
+		sequence->packed = g_byte_array_new();
 	sequence->elems = g_ptr_array_new();
 	return &sequence->p;
 
@@ -216,6 +233,8 @@ void _sequence_definition_free(struct bt_definition *definition)
 		}
 		(void) g_ptr_array_free(sequence->elems, TRUE);
 	}
+	if (sequence->packed)
+		(void) g_byte_array_free(sequence->packed, TRUE);
 	bt_definition_unref(len_definition);
 	bt_free_definition_scope(sequence->p.scope);
 	bt_declaration_unref(sequence->p.declaration);
@@ -233,6 +252,23 @@ struct bt_definition *bt_sequence_index(struct definition_sequence *sequence, ui
 		return NULL;
 	if (i >= sequence->length->value._unsigned)
 		return NULL;
+	bt_sequence_unpack(sequence);
 	assert(i < sequence->elems->len);
 	return g_ptr_array_index(sequence->elems, i);
 }
+
+/*
+ * Update the element definitions of a sequence read packed.
+ */
+void bt_sequence_unpack(struct definition_sequence *sequence)
+{
+	uint64_t len;
+
+	if (!sequence->elems_stale)
+		return;
+	len = sequence->length->value._unsigned;
+	sequence_grow(sequence, len);
+	bt_integer_unpack((struct bt_definition **) sequence->elems->pdata,
+		len, sequence->packed);
+	sequence->elems_stale = 0;
+}
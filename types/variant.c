@@ -103,6 +103,10 @@ void _variant_declaration_free(struct bt_declaration *declaration)
 
 	bt_declaration_unref(&variant_declaration->untagged_variant->p);
 	g_array_free(variant_declaration->tag_name, TRUE);
+	if (variant_declaration->tag_enum)
+		bt_declaration_unref(&variant_declaration->tag_enum->p);
+	if (variant_declaration->tag_fields)
+		g_array_free(variant_declaration->tag_fields, TRUE);
 	g_free(variant_declaration);
 }
 
@@ -118,6 +122,8 @@ struct declaration_variant *
 	bt_declaration_ref(&untagged_variant->p);
 	variant_declaration->tag_name = g_array_new(FALSE, TRUE, sizeof(GQuark));
 	bt_append_scope_path(tag, variant_declaration->tag_name);
+	variant_declaration->tag_enum = NULL;
+	variant_declaration->tag_fields = NULL;
 	declaration->id = CTF_TYPE_VARIANT;
 	declaration->alignment = 1;
 	declaration->declaration_free = _variant_declaration_free;
@@ -127,6 +133,45 @@ struct declaration_variant *
 	return variant_declaration;
 }
 
+/*
+ * Map each interval of the tag enumeration to the field it selects, so
+ * that selecting the current field does not need to go through the tag
+ * quarks. Only the first enumeration set is kept: definitions tagged by
+ * another enumeration use the quark lookup.
+ */
+void bt_variant_declaration_set_tag_enum(struct declaration_variant *variant_declaration,
+			struct declaration_enum *enum_declaration)
+{
+	struct declaration_untagged_variant *untagged_variant =
+		variant_declaration->untagged_variant;
+	GArray *intervals;
+	unsigned int i;
+
+	if (variant_declaration->tag_enum)
+		return;
+	if (!enum_declaration->table.intervals)
+		bt_enum_build_index(enum_declaration);
+	intervals = enum_declaration->table.intervals;
+	variant_declaration->tag_fields = g_array_sized_new(FALSE, FALSE,
+			sizeof(long), intervals->len);
+	g_array_set_size(variant_declaration->tag_fields, intervals->len);
+	for (i = 0; i < intervals->len; i++) {
+		GArray *quarks = g_array_index(intervals,
+				struct enum_interval, i).quarks;
+		gpointer value;
+		long index = -1;
+
+		if (quarks && quarks->len == 1
+				&& g_hash_table_lookup_extended(untagged_variant->fields_by_tag,
+					(gconstpointer) (unsigned long) g_array_index(quarks, GQuark, 0),
+					NULL, &value))
+			index = (unsigned long) value;
+		g_array_index(variant_declaration->tag_fields, long, i) = index;
+	}
+	bt_declaration_ref(&enum_declaration->p);
+	variant_declaration->tag_enum = enum_declaration;
+}
+
 static
 struct bt_definition *
 	_variant_definition_new(struct bt_declaration *declaration,
@@ -266,6 +311,20 @@ struct bt_definition *bt_variant_get_current_field(struct definition_variant *va
 	GQuark tag;
 	gpointer orig_key, value;
 
+	/* Fast path: field selected by the interval of the tag value. */
+	if (_enum->interval >= 0
+			&& _enum->declaration == variant_declaration->tag_enum
+			&& (unsigned int) _enum->interval < variant_declaration->tag_fields->len) {
+		long field_index = g_array_index(variant_declaration->tag_fields,
+				long, _enum->interval);
+
+		if (field_index >= 0) {
+			variant->current_field =
+				g_ptr_array_index(variant->fields, field_index);
+			return variant->current_field;
+		}
+	}
+
 	tag_array = _enum->value;
 	if (!tag_array) {
 		/* Enumeration has unknown tag. */